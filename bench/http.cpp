@@ -0,0 +1,92 @@
+#include "pichi/common/config.hpp"
+#include "utils.hpp"
+#include <array>
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/parser.hpp>
+#include <pichi/adapter/tcp/head.hpp>
+#include <pichi/common/literals.hpp>
+#include <pichi/common/uri.hpp>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <utility>
+
+using namespace std::literals;
+namespace asio = boost::asio;
+namespace head = pichi::adapter::tcp::head;
+namespace http = boost::beast::http;
+namespace sys  = boost::system;
+
+namespace pichi::bench {
+
+static auto const ROUNDS = 1000000_sz;
+
+static auto const REQUESTS = std::array{
+    std::make_pair("bare"sv, "CONNECT example.com:443 HTTP/1.1\r\nHost: example.com:443\r\n\r\n"sv),
+    std::make_pair(
+        "browser"sv,
+        "CONNECT www.example.com:443 HTTP/1.1\r\n"
+        "Host: www.example.com:443\r\n"
+        "Proxy-Connection: keep-alive\r\n"
+        "User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) AppleWebKit/537.36 "
+        "(KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+        "Proxy-Authorization: Basic cGljaGk6cGljaGk=\r\n"
+        "\r\n"sv
+    ),
+};
+
+/*
+ * The path before the fast one was introduced, which parses the head by the Beast parser, splits
+ * the target by HostAndPort and matches Proxy-Authorization by the regex.
+ */
+static auto const BASIC_AUTH_PATTERN = std::regex{"^basic ([a-z0-9+/]+={0,2})", std::regex::icase};
+
+static void beast(std::string_view name, std::string_view req)
+{
+  run(std::string{name} + "/beast", ROUNDS, [req]() {
+    auto parser = http::request_parser<http::empty_body>{};
+    auto ec     = sys::error_code{};
+    auto n      = parser.put(asio::buffer(req), ec);
+    if (ec || !parser.is_header_done()) return 0_sz;
+
+    auto& fields = parser.get();
+    auto  target = fields.target();
+    auto  hp     = HostAndPort{{target.data(), target.size()}};
+    if (hp.host_.empty() || hp.port_.empty()) return 0_sz;
+
+    if (auto it = fields.find(http::field::proxy_authorization); it != fields.end()) {
+      auto match = std::cmatch{};
+      auto auth  = it->value();
+      if (!std::regex_match(auth.begin(), auth.end(), match, BASIC_AUTH_PATTERN)) return 0_sz;
+    }
+    return n;
+  });
+}
+
+static void fast(std::string_view name, std::string_view req)
+{
+  run(std::string{name} + "/head", ROUNDS, [req]() {
+    auto end = head::find_end(ConstBuffer{req});
+    if (end == 0) return 0_sz;
+
+    auto connect = head::parse_connect(ConstBuffer{req, end});
+    if (!connect.has_value() || connect->host_.empty()) return 0_sz;
+
+    if (connect->authorization_.has_value() &&
+        !head::basic_credential(*connect->authorization_).has_value())
+      return 0_sz;
+    return end;
+  });
+}
+
+}  // namespace pichi::bench
+
+int main()
+{
+  for (auto&& [name, req] : pichi::bench::REQUESTS) {
+    pichi::bench::beast(name, req);
+    pichi::bench::fast(name, req);
+  }
+  return 0;
+}
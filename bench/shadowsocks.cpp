@@ -0,0 +1,110 @@
+#include "pichi/common/config.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <array>
+#include <botan/cipher_mode.h>
+#include <botan/sodium.h>
+#include <memory>
+#include <pichi/common/literals.hpp>
+#include <pichi/stream/shadowsocks.hpp>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+using namespace std::literals;
+namespace rngs  = std::ranges;
+namespace views = rngs::views;
+
+namespace pichi::bench {
+
+static auto const PASSWORD = "a flexible rule-based proxy"s;
+static auto const ROUNDS   = 100000_sz;
+static auto const SIZES    = std::array{64_sz, 1024_sz, 0x3fff_sz};
+
+static auto const METHODS = std::array{
+    std::make_tuple(CryptoMethod::AES_128_GCM, "aes-128-gcm"sv, "AES-128/GCM"sv, 16_sz, 12_sz),
+    std::make_tuple(CryptoMethod::AES_256_GCM, "aes-256-gcm"sv, "AES-256/GCM"sv, 32_sz, 12_sz),
+    std::make_tuple(
+        CryptoMethod::CHACHA20_IETF_POLY1305,
+        "chacha20-ietf-poly1305"sv,
+        "ChaCha20Poly1305"sv,
+        32_sz,
+        12_sz
+    ),
+};
+
+/*
+ * The implementation of Cryptor::process before the in-place path was introduced, which copies
+ * the payload and allocates the tag for each frame.
+ */
+class LegacyCryptor {
+public:
+  LegacyCryptor(std::string_view algo, Botan::Cipher_Dir dir, size_t key, size_t nonce)
+    : cryptor_{Botan::Cipher_Mode::create_or_throw(algo, dir)}, nonce_(nonce, 0_u8)
+  {
+    cryptor_->set_key(std::vector<uint8_t>(key, 0x5a_u8));
+  }
+
+  size_t process(ConstBuffer orig, MutableBuffer dest)
+  {
+    auto n = rngs::size(orig) - cryptor_->minimum_final_size();
+    rngs::copy(orig | views::take(n), rngs::begin(dest));
+    cryptor_->start(nonce_);
+    cryptor_->process(dest | views::take(n));
+
+    auto v = orig | views::drop(n);
+    auto t = std::vector<uint8_t>{rngs::begin(v), rngs::end(v)};
+    cryptor_->finish(t);
+    rngs::copy(t, rngs::begin(dest | views::drop(n)));
+
+    Botan::Sodium::sodium_increment(rngs::data(nonce_), rngs::size(nonce_));
+    return n + rngs::size(t);
+  }
+
+private:
+  std::unique_ptr<Botan::Cipher_Mode> cryptor_;
+  std::vector<uint8_t>                nonce_;
+};
+
+static void legacy(std::string_view name, std::string_view algo, size_t key, size_t nonce)
+{
+  auto encryptor = LegacyCryptor{algo, Botan::Cipher_Dir::Encryption, key, nonce};
+  auto decryptor = LegacyCryptor{algo, Botan::Cipher_Dir::Decryption, key, nonce};
+  auto plain     = std::vector<uint8_t>(0x3fff + 16, 0x5a_u8);
+  auto cipher    = std::vector<uint8_t>(rngs::size(plain));
+
+  for (auto size : SIZES)
+    run(std::string{name} + "/legacy/" + std::to_string(size), ROUNDS, [&]() {
+      auto n = encryptor.process({plain, size}, cipher);
+      return decryptor.process({cipher, n}, plain);
+    });
+}
+
+static void in_place(std::string_view name, CryptoMethod method)
+{
+  auto encryptor = stream::detail::Encryptor{method, PASSWORD};
+  auto decryptor = stream::detail::Decryptor{method};
+  auto salt      = decryptor.salt();
+  rngs::copy(encryptor.salt(), rngs::begin(salt));
+  decryptor.set_psk(PASSWORD);
+
+  auto buf = std::vector<uint8_t>(0x3fff + 16, 0x5a_u8);
+  for (auto size : SIZES)
+    run(std::string{name} + "/in-place/" + std::to_string(size), ROUNDS, [&]() {
+      auto n = encryptor.process({buf, size}, buf);
+      return decryptor.process({buf, n}, buf);
+    });
+}
+
+}  // namespace pichi::bench
+
+int main()
+{
+  for (auto&& [method, name, algo, key, nonce] : pichi::bench::METHODS) {
+    pichi::bench::legacy(name, algo, key, nonce);
+    pichi::bench::in_place(name, method);
+  }
+  return 0;
+}
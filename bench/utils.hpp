@@ -0,0 +1,34 @@
+#ifndef PICHI_BENCH_UTILS_HPP
+#define PICHI_BENCH_UTILS_HPP
+
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+
+namespace pichi::bench {
+
+/*
+ * Running the function for the specified rounds, and printing the throughput of the processed
+ * bytes, which are the return values of the function.
+ */
+template <typename Function> void run(std::string_view name, size_t rounds, Function&& f)
+{
+  using Clock = std::chrono::steady_clock;
+
+  auto bytes = size_t{0};
+  auto start = Clock::now();
+  for (auto i = size_t{0}; i < rounds; ++i) bytes += f();
+  auto elapsed = std::chrono::duration<double>{Clock::now() - start};
+
+  std::printf(
+      "%-48.*s %10.2f ns/op %10.2f MiB/s\n",
+      static_cast<int>(name.size()),
+      name.data(),
+      elapsed.count() * 1e9 / static_cast<double>(rounds),
+      static_cast<double>(bytes) / elapsed.count() / 1024.0 / 1024.0
+  );
+}
+
+}  // namespace pichi::bench
+
+#endif  // PICHI_BENCH_UTILS_HPP
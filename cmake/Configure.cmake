@@ -97,6 +97,11 @@ if(BUILD_SERVER)
   check_function_exists("strerror_r" HAS_STRERROR_R)
 endif()
 
+include(CheckSymbolExists)
+set(CMAKE_REQUIRED_DEFINITIONS -D_GNU_SOURCE)
+check_symbol_exists("splice" "fcntl.h" HAS_SPLICE)
+unset(CMAKE_REQUIRED_DEFINITIONS)
+
 configure_file(${CMAKE_SOURCE_DIR}/include/pichi/common/config.hpp.in
   ${CMAKE_BINARY_DIR}/include/pichi/common/config.hpp)
 
@@ -118,7 +118,9 @@ endif()
 list(APPEND BOOST_MACROS
   BOOST_ASIO_NO_DEPRECATED
   BOOST_ASIO_DISABLE_ERROR_LOCATION
-  BOOST_FILESYSTEM_NO_DEPRECATED)
+  BOOST_FILESYSTEM_NO_DEPRECATED
+  # Each relayed chunk nests several coroutine frames, whose recycling needs more slots than 2
+  BOOST_ASIO_RECYCLING_ALLOCATOR_CACHE_SIZE=16)
 if(NOT ${Boost_VERSION} VERSION_EQUAL "1.81.0")
   # Boost.Beast 1.81.0 contains an error when BOOST_BEAST_NO_SOURCE_LOCATION enabled
   list(APPEND BOOST_MACROS BOOST_BEAST_NO_SOURCE_LOCATION)
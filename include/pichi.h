@@ -1,12 +1,48 @@
 #ifndef PICHI_H
 #define PICHI_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif  // __cplusplus
 
+/*
+ * The options of PICHI server, which are
+ *   - bind: server listening address, NOT NULL,
+ *   - port: server listening port,
+ *   - mmdb: IP GEO database, MMDB format, or NULL,
+ *   - threads: the number of worker threads, including the caller thread,
+ *   - replay_window: seconds of remembering shadowsocks salts,
+ *   - replay_capacity: shadowsocks salts per replay window,
+ *   - replay_fp: false-positive rate of replay detection,
+ *   - dns_ttl: seconds of caching DNS answers,
+ *   - dns_negative_ttl: seconds of caching DNS failures,
+ *   - connect_delay: milliseconds between racing connection attempts,
+ *   - route_cache: cached routing decisions, 0 to disable,
+ *   - ticket_rotation: seconds of rotating TLS ticket keys, 0 to disable tickets.
+ */
+struct pichi_server_options {
+  char const*  bind;
+  uint16_t     port;
+  char const*  mmdb;
+  unsigned int threads;
+  uint32_t     replay_window;
+  size_t       replay_capacity;
+  double       replay_fp;
+  uint32_t     dns_ttl;
+  uint32_t     dns_negative_ttl;
+  uint32_t     connect_delay;
+  size_t       route_cache;
+  uint32_t     ticket_rotation;
+};
+
+/*
+ * Fill the options with the default values, where bind and mmdb are NULL and port is 0.
+ */
+extern void pichi_init_server_options(struct pichi_server_options* opts);
+
 /*
  * Start PICHI server according to
  *   - bind: server listening address, NOT NULL,
@@ -16,6 +52,12 @@ extern "C" {
  */
 extern int pichi_run_server(char const* bind, uint16_t port, char const* mmdb);
 
+/*
+ * Start PICHI server as pichi_run_server does, but according to all options.
+ * The function doesn't return if no error occurs, otherwise -1.
+ */
+extern int pichi_run_server_mt(struct pichi_server_options const* opts);
+
 #ifdef __cplusplus
 }
 #endif  // __cplusplus
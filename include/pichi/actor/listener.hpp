@@ -3,9 +3,13 @@
 
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/strand.hpp>
+#include <chrono>
 #include <memory>
+#include <optional>
 #include <pichi/actor/router.hpp>
 #include <pichi/common/coro.hpp>
+#include <pichi/stream/shadowsocks.hpp>
+#include <pichi/stream/tls_server.hpp>
 #include <pichi/vo/ingress.hpp>
 #include <vector>
 
@@ -13,23 +17,49 @@ namespace pichi::actor {
 
 class Listener {
 private:
-  using Acceptor  = boost::asio::ip::tcp::acceptor;
-  using Acceptors = std::vector<Acceptor>;
-  using RouterPtr = std::shared_ptr<Router>;
-  using Strand    = boost::asio::strand<IOExecutor>;
-  using Ingress   = vo::Ingress;
+  using Acceptor   = boost::asio::ip::tcp::acceptor;
+  using Acceptors  = std::vector<Acceptor>;
+  using RouterPtr  = std::shared_ptr<Router>;
+  using Strand     = boost::asio::strand<IOExecutor>;
+  using Ingress    = vo::Ingress;
+  using IngressPtr = std::shared_ptr<Ingress const>;
+  using TlsPtr     = std::shared_ptr<stream::TlsServerContext>;
+  using KeyPtr     = stream::MasterKey;
+  using Seconds    = std::chrono::seconds;
 
-  Awaitable<void> listen(Acceptor&);
+  /*
+   * The worker is shared by its accepting coroutines and the rerouting handlers, which run on the
+   * worker thread and might outlive the listener destroyed by the primary thread.
+   */
+  struct Worker {
+    Strand    strand_;
+    RouterPtr router_;
+    Acceptors acceptors_;
+  };
+
+  using WorkerPtr = std::shared_ptr<Worker>;
+  using Workers   = std::vector<WorkerPtr>;
+
+  // The configuration is shared with the sessions, which might outlive the listener
+  static Awaitable<void> listen(Workers, IngressPtr, TlsPtr, KeyPtr);
+  static Awaitable<void> accept(WorkerPtr, Acceptor&, IngressPtr, TlsPtr, KeyPtr);
+
+  // Close the acceptors by their own worker threads, and detach the listener from the workers
+  void stop();
 
 public:
-  Listener(IOExecutor const&, RouterPtr const&, Ingress);
+  // The rotation interval of TLS ticket keys is ignored unless the ingress is over TLS
+  Listener(
+      IOExecutor const&, RouterPtr const&, Ingress,
+      Seconds rotation = stream::TlsServerContext::DEFAULT_ROTATION
+  );
   ~Listener();
 
   Listener(Listener const&) = delete;
   Listener(Listener&&)      = default;
 
   Listener& operator=(Listener const&) = delete;
-  Listener& operator=(Listener&&)      = default;
+  Listener& operator=(Listener&&);
 
   void start();
 
@@ -37,11 +67,13 @@ public:
 
   Ingress const& vo() const;
 
+  std::optional<stream::TlsStats> tls_stats() const;
+
 private:
-  Strand    strand_;
-  RouterPtr router_;
-  Ingress   vo_;
-  Acceptors acceptors_ = {};
+  IngressPtr vo_;
+  TlsPtr     tls_;
+  KeyPtr     key_;
+  Workers    workers_ = {};
 };
 
 }  // namespace pichi::actor
@@ -1,17 +1,23 @@
 #ifndef PICHI_ACTOR_ROUTER_HPP
 #define PICHI_ACTOR_ROUTER_HPP
 
+#include <array>
 #include <boost/asio/ip/basic_resolver_results.hpp>
-#include <boost/asio/ip/network_v4.hpp>
-#include <boost/asio/ip/network_v6.hpp>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <pichi/adapter/tcp/connector.hpp>
 #include <pichi/common/coro.hpp>
 #include <pichi/common/endpoint.hpp>
+#include <pichi/common/pattern.hpp>
 #include <pichi/service/mmdb.hpp>
+#include <pichi/stream/tls.hpp>
 #include <pichi/vo/egress.hpp>
 #include <pichi/vo/route.hpp>
 #include <pichi/vo/rule.hpp>
-#include <regex>
 #include <string>
 #include <string_view>
 #include <tuple>
@@ -30,56 +36,155 @@ namespace pichi::actor {
 
 using ResolveResults = boost::asio::ip::basic_resolver_results<boost::asio::ip::tcp>;
 
-namespace detail {
+// The egress compiled once per router, which is shared by all the sessions routed to it
+using SharedConnector = std::shared_ptr<adapter::tcp::Connector const>;
 
-class Matcher {
-private:
-  bool match_range(ResolveResults const&) const;
+struct RouterStats {
+  size_t capacity_ = 0;
+  size_t entries_  = 0;
+  size_t hits_     = 0;
+  size_t misses_   = 0;
+};
+
+namespace detail {
 
-  bool match_pattern(std::string const&) const;
+inline constexpr auto NONE = std::numeric_limits<size_t>::max();
 
-  bool match_domain(Endpoint const&) const;
+// The interned countries of the resolved addresses
+using Countries = std::vector<service::Mmdb::Country>;
 
+class Matcher {
 public:
-  Matcher(std::string_view, vo::Rule const&, std::string_view, vo::Egress const&);
+  Matcher(std::string_view, vo::Rule const&, std::string_view, SharedConnector, service::Mmdb&);
   Matcher(
-      std::string_view, vo::Rule const&, std::string_view, vo::Egress const&,
+      std::string_view, vo::Rule const&, std::string_view, SharedConnector,
       std::function<Awaitable<bool>(Endpoint const&)> f
   );
 
-  bool match(
-      Endpoint const&, std::string const&, AdapterType, std::optional<ResolveResults> const&,
-      service::Mmdb& mmdb
-  ) const;
+  bool match(Endpoint const&, std::string const&, AdapterType, std::optional<Countries> const&)
+      const;
 
   bool need_resolving() const;
+  bool need_locating() const;
 
-  std::string const& rname() const;
-  std::string const& ename() const;
-  vo::Egress const&  egress() const;
+  std::string const&     rname() const;
+  std::string const&     ename() const;
+  SharedConnector const& egress() const;
 
 private:
-  std::string rname_;
-  std::string ename_;
-  vo::Egress  egress_;
+  std::string     rname_;
+  std::string     ename_;
+  SharedConnector egress_;
 
   bool resolve_;
 
-  std::vector<boost::asio::ip::network_v4> ranges4_ = {};
-  std::vector<boost::asio::ip::network_v6> ranges6_ = {};
-
   std::unordered_set<std::string> inames_ = {};
 
   std::unordered_set<AdapterType> types_ = {};
 
-  std::vector<std::regex> patterns_ = {};
-
-  std::vector<std::string> domains_   = {};
-  std::vector<std::string> countries_ = {};
+  Countries countries_ = {};
 };
 
 template <typename Value> using ValueMap = std::unordered_map<std::string, Value>;
 
+using Connectors = ValueMap<SharedConnector>;
+
+/*
+ * All domains of the routed rules are compiled into one trie whose edges are the labels, from the
+ * top level one to the leftmost one. Each node records the least index of the matchers owning the
+ * domain terminated by the node, so that the first matched rule is found by one pass over the host.
+ */
+class DomainTrie {
+private:
+  struct Hash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+  };
+
+  struct Node {
+    std::unordered_map<std::string, size_t, Hash, std::equal_to<>> children_ = {};
+
+    size_t index_ = NONE;
+  };
+
+  void insert(std::string_view, size_t);
+
+public:
+  DomainTrie(vo::Route const&, ValueMap<vo::Rule> const&);
+
+  std::optional<size_t> match(Endpoint const&) const;
+
+private:
+  std::vector<Node> nodes_ = {Node{}};
+};
+
+/*
+ * All networks of the routed rules are flattened into the sorted and disjoint segments, each of
+ * which records the least index of the matchers covering it. CIDR blocks are either nested or
+ * disjoint, so the flattening is a single sweep and an address is matched by one binary search.
+ *
+ * The matchers preceding the first one needing resolving never see the resolved results of a
+ * domain, so that their networks are kept in the separated segments.
+ */
+class RangeTable {
+private:
+  template <size_t N> struct Segments {
+    using Bytes = std::array<unsigned char, N>;
+
+    std::vector<Bytes>  starts_  = {};
+    std::vector<size_t> indices_ = {};
+
+    void emit(Bytes const&, size_t);
+
+    size_t match(Bytes const&) const;
+  };
+
+  struct Table {
+    Segments<4>  v4_ = {};
+    Segments<16> v6_ = {};
+
+    size_t match(ResolveResults const&) const;
+  };
+
+public:
+  RangeTable(vo::Route const&, ValueMap<vo::Rule> const&, size_t resolving);
+
+  std::optional<size_t> match(ResolveResults const&, bool resolved) const;
+
+private:
+  Table preceding_ = {};
+  Table following_ = {};
+};
+
+/*
+ * DecisionCache remembers the indices of the matched matchers, or NONE for the default egress, by
+ * the destination, the ingress name and the ingress type. It's a bounded LRU shared by all worker
+ * threads, which lives as long as the router owning it, so that updating the rules, the route or
+ * the egresses invalidates it naturally.
+ */
+class DecisionCache {
+private:
+  using Lru   = std::list<std::pair<std::string, size_t>>;
+  using Index = std::unordered_map<std::string_view, Lru::iterator>;
+
+public:
+  explicit DecisionCache(size_t);
+
+  std::optional<size_t> find(std::string const&);
+  void                  insert(std::string, size_t);
+
+  RouterStats stats();
+
+private:
+  std::mutex mutex_    = {};
+  size_t     capacity_ = 0;
+  size_t     hits_     = 0;
+  size_t     misses_   = 0;
+  Lru        lru_      = {};
+  Index      index_    = {};
+};
+
 }  // namespace detail
 
 class Router {
@@ -89,21 +194,42 @@ private:
   using Matchers = std::vector<detail::Matcher>;
 
 public:
+  /*
+   * Rule name, egress name, compiled egress and the addresses of the peer if they have been
+   * resolved while routing, which are reusable for connecting directly.
+   */
+  using Result =
+      std::tuple<std::string, std::string, SharedConnector, std::optional<ResolveResults>>;
+
+  // Decisions are cached only if the capacity of the cache is not 0
   Router(
-      IOExecutor const&, ValueMap<vo::Egress> const&, ValueMap<vo::Rule> const&, vo::Route const&
+      IOExecutor const&, ValueMap<vo::Egress> const&, ValueMap<vo::Rule> const&, vo::Route const&,
+      size_t cache = 0
   );
 
-  Awaitable<std::tuple<std::string, std::string, vo::Egress>>
-      route(Endpoint const&, std::string const&, AdapterType) const;
+  Awaitable<Result> route(Endpoint const&, std::string const&, AdapterType) const;
 
-  Awaitable<std::tuple<std::string, std::string, vo::Egress>>
+  Awaitable<Result>
       route(Endpoint const&, std::string const&, AdapterType, Awaitable<ResolveResults>) const;
 
+  RouterStats stats() const;
+
+  // The handshakes of the TLS egresses used by the route, by their names
+  ValueMap<stream::TlsStats> tls_stats() const;
+
 private:
-  IOExecutor ex_;
-  Matchers   matchers_ = {};
+  Result decide(size_t, std::optional<ResolveResults>) const;
+
+  IOExecutor         ex_;
+  detail::Connectors connectors_;
+  Matchers           matchers_ = {};
+  detail::DomainTrie domains_;
+  detail::RangeTable ranges_;
+  PatternSet         patterns_;
+
+  std::tuple<std::string, std::string, SharedConnector> default_;
 
-  std::tuple<std::string, std::string, vo::Egress> default_;
+  std::unique_ptr<detail::DecisionCache> cache_;
 };
 
 }  // namespace pichi::actor
@@ -5,6 +5,7 @@
 #include <boost/asio/strand.hpp>
 #include <boost/beast/http/message.hpp>
 #include <boost/beast/http/string_body.hpp>
+#include <chrono>
 #include <memory>
 #include <pichi/actor/listener.hpp>
 #include <pichi/actor/router.hpp>
@@ -29,7 +30,11 @@ public:
   using Request  = boost::beast::http::request<HttpBody>;
   using Response = boost::beast::http::response<HttpBody>;
 
-  explicit Server(IOExecutor const&);
+  // Routing decisions are cached if the capacity of the cache is not 0
+  explicit Server(
+      IOExecutor const&, size_t cache = 0,
+      std::chrono::seconds rotation = stream::TlsServerContext::DEFAULT_ROTATION
+  );
 
   Awaitable<void> serve(boost::asio::ip::tcp::endpoint);
 
@@ -45,8 +50,10 @@ private:
   ValueMap<vo::Egress> egresses_;
   ValueMap<vo::Rule>   rules_ = {};
 
-  vo::Route route_;
-  RouterPtr router_;
+  vo::Route            route_;
+  size_t               cache_;
+  std::chrono::seconds rotation_;
+  RouterPtr            router_;
 };
 
 }  // namespace pichi::actor
@@ -3,9 +3,11 @@
 
 #include <boost/asio/ip/tcp.hpp>
 #include <memory>
+#include <optional>
 #include <pichi/actor/router.hpp>
 #include <pichi/adapter/tcp/adapter.hpp>
 #include <pichi/common/coro.hpp>
+#include <pichi/common/endpoint.hpp>
 #include <pichi/common/enumerations.hpp>
 #include <pichi/vo/ingress.hpp>
 
@@ -13,10 +15,22 @@ namespace pichi::actor {
 
 class Session {
 private:
-  using RouterPtr = std::shared_ptr<Router>;
-  using Socket    = boost::asio::ip::tcp::socket;
-
-  Awaitable<adapter::tcp::Egress> handshake(adapter::tcp::Ingress&, vo::Ingress const&);
+  using RouterPtr  = std::shared_ptr<Router>;
+  using Socket     = boost::asio::ip::tcp::socket;
+  using IngressPtr = std::shared_ptr<vo::Ingress const>;
+
+  // The egress connected to the remote via the connector chosen by the router
+  struct Upstream {
+    SharedConnector      connector_;
+    Endpoint             remote_;
+    adapter::tcp::Egress egress_;
+  };
+
+  Awaitable<Upstream> dial(Endpoint const&, vo::Ingress const&);
+  Awaitable<std::optional<Upstream>> handshake(adapter::tcp::Ingress&, vo::Ingress const&);
+  Awaitable<void>                    demultiplex(adapter::tcp::Ingress&, IngressPtr const&);
+  Awaitable<void>                    exchange(adapter::tcp::Ingress&, Upstream);
+  Awaitable<void>                    run(adapter::tcp::Ingress, IngressPtr);
 
 public:
   template <boost::asio::execution::executor Executor>
@@ -24,7 +38,9 @@ public:
   {
   }
 
-  Awaitable<void> start(vo::Ingress const&, Socket);
+  // The configuration is shared, so that it outlives the ingress deleted or replaced meanwhile
+  Awaitable<void>
+      start(IngressPtr, adapter::tcp::TlsContext const&, stream::MasterKey const&, Socket);
 
 private:
   IOExecutor ex_;
@@ -1,10 +1,16 @@
 #ifndef PICHI_ADAPTER_TCP_ADAPTER_HPP
 #define PICHI_ADAPTER_TCP_ADAPTER_HPP
 
+#include <boost/asio/execution_context.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <pichi/adapter/tcp/connector.hpp>
 #include <pichi/adapter/tcp/direct.hpp>
 #include <pichi/adapter/tcp/dual.hpp>
 #include <pichi/adapter/tcp/http.hpp>
+#include <pichi/adapter/tcp/mux.hpp>
 #include <pichi/adapter/tcp/reject.hpp>
 #include <pichi/adapter/tcp/shadowsocks.hpp>
 #include <pichi/adapter/tcp/socks5.hpp>
@@ -12,12 +18,16 @@
 #include <pichi/adapter/tcp/trojan.hpp>
 #include <pichi/adapter/tcp/tunnel.hpp>
 #include <pichi/common/coro.hpp>
+#include <pichi/common/endpoint.hpp>
 #include <pichi/stream/concepts.hpp>
 #include <pichi/stream/tls.hpp>
 #include <pichi/stream/websocket.hpp>
 #include <pichi/vo/egress.hpp>
 #include <pichi/vo/ingress.hpp>
+#include <optional>
+#include <stddef.h>
 #include <variant>
+#include <vector>
 
 namespace pichi::adapter::tcp {
 
@@ -25,18 +35,67 @@ using Socket    = boost::asio::ip::tcp::socket;
 using Tls       = stream::Tls<Socket>;
 using Websocket = stream::Websocket<Tls>;
 
+// The TLS server context shared by all sessions of a listener, or null if TLS is disabled
+using TlsContext = std::shared_ptr<boost::asio::ssl::context>;
+
 using Ingress = std::variant<
     DualIngress<Socket>, DualIngress<Tls>, HttpIngress<Socket>, HttpIngress<Tls>,
     Socks5Ingress<Socket>, Socks5Ingress<Tls>, TrojanIngress<Tls>, TrojanIngress<Websocket>,
-    Shadowsocks<Socket>, TransparentIngress, Tunnel>;
+    Shadowsocks<Socket>, TransparentIngress, Tunnel, MuxIngress>;
 
 using Egress = std::variant<
     Direct, RejectEgress, HttpEgress<Socket>, HttpEgress<Tls>, Socks5Egress<Socket>,
-    Socks5Egress<Tls>, TrojanEgress<Tls>, TrojanEgress<Websocket>, Shadowsocks<Socket>>;
+    Socks5Egress<Tls>, TrojanEgress<Tls>, TrojanEgress<Websocket>, Shadowsocks<Socket>,
+    MuxEgress>;
+
+// The master key is null unless the ingress is shadowsocks
+template <stream::AsyncSocket Socket>
+Ingress create_ingress(vo::Ingress const&, TlsContext const&, stream::MasterKey const&, Socket);
+
+extern Egress create_egress(std::shared_ptr<Connector const> const&, IOExecutor const&);
+
+/*
+ * IdlePool keeps the egresses left idle by the HTTP exchanges per worker thread, whose upstream
+ * connections can carry the following requests to the same remote via the same egress. An idle
+ * egress is closed by the timer after a few seconds, before the upstream is likely to close it.
+ * Only the egresses on the raw sockets are kept, so that each one can be probed before reused,
+ * and the one closed or spoken by the upstream meanwhile is dropped rather than reused.
+ */
+class IdlePool : public boost::asio::detail::execution_context_service_base<IdlePool> {
+private:
+  using Clock = std::chrono::steady_clock;
+  using Key   = std::weak_ptr<Connector const>;
+
+  struct Idle {
+    Endpoint          remote_;
+    Egress            egress_;
+    Clock::time_point since_;
+  };
+
+  void            shutdown() noexcept override;
+  void            drop(Egress);
+  void            expire(Clock::time_point);
+  Awaitable<void> sweep();
+
+public:
+  // Most servers close the idle connections after 5 seconds
+  static constexpr auto   TIMEOUT = std::chrono::seconds{4};
+  static constexpr size_t LIMIT   = 64;
+
+  explicit IdlePool(boost::asio::execution_context&);
+
+  void initialize(IOExecutor const&);
+
+  std::optional<Egress> acquire(std::shared_ptr<Connector const> const&, Endpoint const&);
+  void                  release(std::shared_ptr<Connector const> const&, Endpoint, Egress);
 
-template <stream::AsyncSocket Socket> Ingress create_ingress(vo::Ingress const&, Socket);
+private:
+  std::optional<IOExecutor>                              ex_       = {};
+  bool                                                   sweeping_ = false;
+  std::map<Key, std::vector<Idle>, std::owner_less<Key>> entries_  = {};
+};
 
-extern Egress create_egress(vo::Egress const&, IOExecutor const&);
+extern IdlePool& get_idle_pool(IOExecutor const&);
 
 }  // namespace pichi::adapter::tcp
 
@@ -0,0 +1,39 @@
+#ifndef PICHI_ADAPTER_TCP_CONNECTOR_HPP
+#define PICHI_ADAPTER_TCP_CONNECTOR_HPP
+
+#include <boost/asio/ssl/context.hpp>
+#include <memory>
+#include <pichi/stream/shadowsocks.hpp>
+#include <pichi/vo/egress.hpp>
+#include <string>
+
+namespace pichi::adapter::tcp {
+
+/*
+ * Connector is an egress compiled once while the router is built, which holds the TLS context
+ * with the loaded CA file, the credential serialized as it's sent to the proxy, and the master key
+ * derived from the shadowsocks password. It's immutable after construction and shared by the
+ * sessions of all worker threads.
+ */
+class Connector {
+private:
+  using Context = boost::asio::ssl::context;
+
+public:
+  explicit Connector(vo::Egress);
+
+  vo::Egress const&               vo() const;
+  std::shared_ptr<Context> const& tls() const;
+  std::string const&              credential() const;
+  stream::MasterKey const&        master_key() const;
+
+private:
+  vo::Egress               vo_;
+  std::shared_ptr<Context> tls_        = {};
+  std::string              credential_ = {};
+  stream::MasterKey        master_key_ = {};
+};
+
+}  // namespace pichi::adapter::tcp
+
+#endif  // PICHI_ADAPTER_TCP_CONNECTOR_HPP
@@ -11,7 +11,8 @@ namespace pichi::adapter::tcp {
 
 class Direct {
 private:
-  using Socket = boost::asio::ip::tcp::socket;
+  using Socket         = boost::asio::ip::tcp::socket;
+  using ResolveResults = boost::asio::ip::tcp::resolver::results_type;
 
 public:
   template <boost::asio::execution::executor Executor>
@@ -20,10 +21,13 @@ public:
   }
 
   Awaitable<void>   connect(Endpoint const&);
+  Awaitable<void>   connect(Endpoint const&, ResolveResults const&);
   Awaitable<size_t> recv(MutableBuffer);
   Awaitable<void>   send(ConstBuffer);
   Awaitable<void>   close();
 
+  Socket* raw_socket();
+
 private:
   Socket socket_;
 };
@@ -28,7 +28,16 @@ public:
   Awaitable<void>     confirm();
   Awaitable<void>     disconnect(boost::system::error_code const&);
 
+  // Forwarded to the HTTP delegate, or false for SOCKS5
+  bool persistent() const;
+  bool requested() const;
+  bool responded() const;
+  bool kept_alive() const;
+  bool reusable() const;
+
 private:
+  HttpIngress<NextLayer> const* http() const;
+
   vo::Ingress vo_;
   NextLayer   underlying_;
   Delegate    delegate_;
@@ -0,0 +1,51 @@
+#ifndef PICHI_ADAPTER_TCP_H2_HPP
+#define PICHI_ADAPTER_TCP_H2_HPP
+
+#include <deque>
+#include <pichi/adapter/tcp/mux.hpp>
+#include <pichi/common/buffer.hpp>
+#include <pichi/common/coro.hpp>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pichi::adapter::tcp::h2 {
+
+/*
+ * Decoder decompresses the header blocks sent by the client @RFC7541. Its dynamic table lives as
+ * long as the connection, and never exceeds the default 4096 bytes, which is what the server
+ * advertises.
+ */
+class Decoder {
+public:
+  using Field  = std::pair<std::string, std::string>;
+  using Fields = std::vector<Field>;
+
+  static constexpr size_t TABLE_SIZE = 4096;
+
+  // Throw if the block is malformed, or the decoded fields exceed the limit in total
+  Fields decode(ConstBuffer, size_t limit = 64 * 1024);
+
+private:
+  Field get(size_t) const;
+  Field literal(ConstBuffer&, uint8_t) const;
+  void  insert(Field);
+  void  evict(size_t);
+
+  std::deque<Field> table_    = {};
+  size_t            size_     = 0;
+  size_t            capacity_ = TABLE_SIZE;
+};
+
+/*
+ * Serve the HTTP/2 connection, whose preface has been consumed by the transport, until it's closed.
+ * Only the CONNECT requests are accepted, each of which becomes a stream handed to accept after
+ * being authenticated by the transport. The stream is answered by Stream::respond.
+ */
+template <typename Transport> Awaitable<void> serve(IOExecutor const&, Transport, mux::Accept);
+
+}  // namespace pichi::adapter::tcp::h2
+
+#endif  // PICHI_ADAPTER_TCP_H2_HPP
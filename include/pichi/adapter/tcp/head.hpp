@@ -0,0 +1,39 @@
+#ifndef PICHI_ADAPTER_TCP_HEAD_HPP
+#define PICHI_ADAPTER_TCP_HEAD_HPP
+
+#include <optional>
+#include <pichi/common/buffer.hpp>
+#include <stddef.h>
+#include <string_view>
+
+namespace pichi::adapter::tcp::head {
+
+/*
+ * The fast path for the HTTP/1 CONNECT requests, which make up most of the HTTP ingress traffic.
+ * The request head is scanned and parsed in place without any allocation, and anything beyond
+ * the plain form of CONNECT is left to the Beast parser.
+ */
+
+// The length of the head ended by the first blank line, or 0 if the head is incomplete
+extern size_t find_end(ConstBuffer, size_t from = 0);
+
+// Whether the incomplete head might still turn out to be a CONNECT request on the fast path
+extern bool maybe_connect(ConstBuffer);
+
+struct Connect {
+  std::string_view host_;
+  std::string_view port_;
+
+  // The value of Proxy-Authorization if any
+  std::optional<std::string_view> authorization_;
+};
+
+// Parse the complete head, or nullopt if it's not a CONNECT request on the fast path
+extern std::optional<Connect> parse_connect(ConstBuffer);
+
+// The credential of the Basic authentication, or nullopt if the value is malformed
+extern std::optional<std::string_view> basic_credential(std::string_view);
+
+}  // namespace pichi::adapter::tcp::head
+
+#endif  // PICHI_ADAPTER_TCP_HEAD_HPP
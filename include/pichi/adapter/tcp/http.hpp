@@ -1,9 +1,15 @@
 #ifndef PICHI_ADAPTER_TCP_HTTP_HPP
 #define PICHI_ADAPTER_TCP_HTTP_HPP
 
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/ip/tcp.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/fields.hpp>
 #include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/status.hpp>
+#include <boost/optional/optional.hpp>
+#include <boost/system/error_code.hpp>
 #include <pichi/common/buffer.hpp>
 #include <pichi/common/coro.hpp>
 #include <pichi/common/endpoint.hpp>
@@ -11,7 +17,11 @@
 #include <pichi/stream/tls.hpp>
 #include <pichi/vo/egress.hpp>
 #include <pichi/vo/ingress.hpp>
+#include <memory>
+#include <optional>
+#include <stdint.h>
 #include <string>
+#include <string_view>
 #include <unordered_set>
 #include <variant>
 
@@ -30,6 +40,35 @@ template <bool isRequest> using Message = boost::beast::http::message<isRequest,
 using Request                           = Message<true>;
 using Response                          = Message<false>;
 
+// The body relayed as it is, whose bytes are only counted by the parser to find the message end
+struct RelayedBody {
+  struct value_type {};
+
+  class reader {
+  public:
+    template <bool isRequest, typename Fields>
+    reader(boost::beast::http::header<isRequest, Fields>&, value_type&)
+    {
+    }
+
+    void init(boost::optional<uint64_t> const&, boost::system::error_code& ec) { ec = {}; }
+
+    template <typename ConstBufferSequence>
+    size_t put(ConstBufferSequence const& buffers, boost::system::error_code& ec)
+    {
+      ec = {};
+      return boost::asio::buffer_size(buffers);
+    }
+
+    void finish(boost::system::error_code& ec) { ec = {}; }
+  };
+};
+
+template <bool isRequest>
+using Tracker         = boost::beast::http::parser<isRequest, RelayedBody>;
+using RequestTracker  = Tracker<true>;
+using ResponseTracker = Tracker<false>;
+
 template <stream::AsyncLayer NextLayer> struct InvalidManner {
   Awaitable<size_t> recv(NextLayer&, MutableBuffer);
   Awaitable<void>   send(NextLayer&, ConstBuffer);
@@ -44,25 +83,61 @@ public:
   Awaitable<void>   send(NextLayer&, ConstBuffer);
   Awaitable<void>   confirm(NextLayer&);
 
+  bool drained() const;
+
 private:
   Cache cache_;
 };
 
+/*
+ * ProxyManner relays a plain request, whose header has been parsed by the tracker. Unless the
+ * request is upgrading the protocol, both the request and its response are tracked to their ends,
+ * so that the client connection can carry the following request and the upstream one can be
+ * reused. Otherwise the bytes are relayed as they are until either side closes.
+ *
+ * The trackers are held by pointers since Beast parsers are not movable.
+ */
 template <stream::AsyncLayer NextLayer> class ProxyManner {
 public:
-  explicit ProxyManner(Cache, Request);
+  ProxyManner(Cache, std::unique_ptr<RequestTracker>);
 
   Awaitable<size_t> recv(NextLayer&, MutableBuffer);
   Awaitable<void>   send(NextLayer&, ConstBuffer);
   Awaitable<void>   confirm(NextLayer&);
 
+  bool persistent() const;
+  bool requested() const;
+  bool responded() const;
+  bool kept_alive() const;
+  bool reusable() const;
+
+  // The client bytes following the request
+  Cache release();
+
 private:
+  void              reset();
+  size_t            track(MutableBuffer);
+  Awaitable<void>   reply(NextLayer&);
+  Awaitable<size_t> relay(NextLayer&, ConstBuffer);
+
   Cache in_;
-  Cache out_;
+  Cache head_ = {};
+  Cache out_  = {};
+
+  std::unique_ptr<RequestTracker>  request_;
+  std::unique_ptr<ResponseTracker> response_ = {};
 
-  ResponseParser parser_;
+  bool persistent_;
+  bool keep_alive_;
+  bool surplus_ = false;
 };
 
+// The value of Proxy-Authorization, or empty if no authentication
+extern std::string gen_credential(vo::Egress const&);
+
+// The status replied to the client if the session fails for the error
+extern boost::beast::http::status to_status(boost::system::error_code const&);
+
 }  // namespace detail
 
 template <stream::AsyncLayer NextLayer> class HttpIngress {
@@ -85,12 +160,35 @@ public:
 
   Awaitable<Endpoint> continue_read_remote(ConstBuffer);
 
+  boost::asio::ip::tcp::socket* raw_socket();
+
+  // Whether the client sent the HTTP/2 connection preface rather than a single request
+  bool multiplexed() const;
+
+  // Throw if the credentials are required but not carried by the fields
+  void authenticate(boost::beast::http::fields const&) const;
+
+  /*
+   * Whether a plain request is being proxied with its end tracked, so that the exchange is over
+   * once both the request and its response are relayed. The client connection is kept alive for
+   * the next request read by read_remote, and the upstream one can be reused by another exchange
+   * to the same remote.
+   */
+  bool persistent() const;
+  bool requested() const;
+  bool responded() const;
+  bool kept_alive() const;
+  bool reusable() const;
+
 private:
+  // Throw if the credentials are required but not carried by the Proxy-Authorization value
+  void authenticate(std::optional<std::string_view>) const;
+
   NextLayer underlying_;
   Manner    manner_;
+  bool      multiplexed_ = false;
 
-  detail::RequestParser parser_ = {};
-  detail::Cache         cache_  = {};
+  detail::Cache cache_ = {};
 
   Credentials credentials_;
 };
@@ -98,6 +196,7 @@ private:
 template <stream::AsyncLayer NextLayer> class HttpEgress {
 public:
   explicit HttpEgress(vo::Egress const&, NextLayer);
+  HttpEgress(vo::Egress const&, std::string credential, NextLayer);
 
   Awaitable<size_t> recv(MutableBuffer);
   Awaitable<void>   send(ConstBuffer);
@@ -105,6 +204,8 @@ public:
 
   Awaitable<void> connect(Endpoint const&);
 
+  boost::asio::ip::tcp::socket* raw_socket();
+
 private:
   NextLayer     underlying_;
   Endpoint      peer_;
@@ -0,0 +1,194 @@
+#ifndef PICHI_ADAPTER_TCP_MUX_HPP
+#define PICHI_ADAPTER_TCP_MUX_HPP
+
+#include <boost/asio/execution_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/system/error_code.hpp>
+#include <functional>
+#include <map>
+#include <memory>
+#include <pichi/adapter/tcp/connector.hpp>
+#include <pichi/common/buffer.hpp>
+#include <pichi/common/coro.hpp>
+#include <pichi/common/endpoint.hpp>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace pichi::adapter::tcp {
+
+namespace mux {
+
+/*
+ * A multiplexed connection is a Trojan connection requested by the MUX command, after which both
+ * sides exchange the frames:
+ *
+ *   +-----+-----------+--------+---------+
+ *   | CMD | STREAM ID | LENGTH | PAYLOAD |
+ *   +-----+-----------+--------+---------+
+ *   |  1  |     4     |   2    | <= 16K  |
+ *   +-----+-----------+--------+---------+
+ *
+ * SYN opens a stream with the remote address as its payload, PSH carries the data, FIN closes the
+ * stream in both directions, and UPD returns the consumed bytes to the window of the sender. Only
+ * the client side opens the streams, whose IDs are odd, and it sends the data without awaiting any
+ * reply, so that a stream costs no round trip.
+ */
+enum class Command : uint8_t { SYN = 0, PSH = 1, FIN = 2, UPD = 3 };
+
+inline constexpr size_t   HEADER_SIZE = 7;
+inline constexpr size_t   MAX_FRAME   = 16 * 1024;
+inline constexpr uint32_t WINDOW      = 256 * 1024;
+
+class Stream;
+
+// The type-erased connection carrying the streams
+class Link : public std::enable_shared_from_this<Link> {
+public:
+  virtual ~Link() = default;
+
+  virtual Awaitable<std::shared_ptr<Stream>> open(Endpoint const&)                        = 0;
+  virtual Awaitable<void>                    write(Command, uint32_t, ConstBuffer)        = 0;
+  virtual Awaitable<void>                    respond(uint32_t, boost::system::error_code) = 0;
+  virtual void                               release(uint32_t)                            = 0;
+
+  virtual size_t streams() const = 0;
+  virtual bool   is_open() const = 0;
+};
+
+/*
+ * Stream buffers the received bytes until they are consumed, and the peer is never allowed to send
+ * more than WINDOW bytes unconsumed, so that a slow session can't stall the others sharing the
+ * same connection.
+ */
+class Stream {
+private:
+  using Timer  = boost::asio::steady_timer;
+  using Buffer = boost::beast::flat_buffer;
+
+public:
+  // The stream may send credit bytes before the peer grants more, and at most limit in total
+  Stream(
+      std::shared_ptr<Link>, uint32_t, IOExecutor const&, int64_t credit = WINDOW,
+      int64_t limit = WINDOW
+  );
+  ~Stream();
+
+  Stream(Stream const&)            = delete;
+  Stream& operator=(Stream const&) = delete;
+
+  Awaitable<size_t> recv(MutableBuffer);
+  Awaitable<void>   send(ConstBuffer);
+  Awaitable<void>   close();
+
+  // Tell the peer whether the remote is connected, if the protocol has a reply
+  Awaitable<void> respond(boost::system::error_code const&);
+
+  // Invoked by the connection for the received frames
+  bool          admit(size_t) const;
+  MutableBuffer prepare(size_t);
+  void          commit(size_t);
+  void          grant(int64_t);
+  void          finish(boost::system::error_code const&);
+
+private:
+  std::shared_ptr<Link>     link_;
+  uint32_t                  id_;
+  Timer                     readable_;
+  Timer                     writable_;
+  Buffer                    inbound_ = {};
+  size_t                    unacked_ = 0;
+  int64_t                   credit_;
+  int64_t                   limit_;
+  boost::system::error_code ec_      = {};
+  bool                      closed_  = false;
+};
+
+using Accept = std::function<void(std::shared_ptr<Stream>, Endpoint)>;
+
+/*
+ * The timers are cancelled to wake up their waiters, so the cancellation requested by the awaiting
+ * coroutine is only distinguishable by its cancellation state.
+ */
+extern Awaitable<void> wait(boost::asio::steady_timer&);
+
+// Request the MUX command over the transport, and start carrying the streams opened by the caller
+template <typename Transport>
+Awaitable<std::shared_ptr<Link>> connect(IOExecutor const&, Transport);
+
+// Hand each stream opened by the client to accept until the connection is closed
+template <typename Transport> Awaitable<void> serve(IOExecutor const&, Transport, Accept);
+
+/*
+ * Pool keeps the multiplexed connections of each egress per worker thread, and a new stream goes
+ * to the least loaded one. At most MuxOption::connections_ are dialed, and a connection carrying
+ * MuxOption::streams_ streams is picked only if no more connection can be dialed.
+ */
+class Pool : public boost::asio::detail::execution_context_service_base<Pool> {
+private:
+  using Timer = boost::asio::steady_timer;
+  using Dial  = std::function<Awaitable<std::shared_ptr<Link>>()>;
+  using Key   = std::weak_ptr<Connector const>;
+
+  struct Entry {
+    std::vector<std::weak_ptr<Link>> links_   = {};
+    size_t                           dialing_ = 0;
+
+    // Wakes up the sessions waiting for the connections being dialed
+    std::unique_ptr<Timer> dialed_ = {};
+  };
+
+  void shutdown() noexcept override;
+
+public:
+  explicit Pool(boost::asio::execution_context&);
+
+  Awaitable<std::shared_ptr<Link>> acquire(std::shared_ptr<Connector const> const&, Dial);
+
+private:
+  std::map<Key, Entry, std::owner_less<Key>> entries_ = {};
+};
+
+extern Pool& get_pool(IOExecutor const&);
+
+}  // namespace mux
+
+class MuxIngress {
+public:
+  MuxIngress(std::shared_ptr<mux::Stream>, Endpoint);
+
+  Awaitable<size_t> recv(MutableBuffer);
+  Awaitable<void>   send(ConstBuffer);
+  Awaitable<void>   close();
+
+  Awaitable<Endpoint> read_remote();
+  Awaitable<void>     confirm();
+  Awaitable<void>     disconnect(boost::system::error_code const&);
+
+private:
+  std::shared_ptr<mux::Stream> stream_;
+  Endpoint                     remote_;
+};
+
+class MuxEgress {
+public:
+  MuxEgress(std::shared_ptr<Connector const>, IOExecutor const&);
+
+  Awaitable<size_t> recv(MutableBuffer);
+  Awaitable<void>   send(ConstBuffer);
+  Awaitable<void>   close();
+
+  Awaitable<void> connect(Endpoint const&);
+
+private:
+  Awaitable<std::shared_ptr<mux::Link>> dial();
+
+  std::shared_ptr<Connector const> connector_;
+  IOExecutor                       ex_;
+  std::shared_ptr<mux::Stream>     stream_ = {};
+};
+
+}  // namespace pichi::adapter::tcp
+
+#endif  // PICHI_ADAPTER_TCP_MUX_HPP
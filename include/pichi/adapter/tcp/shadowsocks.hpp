@@ -14,18 +14,20 @@ namespace pichi::adapter::tcp {
 
 namespace detail {
 
-template <stream::AsyncSocket Socket> auto create_stream(vo::Ingress const& vo, Socket s)
+template <stream::AsyncSocket Socket>
+auto create_stream(vo::Ingress const& vo, stream::MasterKey key, Socket s)
 {
-  assertTrue(vo.opt_.has_value());
+  assertTrue(vo.opt_.has_value() && key != nullptr);
   auto&& opt = std::get<vo::ShadowsocksOption>(*vo.opt_);
-  return stream::Shadowsocks<Socket>{opt.method_, ConstBuffer{opt.password_}, std::move(s)};
+  return stream::Shadowsocks<Socket>{opt.method_, std::move(key), std::move(s)};
 }
 
-template <stream::AsyncSocket Socket> auto create_stream(vo::Egress const& vo, IOExecutor const& ex)
+template <stream::AsyncSocket Socket>
+auto create_stream(vo::Egress const& vo, stream::MasterKey key, IOExecutor const& ex)
 {
-  assertTrue(vo.opt_.has_value());
+  assertTrue(vo.opt_.has_value() && key != nullptr);
   auto&& opt = std::get<vo::ShadowsocksOption>(*vo.opt_);
-  return stream::Shadowsocks<Socket>{opt.method_, ConstBuffer{opt.password_}, *vo.server_, ex};
+  return stream::Shadowsocks<Socket>{opt.method_, std::move(key), *vo.server_, ex};
 }
 
 }  // namespace detail
@@ -35,10 +37,13 @@ public:
   // For unit test purpose
   Shadowsocks(stream::Shadowsocks<Socket> stream) : stream_{std::move(stream)} {}
 
-  Shadowsocks(vo::Ingress const& vo, Socket s) : stream_{detail::create_stream(vo, std::move(s))} {}
+  Shadowsocks(vo::Ingress const& vo, stream::MasterKey key, Socket s)
+    : stream_{detail::create_stream(vo, std::move(key), std::move(s))}
+  {
+  }
 
-  Shadowsocks(vo::Egress const& vo, IOExecutor const& ex)
-    : stream_{detail::create_stream<Socket>(vo, ex)}
+  Shadowsocks(vo::Egress const& vo, stream::MasterKey key, IOExecutor const& ex)
+    : stream_{detail::create_stream<Socket>(vo, std::move(key), ex)}
   {
   }
 
@@ -61,6 +66,9 @@ public:
 
   Awaitable<void> disconnect(boost::system::error_code const&) { co_return; }
 
+  // The socket is idle only if nothing is read ahead by the stream
+  Socket* idle_socket() { return stream_.buffered() ? nullptr : &stream_.next_layer(); }
+
 private:
   stream::Shadowsocks<Socket> stream_;
 };
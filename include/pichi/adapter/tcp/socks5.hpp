@@ -1,12 +1,13 @@
 #ifndef PICHI_ADAPTER_TCP_SOCKS5_HPP
 #define PICHI_ADAPTER_TCP_SOCKS5_HPP
 
-#include <array>
+#include <boost/asio/ip/tcp.hpp>
 #include <boost/system/error_code.hpp>
 #include <pichi/stream/concepts.hpp>
 #include <pichi/stream/tls.hpp>
 #include <pichi/vo/egress.hpp>
 #include <pichi/vo/ingress.hpp>
+#include <string>
 
 namespace pichi::adapter::tcp {
 
@@ -26,15 +27,18 @@ private:
 class EgressCredential {
 public:
   explicit EgressCredential(vo::Egress const&);
+  explicit EgressCredential(std::string);
 
   bool        need_auth() const;
   ConstBuffer data() const;
 
 private:
-  std::array<uint8_t, 1024> data_ = {};
-  size_t                    len_  = 0;
+  std::string data_;
 };
 
+// The username/password request of RFC 1929, or empty if no authentication
+extern std::string gen_credential(vo::Egress const&);
+
 }  // namespace socks5
 
 template <stream::AsyncLayer NextLayer> class Socks5Ingress {
@@ -56,6 +60,8 @@ public:
 
   Awaitable<Endpoint> continue_read_remote(ConstBuffer);
 
+  boost::asio::ip::tcp::socket* raw_socket();
+
 private:
   NextLayer  underlying_;
   Credential credential_;
@@ -64,6 +70,7 @@ private:
 template <stream::AsyncLayer NextLayer> class Socks5Egress {
 public:
   explicit Socks5Egress(vo::Egress const&, NextLayer);
+  Socks5Egress(vo::Egress const&, std::string credential, NextLayer);
 
   Awaitable<size_t> recv(MutableBuffer);
   Awaitable<void>   send(ConstBuffer);
@@ -71,6 +78,8 @@ public:
 
   Awaitable<void> connect(Endpoint const&);
 
+  boost::asio::ip::tcp::socket* raw_socket();
+
 private:
   NextLayer underlying_;
   Endpoint  peer_;
@@ -24,6 +24,8 @@ public:
   Awaitable<void>     confirm();
   Awaitable<void>     disconnect(boost::system::error_code const&);
 
+  Socket* raw_socket();
+
 private:
   Socket socket_;
 };
@@ -63,6 +63,9 @@ private:
   MutableBuffer available_;
 };
 
+// The hex encoded SHA-224 of the password
+extern std::string gen_credential(vo::Egress const&);
+
 }  // namespace trojan
 
 template <stream::AsyncLayer NextLayer> class TrojanIngress {
@@ -81,16 +84,22 @@ public:
   Awaitable<void>     confirm();
   Awaitable<void>     disconnect(boost::system::error_code const&);
 
+  // Whether the client requested the multiplexed streams rather than a single remote
+  bool multiplexed() const;
+
 private:
   NextLayer  underlying_;
   Credential cred_;
-  Cache      cache_ = {};
+  Cache      cache_       = {};
   Endpoint   remote_;
+  bool       mux_;
+  bool       multiplexed_ = false;
 };
 
 template <stream::AsyncLayer NextLayer> class TrojanEgress {
 public:
   explicit TrojanEgress(vo::Egress const&, NextLayer);
+  TrojanEgress(vo::Egress const&, std::string credential, NextLayer);
 
   Awaitable<size_t> recv(MutableBuffer);
   Awaitable<void>   send(ConstBuffer);
@@ -98,7 +107,12 @@ public:
 
   Awaitable<void> connect(Endpoint const&);
 
+  // Connect to the server, which is requested to carry the multiplexed streams afterwards
+  Awaitable<void> multiplex();
+
 private:
+  Awaitable<void> request(uint8_t, Endpoint const&);
+
   std::string cred_;
   Endpoint    peer_;
   NextLayer   underlying_;
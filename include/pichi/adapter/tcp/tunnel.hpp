@@ -28,6 +28,8 @@ public:
   Awaitable<void>     confirm();
   Awaitable<void>     disconnect(boost::system::error_code const&);
 
+  Socket* raw_socket();
+
 private:
   Balancer    balancer_;
   std::string name_;
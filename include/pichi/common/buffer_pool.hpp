@@ -0,0 +1,45 @@
+#ifndef PICHI_COMMON_BUFFER_POOL_HPP
+#define PICHI_COMMON_BUFFER_POOL_HPP
+
+#include <memory>
+#include <pichi/common/buffer.hpp>
+#include <stddef.h>
+
+namespace pichi {
+
+struct BufferPoolStats {
+  size_t in_use_       = 0;
+  size_t in_use_bytes_ = 0;
+  size_t idle_         = 0;
+  size_t idle_bytes_   = 0;
+  size_t hits_         = 0;
+  size_t misses_       = 0;
+};
+
+/*
+ * PooledBuffer borrows a buffer from the pool of the current thread, and gives it back while being
+ * destroyed. The requested size is rounded up to a power of 2 within [MIN_SIZE, MAX_SIZE].
+ */
+class PooledBuffer {
+public:
+  static constexpr size_t MIN_SIZE = 4096;
+  static constexpr size_t MAX_SIZE = 65536;
+
+  explicit PooledBuffer(size_t);
+  ~PooledBuffer();
+
+  PooledBuffer(PooledBuffer const&)            = delete;
+  PooledBuffer& operator=(PooledBuffer const&) = delete;
+
+  MutableBuffer buffer() const;
+
+private:
+  std::unique_ptr<uint8_t[]> data_;
+  size_t                     size_;
+};
+
+extern BufferPoolStats buffer_pool_stats();
+
+}  // namespace pichi
+
+#endif  // PICHI_COMMON_BUFFER_POOL_HPP
@@ -18,6 +18,11 @@ namespace pichi {
 
 using IOExecutor = boost::asio::any_io_executor;
 
+/*
+ * The frames of Awaitable are allocated by the thread-local recycling allocator of Asio, whose
+ * slots are enlarged by BOOST_ASIO_RECYCLING_ALLOCATOR_CACHE_SIZE. Frames are cached only if their
+ * sizes are not greater than 1020 bytes, so the coroutines on the relaying path MUST stay small.
+ */
 template <typename T, boost::asio::execution::executor E = IOExecutor>
 using Awaitable = boost::asio::awaitable<T, E>;
 
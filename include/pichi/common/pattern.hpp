@@ -0,0 +1,56 @@
+#ifndef PICHI_COMMON_PATTERN_HPP
+#define PICHI_COMMON_PATTERN_HPP
+
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace pichi {
+
+/*
+ * PatternSet compiles the patterns into one Thompson NFA, whose states are simulated in lockstep
+ * without any backtracking. Matching is linear in the length of the input, and it reports the least
+ * index of the patterns found in the input, as std::regex_search does for each pattern.
+ *
+ * The supported syntax is the subset of ECMAScript: literals, '.', character classes, escapes like
+ * '\d', groups, alternations, greedy or lazy quantifiers, '^' and '$'. Backreferences, lookarounds,
+ * word boundaries and the patterns expanding to too many states are rejected by SEMANTIC_ERROR.
+ */
+class PatternSet {
+private:
+  enum class Kind : uint8_t { CHAR, SPLIT, BOL, EOL, MATCH };
+
+  struct State {
+    Kind     kind_;
+    uint32_t out_   = 0;
+    uint32_t alt_   = 0;  // The second branch of SPLIT, or the character set of CHAR
+    size_t   index_ = 0;  // The index of the pattern owning the state
+  };
+
+  struct Entry {
+    uint32_t state_;
+    size_t   index_;
+  };
+
+  friend class PatternCompiler;
+
+public:
+  static size_t const MAX_STATES = 1 << 12;  // per pattern
+  static size_t const MAX_REPEAT = 1000;
+  static size_t const MAX_DEPTH  = 64;
+
+  void add(std::string_view, size_t index);
+
+  std::optional<size_t> match(std::string_view) const;
+
+private:
+  std::vector<State>            states_  = {};
+  std::vector<std::bitset<256>> sets_    = {};
+  std::vector<Entry>            entries_ = {};  // Sorted by the indices
+};
+
+}  // namespace pichi
+
+#endif  // PICHI_COMMON_PATTERN_HPP
@@ -1,31 +1,85 @@
 #ifndef PICHI_SERVICE_MMDB_HPP
 #define PICHI_SERVICE_MMDB_HPP
 
+#include <array>
 #include <boost/asio/execution_context.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <functional>
+#include <list>
 #include <maxminddb.h>
 #include <mutex>
 #include <optional>
+#include <stdint.h>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 
 namespace pichi::service {
 
+struct MmdbStats {
+  size_t entries_ = 0;
+  size_t hits_    = 0;
+  size_t misses_  = 0;
+};
+
+/*
+ * Mmdb looks up the countries of the addresses, which are interned as integers so that the rules
+ * compare them without any string comparison. The results, including the absent ones, are cached
+ * by a bounded LRU shared by all sessions, so that a hot address is looked up only once.
+ */
 class Mmdb : public boost::asio::detail::execution_context_service_base<Mmdb> {
+public:
+  using Country = uint32_t;
+
 private:
   using Database = std::optional<MMDB_s>;
+  using Key      = std::array<uint8_t, 17>;
+  using Lru      = std::list<std::pair<Key, std::optional<Country>>>;
+
+  struct Hash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    size_t operator()(Key const& key) const
+    {
+      return (*this)(std::string_view{reinterpret_cast<char const*>(key.data()), key.size()});
+    }
+  };
+
+  using Countries = std::unordered_map<std::string, Country, Hash, std::equal_to<>>;
+  using Index     = std::unordered_map<Key, Lru::iterator, Hash>;
+
+  std::optional<std::string_view> query(boost::asio::ip::address const&) const;
+
+  // MUST be called with mutex_ locked
+  Country emplace(std::string_view);
 
 public:
+  static constexpr size_t MAX_ENTRIES = 1 << 16;
+
   explicit Mmdb(boost::asio::execution_context&);
 
   void initialize(std::string const&);
 
-  bool match(sockaddr const* const, std::string_view);
+  Country intern(std::string_view);
+
+  std::optional<Country> lookup(boost::asio::ip::address const&);
+
+  MmdbStats stats();
 
 private:
   void shutdown() noexcept override;
 
   std::once_flag flag_;
   Database       db_;
+
+  std::mutex mutex_     = {};
+  Countries  countries_ = {};
+  Lru        lru_       = {};
+  Index      index_     = {};
+  size_t     hits_      = 0;
+  size_t     misses_    = 0;
 };
 
 }  // namespace pichi::service
@@ -0,0 +1,102 @@
+#ifndef PICHI_SERVICE_RESOLVER_HPP
+#define PICHI_SERVICE_RESOLVER_HPP
+
+#include <boost/asio/execution_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <pichi/common/coro.hpp>
+#include <pichi/common/endpoint.hpp>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pichi::service {
+
+using ResolveResults = boost::asio::ip::tcp::resolver::results_type;
+
+struct ResolverStats {
+  size_t entries_ = 0;
+  size_t hits_    = 0;
+  size_t misses_  = 0;
+};
+
+/*
+ * Resolver caches the answers of getaddrinfo for a fixed TTL, since it reports no TTL of records,
+ * and caches the failures for a shorter one. The concurrent lookups of the same host and port from
+ * all worker threads are coalesced into one query, whose waiters are woken up on their executors.
+ * If the query is aborted, it's handed over to the first waiter alive, which issues it once more.
+ * It also holds the delay between the racing attempts of connecting to the resolved addresses.
+ */
+class Resolver : public boost::asio::detail::execution_context_service_base<Resolver> {
+private:
+  using Clock = std::chrono::steady_clock;
+  using Ttl   = std::chrono::seconds;
+  using Delay = std::chrono::milliseconds;
+
+  struct Waiter {
+    explicit Waiter(IOExecutor const&);
+
+    boost::asio::steady_timer timer_;
+    boost::system::error_code ec_      = {};
+    ResolveResults            results_ = {};
+    bool                      retry_   = false;
+  };
+
+  struct Entry {
+    bool                              pending_ = false;
+    Clock::time_point                 expiry_  = {};
+    boost::system::error_code         ec_      = {};
+    ResolveResults                    results_ = {};
+    std::vector<std::weak_ptr<Waiter>> waiters_ = {};
+  };
+
+  using Entries = std::unordered_map<std::string, Entry>;
+
+  void evict();
+  void complete(std::string const&, boost::system::error_code const&, ResolveResults const&);
+  bool handover(Entry&);
+
+  Awaitable<ResolveResults> query(std::string const&, std::string const&, uint16_t);
+
+public:
+  static constexpr auto   DEFAULT_TTL          = Ttl{60};
+  static constexpr auto   DEFAULT_NEGATIVE_TTL = Ttl{5};
+  static constexpr auto   DEFAULT_DELAY        = Delay{250};
+  static constexpr size_t MAX_ENTRIES          = 1 << 14;
+
+  explicit Resolver(boost::asio::execution_context&);
+
+  // Configuration MUST be done before resolving, otherwise it might not take effect
+  void configure(Ttl, Ttl, Delay);
+
+  Awaitable<ResolveResults> resolve(std::string const&, uint16_t);
+
+  void clear();
+
+  ResolverStats stats();
+
+  Delay delay();
+
+private:
+  void shutdown() noexcept override;
+
+  std::mutex mutex_    = {};
+  Ttl        ttl_      = DEFAULT_TTL;
+  Ttl        negative_ = DEFAULT_NEGATIVE_TTL;
+  Delay      delay_    = DEFAULT_DELAY;
+  size_t     hits_     = 0;
+  size_t     misses_   = 0;
+
+  Entries entries_ = {};
+};
+
+extern Resolver& get_resolver(IOExecutor const&);
+
+}  // namespace pichi::service
+
+#endif  // PICHI_SERVICE_RESOLVER_HPP
@@ -2,47 +2,85 @@
 #define PICHI_SERVICE_SENTRY_HPP
 
 #include <boost/asio/execution_context.hpp>
-#include <boost/asio/strand.hpp>
 #include <boost/asio/system_timer.hpp>
+#include <botan/mac.h>
+#include <chrono>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <pichi/common/buffer.hpp>
 #include <pichi/common/coro.hpp>
-#include <string>
-#include <unordered_set>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
 
 namespace pichi::service {
 
+struct SaltSentryStats {
+  size_t capacity_ = 0;
+  size_t active_   = 0;
+  size_t expiring_ = 0;
+  size_t bytes_    = 0;
+};
+
+/*
+ * SaltSentry remembers the salts seen in the recent 1 ~ 2 windows by 2 rotating bloom filters,
+ * whose memory is fixed by the capacity (salts per window) and the false-positive budget.
+ * The filters are rotated by the window only. Once the capacity is exceeded within a window, the
+ * false-positive rate degrades beyond the budget rather than any salt being forgotten early, and
+ * it's visible by stats. Only the salts authenticated by their first chunks are recorded.
+ * The salts are hashed by SipHash with a random key, which prevents the bits from being chosen
+ * by the clients.
+ */
 class SaltSentry : public boost::asio::detail::execution_context_service_base<SaltSentry> {
 private:
-  using Salts  = std::unordered_set<std::string>;
-  using Strand = std::optional<boost::asio::strand<IOExecutor>>;
+  using Bits   = std::vector<uint64_t>;
+  using Mac    = std::unique_ptr<Botan::MessageAuthenticationCode>;
   using Timer  = std::optional<boost::asio::system_timer>;
+  using Window = std::chrono::seconds;
 
   Awaitable<void> run();
 
 public:
+  static constexpr auto   DEFAULT_WINDOW   = Window{600};
+  static constexpr size_t DEFAULT_CAPACITY = 1 << 20;
+  static constexpr double DEFAULT_FP       = 1e-6;
+
   explicit SaltSentry(boost::asio::execution_context&);
 
+  // Configuration MUST be done before initialization, otherwise it doesn't take effect
+  void configure(Window, size_t, double);
   void initialize(IOExecutor const&);
 
-  Awaitable<bool> contains(ConstBuffer);
-  Awaitable<void> reset();
+  // Recording the salt, and returning whether it was seen before
+  bool contains(ConstBuffer);
+  void reset();
+
+  SaltSentryStats stats();
 
   void cancel();
 
 private:
   void shutdown() noexcept override;
 
-  std::once_flag flag_ = {};
+  std::once_flag flag_  = {};
+  std::mutex     mutex_ = {};
+
+  Window window_   = DEFAULT_WINDOW;
+  size_t capacity_ = DEFAULT_CAPACITY;
+  double fp_       = DEFAULT_FP;
+  size_t hashes_   = 0;
 
-  Strand strand_   = {};
-  Timer  timer_    = {};
-  Salts  expiring_ = {};
-  Salts  active_   = {};
+  Timer  timer_         = {};
+  Mac    mac_           = {};
+  Bits   expiring_      = {};
+  Bits   active_        = {};
+  size_t expiring_size_ = 0;
+  size_t active_size_   = 0;
 };
 
-extern SaltSentry& get_sentry(IOExecutor const&);
+extern SaltSentry&      get_sentry(IOExecutor const&);
+extern SaltSentryStats sentry_stats(IOExecutor const&);
 
 }  // namespace pichi::service
 
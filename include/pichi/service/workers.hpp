@@ -0,0 +1,72 @@
+#ifndef PICHI_SERVICE_WORKERS_HPP
+#define PICHI_SERVICE_WORKERS_HPP
+
+#include <boost/asio/execution_context.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <memory>
+#include <optional>
+#include <pichi/common/coro.hpp>
+#include <thread>
+#include <vector>
+
+namespace pichi::service {
+
+/*
+ * Workers records the relationship between the primary io_context, which owns the API server and
+ * the shared services, and the worker io_contexts, each of which is driven by its own thread.
+ * All attachments MUST be done before any of the contexts starts running.
+ */
+class Workers : public boost::asio::detail::execution_context_service_base<Workers> {
+private:
+  using Executors = std::vector<IOExecutor>;
+  using Primary   = std::optional<IOExecutor>;
+
+  void shutdown() noexcept override;
+
+public:
+  explicit Workers(boost::asio::execution_context&);
+
+  void attach(IOExecutor const&);
+  void bind(IOExecutor const&);
+
+  Primary const&   primary() const;
+  Executors const& executors() const;
+
+private:
+  Primary   primary_   = {};
+  Executors executors_ = {};
+};
+
+/*
+ * WorkerPool attaches (threads - 1) worker io_contexts to the primary one and runs each of them in
+ * a dedicated thread. The primary io_context, which is also a worker, is still run by the caller.
+ */
+class WorkerPool {
+private:
+  using Context  = boost::asio::io_context;
+  using Guard    = boost::asio::executor_work_guard<Context::executor_type>;
+  using Contexts = std::vector<std::unique_ptr<Context>>;
+  using Guards   = std::vector<Guard>;
+  using Threads  = std::vector<std::thread>;
+
+public:
+  WorkerPool(Context&, size_t);
+  ~WorkerPool();
+
+  WorkerPool(WorkerPool const&)            = delete;
+  WorkerPool& operator=(WorkerPool const&) = delete;
+
+private:
+  Contexts contexts_ = {};
+  Guards   guards_   = {};
+  Threads  threads_  = {};
+};
+
+extern void                    attach_worker(IOExecutor const&, IOExecutor const&);
+extern IOExecutor              primary_executor(IOExecutor const&);
+extern std::vector<IOExecutor> worker_executors(IOExecutor const&);
+
+}  // namespace pichi::service
+
+#endif  // PICHI_SERVICE_WORKERS_HPP
@@ -6,8 +6,10 @@
 #include <boost/asio/read.hpp>
 #include <boost/asio/write.hpp>
 #include <pichi/common/endpoint.hpp>
+#include <pichi/service/resolver.hpp>
 #include <pichi/stream/completer.hpp>
 #include <pichi/stream/concepts.hpp>
+#include <pichi/stream/racing.hpp>
 
 namespace pichi::stream {
 
@@ -23,17 +25,23 @@ template <AsyncStream Stream> Awaitable<void> close(Stream& stream)
   co_await close(stream.next_layer());
 }
 
+template <AsyncSocket Socket>
+Awaitable<void> connect(Socket& s, service::ResolveResults const& results)
+{
+  if constexpr (!std::same_as<Socket, boost::asio::ip::tcp::socket>)
+    co_await s.async_connect({}, boost::asio::use_awaitable);
+  else
+    co_await race(s, results, service::get_resolver(s.get_executor()).delay());
+}
+
 template <AsyncSocket Socket> Awaitable<void> connect(Socket& s, Endpoint const& peer)
 {
   if constexpr (!std::same_as<Socket, boost::asio::ip::tcp::socket>)
     co_await s.async_connect({}, boost::asio::use_awaitable);
   else if (peer.type_ == EndpointType::DOMAIN_NAME)
-    co_await boost::asio::async_connect(
-        s,
-        co_await boost::asio::ip::tcp::resolver{s.get_executor()}
-            .async_resolve(peer.host_, std::to_string(peer.port_), boost::asio::use_awaitable)
+    co_await connect(
+        s, co_await service::get_resolver(s.get_executor()).resolve(peer.host_, peer.port_)
     );
-
   else
     co_await s.async_connect(
         {boost::asio::ip::make_address(peer.host_), peer.port_},
@@ -0,0 +1,25 @@
+#ifndef PICHI_STREAM_RACING_HPP
+#define PICHI_STREAM_RACING_HPP
+
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <pichi/common/coro.hpp>
+
+namespace pichi::stream {
+
+/*
+ * Connect the socket to one of the resolved addresses as Happy Eyeballs (RFC 8305) does. The
+ * addresses are interleaved by family, starting with the family of the first one, and the attempts
+ * are started one by one every `delay`, or as soon as an earlier attempt fails. The first
+ * established connection wins, and the others are closed. If all attempts fail, the error of the
+ * last one is thrown.
+ * The executor of the socket MUST NOT be driven by multiple threads.
+ */
+extern Awaitable<void> race(
+    boost::asio::ip::tcp::socket&, boost::asio::ip::tcp::resolver::results_type const&,
+    std::chrono::milliseconds
+);
+
+}  // namespace pichi::stream
+
+#endif  // PICHI_STREAM_RACING_HPP
@@ -1,6 +1,7 @@
 #ifndef PICHI_STREAM_SHADOWSOCKS_HPP
 #define PICHI_STREAM_SHADOWSOCKS_HPP
 
+#include <algorithm>
 #include <array>
 #include <boost/asio/async_result.hpp>
 #include <boost/asio/buffer.hpp>
@@ -10,9 +11,12 @@
 #include <boost/beast/core/flat_buffer.hpp>
 #include <botan/cipher_mode.h>
 #include <pichi/common/asserts.hpp>
+#include <pichi/common/buffer_pool.hpp>
 #include <pichi/common/endpoint.hpp>
 #include <pichi/service/sentry.hpp>
 #include <pichi/stream/helpers.hpp>
+#include <memory>
+#include <optional>
 #include <ranges>
 #include <vector>
 
@@ -20,18 +24,43 @@ namespace pichi::stream {
 
 namespace detail {
 
+// The maximum number of the idle ciphers per method and direction
+inline constexpr size_t MAX_IDLE = 64;
+
+// The ciphers cached by the current thread
+struct CryptoPoolStats {
+  size_t idle_   = 0;
+  size_t hits_   = 0;
+  size_t misses_ = 0;
+};
+
 class Cryptor {
 public:
   Cryptor(CryptoMethod, Botan::Cipher_Dir);
+  ~Cryptor();
 
+  // The cipher replaced by the assignment is given back to the pool as the destroyed one
+  Cryptor(Cryptor&&) = default;
+  Cryptor& operator=(Cryptor&&);
+
+  // The subkey is derived from the master key and the salt
   void set_psk(ConstBuffer, ConstBuffer);
 
+  /*
+   * The source and the destination buffers are either disjoint or identical. The latter one means
+   * the data is sealed/opened in place without any copying.
+   */
   size_t process(ConstBuffer, MutableBuffer);
 
 private:
+  void giveback();
+
+  CryptoMethod                        method_;
+  Botan::Cipher_Dir                   direction_;
   std::unique_ptr<Botan::Cipher_Mode> cryptor_;
 
   std::vector<uint8_t> nonce_;
+  std::vector<uint8_t> tag_;
 };
 
 class Encryptor {
@@ -52,7 +81,9 @@ class Decryptor {
 public:
   Decryptor(CryptoMethod);
 
+  // The salt is kept after setting PSK, until it's dropped once the first chunk is authenticated
   MutableBuffer salt();
+  void          drop_salt();
 
   void   set_psk(ConstBuffer);
   size_t process(ConstBuffer, MutableBuffer);
@@ -63,26 +94,24 @@ private:
   std::vector<uint8_t> salt_;
 };
 
-class Cache {
-public:
-  Cache() = default;
-
-  bool empty() const;
-
-  size_t copy(MutableBuffer);
+extern CryptoPoolStats crypto_pool_stats();
 
-  MutableBuffer prepare(MutableBuffer, size_t);
+}  // namespace detail
 
-private:
-  boost::beast::flat_buffer data_ = {};
-};
+/*
+ * The master key derived from the password by EVP_BytesToKey, which is done once per ingress or
+ * egress rather than per connection, and shared by all of its connections.
+ */
+using MasterKey = std::shared_ptr<std::vector<uint8_t> const>;
 
-}  // namespace detail
+extern MasterKey derive_master_key(CryptoMethod, ConstBuffer);
 
 template <AsyncSocket Socket> class Shadowsocks {
 private:
-  static constexpr size_t FRAME_SIZE = 0x3fff;
-  static constexpr size_t TAG_SIZE   = 16;
+  static constexpr size_t FRAME_SIZE  = 0x3fff;
+  static constexpr size_t TAG_SIZE    = 16;
+  static constexpr size_t LENGTH_SIZE = 2 + TAG_SIZE;
+  static constexpr size_t READ_AHEAD  = LENGTH_SIZE + FRAME_SIZE + TAG_SIZE;
 
   using Sentry    = service::SaltSentry*;
   using ErrorCode = boost::system::error_code;
@@ -93,77 +122,110 @@ private:
   using CipherBuffer = std::array<uint8_t, FRAME_SIZE + 2 + 2 * TAG_SIZE>;
   using LengthBuffer = std::array<uint8_t, 2>;
 
-  using Data  = std::vector<uint8_t>;
-  using Cache = detail::Cache;
+  using Pending = std::optional<size_t>;
+
+  // Pulling as much ciphertext as the socket has until at least n bytes are read ahead
+  Awaitable<void> read_ahead(size_t n)
+  {
+    while (recv_.size() < n)
+      recv_.commit(
+          co_await socket_.async_read_some(recv_.prepare(READ_AHEAD), boost::asio::use_awaitable)
+      );
+  }
+
+  // Opening the next non-empty frame read ahead in place, whose plaintext is left at the front
+  bool open_frame()
+  {
+    while (!left_.has_value()) {
+      if (!pending_.has_value()) {
+        if (recv_.size() < LENGTH_SIZE) return false;
+        auto lb = MutableBuffer{recv_.data(), LENGTH_SIZE};
+        decryptor_.process(lb, lb);
+        if (!std::ranges::empty(decryptor_.salt())) record_salt();
+        pending_ = ntoh<uint16_t>(ConstBuffer{lb, 2});
+        assertTrue(*pending_ <= FRAME_SIZE, PichiError::BAD_PROTO);
+        recv_.consume(LENGTH_SIZE);
+      }
+
+      auto len = *pending_ + TAG_SIZE;
+      if (recv_.size() < len) return false;
+      auto block = MutableBuffer{recv_.data(), len};
+      decryptor_.process(block, block);
+      if (*pending_ > 0)
+        left_ = *pending_;
+      else
+        recv_.consume(TAG_SIZE);
+      pending_.reset();
+    }
+    return true;
+  }
 
   Awaitable<void> read_salt()
   {
     auto salt = decryptor_.salt();
+    // Salt is read exactly, so that nothing is taken away from the socket before being accepted
     co_await boost::asio::async_read(
         socket_,
         boost::asio::buffer(std::ranges::data(salt), std::ranges::size(salt)),
         boost::asio::use_awaitable
     );
-    if (sentry_) assertFalse(co_await sentry_->contains(salt), PichiError::BAD_PROTO);
-    decryptor_.set_psk(pw_);
-    pw_.clear();
+    decryptor_.set_psk(*key_);
+    key_.reset();
   }
 
-  Awaitable<void> write_salt()
+  // Recording the salt after the first chunk is authenticated, so that no garbage from the clients
+  // without the password is able to fill the sentry and push the genuine salts out
+  void record_salt()
   {
-    co_await boost::asio::async_write(
-        socket_,
-        boost::asio::buffer(encryptor_.salt()),
-        boost::asio::use_awaitable
-    );
+    if (sentry_) assertFalse(sentry_->contains(decryptor_.salt()), PichiError::BAD_PROTO);
+    decryptor_.drop_salt();
   }
 
-  Awaitable<void> read_block(MutableBuffer block)
+  Awaitable<void> write_salt()
   {
-    auto cipher = CipherBuffer{};
-    auto len    = std::ranges::size(block) + TAG_SIZE;
-
-    co_await boost::asio::async_read(
+    co_await boost::asio::async_write(
         socket_,
-        boost::asio::buffer(cipher, len),
+        boost::asio::buffer(encryptor_.salt()),
         boost::asio::use_awaitable
     );
-    decryptor_.process({cipher, len}, block);
   }
 
   Awaitable<void> do_connect(Endpoint const& peer)
   {
     co_await connect(socket_, proxy_);
 
-    auto plain = PlainBuffer{};
-    auto len   = serializeEndpoint(peer, plain);
+    auto pooled = PooledBuffer{sizeof(PlainBuffer)};
+    auto plain  = pooled.buffer();
+    auto len    = serializeEndpoint(peer, plain);
     co_await do_write({plain, len});
   }
 
   Awaitable<size_t> do_read(MutableBuffer plain)
   {
-    if (!std::ranges::empty(pw_)) co_await read_salt();
-
-    if (!cache_.empty()) co_return cache_.copy(plain);
-
-    auto lb = LengthBuffer{};
-    co_await read_block(lb);
-
-    auto len = ntoh<uint16_t>(lb);
-    assertTrue(len <= FRAME_SIZE, PichiError::BAD_PROTO);
-
-    co_await read_block(cache_.prepare(plain, len));
-    co_return cache_.empty() ? len : cache_.copy(plain);
+    if (key_) co_await read_salt();
+    while (!open_frame()) co_await read_ahead(recv_.size() + 1);
+
+    // The plaintext is served from the opened frame, whose tag is dropped after all is served
+    auto n = std::min(std::ranges::size(plain), *left_);
+    std::ranges::copy(ConstBuffer{recv_.data(), n}, std::ranges::begin(plain));
+    recv_.consume(n);
+    *left_ -= n;
+    if (*left_ == 0) {
+      recv_.consume(TAG_SIZE);
+      left_.reset();
+    }
+    co_return n;
   }
 
   Awaitable<size_t> do_write(ConstBuffer plain)
   {
     if (!std::ranges::empty(encryptor_.salt())) co_await write_salt();
 
-    auto data = CipherBuffer{};
-    auto ret  = size_t{0};
+    // The chunks are sealed in a pooled buffer rather than the frame, which stays recyclable
+    auto pooled = PooledBuffer{sizeof(CipherBuffer)};
+    auto ret    = size_t{0};
     while (std::ranges::size(plain) > 0) {
-      auto cipher = MutableBuffer{data};
+      auto cipher = pooled.buffer();
 
       auto lb = LengthBuffer{};
       auto pl = std::min(std::ranges::size(plain), FRAME_SIZE);
@@ -172,7 +234,7 @@ private:
       cl += encryptor_.process({plain, pl}, cipher + cl);
       co_await boost::asio::async_write(
           socket_,
-          boost::asio::buffer(data, cl),
+          boost::asio::buffer(std::ranges::data(cipher), cl),
           boost::asio::use_awaitable
       );
       plain += pl;
@@ -187,32 +249,32 @@ public:
   using next_layer_type = Socket;
 
   // Used by ingresses
-  Shadowsocks(CryptoMethod method, ConstBuffer pw, Socket socket)
-    : pw_{std::ranges::begin(pw), std::ranges::end(pw)},
+  Shadowsocks(CryptoMethod method, MasterKey key, Socket socket)
+    : key_{std::move(key)},
       sentry_{std::addressof(service::get_sentry(socket.get_executor()))},
       socket_{std::move(socket)},
-      encryptor_{method, pw_},
+      encryptor_{method, *key_},
       decryptor_{method}
   {
   }
 
   // Used by egresses
-  Shadowsocks(CryptoMethod method, ConstBuffer pw, Endpoint const& proxy, IOExecutor const& ex)
-    : pw_{std::ranges::begin(pw), std::ranges::end(pw)},
+  Shadowsocks(CryptoMethod method, MasterKey key, Endpoint const& proxy, IOExecutor const& ex)
+    : key_{std::move(key)},
       sentry_{nullptr},
       socket_{ex},
-      encryptor_{method, pw_},
+      encryptor_{method, *key_},
       decryptor_{method},
       proxy_{proxy}
   {
   }
 
   // For unit test purpose
-  Shadowsocks(CryptoMethod method, ConstBuffer pw, ConstBuffer salt, Socket socket)
-    : pw_{std::ranges::begin(pw), std::ranges::end(pw)},
+  Shadowsocks(CryptoMethod method, MasterKey key, ConstBuffer salt, Socket socket)
+    : key_{std::move(key)},
       sentry_{std::addressof(service::get_sentry(socket.get_executor()))},
       socket_{std::move(socket)},
-      encryptor_{method, pw_, salt},
+      encryptor_{method, *key_, salt},
       decryptor_{method},
       proxy_{}
   {
@@ -225,6 +287,9 @@ public:
 
   bool is_open() const { return socket_.is_open(); }
 
+  // Whether any ciphertext is read ahead, which is served without reading the socket
+  bool buffered() const { return recv_.size() > 0; }
+
   template <typename ShutdownToken> auto async_shutdown(ShutdownToken&& token)
   {
     return stream::async_initiate<void(ErrorCode)>(std::forward<ShutdownToken>(token), ErrorCode{});
@@ -271,8 +336,15 @@ public:
   }
 
 private:
-  Data  pw_;
-  Cache cache_ = {};
+  // The master key is dropped once the subkey of the decryptor is derived
+  MasterKey key_;
+  Pending   pending_ = {};
+
+  // Ciphertext read ahead from the socket, which might contain several frames
+  boost::beast::flat_buffer recv_ = {};
+
+  // The plaintext left in the front of recv_ by the frame opened but not served completely
+  Pending left_ = {};
 
   Sentry    sentry_;
   Socket    socket_;
@@ -0,0 +1,19 @@
+#ifndef PICHI_STREAM_SPLICE_HPP
+#define PICHI_STREAM_SPLICE_HPP
+
+#include <boost/asio/ip/tcp.hpp>
+#include <pichi/common/coro.hpp>
+
+namespace pichi::stream {
+
+/*
+ * Relay the bytes from the first socket to the second one by splice(2) via an intermediate pipe,
+ * which keeps the payload inside the kernel. It returns only if an error occurs, and EOF is
+ * reported as boost::asio::error::eof just like the ordinary reading.
+ * It's only available if HAS_SPLICE is defined.
+ */
+extern Awaitable<void> splice(boost::asio::ip::tcp::socket&, boost::asio::ip::tcp::socket&);
+
+}  // namespace pichi::stream
+
+#endif  // PICHI_STREAM_SPLICE_HPP
@@ -3,6 +3,7 @@
 
 #include <boost/asio/ssl/context.hpp>
 #include <boost/asio/ssl/stream.hpp>
+#include <memory>
 #include <pichi/common/asserts.hpp>
 #include <pichi/vo/egress.hpp>
 #include <pichi/vo/ingress.hpp>
@@ -14,12 +15,26 @@ extern boost::asio::ssl::context tls_context(vo::TlsEgressOption const&, std::st
 
 extern void setup_fingerprint(::SSL*);
 
+struct TlsStats {
+  size_t handshakes_ = 0;
+  size_t resumed_    = 0;
+};
+
+/*
+ * The contexts created for egresses cache the latest sessions issued by the server, one of which is
+ * offered by each following client handshake to skip the full key exchange. The handshakes are
+ * counted per context.
+ */
+extern void     resume_session(::SSL*);
+extern TlsStats tls_stats(boost::asio::ssl::context&);
+
 /*
  *  1. Tls is about to implement both of AsyncReadStream and
  * AsyncWriteStream concepts, which is required by the HTTP functions provided
  * by Boost.Beast.
  *  2. The main difference bewteen TlsStream and boost::asio::ssl::stream is
- * TlsStream keeps boost::asio::ssl::context in its scope.
+ * TlsStream keeps boost::asio::ssl::context in its scope, which might be shared with other
+ * streams.
  */
 
 template <typename Socket> class Tls {
@@ -32,9 +47,15 @@ public:
   using executor_type   = typename Stream::executor_type;
   using next_layer_type = typename Stream::next_layer_type;
 
+  template <typename... Args>
+  Tls(std::shared_ptr<Context> ctx, Args&&... args)
+    : ctx_{std::move(ctx)}, stream_{std::forward<Args>(args)..., *ctx_}
+  {
+  }
+
   template <typename... Args>
   Tls(Context ctx, Args&&... args)
-    : ctx_{std::move(ctx)}, stream_{std::forward<Args>(args)..., ctx_}
+    : Tls{std::make_shared<Context>(std::move(ctx)), std::forward<Args>(args)...}
   {
   }
 
@@ -60,6 +81,7 @@ public:
 
   template <typename HandshakeToken> auto async_handshake(HandshakeToken&& token)
   {
+    resume_session(stream_.native_handle());
     return stream_.async_handshake(
         boost::asio::ssl::stream_base::client,
         std::forward<HandshakeToken>(token)
@@ -87,8 +109,8 @@ public:
   }
 
 private:
-  Context ctx_;
-  Stream  stream_;
+  std::shared_ptr<Context> ctx_;
+  Stream                   stream_;
 };
 
 }  // namespace pichi::stream
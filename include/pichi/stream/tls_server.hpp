@@ -0,0 +1,62 @@
+#ifndef PICHI_STREAM_TLS_SERVER_HPP
+#define PICHI_STREAM_TLS_SERVER_HPP
+
+#include <boost/asio/ssl/context.hpp>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <pichi/stream/tls.hpp>
+#include <pichi/vo/options.hpp>
+
+namespace pichi::stream {
+
+struct SessionTickets;
+
+/*
+ * TlsServerContext holds the TLS server context of one listener, which is built once and shared by
+ * all sessions accepted by its workers. It's rebuilt once the certificate chain or the private key
+ * is modified, and then swapped atomically: the sessions accepted afterwards take the new context,
+ * while the handshaking ones keep the old one alive. No lock is held while building.
+ *
+ * The session tickets are encrypted by the keys generated in process, which survive the rebuilding
+ * and rotate every rotation interval. The tickets encrypted by the previous key are still accepted
+ * and renewed, while they expire within one interval. The tickets are disabled if the interval is
+ * 0.
+ */
+class TlsServerContext {
+private:
+  using Context  = boost::asio::ssl::context;
+  using FileTime = std::filesystem::file_time_type;
+  using Seconds  = std::chrono::seconds;
+
+public:
+  static constexpr auto RELOAD_INTERVAL  = Seconds{5};
+  static constexpr auto DEFAULT_ROTATION = Seconds{3600};
+
+  explicit TlsServerContext(vo::TlsIngressOption, Seconds rotation = DEFAULT_ROTATION);
+
+  std::shared_ptr<Context> get() const;
+
+  // Rebuild the context if any file has been modified since the last building, MUST NOT be invoked
+  // concurrently. The current context is kept if the rebuilding throws.
+  bool reload();
+
+  // Rotate the ticket keys if the rotation interval has elapsed since the last rotation
+  bool rotate();
+
+  TlsStats stats() const;
+
+private:
+  vo::TlsIngressOption            opt_;
+  FileTime                        cert_time_;
+  FileTime                        key_time_;
+  std::shared_ptr<SessionTickets> tickets_;
+
+  mutable std::mutex       mutex_ = {};
+  std::shared_ptr<Context> ctx_;
+};
+
+}  // namespace pichi::stream
+
+#endif  // PICHI_STREAM_TLS_SERVER_HPP
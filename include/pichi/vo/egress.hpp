@@ -20,6 +20,7 @@ struct Egress {
   std::optional<Option>          opt_        = {};
   std::optional<TlsEgressOption> tls_        = {};
   std::optional<WebsocketOption> websocket_  = {};
+  std::optional<MuxOption>       mux_        = {};
 };
 
 extern rapidjson::Value toJson(Egress const&, rapidjson::Document::AllocatorType&);
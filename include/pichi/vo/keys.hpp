@@ -77,6 +77,7 @@ inline decltype(auto) BALANCE      = "balance";
 inline decltype(auto) MODE         = "mode";
 inline decltype(auto) DELAY        = "delay";
 inline decltype(auto) REMOTE       = "remote";
+inline decltype(auto) MUX          = "mux";
 
 }  // namespace option
 
@@ -88,6 +89,7 @@ inline decltype(auto) INSECURE    = "insecure";
 inline decltype(auto) CA_FILE     = "ca_file";
 inline decltype(auto) SERVER_NAME = "server_name";
 inline decltype(auto) SNI         = "sni";
+inline decltype(auto) ALPN        = "alpn";
 
 }  // namespace tls
 
@@ -98,6 +100,13 @@ inline decltype(auto) HOST = "host";
 
 }  // namespace websocket
 
+namespace mux {
+
+inline decltype(auto) CONNECTIONS = "connections";
+inline decltype(auto) STREAMS     = "streams";
+
+}  // namespace mux
+
 namespace ingress {
 
 inline decltype(auto) TYPE        = "type";
@@ -117,6 +126,7 @@ inline decltype(auto) CREDENTIAL = "credential";
 inline decltype(auto) OPTION     = "option";
 inline decltype(auto) TLS        = "tls";
 inline decltype(auto) WEBSOCKET  = "websocket";
+inline decltype(auto) MUX        = "mux";
 
 }  // namespace egress
 
@@ -146,6 +156,29 @@ inline decltype(auto) MESSAGE = "message";
 
 }  // namespace error
 
+namespace stats {
+
+inline decltype(auto) BUFFERS      = "buffers";
+inline decltype(auto) IN_USE       = "in_use";
+inline decltype(auto) IN_USE_BYTES = "in_use_bytes";
+inline decltype(auto) IDLE         = "idle";
+inline decltype(auto) IDLE_BYTES   = "idle_bytes";
+inline decltype(auto) HITS         = "hits";
+inline decltype(auto) MISSES       = "misses";
+inline decltype(auto) SENTRY       = "sentry";
+inline decltype(auto) CAPACITY     = "capacity";
+inline decltype(auto) ACTIVE       = "active";
+inline decltype(auto) EXPIRING     = "expiring";
+inline decltype(auto) BYTES        = "bytes";
+inline decltype(auto) ROUTER       = "router";
+inline decltype(auto) ENTRIES      = "entries";
+inline decltype(auto) INGRESSES    = "ingresses";
+inline decltype(auto) EGRESSES     = "egresses";
+inline decltype(auto) HANDSHAKES   = "handshakes";
+inline decltype(auto) RESUMED      = "resumed";
+
+}  // namespace stats
+
 }  // namespace pichi::vo
 
 #endif  // PICHI_VO_KEYS_HPP
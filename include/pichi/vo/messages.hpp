@@ -19,6 +19,8 @@ inline std::string_view const DM_INVALID = "Invalid delay mode type string";
 inline std::string_view const DL_INVALID = "Delay time must be in range [0, 300]";
 inline std::string_view const BA_INVALID = "Invalid balance string";
 inline std::string_view const SEC_INVALID = "Invalid security string";
+inline std::string_view const MUX_INVALID = "Connections and streams must be positive";
+inline std::string_view const ALPN_INVALID = "ALPN protocol length must be in range [1, 255]";
 inline std::string_view const STR_EMPTY = "Empty string";
 inline std::string_view const MISSING_TYPE_FIELD = "Missing type field";
 inline std::string_view const MISSING_HOST_FIELD = "Missing host field";
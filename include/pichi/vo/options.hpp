@@ -36,6 +36,7 @@ extern bool operator==(RejectOption const&, RejectOption const&);
 
 struct TrojanOption {
   Endpoint remote_;
+  bool     mux_ = false;  // Whether the multiplexed connections of pichi egresses are accepted
 };
 
 extern rapidjson::Value toJson(TrojanOption const&, rapidjson::Document::AllocatorType&);
@@ -44,6 +45,9 @@ extern bool operator==(TrojanOption const&, TrojanOption const&);
 struct TlsIngressOption {
   std::string certFile_;
   std::string keyFile_;
+
+  // The application protocols negotiated by ALPN in the order of preference, none if empty
+  std::vector<std::string> alpn_ = {};
 };
 
 extern rapidjson::Value toJson(TlsIngressOption const&, rapidjson::Document::AllocatorType&);
@@ -67,6 +71,14 @@ struct WebsocketOption {
 extern rapidjson::Value toJson(WebsocketOption const&, rapidjson::Document::AllocatorType&);
 extern bool operator==(WebsocketOption const&, WebsocketOption const&);
 
+struct MuxOption {
+  uint16_t connections_;
+  uint16_t streams_;
+};
+
+extern rapidjson::Value toJson(MuxOption const&, rapidjson::Document::AllocatorType&);
+extern bool operator==(MuxOption const&, MuxOption const&);
+
 }  // namespace pichi::vo
 
 #endif  // PICHI_VO_OPTIONS_HPP
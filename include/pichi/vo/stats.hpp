@@ -0,0 +1,27 @@
+#ifndef PICHI_VO_STATS_HPP
+#define PICHI_VO_STATS_HPP
+
+#include <pichi/actor/router.hpp>
+#include <pichi/common/buffer_pool.hpp>
+#include <pichi/service/sentry.hpp>
+#include <pichi/stream/tls.hpp>
+#include <rapidjson/document.h>
+#include <string>
+#include <unordered_map>
+
+namespace pichi::vo {
+
+struct Stats {
+  BufferPoolStats          buffers_ = {};
+  service::SaltSentryStats sentry_  = {};
+  actor::RouterStats       router_  = {};
+
+  std::unordered_map<std::string, stream::TlsStats> ingresses_ = {};
+  std::unordered_map<std::string, stream::TlsStats> egresses_  = {};
+};
+
+extern rapidjson::Value toJson(Stats const&, rapidjson::Document::AllocatorType&);
+
+}  // namespace pichi::vo
+
+#endif  // PICHI_VO_STATS_HPP
@@ -4,6 +4,7 @@
 #include <format>
 #include <fstream>
 #include <iostream>
+#include <pichi.h>
 #include <pichi/common/asserts.hpp>
 #include <stdio.h>
 #ifdef HAS_UNISTD_H
@@ -23,12 +24,12 @@ namespace sys = boost::system;
 
 using pichi::assertSuccess;
 
-extern void run(std::string const&, uint16_t, std::string const&, std::string const&);
+extern void run(pichi_server_options const&, std::string const&);
 
 int main(int argc, char const* argv[])
 {
+  auto opts   = pichi_server_options{};
   auto listen = std::string{};
-  auto port   = uint16_t{};
   auto json   = std::string{};
   auto geo    = std::string{};
   auto user   = std::string{};
@@ -36,7 +37,8 @@ int main(int argc, char const* argv[])
   auto pid_fn = std::string{};
   auto log_fn = std::string{};
   auto desc   = po::options_description{"Allow options"};
-  desc.add_options()("help,h", "produce help message")("listen,l", po::value<std::string>(&listen)->default_value("::1"), "API server address")("port,p", po::value<uint16_t>(&port), "API server port")("geo,g", po::value<std::string>(&geo), "GEO file")("config,c", po::value<std::string>(&json), "Initial configration(JSON format)")("version,v", "show version")
+  pichi_init_server_options(&opts);
+  desc.add_options()("help,h", "produce help message")("listen,l", po::value<std::string>(&listen)->default_value("::1"), "API server address")("port,p", po::value<uint16_t>(&opts.port), "API server port")("geo,g", po::value<std::string>(&geo), "GEO file")("config,c", po::value<std::string>(&json), "Initial configration(JSON format)")("threads,t", po::value<unsigned int>(&opts.threads)->default_value(opts.threads), "worker threads")("replay-window", po::value<uint32_t>(&opts.replay_window)->default_value(opts.replay_window), "seconds of remembering shadowsocks salts")("replay-capacity", po::value<size_t>(&opts.replay_capacity)->default_value(opts.replay_capacity), "shadowsocks salts per replay window")("replay-fp", po::value<double>(&opts.replay_fp)->default_value(opts.replay_fp), "false-positive rate of replay detection")("dns-ttl", po::value<uint32_t>(&opts.dns_ttl)->default_value(opts.dns_ttl), "seconds of caching DNS answers")("dns-negative-ttl", po::value<uint32_t>(&opts.dns_negative_ttl)->default_value(opts.dns_negative_ttl), "seconds of caching DNS failures")("connect-delay", po::value<uint32_t>(&opts.connect_delay)->default_value(opts.connect_delay), "milliseconds between racing connection attempts")("route-cache", po::value<size_t>(&opts.route_cache)->default_value(opts.route_cache), "cached routing decisions, 0 to disable")("ticket-rotation", po::value<uint32_t>(&opts.ticket_rotation)->default_value(opts.ticket_rotation), "seconds of rotating TLS ticket keys, 0 to disable tickets")("version,v", "show version")
 
 #if defined(HAS_FORK) && defined(HAS_SETSID)
   ("daemon,d", "daemonize")("pid", po::value<std::string>(&pid_fn)->default_value("/var/run/pichi.pid"), "pid file")
@@ -116,7 +118,9 @@ int main(int argc, char const* argv[])
     }
 #endif  // HAS_SETUID && HAS_GETPWNAM
 
-    run(listen, port, json, geo);
+    opts.bind = listen.c_str();
+    opts.mmdb = geo.empty() ? nullptr : geo.c_str();
+    run(opts, json);
     return 0;
   }
   catch (std::exception const& e) {
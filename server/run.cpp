@@ -10,15 +10,20 @@
 #include <boost/beast/http/status.hpp>
 #include <boost/beast/http/string_body.hpp>
 #include <boost/beast/http/write.hpp>
+#include <chrono>
 #include <exception>
 #include <fstream>
 #include <iostream>
+#include <pichi.h>
 #include <pichi/actor/detached.hpp>
 #include <pichi/actor/server.hpp>
 #include <pichi/common/asserts.hpp>
 #include <pichi/common/coro.hpp>
 #include <pichi/common/endpoint.hpp>
 #include <pichi/service/mmdb.hpp>
+#include <pichi/service/resolver.hpp>
+#include <pichi/service/sentry.hpp>
+#include <pichi/service/workers.hpp>
 #include <pichi/vo/to_json.hpp>
 #include <ranges>
 #include <rapidjson/document.h>
@@ -206,18 +211,28 @@ private:
   std::string fn_;
 };
 
-void run(std::string const& bind, uint16_t port, std::string const& fn, std::string const& mmdb)
+void run(pichi_server_options const& opts, std::string const& fn)
 {
   auto io = asio::io_context{};
   auto ex = io.get_executor();
 
-  auto server = actor::Server{ex};
-  auto client = HttpClient{ex, fn};
+  auto workers = service::WorkerPool{io, opts.threads};
 
-  if (!mmdb.empty()) asio::use_service<service::Mmdb>(io).initialize(mmdb);
+  auto server = actor::Server{ex, opts.route_cache, std::chrono::seconds{opts.ticket_rotation}};
+  auto client = HttpClient{ex, fn};
 
-  asio::co_spawn(io, server.serve({asio::ip::make_address(bind), port}), actor::detached);
-  asio::co_spawn(io, client.run(bind, port), [&](auto eptr) noexcept {
+  if (opts.mmdb != nullptr) asio::use_service<service::Mmdb>(io).initialize(opts.mmdb);
+  asio::use_service<service::SaltSentry>(io).configure(
+      std::chrono::seconds{opts.replay_window}, opts.replay_capacity, opts.replay_fp
+  );
+  asio::use_service<service::Resolver>(io).configure(
+      std::chrono::seconds{opts.dns_ttl},
+      std::chrono::seconds{opts.dns_negative_ttl},
+      std::chrono::milliseconds{opts.connect_delay}
+  );
+
+  asio::co_spawn(io, server.serve({asio::ip::make_address(opts.bind), opts.port}), actor::detached);
+  asio::co_spawn(io, client.run(opts.bind, opts.port), [&](auto eptr) noexcept {
     if (eptr) {
       try {
         std::rethrow_exception(eptr);
@@ -1,25 +1,113 @@
 #include "pichi/common/config.hpp"
 #include <algorithm>
+#include <boost/asio/detail/socket_option.hpp>
 #include <boost/asio/detail/throw_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <iterator>
 #include <pichi/actor/detached.hpp>
 #include <pichi/actor/listener.hpp>
 #include <pichi/actor/session.hpp>
 #include <pichi/common/asserts.hpp>
 #include <pichi/common/enumerations.hpp>
 #include <pichi/service/balancer.hpp>
+#include <pichi/service/workers.hpp>
 #include <ranges>
+#include <string>
+#include <utility>
 
 namespace asio  = boost::asio;
 namespace ip    = asio::ip;
 namespace rngs  = std::ranges;
+namespace sys   = boost::system;
 namespace views = std::views;
 
+// Only the options balancing the incoming connections among the listening sockets are suitable
+#if defined(SO_REUSEPORT_LB)
+#define PICHI_REUSE_PORT SO_REUSEPORT_LB
+#elif defined(__linux__) && defined(SO_REUSEPORT)
+#define PICHI_REUSE_PORT SO_REUSEPORT
+#endif  // defined(SO_REUSEPORT_LB)
+
 namespace pichi::actor {
 
-Awaitable<void> Listener::listen(Acceptor& ac)
+static ip::tcp::acceptor make_acceptor(
+    IOExecutor const& ex, ip::tcp::endpoint const& endpoint, [[maybe_unused]] bool reuse_port
+)
+{
+  auto ac = ip::tcp::acceptor{ex};
+  ac.open(endpoint.protocol());
+  ac.set_option(ip::tcp::acceptor::reuse_address{true});
+#ifdef PICHI_REUSE_PORT
+  if (reuse_port)
+    ac.set_option(asio::detail::socket_option::boolean<SOL_SOCKET, PICHI_REUSE_PORT>{true});
+#endif  // PICHI_REUSE_PORT
+  ac.bind(endpoint);
+  ac.listen();
+  return ac;
+}
+
+// The master key of the shadowsocks ingress is derived once, and shared by all of its sessions
+static stream::MasterKey gen_master_key(vo::Ingress const& vo)
+{
+  if (vo.type_ != AdapterType::SS) return nullptr;
+  auto&& opt = std::get<vo::ShadowsocksOption>(*vo.opt_);
+  return stream::derive_master_key(opt.method_, ConstBuffer{opt.password_});
+}
+
+// Reloading and ticket key rotation are done by the same coroutine until the listener is destroyed
+static Awaitable<void> watch(std::weak_ptr<stream::TlsServerContext> weak, std::string name)
+{
+  auto timer = asio::steady_timer{co_await asio::this_coro::executor};
+  while (true) {
+    timer.expires_after(stream::TlsServerContext::RELOAD_INTERVAL);
+    co_await timer.async_wait(asio::use_awaitable);
+
+    auto tls = weak.lock();
+    if (!tls) break;
+    if (tls->rotate())
+      std::clog << std::format(
+          "{} | TLS ticket keys of {} rotated\n",
+          std::chrono::system_clock::now(),
+          name
+      );
+    try {
+      if (tls->reload())
+        std::clog << std::format(
+            "{} | TLS context of {} reloaded\n",
+            std::chrono::system_clock::now(),
+            name
+        );
+    }
+    catch (sys::system_error const& e) {
+      std::clog << std::format(
+          "{} | TLS context of {} not reloaded: {}\n",
+          std::chrono::system_clock::now(),
+          name,
+          e.what()
+      );
+    }
+  }
+}
+
+Awaitable<void> Listener::listen(Workers workers, IngressPtr vo, TlsPtr tls, KeyPtr key)
+{
+  if (vo->type_ == AdapterType::TUNNEL)
+    co_await service::create_balancer(co_await asio::this_coro::executor, *vo);
+  for (auto&& worker : workers)
+    for (auto&& acceptor : worker->acceptors_)
+      asio::co_spawn(
+          worker->strand_.get_inner_executor(), accept(worker, acceptor, vo, tls, key), detached
+      );
+}
+
+Awaitable<void>
+    Listener::accept(WorkerPtr worker, Acceptor& ac, IngressPtr vo, TlsPtr tls, KeyPtr key)
 {
-  auto ex = strand_.get_inner_executor();
-  if (vo_.type_ == AdapterType::TUNNEL) co_await service::create_balancer(ex, vo_);
+  auto ex = worker->strand_.get_inner_executor();
   while (ac.is_open()) {
     auto [ec, s] = co_await redirect(ac.async_accept(asio::use_awaitable));
     if (ec == asio::error::operation_aborted)
@@ -27,48 +115,105 @@ Awaitable<void> Listener::listen(Acceptor& ac)
     else
       asio::detail::throw_error(ec);
 
-    co_await switch_to(strand_);
+    co_await switch_to(worker->strand_);
     asio::co_spawn(
         ex,
-        [session = Session{ex, router_}, s = std::move(*s), &vo = vo_]() mutable {
-          return session.start(vo, std::move(s));
-        },
+        [session = Session{ex, worker->router_},
+         s       = std::move(*s),
+         vo,
+         tls     = tls ? tls->get() : nullptr,
+         key]() mutable { return session.start(vo, tls, key, std::move(s)); },
         detached
     );
   }
 }
 
-Listener::Listener(IOExecutor const& ex, RouterPtr const& router, vo::Ingress vo)
-  : strand_{asio::make_strand(ex)}, router_{router}, vo_{std::move(vo)}
+Listener::Listener(IOExecutor const& ex, RouterPtr const& router, vo::Ingress vo, Seconds rotation)
+  : vo_{std::make_shared<vo::Ingress const>(std::move(vo))},
+    tls_{
+        vo_->tls_.has_value() ? std::make_shared<stream::TlsServerContext>(*vo_->tls_, rotation)
+                              : nullptr
+    },
+    key_{gen_master_key(*vo_)}
 {
-  auto v = vo_.bind_ | views::transform([ex](auto&& endpoint) {
-             return Acceptor{
-                 ex,
-                 ip::tcp::endpoint{ip::make_address(endpoint.host_), endpoint.port_}
-             };
-           });
-  acceptors_.assign(rngs::begin(v), rngs::end(v));
+  auto executors = service::worker_executors(ex);
+#ifndef PICHI_REUSE_PORT
+  // Without port reusing, only one worker is able to accept the connections
+  executors.resize(1);
+#endif  // PICHI_REUSE_PORT
+
+  auto endpoints = std::vector<ip::tcp::endpoint>{};
+  rngs::transform(vo_->bind_, std::back_inserter(endpoints), [](auto&& endpoint) {
+    return ip::tcp::endpoint{ip::make_address(endpoint.host_), endpoint.port_};
+  });
+
+  auto reuse_port = rngs::size(executors) > 1;
+  workers_.reserve(rngs::size(executors));
+  for (auto&& worker : executors) {
+    auto acceptors = endpoints | views::transform([&worker, reuse_port](auto&& endpoint) {
+                       return make_acceptor(worker, endpoint, reuse_port);
+                     });
+    workers_.push_back(std::make_shared<Worker>(
+        Worker{asio::make_strand(worker), router, {rngs::begin(acceptors), rngs::end(acceptors)}}
+    ));
+    // The rest workers must share the ports which might be assigned by OS
+    rngs::transform(workers_.front()->acceptors_, rngs::begin(endpoints), [](auto&& acceptor) {
+      return acceptor.local_endpoint();
+    });
+  }
+}
+
+Listener::~Listener() { stop(); }
+
+Listener& Listener::operator=(Listener&& other)
+{
+  if (this == &other) return *this;
+  stop();
+  vo_      = std::move(other.vo_);
+  tls_     = std::move(other.tls_);
+  key_     = std::move(other.key_);
+  workers_ = std::exchange(other.workers_, {});
+  return *this;
 }
 
-Listener::~Listener()
+void Listener::stop()
 {
-  // router_ is also a flag to indicate whether this listener is moved or not.
-  if (router_ != nullptr && vo_.type_ == AdapterType::TUNNEL)
-    service::remove_balancer(strand_, vo_.name_);
+  // workers_ is also a flag to indicate whether this listener is moved or not.
+  if (rngs::empty(workers_)) return;
+  if (vo_->type_ == AdapterType::TUNNEL)
+    service::remove_balancer(workers_.front()->strand_, vo_->name_);
+
+  // The pending accepting is aborted on the worker thread, which then releases the worker
+  for (auto&& worker : workers_)
+    asio::post(worker->strand_, [worker]() {
+      for (auto&& acceptor : worker->acceptors_) {
+        auto ec = sys::error_code{};
+        acceptor.close(ec);
+      }
+    });
+  workers_.clear();
 }
 
-vo::Ingress const& Listener::vo() const { return vo_; }
+vo::Ingress const& Listener::vo() const { return *vo_; }
+
+std::optional<stream::TlsStats> Listener::tls_stats() const
+{
+  if (!tls_) return std::nullopt;
+  return tls_->stats();
+}
 
 void Listener::start()
 {
-  rngs::for_each(acceptors_, [ex = strand_.get_inner_executor(), this](auto&& acceptor) {
-    asio::co_spawn(ex, listen(acceptor), detached);
-  });
+  auto ex = workers_.front()->strand_.get_inner_executor();
+  asio::co_spawn(ex, listen(workers_, vo_, tls_, key_), detached);
+  if (tls_) asio::co_spawn(ex, watch(tls_, vo_->name_), detached);
 }
 
 void Listener::reroute(RouterPtr const& router)
 {
-  asio::post(strand_, [this, router]() { router_ = std::move(router); });
+  rngs::for_each(workers_, [&router](auto&& worker) {
+    asio::post(worker->strand_, [worker, router]() { worker->router_ = router; });
+  });
 }
 
 }  // namespace pichi::actor
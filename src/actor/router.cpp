@@ -1,9 +1,13 @@
 #include "pichi/common/config.hpp"
 #include <algorithm>
+#include <array>
 #include <boost/asio/execution/context.hpp>
+#include <boost/asio/ip/network_v4.hpp>
+#include <boost/asio/ip/network_v6.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/system/detail/error_code.hpp>
 #include <cctype>
+#include <concepts>
 #include <cstdint>
 #include <maxminddb.h>
 #include <numeric>
@@ -11,8 +15,10 @@
 #include <pichi/common/asserts.hpp>
 #include <pichi/common/enumerations.hpp>
 #include <pichi/common/literals.hpp>
+#include <pichi/service/resolver.hpp>
 #include <pichi/vo/parse.hpp>
 #include <ranges>
+#include <tuple>
 #include <utility>
 
 using namespace std::literals;
@@ -43,108 +49,272 @@ template <rngs::range Range> auto to_lower_str(Range&& orig)
   return std::string{rngs::cbegin(v), rngs::cend(v)};
 }
 
-bool Matcher::match_range(ResolveResults const& rs) const
+// Visit the labels of the domain from right to left until f returns false
+template <std::predicate<std::string_view> F> void visit_labels(std::string_view domain, F&& f)
 {
-  static auto match = [](auto const& ranges, auto const& addr) {
-    return rngs::any_of(ranges, [&](auto net) {
-      auto hosts = net.hosts();
-      return hosts.find(addr) != hosts.end();
-    });
-  };
-  return rngs::any_of(rs, [this](auto&& entry) {
-    auto addr = entry.endpoint().address();
-    return (addr.is_v4() && match(ranges4_, addr.to_v4())) ||
-           (addr.is_v6() && match(ranges6_, addr.to_v6()));
-  });
+  while (true) {
+    auto dot = domain.rfind('.');
+    if (dot == std::string_view::npos) {
+      f(domain);
+      return;
+    }
+    if (!f(domain.substr(dot + 1))) return;
+    domain.remove_suffix(rngs::size(domain) - dot);
+  }
 }
 
-bool Matcher::match_pattern(std::string const& peer) const
+// The leading dot of the domain is ignored
+static auto strip_dot(std::string const& domain)
 {
-  return rngs::any_of(patterns_, [&](auto&& pattern) { return std::regex_search(peer, pattern); });
-}
-
-bool Matcher::match_domain(Endpoint const& peer) const
-{
-  return peer.type_ == EndpointType::DOMAIN_NAME && !peer.host_.empty() &&
-         rngs::any_of(domains_, [sub = to_lower_str(peer.host_)](auto&& domain) {
-           auto d = domain | views::reverse;
-           auto s =
-               (sub.front() == '.' ? views::drop(sub, 1) : views::drop(sub, 0)) | views::reverse;
-
-           auto dot = s | views::drop(rngs::size(d)) | views::take(1);
-           return rngs::equal(d, s | views::take(rngs::size(d))) &&
-                  (rngs::empty(dot) || *rngs::cbegin(dot) == '.');
-         });
+  return !rngs::empty(domain) && *rngs::cbegin(domain) == '.' ? views::drop(domain, 1)
+                                                               : views::drop(domain, 0);
 }
 
 Matcher::Matcher(
-    std::string_view rname, vo::Rule const& rule, std::string_view ename, vo::Egress const& egress
+    std::string_view rname, vo::Rule const& rule, std::string_view ename, SharedConnector egress,
+    service::Mmdb& mmdb
 )
   : rname_{rname},
     ename_{ename},
-    egress_{egress},
+    egress_{std::move(egress)},
     resolve_{!rngs::empty(rule.country_) || !rngs::empty(rule.range_)}
 {
-  // FIXME Utilize std::views::concat if being able to apply C++26
-  auto append = [this](auto&& range) {
-    auto ec = sys::error_code{};
-    auto n4 = ip::make_network_v4(range, ec);
-    if (ec) {
-      auto n6 = ip::make_network_v6(range, ec);
-      assertTrue(!ec, PichiError::SEMANTIC_ERROR);
-      ranges6_.push_back(n6);
-    }
-    else
-      ranges4_.push_back(n4);
-  };
-
-  rngs::for_each(rule.range_, append);
-  rngs::for_each(rule.range_nr_, append);
-
   insert_range(inames_, rule.ingress_);
   insert_range(types_, rule.type_);
 
-  insert_range(patterns_, rule.pattern_ | views::transform([](auto&& s) { return std::regex{s}; }));
-
-  insert_range(domains_, rule.domain_ | views::transform([](auto&& s) {
-                           return rngs::empty(s) || *rngs::cbegin(s) != '.' ? views::drop(s, 0)
-                                                                            : views::drop(s, 1);
-                         }) | views::filter([](auto&& v) {
-                           return !rngs::empty(v);
-                         }) | views::transform([](auto&& s) { return to_lower_str(s); }));
-
-  insert_range(countries_, rule.country_);
-  insert_range(countries_, rule.country_nr_);
+  auto intern = [&mmdb](auto&& country) { return mmdb.intern(country); };
+  insert_range(countries_, rule.country_ | views::transform(intern));
+  insert_range(countries_, rule.country_nr_ | views::transform(intern));
 }
 
 bool Matcher::need_resolving() const { return resolve_; }
 
+bool Matcher::need_locating() const { return !rngs::empty(countries_); }
+
 std::string const& Matcher::rname() const { return rname_; }
 
 std::string const& Matcher::ename() const { return ename_; }
 
-vo::Egress const& Matcher::egress() const { return egress_; }
+SharedConnector const& Matcher::egress() const { return egress_; }
 
 bool Matcher::match(
-    Endpoint const& peer, std::string const& iname, AdapterType type,
-    std::optional<ResolveResults> const& rs, service::Mmdb& mmdb
+    Endpoint const&, std::string const& iname, AdapterType type,
+    std::optional<Countries> const& countries
 ) const
 {
-  return (rs.has_value() && !rs->empty() &&
-          (match_range(*rs) || rngs::any_of(
-                                   *rs,
-                                   [&, this](auto&& r) {
-                                     return rngs::any_of(countries_, [&](auto&& country) {
-                                       return mmdb.match(r.endpoint().data(), country);
-                                     });
-                                   }
-                               ))) ||
-         inames_.contains(iname) || types_.contains(type) || match_pattern(peer.host_) ||
-         match_domain(peer);
+  return (countries.has_value() && rngs::any_of(*countries, [this](auto country) {
+            return rngs::find(countries_, country) != rngs::end(countries_);
+          })) ||
+         inames_.contains(iname) || types_.contains(type);
+}
+
+// Visit the routed rules along with the indices of their matchers
+template <std::invocable<vo::Rule const&, size_t> F>
+void for_each_rule(vo::Route const& route, ValueMap<vo::Rule> const& rules, F&& f)
+{
+  auto index = 0_sz;
+  for (auto&& p : route.rules_)
+    for (auto&& rname : p.first) f(rules.at(rname), index++);
+}
+
+DomainTrie::DomainTrie(vo::Route const& route, ValueMap<vo::Rule> const& rules)
+{
+  for_each_rule(route, rules, [this](auto&& rule, auto index) {
+    for (auto&& domain : rule.domain_) {
+      auto lower = to_lower_str(strip_dot(domain));
+      if (!rngs::empty(lower)) insert(lower, index);
+    }
+  });
+}
+
+void DomainTrie::insert(std::string_view domain, size_t index)
+{
+  auto node = 0_sz;
+  visit_labels(domain, [&, this](auto label) {
+    auto next           = rngs::size(nodes_);
+    auto [it, inserted] = nodes_[node].children_.try_emplace(std::string{label}, next);
+    node                = it->second;
+    if (inserted) nodes_.emplace_back();
+    return true;
+  });
+  nodes_[node].index_ = std::min(nodes_[node].index_, index);
+}
+
+std::optional<size_t> DomainTrie::match(Endpoint const& peer) const
+{
+  if (peer.type_ != EndpointType::DOMAIN_NAME) return std::nullopt;
+
+  auto host = to_lower_str(strip_dot(peer.host_));
+  if (rngs::empty(host)) return std::nullopt;
+
+  auto node  = 0_sz;
+  auto index = NONE;
+  visit_labels(host, [&, this](auto label) {
+    auto const& children = nodes_[node].children_;
+    auto it              = children.find(label);
+    if (it == rngs::cend(children)) return false;
+    node  = it->second;
+    index = std::min(index, nodes_[node].index_);
+    return true;
+  });
+  return index == NONE ? std::nullopt : std::make_optional(index);
+}
+
+template <size_t N> using Bytes = std::array<unsigned char, N>;
+
+template <size_t N> struct Prefix {
+  Bytes<N> first_;
+  Bytes<N> last_;
+  size_t   index_;
+};
+
+template <size_t N> Prefix<N> make_prefix(Bytes<N> const& bytes, size_t length, size_t index)
+{
+  auto ret = Prefix<N>{bytes, bytes, index};
+  for (auto i = 0_sz; i < N; ++i) {
+    auto bits = std::min(8_sz, length - std::min(length, i * 8));
+    auto mask = static_cast<unsigned char>(0xff00 >> bits);
+    ret.first_[i] &= mask;
+    ret.last_[i] |= static_cast<unsigned char>(~mask);
+  }
+  return ret;
+}
+
+// Return false if the bytes wrap around
+template <size_t N> bool increase(Bytes<N>& bytes)
+{
+  for (auto& b : bytes | views::reverse)
+    if (++b != 0) return true;
+  return false;
+}
+
+template <size_t N>
+void flatten(std::vector<Prefix<N>>& prefixes, std::invocable<Bytes<N> const&, size_t> auto&& emit)
+{
+  // The enclosing prefixes precede the enclosed ones
+  rngs::sort(prefixes, [](auto&& l, auto&& r) {
+    return std::tie(l.first_, r.last_, l.index_) < std::tie(r.first_, l.last_, r.index_);
+  });
+
+  // The last addresses and the least indices of the prefixes enclosing the current one
+  auto enclosing = std::vector<std::pair<Bytes<N>, size_t>>{};
+  auto pop       = [&]() {
+    auto next = enclosing.back().first;
+    enclosing.pop_back();
+    if (increase(next)) emit(next, rngs::empty(enclosing) ? NONE : enclosing.back().second);
+  };
+
+  for (auto&& prefix : prefixes) {
+    while (!rngs::empty(enclosing) && enclosing.back().first < prefix.first_) pop();
+    auto index = std::min(prefix.index_, rngs::empty(enclosing) ? NONE : enclosing.back().second);
+    emit(prefix.first_, index);
+    enclosing.emplace_back(prefix.last_, index);
+  }
+  while (!rngs::empty(enclosing)) pop();
+}
+
+template <size_t N> void RangeTable::Segments<N>::emit(Bytes const& start, size_t index)
+{
+  // The later segment starting at the same address overrides the former one
+  if (!rngs::empty(starts_) && starts_.back() == start) {
+    starts_.pop_back();
+    indices_.pop_back();
+  }
+  // The adjacent segments with the same index are merged
+  if (rngs::empty(indices_) || indices_.back() != index) {
+    starts_.push_back(start);
+    indices_.push_back(index);
+  }
+}
+
+template <size_t N> size_t RangeTable::Segments<N>::match(Bytes const& addr) const
+{
+  auto it = rngs::upper_bound(starts_, addr);
+  return it == rngs::cbegin(starts_) ? NONE : indices_[it - rngs::cbegin(starts_) - 1];
+}
+
+RangeTable::RangeTable(vo::Route const& route, ValueMap<vo::Rule> const& rules, size_t resolving)
+{
+  auto prefixes4 = std::array<std::vector<Prefix<4>>, 2>{};
+  auto prefixes6 = std::array<std::vector<Prefix<16>>, 2>{};
+
+  for_each_rule(route, rules, [&](auto&& rule, auto index) {
+    auto following = index < resolving ? 0_sz : 1_sz;
+    // FIXME Utilize std::views::concat if being able to apply C++26
+    auto append = [&](auto&& range) {
+      auto ec = sys::error_code{};
+      auto n4 = ip::make_network_v4(range, ec);
+      if (ec) {
+        auto n6 = ip::make_network_v6(range, ec);
+        assertTrue(!ec, PichiError::SEMANTIC_ERROR);
+        prefixes6[following].push_back(
+            make_prefix(n6.address().to_bytes(), n6.prefix_length(), index)
+        );
+      }
+      else
+        prefixes4[following].push_back(
+            make_prefix(n4.address().to_bytes(), n4.prefix_length(), index)
+        );
+    };
+    rngs::for_each(rule.range_, append);
+    rngs::for_each(rule.range_nr_, append);
+  });
+
+  auto compile = [&](Table& table, size_t i) {
+    flatten(prefixes4[i], [&](auto&& start, auto index) { table.v4_.emit(start, index); });
+    flatten(prefixes6[i], [&](auto&& start, auto index) { table.v6_.emit(start, index); });
+  };
+  compile(preceding_, 0_sz);
+  compile(following_, 1_sz);
+}
+
+size_t RangeTable::Table::match(ResolveResults const& rs) const
+{
+  auto index = NONE;
+  for (auto&& entry : rs) {
+    auto addr = entry.endpoint().address();
+    index     = std::min(
+        index,
+        addr.is_v4() ? v4_.match(addr.to_v4().to_bytes()) : v6_.match(addr.to_v6().to_bytes())
+    );
+  }
+  return index;
+}
+
+std::optional<size_t> RangeTable::match(ResolveResults const& rs, bool resolved) const
+{
+  auto index = std::min(resolved ? NONE : preceding_.match(rs), following_.match(rs));
+  return index == NONE ? std::nullopt : std::make_optional(index);
+}
+
+static auto compile_patterns(vo::Route const& route, ValueMap<vo::Rule> const& rules)
+{
+  auto ret = PatternSet{};
+  for_each_rule(route, rules, [&ret](auto&& rule, auto index) {
+    for (auto&& pattern : rule.pattern_) ret.add(pattern, index);
+  });
+  return ret;
+}
+
+// Only the egresses used by the route are compiled, each of which is compiled only once
+static Connectors compile_egresses(vo::Route const& route, ValueMap<vo::Egress> const& egresses)
+{
+  auto ret     = Connectors{};
+  auto compile = [&](auto&& ename) {
+    if (!ret.contains(ename))
+      ret.emplace(ename, std::make_shared<adapter::tcp::Connector const>(egresses.at(ename)));
+  };
+  for (auto&& p : route.rules_) {
+    assertTrue(egresses.contains(p.second));
+    compile(p.second);
+  }
+  compile(*route.default_);
+  return ret;
 }
 
 static auto parse_route(
-    vo::Route const& route, ValueMap<vo::Egress> const& egresses, ValueMap<vo::Rule> const& rules
+    vo::Route const& route, Connectors const& egresses, ValueMap<vo::Rule> const& rules,
+    service::Mmdb& mmdb
 )
 {
   auto ret = std::vector<Matcher>{};
@@ -160,46 +330,121 @@ static auto parse_route(
     for (auto&& rname : p.first) {
       assertTrue(rules.contains(rname));
       assertTrue(egresses.contains(p.second));
-      ret.emplace_back(rname, rules.at(rname), p.second, egresses.at(p.second));
+      ret.emplace_back(rname, rules.at(rname), p.second, egresses.at(p.second), mmdb);
     }
   }
   return ret;
 }
 
+DecisionCache::DecisionCache(size_t capacity) : capacity_{capacity} {}
+
+std::optional<size_t> DecisionCache::find(std::string const& key)
+{
+  auto lock = std::scoped_lock{mutex_};
+  auto it   = index_.find(key);
+  if (it == std::end(index_)) {
+    ++misses_;
+    return {};
+  }
+  ++hits_;
+  lru_.splice(rngs::begin(lru_), lru_, it->second);
+  return it->second->second;
+}
+
+void DecisionCache::insert(std::string key, size_t index)
+{
+  auto lock = std::scoped_lock{mutex_};
+  if (index_.contains(key)) return;
+  if (rngs::size(lru_) >= capacity_) {
+    index_.erase(lru_.back().first);
+    lru_.pop_back();
+  }
+  lru_.emplace_front(std::move(key), index);
+  index_.emplace(lru_.front().first, rngs::begin(lru_));
+}
+
+RouterStats DecisionCache::stats()
+{
+  auto lock = std::scoped_lock{mutex_};
+  return {
+      .capacity_ = capacity_,
+      .entries_  = rngs::size(lru_),
+      .hits_     = hits_,
+      .misses_   = misses_,
+  };
+}
+
+// The fields are separated by NUL, which is present in neither host names nor ingress names
+static std::string make_key(Endpoint const& peer, std::string const& iname, AdapterType itype)
+{
+  auto key = peer.host_;
+  key.push_back('\0');
+  key.append(std::to_string(peer.port_));
+  key.push_back('\0');
+  key.append(iname);
+  key.push_back('\0');
+  key.append(std::to_string(static_cast<int>(itype)));
+  return key;
+}
+
 }  // namespace detail
 
 Router::Router(
     IOExecutor const& ex, ValueMap<vo::Egress> const& egresses, ValueMap<vo::Rule> const& rules,
-    vo::Route const& route
+    vo::Route const& route, size_t cache
 )
   : ex_{ex},
-    matchers_{detail::parse_route(route, egresses, rules)},
-    default_{std::make_tuple("*"s, *route.default_, egresses.at(*route.default_))}
+    connectors_{detail::compile_egresses(route, egresses)},
+    matchers_{detail::parse_route(
+        route, connectors_, rules,
+        asio::use_service<service::Mmdb>(asio::query(ex, asio::execution::context))
+    )},
+    domains_{route, rules},
+    ranges_{
+        route, rules,
+        static_cast<size_t>(rngs::distance(
+            rngs::cbegin(matchers_), rngs::find_if(matchers_, &detail::Matcher::need_resolving)
+        ))
+    },
+    patterns_{detail::compile_patterns(route, rules)},
+    default_{std::make_tuple("*"s, *route.default_, connectors_.at(*route.default_))},
+    cache_{cache > 0 ? std::make_unique<detail::DecisionCache>(cache) : nullptr}
 {
 }
 
-Awaitable<std::tuple<std::string, std::string, vo::Egress>>
+RouterStats Router::stats() const { return cache_ ? cache_->stats() : RouterStats{}; }
+
+Router::ValueMap<stream::TlsStats> Router::tls_stats() const
+{
+  auto ret = ValueMap<stream::TlsStats>{};
+  for (auto&& [ename, connector] : connectors_)
+    if (connector->tls()) ret.emplace(ename, stream::tls_stats(*connector->tls()));
+  return ret;
+}
+
+Router::Result Router::decide(size_t index, std::optional<ResolveResults> rs) const
+{
+  if (index == detail::NONE) return std::tuple_cat(default_, std::make_tuple(std::move(rs)));
+  auto const& matcher = matchers_[index];
+  return {matcher.rname(), matcher.ename(), matcher.egress(), std::move(rs)};
+}
+
+Awaitable<Router::Result>
     Router::route(Endpoint const& peer, std::string const& iname, AdapterType itype) const
 {
-  auto r = ip::tcp::resolver{ex_};
-  co_return co_await route(
-      peer,
-      iname,
-      itype,
-      std::invoke(
-          [&](auto&& peer) {
-            return r.async_resolve(peer.host_, std::to_string(peer.port_), asio::use_awaitable);
-          },
-          peer
-      )
-  );
+  auto& resolver = service::get_resolver(co_await asio::this_coro::executor);
+  co_return co_await route(peer, iname, itype, resolver.resolve(peer.host_, peer.port_));
 }
 
-Awaitable<std::tuple<std::string, std::string, vo::Egress>> Router::route(
+Awaitable<Router::Result> Router::route(
     Endpoint const& peer, std::string const& iname, AdapterType itype,
     Awaitable<ResolveResults> resolve
 ) const
 {
+  auto key = cache_ ? detail::make_key(peer, iname, itype) : std::string{};
+  if (cache_)
+    if (auto index = cache_->find(key); index.has_value()) co_return decide(*index, {});
+
   auto& mmdb = asio::use_service<service::Mmdb>(asio::query(ex_, asio::execution::context));
 
   auto ec = sys::error_code{};
@@ -210,7 +455,22 @@ Awaitable<std::tuple<std::string, std::string, vo::Egress>> Router::route(
         ResolveResults::create(ip::tcp::endpoint{ip::make_address(peer.host_), peer.port_}, "", "")
     );
 
-  for (auto&& matcher : matchers_) {
+  // Each address is located once for all matchers
+  auto countries = std::optional<detail::Countries>{};
+  auto locate    = [&]() {
+    auto ret = detail::Countries{};
+    for (auto&& r : *rs)
+      if (auto country = mmdb.lookup(r.endpoint().address()); country.has_value())
+        ret.push_back(*country);
+    return ret;
+  };
+
+  auto index   = detail::NONE;
+  auto domain  = domains_.match(peer);
+  auto range   = rs.has_value() ? ranges_.match(*rs, false) : std::nullopt;
+  auto pattern = patterns_.match(peer.host_);
+  for (auto i = 0_sz; i < rngs::size(matchers_) && index == detail::NONE; ++i) {
+    auto const& matcher = matchers_[i];
     if (!rs.has_value() && matcher.need_resolving()) {
       rs = co_await redirect(std::move(resolve), ec);
 
@@ -219,11 +479,19 @@ Awaitable<std::tuple<std::string, std::string, vo::Egress>> Router::route(
 
       // Skip further resolving
       if (!rs.has_value()) rs = ResolveResults{};
+      range = ranges_.match(*rs, true);
     }
-    if (matcher.match(peer, iname, itype, rs, mmdb))
-      co_return std::make_tuple(matcher.rname(), matcher.ename(), matcher.egress());
+    if (rs.has_value() && !countries.has_value() && matcher.need_locating()) countries = locate();
+    if (domain == i || range == i || pattern == i || matcher.match(peer, iname, itype, countries))
+      index = i;
   }
-  co_return default_;
+
+  // The decision made without the addresses of the peer might change once the DNS recovers
+  if (cache_ && !ec) cache_->insert(std::move(key), index);
+
+  // Only the addresses resolved from a domain name are worth handing over to the egress
+  if (peer.type_ != EndpointType::DOMAIN_NAME || !rs.has_value() || rngs::empty(*rs)) rs.reset();
+  co_return decide(index, std::move(rs));
 }
 
 }  // namespace pichi::actor
@@ -11,8 +11,10 @@
 #include <pichi/actor/server.hpp>
 #include <pichi/common/error.hpp>
 #include <pichi/service/clients.hpp>
+#include <pichi/service/sentry.hpp>
 #include <pichi/vo/error.hpp>
 #include <pichi/vo/parse.hpp>
+#include <pichi/vo/stats.hpp>
 #include <pichi/vo/to_json.hpp>
 #include <ranges>
 #include <rapidjson/document.h>
@@ -100,21 +102,42 @@ static auto const EGRESS_NAME_REGEX  = std::regex{"^/egresses/([^?#]+)/?([?#].*)
 static auto const RULE_REGEX         = std::regex{"^/rules/?([?#].*)?$"};
 static auto const RULE_NAME_REGEX    = std::regex{"^/rules/([^?#]+)/?([?#].*)?$"};
 static auto const ROUTE_REGEX        = std::regex{"^/route$"};
+static auto const STATS_REGEX        = std::regex{"^/stats/?([?#].*)?$"};
 
 static auto const DEFAULT_EGRESS_NAME = "direct"s;
 
+static vo::Stats gen_stats(
+    IOExecutor const& ex, Router const& router,
+    std::unordered_map<std::string, Listener> const& listeners
+)
+{
+  auto ingresses = std::unordered_map<std::string, stream::TlsStats>{};
+  for (auto&& [name, listener] : listeners)
+    if (auto stats = listener.tls_stats(); stats.has_value()) ingresses.emplace(name, *stats);
+
+  return {
+      .buffers_   = buffer_pool_stats(),
+      .sentry_    = service::sentry_stats(ex),
+      .router_    = router.stats(),
+      .ingresses_ = std::move(ingresses),
+      .egresses_  = router.tls_stats(),
+  };
+}
+
 bool match(boost::string_view s, std::regex const& re, std::cmatch& mr)
 {
   return std::regex_match(std::cbegin(s), std::cend(s), mr, re);
 }
 
-Server::Server(IOExecutor const& ex)
+Server::Server(IOExecutor const& ex, size_t cache, std::chrono::seconds rotation)
 : strand_{asio::make_strand(ex)},
   egresses_{
     {DEFAULT_EGRESS_NAME, vo::Egress{.type_ = AdapterType::DIRECT}}
   },
   route_{vo::Route{.default_ = DEFAULT_EGRESS_NAME}},
-  router_{std::make_shared<Router>(ex, egresses_, rules_, route_)}
+  cache_{cache},
+  rotation_{rotation},
+  router_{std::make_shared<Router>(ex, egresses_, rules_, route_, cache_)}
 {
 }
 
@@ -192,7 +215,8 @@ Awaitable<Server::Response> Server::handle(Request const& req)
     case http::verb::put: {
       auto vo      = vo::parse<vo::Ingress>(req.body());
       vo.name_     = name;
-      auto [it, _] = listeners_.insert_or_assign(name, Listener{ex, router_, std::move(vo)});
+      auto [it, _] =
+          listeners_.insert_or_assign(name, Listener{ex, router_, std::move(vo), rotation_});
       it->second.start();
       co_return gen_resp(http::status::no_content);
     }
@@ -299,12 +323,26 @@ Awaitable<Server::Response> Server::handle(Request const& req)
       break;
     }
   }
+  else if (match(req.target(), STATS_REGEX, mr)) {
+    switch (req.method()) {
+    case http::verb::get:
+      co_return gen_resp(
+          http::status::ok,
+          vo::toJson(gen_stats(strand_.get_inner_executor(), *router_, listeners_), alloc)
+      );
+    case http::verb::options:
+      co_return gen_resp(http::verb::get, http::verb::options);
+    default:
+      break;
+    }
+  }
   co_return gen_resp(http::status::not_found);
 }
 
 void Server::update_router()
 {
-  router_ = std::make_shared<Router>(strand_.get_inner_executor(), egresses_, rules_, route_);
+  router_ =
+      std::make_shared<Router>(strand_.get_inner_executor(), egresses_, rules_, route_, cache_);
   rngs::for_each(listeners_, [this](auto&& p) { p.second.reroute(router_); });
 }
 
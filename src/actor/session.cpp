@@ -1,35 +1,215 @@
 #include "pichi/common/config.hpp"
+#include <algorithm>
 #include <boost/asio/deferred.hpp>
 #include <boost/asio/experimental/parallel_group.hpp>
+#include <boost/beast/http/error.hpp>
 #include <chrono>
 #include <format>
 #include <iostream>
+#include <optional>
+#include <pichi/actor/detached.hpp>
 #include <pichi/actor/session.hpp>
 #include <pichi/adapter/tcp/adapter.hpp>
+#include <pichi/adapter/tcp/h2.hpp>
+#include <pichi/common/asserts.hpp>
+#include <pichi/common/buffer_pool.hpp>
 #include <pichi/stream/helpers.hpp>
+#include <pichi/stream/splice.hpp>
 
 namespace asio = boost::asio;
+namespace http = boost::beast::http;
 namespace sys  = boost::system;
 
 namespace pichi::actor {
 
+/*
+ * The raw socket is available only if the adapter neither transforms the bytes nor caches any
+ * unconsumed ones. Thus the relay can be done by splice() once both sides provide theirs.
+ */
+template <typename Adapter> static asio::ip::tcp::socket* raw_socket(Adapter& adapter)
+{
+  if constexpr (requires { adapter.raw_socket(); })
+    return adapter.raw_socket();
+  else
+    return nullptr;
+}
+
+/*
+ * The lowest layer socket whose readability can be awaited before borrowing any buffer, which is
+ * available only if the adapter has nothing buffered. The TLS based adapters provide none, since
+ * the ciphertext taken by the TLS engine but not yet decrypted isn't observable.
+ */
+template <typename Adapter> static asio::ip::tcp::socket* idle_socket(Adapter& adapter)
+{
+  if constexpr (requires { adapter.idle_socket(); })
+    return adapter.idle_socket();
+  else
+    return raw_socket(adapter);
+}
+
+/*
+ * The egress connecting to the peer directly reuses the addresses resolved by the router, rather
+ * than resolving the same domain name once more.
+ */
+template <typename Adapter>
+static Awaitable<void>
+    connect(Adapter& adapter, Endpoint const& peer, std::optional<ResolveResults> const& resolved)
+{
+  if constexpr (requires { adapter.connect(peer, *resolved); })
+    if (resolved.has_value()) return adapter.connect(peer, *resolved);
+  return adapter.connect(peer);
+}
+
+// The egress rejecting the sessions with duplicated salts randomly
+static SharedConnector const& rejector()
+{
+  static auto const REJECTOR = std::make_shared<adapter::tcp::Connector const>(vo::Egress{
+      .type_ = AdapterType::REJECT,
+      .opt_  = vo::RejectOption{.mode_ = DelayMode::RANDOM, .delay_ = {}},
+  });
+  return REJECTOR;
+}
+
+// Whether the ingress requested to carry the multiplexed streams rather than a single remote
+template <typename Adapter> static bool multiplexed(Adapter const& adapter)
+{
+  if constexpr (requires { adapter.multiplexed(); })
+    return adapter.multiplexed();
+  else
+    return false;
+}
+
+// Whether the ingress tracks the HTTP exchanges, so that its connection might carry more than one
+template <typename Adapter> static bool persistent(Adapter const& adapter)
+{
+  if constexpr (requires { adapter.persistent(); })
+    return adapter.persistent();
+  else
+    return false;
+}
+
+/*
+ * The progress of the HTTP exchange tracked by the ingress. The connections are left for the
+ * following exchanges only after both the request and its response are relayed to their ends.
+ */
+struct Progress {
+  bool requested_;
+  bool responded_;
+  bool kept_alive_;
+  bool reusable_;
+};
+
+template <typename Adapter> static Progress progress(Adapter const& adapter)
+{
+  if constexpr (requires { adapter.persistent(); })
+    return {adapter.requested(), adapter.responded(), adapter.kept_alive(), adapter.reusable()};
+  else
+    return {true, true, false, false};
+}
+
+template <typename Ingress>
+static Awaitable<void> serve(IOExecutor const&, Ingress&, adapter::tcp::mux::Accept)
+{
+  fail();
+}
+
+template <typename Stream>
+static Awaitable<void> serve(
+    IOExecutor const& ex, adapter::tcp::TrojanIngress<Stream>& ingress,
+    adapter::tcp::mux::Accept accept
+)
+{
+  return adapter::tcp::mux::serve(ex, std::move(ingress), std::move(accept));
+}
+
+template <typename Stream>
+static Awaitable<void> serve(
+    IOExecutor const& ex, adapter::tcp::HttpIngress<Stream>& ingress,
+    adapter::tcp::mux::Accept accept
+)
+{
+  return adapter::tcp::h2::serve(ex, std::move(ingress), std::move(accept));
+}
+
+static size_t adapt(size_t size, size_t received)
+{
+  if (received == size) return std::min(size * 2, PooledBuffer::MAX_SIZE);
+  if (received < size / 4) return std::max(size / 2, PooledBuffer::MIN_SIZE);
+  return size;
+}
+
 template <typename From, typename To> Awaitable<void> bridge(From& from, To& to)
 {
-  auto ec = sys::error_code{};
+  auto ec   = sys::error_code{};
+  auto size = PooledBuffer::MIN_SIZE;
   while (true) {
-    auto buf = std::array<uint8_t, 0xffff>{};
+#ifdef HAS_SPLICE
+    auto src = std::visit([](auto&& from) { return raw_socket(from); }, from);
+    auto dst = std::visit([](auto&& to) { return raw_socket(to); }, to);
+    if (src != nullptr && dst != nullptr) {
+      co_await redirect(stream::splice(*src, *dst), ec);
+      break;
+    }
+#endif  // HAS_SPLICE
+    auto idle = std::visit([](auto&& from) { return idle_socket(from); }, from);
+    if (idle != nullptr) {
+      co_await redirect(idle->async_wait(idle->wait_read, asio::use_awaitable), ec);
+      if (ec) break;
+    }
+
+    auto pooled = PooledBuffer{size};
+    auto buf    = pooled.buffer();
     auto len =
-        co_await redirect(std::visit([&buf](auto&& from) { return from.recv(buf); }, from), ec);
+        co_await redirect(std::visit([buf](auto&& from) { return from.recv(buf); }, from), ec);
     if (ec) break;
-    co_await redirect(std::visit([&buf, len](auto&& to) { return to.send({buf, *len}); }, to), ec);
+    co_await redirect(std::visit([buf, len](auto&& to) { return to.send({buf, *len}); }, to), ec);
     if (ec) break;
+    size = adapt(size, *len);
   }
   co_await std::visit([](auto&& a) { return a.close(); }, from);
   co_await std::visit([](auto&& a) { return a.close(); }, to);
   asio::detail::throw_error(ec);
 }
 
-Awaitable<adapter::tcp::Egress>
+// Relay the bytes until the message tracked by the ingress ends
+template <typename From, typename To>
+static Awaitable<void>
+    relay(From& from, To& to, adapter::tcp::Ingress const& ingress, bool Progress::*done)
+{
+  auto size = PooledBuffer::MIN_SIZE;
+  while (!(std::visit([](auto&& ingress) { return progress(ingress); }, ingress).*done)) {
+    auto pooled = PooledBuffer{size};
+    auto buf    = pooled.buffer();
+    auto len    = co_await std::visit([buf](auto&& from) { return from.recv(buf); }, from);
+    co_await std::visit([buf, len](auto&& to) { return to.send({buf, len}); }, to);
+    size = adapt(size, len);
+  }
+}
+
+Awaitable<Session::Upstream> Session::dial(Endpoint const& remote, vo::Ingress const& vo)
+{
+  auto [rname, ename, connector, resolved] = co_await router_->route(remote, vo.name_, vo.type_);
+
+  // The upstream connection left by the previous exchange to the same remote is reused if alive
+  auto idle   = adapter::tcp::get_idle_pool(ex_).acquire(connector, remote);
+  auto egress = idle.has_value() ? std::move(*idle) : adapter::tcp::create_egress(connector, ex_);
+  if (!idle.has_value())
+    co_await std::visit([&](auto&& egress) { return connect(egress, remote, resolved); }, egress);
+
+  std::clog << std::format(
+      "{} | {}:{} | {}: {} -> {}\n",
+      std::chrono::system_clock::now(),
+      remote.host_,
+      remote.port_,
+      rname,
+      vo.name_,
+      ename
+  );
+
+  co_return Upstream{connector, remote, std::move(egress)};
+}
+
+Awaitable<std::optional<Session::Upstream>>
     Session::handshake(adapter::tcp::Ingress& ingress, vo::Ingress const& vo)
 {
   auto [ec, peer] =
@@ -41,58 +221,122 @@ Awaitable<adapter::tcp::Egress>
         vo.name_
     );
     router_     = nullptr;
-    auto egress = adapter::tcp::create_egress(
-        {
-            .type_ = AdapterType::REJECT,
-            .opt_  = vo::RejectOption{.mode_ = DelayMode::RANDOM, .delay_ = {}}
-    },
-        ex_
-    );
+    auto egress = adapter::tcp::create_egress(rejector(), ex_);
     co_await std::visit([](auto&& egress) { return egress.connect({}); }, egress);
-    co_return egress;
+    co_return Upstream{rejector(), {}, std::move(egress)};
   }
   if (ec) asio::detail::throw_error(ec);
 
-  auto [rname, ename, evo] = co_await router_->route(*peer, vo.name_, vo.type_);
+  // The router is kept for the streams to be demultiplexed
+  if (std::visit([](auto&& ingress) { return multiplexed(ingress); }, ingress))
+    co_return std::nullopt;
 
-  auto egress = adapter::tcp::create_egress(evo, ex_);
-
-  co_await std::visit([&](auto&& egress) { return egress.connect(*peer); }, egress);
+  auto upstream = co_await dial(*peer, vo);
   co_await std::visit([](auto&& ingress) { return ingress.confirm(); }, ingress);
-  router_ = nullptr;
 
-  std::clog << std::format(
-      "{} | {}:{} | {}: {} -> {}\n",
-      std::chrono::system_clock::now(),
-      peer->host_,
-      peer->port_,
-      rname,
-      vo.name_,
-      ename
-  );
+  // The router is kept for the following requests on the connection kept alive
+  if (!std::visit([](auto&& ingress) { return persistent(ingress); }, ingress)) router_ = nullptr;
 
-  co_return egress;
+  co_return upstream;
+}
+
+Awaitable<void> Session::demultiplex(adapter::tcp::Ingress& ingress, IngressPtr const& vo)
+{
+  // Each stream is routed and bridged by a session of its own
+  auto accept = [ex = ex_, router = router_, vo](auto stream, auto remote) {
+    asio::co_spawn(
+        ex,
+        [session = Session{ex, router},
+         ingress = adapter::tcp::Ingress{
+             std::in_place_type<adapter::tcp::MuxIngress>, std::move(stream), std::move(remote)
+         },
+         vo]() mutable { return session.run(std::move(ingress), vo); },
+        detached
+    );
+  };
+  router_ = nullptr;
+  co_await std::visit(
+      [&](auto&& ingress) { return serve(ex_, ingress, std::move(accept)); },
+      ingress
+  );
 }
 
-Awaitable<void> Session::start(vo::Ingress const& vo, Socket s)
+Awaitable<void> Session::exchange(adapter::tcp::Ingress& ingress, Upstream upstream)
 {
-  auto ingress = adapter::tcp::create_ingress(vo, std::move(s));
+  auto&& egress = upstream.egress_;
 
-  auto [ec, egress] = co_await redirect(handshake(ingress, vo));
+  auto [order, e0, e1] =
+      co_await asio::experimental::make_parallel_group(
+          asio::co_spawn(
+              ex_, relay(ingress, egress, ingress, &Progress::requested_), asio::deferred
+          ),
+          asio::co_spawn(
+              ex_, relay(egress, ingress, ingress, &Progress::responded_), asio::deferred
+          )
+      )
+          .async_wait(asio::experimental::wait_for_one_error(), asio::use_awaitable);
 
-  if (ec) {
-    co_await std::visit([ec](auto&& ingress) { return ingress.disconnect(ec); }, ingress);
-    throw sys::system_error(ec);
+  if (e0 || e1) {
+    co_await std::visit([](auto&& a) { return a.close(); }, ingress);
+    co_await std::visit([](auto&& a) { return a.close(); }, egress);
+    std::rethrow_exception(e0 ? e0 : e1);
   }
 
-  auto [order, e0, e1] = co_await asio::experimental::make_parallel_group(
-                             asio::co_spawn(ex_, bridge(ingress, *egress), asio::deferred),
-                             asio::co_spawn(ex_, bridge(*egress, ingress), asio::deferred)
-  )
-                             .async_wait(asio::experimental::wait_for_one(), asio::use_awaitable);
+  if (std::visit([](auto&& ingress) { return progress(ingress); }, ingress).reusable_)
+    adapter::tcp::get_idle_pool(ex_).release(
+        upstream.connector_, std::move(upstream.remote_), std::move(egress)
+    );
+  else
+    co_await std::visit([](auto&& a) { return a.close(); }, egress);
+}
 
-  if (e0) std::rethrow_exception(e0);
-  if (e1) std::rethrow_exception(e1);
+Awaitable<void> Session::run(adapter::tcp::Ingress ingress, IngressPtr vo)
+{
+  /*
+   * The connection kept alive carries the following requests, each of which is routed on its own.
+   * The configuration is owned by the loop, since the ingress might be deleted or replaced
+   * meanwhile.
+   */
+  for (auto kept = false;; kept = true) {
+    auto [ec, upstream] = co_await redirect(handshake(ingress, *vo));
+
+    if (ec) {
+      // The client closing the connection kept alive is not a failure to be replied
+      if (!kept || ec != http::error::end_of_stream)
+        co_await std::visit([ec](auto&& ingress) { return ingress.disconnect(ec); }, ingress);
+      throw sys::system_error(ec);
+    }
+    if (!upstream->has_value()) {
+      co_await demultiplex(ingress, vo);
+      co_return;
+    }
+
+    if (std::visit([](auto&& ingress) { return persistent(ingress); }, ingress)) {
+      co_await exchange(ingress, std::move(**upstream));
+      if (std::visit([](auto&& ingress) { return progress(ingress); }, ingress).kept_alive_)
+        continue;
+      co_await std::visit([](auto&& a) { return a.close(); }, ingress);
+      co_return;
+    }
+
+    auto&& egress        = (*upstream)->egress_;
+    auto [order, e0, e1] = co_await asio::experimental::make_parallel_group(
+                               asio::co_spawn(ex_, bridge(ingress, egress), asio::deferred),
+                               asio::co_spawn(ex_, bridge(egress, ingress), asio::deferred)
+    )
+                               .async_wait(asio::experimental::wait_for_one(), asio::use_awaitable);
+
+    if (e0) std::rethrow_exception(e0);
+    if (e1) std::rethrow_exception(e1);
+    co_return;
+  }
+}
+
+Awaitable<void> Session::start(
+    IngressPtr vo, adapter::tcp::TlsContext const& tls, stream::MasterKey const& key, Socket s
+)
+{
+  co_await run(adapter::tcp::create_ingress(*vo, tls, key, std::move(s)), vo);
 }
 
 }  // namespace pichi::actor
@@ -1,25 +1,63 @@
 #include "pichi/common/config.hpp"
+#include <algorithm>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/execution/context.hpp>
+#include <boost/asio/query.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <pichi/adapter/tcp/adapter.hpp>
 #include <pichi/common/asserts.hpp>
 #include <pichi/common/buffer.hpp>
 #include <pichi/common/enumerations.hpp>
+#include <ranges>
 #include <utility>
 
 using namespace std::literals;
 
+namespace asio = boost::asio;
+namespace rngs = std::ranges;
+namespace sys  = boost::system;
+
 namespace pichi::adapter::tcp {
 
-template <stream::AsyncSocket Socket> Ingress create_ingress(vo::Ingress const& vo, Socket s)
+// Whether the idle egress is still connected, and nothing has been sent by the upstream meanwhile
+static bool alive(Egress& egress)
+{
+  auto socket = std::visit(
+      [](auto&& egress) -> Socket* {
+        if constexpr (requires { egress.raw_socket(); })
+          return egress.raw_socket();
+        else
+          return nullptr;
+      },
+      egress
+  );
+  if (socket == nullptr || !socket->is_open()) return false;
+
+  // Peeking without blocking, which fails with would_block only if the connection is quiet
+  auto byte = uint8_t{};
+  auto ec   = sys::error_code{};
+  socket->non_blocking(true, ec);
+  if (ec) return false;
+  socket->receive(asio::buffer(&byte, sizeof(byte)), Socket::message_peek, ec);
+  auto restored = sys::error_code{};
+  socket->non_blocking(false, restored);
+  return ec == asio::error::would_block && !restored;
+}
+
+template <stream::AsyncSocket Socket>
+Ingress create_ingress(
+    vo::Ingress const& vo, TlsContext const& tls, stream::MasterKey const& key, Socket s
+)
 {
   switch (vo.type_) {
   case AdapterType::SS:
-    return Ingress{std::in_place_type<Shadowsocks<Socket>>, vo, std::move(s)};
+    return Ingress{std::in_place_type<Shadowsocks<Socket>>, vo, key, std::move(s)};
   case AdapterType::SOCKS5:
     if (vo.tls_.has_value())
       return Ingress{
           std::in_place_type<Socks5Ingress<Tls>>,
           vo,
-          Tls{stream::tls_context(*vo.tls_), std::move(s)}
+          Tls{tls, std::move(s)}
       };
     else
       return Ingress{std::in_place_type<Socks5Ingress<Socket>>, vo, std::move(s)};
@@ -28,7 +66,7 @@ template <stream::AsyncSocket Socket> Ingress create_ingress(vo::Ingress const&
       return Ingress{
           std::in_place_type<HttpIngress<Tls>>,
           vo,
-          Tls{stream::tls_context(*vo.tls_), std::move(s)}
+          Tls{tls, std::move(s)}
       };
     else
       return Ingress{std::in_place_type<HttpIngress<Socket>>, vo, std::move(s)};
@@ -37,7 +75,7 @@ template <stream::AsyncSocket Socket> Ingress create_ingress(vo::Ingress const&
       return Ingress{
           std::in_place_type<DualIngress<Tls>>,
           vo,
-          Tls{stream::tls_context(*vo.tls_), std::move(s)}
+          Tls{tls, std::move(s)}
       };
     else
       return Ingress{std::in_place_type<DualIngress<Socket>>, vo, std::move(s)};
@@ -49,7 +87,7 @@ template <stream::AsyncSocket Socket> Ingress create_ingress(vo::Ingress const&
           Websocket{
                     vo.websocket_->path_,
                     vo.websocket_->host_.value_or(""),
-                    stream::tls_context(*vo.tls_),
+                    tls,
                     std::move(s)
           }
       };
@@ -57,7 +95,7 @@ template <stream::AsyncSocket Socket> Ingress create_ingress(vo::Ingress const&
       return Ingress{
           std::in_place_type<TrojanIngress<Tls>>,
           vo,
-          Tls{stream::tls_context(*vo.tls_), std::move(s)}
+          Tls{tls, std::move(s)}
       };
   case AdapterType::TRANSP:
     return Ingress{std::in_place_type<TransparentIngress>, vo, std::move(s)};
@@ -68,11 +106,13 @@ template <stream::AsyncSocket Socket> Ingress create_ingress(vo::Ingress const&
   }
 }
 
-Egress create_egress(vo::Egress const& vo, IOExecutor const& ex)
+Egress create_egress(std::shared_ptr<Connector const> const& connector, IOExecutor const& ex)
 {
+  auto&& vo   = connector->vo();
+  auto&& cred = connector->credential();
   switch (vo.type_) {
   case AdapterType::SS:
-    return Egress{std::in_place_type<Shadowsocks<Socket>>, vo, ex};
+    return Egress{std::in_place_type<Shadowsocks<Socket>>, vo, connector->master_key(), ex};
   case AdapterType::DIRECT:
     return Egress{std::in_place_type<Direct>, ex};
   case AdapterType::REJECT:
@@ -82,31 +122,36 @@ Egress create_egress(vo::Egress const& vo, IOExecutor const& ex)
       return Egress{
           std::in_place_type<Socks5Egress<Tls>>,
           vo,
-          Tls{stream::tls_context(*vo.tls_, vo.server_->host_), Socket{ex}}
+          cred,
+          Tls{connector->tls(), Socket{ex}}
       };
     }
     else
-      return Egress{std::in_place_type<Socks5Egress<Socket>>, vo, Socket{ex}};
+      return Egress{std::in_place_type<Socks5Egress<Socket>>, vo, cred, Socket{ex}};
   case AdapterType::HTTP:
     if (vo.tls_.has_value()) {
       return Egress{
           std::in_place_type<HttpEgress<Tls>>,
           vo,
-          Tls{stream::tls_context(*vo.tls_, vo.server_->host_), Socket{ex}}
+          cred,
+          Tls{connector->tls(), Socket{ex}}
       };
     }
     else
-      return Egress{std::in_place_type<HttpEgress<Socket>>, vo, Socket{ex}};
+      return Egress{std::in_place_type<HttpEgress<Socket>>, vo, cred, Socket{ex}};
   case AdapterType::TROJAN:
-    if (vo.websocket_.has_value())
+    if (vo.mux_.has_value())
+      return Egress{std::in_place_type<MuxEgress>, connector, ex};
+    else if (vo.websocket_.has_value())
       return Egress{
           std::in_place_type<TrojanEgress<Websocket>>,
           vo,
+          cred,
           Websocket{
                     vo.websocket_->path_,
                     vo.websocket_->host_.value_or(""),
                     vo.tls_->sni_,
-                    stream::tls_context(*vo.tls_, vo.server_->host_),
+                    connector->tls(),
                     ex
           }
       };
@@ -114,13 +159,121 @@ Egress create_egress(vo::Egress const& vo, IOExecutor const& ex)
       return Egress{
           std::in_place_type<TrojanEgress<Tls>>,
           vo,
-          Tls{vo.tls_->sni_, stream::tls_context(*vo.tls_, vo.server_->host_), ex}
+          cred,
+          Tls{vo.tls_->sni_, connector->tls(), ex}
       };
   default:
     fail();
   }
 }
 
-template Ingress create_ingress(vo::Ingress const&, Socket);
+template Ingress
+    create_ingress(vo::Ingress const&, TlsContext const&, stream::MasterKey const&, Socket);
+
+IdlePool::IdlePool(asio::execution_context& ctx)
+  : asio::detail::execution_context_service_base<IdlePool>{ctx}
+{
+}
+
+void IdlePool::shutdown() noexcept { entries_.clear(); }
+
+void IdlePool::drop(Egress egress)
+{
+  asio::co_spawn(
+      *ex_,
+      [egress = std::move(egress)]() mutable -> Awaitable<void> {
+        co_await std::visit([](auto&& egress) { return egress.close(); }, egress);
+      },
+      asio::detached
+  );
+}
+
+// Close the egresses idle for too long, or left by the connectors no longer used
+void IdlePool::expire(Clock::time_point now)
+{
+  for (auto it = std::begin(entries_); it != std::end(entries_);) {
+    auto&& idles = it->second;
+    auto   last  = rngs::begin(idles);
+    while (last != rngs::end(idles) && (it->first.expired() || now - last->since_ >= TIMEOUT))
+      ++last;
+    for (auto idle = rngs::begin(idles); idle != last; ++idle) drop(std::move(idle->egress_));
+    idles.erase(rngs::begin(idles), last);
+    it = rngs::empty(idles) ? entries_.erase(it) : std::next(it);
+  }
+}
+
+// The idles of each connector are ordered by their arrival, so the earliest one is the front
+Awaitable<void> IdlePool::sweep()
+{
+  auto timer = asio::steady_timer{*ex_};
+  while (!rngs::empty(entries_)) {
+    auto since = Clock::time_point::max();
+    for (auto&& [_, idles] : entries_) since = std::min(since, idles.front().since_);
+    timer.expires_at(since + TIMEOUT);
+    co_await timer.async_wait(asio::use_awaitable);
+    expire(Clock::now());
+  }
+  sweeping_ = false;
+}
+
+void IdlePool::initialize(IOExecutor const& ex)
+{
+  if (!ex_.has_value()) ex_ = ex;
+}
+
+std::optional<Egress>
+    IdlePool::acquire(std::shared_ptr<Connector const> const& connector, Endpoint const& remote)
+{
+  expire(Clock::now());
+
+  auto it = entries_.find(connector);
+  if (it == std::end(entries_)) return std::nullopt;
+
+  // The upstream might have closed the connection, or replied something unsolicited
+  auto&& idles = it->second;
+  auto   ret   = std::optional<Egress>{};
+  while (!ret.has_value()) {
+    auto idle = rngs::find(idles, remote, &Idle::remote_);
+    if (idle == rngs::end(idles)) break;
+
+    auto egress = std::move(idle->egress_);
+    idles.erase(idle);
+    if (alive(egress))
+      ret = std::move(egress);
+    else
+      drop(std::move(egress));
+  }
+
+  // The sweeper relies on no connector left without idles
+  if (rngs::empty(idles)) entries_.erase(it);
+  return ret;
+}
+
+void IdlePool::release(
+    std::shared_ptr<Connector const> const& connector, Endpoint remote, Egress egress)
+{
+  if (!alive(egress)) {
+    drop(std::move(egress));
+    return;
+  }
+
+  auto&& idles = entries_[connector];
+  if (rngs::size(idles) >= LIMIT) {
+    drop(std::move(idles.front().egress_));
+    idles.erase(rngs::begin(idles));
+  }
+  idles.push_back({std::move(remote), std::move(egress), Clock::now()});
+
+  if (sweeping_) return;
+  sweeping_ = true;
+  asio::co_spawn(*ex_, sweep(), asio::detached);
+}
+
+IdlePool& get_idle_pool(IOExecutor const& ex)
+{
+  auto&& pool = asio::use_service<IdlePool>(asio::query(ex, asio::execution::context));
+  pool.initialize(ex);
+  return pool;
+}
 
 }  // namespace pichi::adapter::tcp
@@ -0,0 +1,64 @@
+#include "pichi/common/config.hpp"
+#include <pichi/adapter/tcp/connector.hpp>
+#include <pichi/adapter/tcp/http.hpp>
+#include <pichi/adapter/tcp/socks5.hpp>
+#include <pichi/adapter/tcp/trojan.hpp>
+#include <pichi/common/enumerations.hpp>
+#include <pichi/stream/tls.hpp>
+#include <utility>
+
+namespace ssl = boost::asio::ssl;
+
+namespace pichi::adapter::tcp {
+
+static std::string gen_credential(vo::Egress const& vo)
+{
+  switch (vo.type_) {
+  case AdapterType::HTTP:
+    return detail::gen_credential(vo);
+  case AdapterType::SOCKS5:
+    return socks5::gen_credential(vo);
+  case AdapterType::TROJAN:
+    return trojan::gen_credential(vo);
+  default:
+    return {};
+  }
+}
+
+static std::shared_ptr<ssl::context> gen_tls(vo::Egress const& vo)
+{
+  if (!vo.tls_.has_value()) return nullptr;
+  switch (vo.type_) {
+  case AdapterType::HTTP:
+  case AdapterType::SOCKS5:
+  case AdapterType::TROJAN:
+    return std::make_shared<ssl::context>(stream::tls_context(*vo.tls_, vo.server_->host_));
+  default:
+    return nullptr;
+  }
+}
+
+static stream::MasterKey gen_master_key(vo::Egress const& vo)
+{
+  if (vo.type_ != AdapterType::SS) return nullptr;
+  auto&& opt = std::get<vo::ShadowsocksOption>(*vo.opt_);
+  return stream::derive_master_key(opt.method_, ConstBuffer{opt.password_});
+}
+
+Connector::Connector(vo::Egress vo)
+  : vo_{std::move(vo)},
+    tls_{gen_tls(vo_)},
+    credential_{gen_credential(vo_)},
+    master_key_{gen_master_key(vo_)}
+{
+}
+
+vo::Egress const& Connector::vo() const { return vo_; }
+
+std::shared_ptr<ssl::context> const& Connector::tls() const { return tls_; }
+
+std::string const& Connector::credential() const { return credential_; }
+
+stream::MasterKey const& Connector::master_key() const { return master_key_; }
+
+}  // namespace pichi::adapter::tcp
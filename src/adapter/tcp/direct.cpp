@@ -3,20 +3,30 @@
 #include <boost/asio/execution_context.hpp>
 #include <pichi/adapter/tcp/direct.hpp>
 #include <pichi/service/clients.hpp>
+#include <pichi/service/workers.hpp>
 #include <pichi/stream/helpers.hpp>
 
 namespace asio = boost::asio;
 
 namespace pichi::adapter::tcp {
 
+static service::TcpClients& get_clients(asio::ip::tcp::socket& socket)
+{
+  return asio::use_service<service::TcpClients>(
+      asio::query(service::primary_executor(socket.get_executor()), asio::execution::context)
+  );
+}
+
 Awaitable<void> Direct::connect(Endpoint const& peer)
 {
   co_await stream::connect(socket_, peer);
+  get_clients(socket_).insert(socket_.local_endpoint());
+}
 
-  auto& clients = asio::use_service<service::TcpClients>(
-      asio::query(socket_.get_executor(), asio::execution::context)
-  );
-  clients.insert(socket_.local_endpoint());
+Awaitable<void> Direct::connect(Endpoint const&, ResolveResults const& results)
+{
+  co_await stream::connect(socket_, results);
+  get_clients(socket_).insert(socket_.local_endpoint());
 }
 
 Awaitable<size_t> Direct::recv(MutableBuffer buf)
@@ -28,12 +38,11 @@ Awaitable<void> Direct::send(ConstBuffer buf) { co_await stream::write(socket_,
 
 Awaitable<void> Direct::close()
 {
-  auto& clients = asio::use_service<service::TcpClients>(
-      asio::query(socket_.get_executor(), asio::execution::context)
-  );
-  clients.remove(socket_.local_endpoint());
+  get_clients(socket_).remove(socket_.local_endpoint());
 
   co_await stream::close(socket_);
 }
 
+Direct::Socket* Direct::raw_socket() { return &socket_; }
+
 }  // namespace pichi::adapter::tcp
@@ -41,6 +41,13 @@ template <stream::AsyncLayer NextLayer> Awaitable<void> DualIngress<NextLayer>::
 
 template <stream::AsyncLayer NextLayer> Awaitable<Endpoint> DualIngress<NextLayer>::read_remote()
 {
+  if (delegate_.has_value()) {
+    // The following request on the HTTP connection kept alive
+    auto http = std::get_if<HttpIngress<NextLayer>>(&*delegate_);
+    assertTrue(http != nullptr, PichiError::MISC, "Unexpected invocation");
+    co_return co_await http->read_remote();
+  }
+
   co_await stream::accept(underlying_);
 
   auto buf = std::array<uint8_t, 1>{};
@@ -50,10 +57,15 @@ template <stream::AsyncLayer NextLayer> Awaitable<Endpoint> DualIngress<NextLaye
     delegate_.emplace(std::in_place_type<Socks5Ingress<NextLayer>>, vo_, std::move(underlying_));
   else
     delegate_.emplace(std::in_place_type<HttpIngress<NextLayer>>, vo_, std::move(underlying_));
-  co_return co_await std::visit(
+  auto remote = co_await std::visit(
       [&](auto&& ingress) { return ingress.continue_read_remote(buf); },
       *delegate_
   );
+
+  // The HTTP/2 connections are only served by the HTTP ingress
+  auto http = std::get_if<HttpIngress<NextLayer>>(&*delegate_);
+  assertFalse(http != nullptr && http->multiplexed(), PichiError::BAD_PROTO);
+  co_return remote;
 }
 
 template <stream::AsyncLayer NextLayer> Awaitable<void> DualIngress<NextLayer>::confirm()
@@ -70,6 +82,37 @@ Awaitable<void> DualIngress<NextLayer>::disconnect(sys::error_code const& ec)
   co_return;
 }
 
+template <stream::AsyncLayer NextLayer> bool DualIngress<NextLayer>::persistent() const
+{
+  return http() != nullptr && http()->persistent();
+}
+
+template <stream::AsyncLayer NextLayer> bool DualIngress<NextLayer>::requested() const
+{
+  return http() != nullptr && http()->requested();
+}
+
+template <stream::AsyncLayer NextLayer> bool DualIngress<NextLayer>::responded() const
+{
+  return http() != nullptr && http()->responded();
+}
+
+template <stream::AsyncLayer NextLayer> bool DualIngress<NextLayer>::kept_alive() const
+{
+  return http() != nullptr && http()->kept_alive();
+}
+
+template <stream::AsyncLayer NextLayer> bool DualIngress<NextLayer>::reusable() const
+{
+  return http() != nullptr && http()->reusable();
+}
+
+template <stream::AsyncLayer NextLayer>
+HttpIngress<NextLayer> const* DualIngress<NextLayer>::http() const
+{
+  return delegate_.has_value() ? std::get_if<HttpIngress<NextLayer>>(&*delegate_) : nullptr;
+}
+
 template class DualIngress<Socket>;
 template class DualIngress<Tls>;
 
@@ -0,0 +1,862 @@
+#include "pichi/common/config.hpp"
+#include <algorithm>
+#include <array>
+#include <boost/asio/detail/throw_error.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/http/fields.hpp>
+#include <boost/beast/http/status.hpp>
+#include <boost/system/system_error.hpp>
+#include <pichi/adapter/tcp/adapter.hpp>
+#include <pichi/adapter/tcp/h2.hpp>
+#include <pichi/common/asserts.hpp>
+#include <pichi/common/literals.hpp>
+#include <pichi/common/uri.hpp>
+#include <pichi/stream/test.hpp>
+#include <ranges>
+#include <string_view>
+#include <unordered_map>
+
+namespace asio = boost::asio;
+namespace http = boost::beast::http;
+namespace rngs = std::ranges;
+namespace sys  = boost::system;
+
+using namespace std::literals;
+
+namespace pichi::adapter::tcp::h2 {
+
+// The frame types @RFC9113 6
+enum class Type : uint8_t {
+  DATA          = 0x0,
+  HEADERS       = 0x1,
+  PRIORITY      = 0x2,
+  RST_STREAM    = 0x3,
+  SETTINGS      = 0x4,
+  PUSH_PROMISE  = 0x5,
+  PING          = 0x6,
+  GOAWAY        = 0x7,
+  WINDOW_UPDATE = 0x8,
+  CONTINUATION  = 0x9
+};
+
+static auto const END_STREAM  = 0x01_u8;
+static auto const ACK         = 0x01_u8;
+static auto const END_HEADERS = 0x04_u8;
+static auto const PADDED      = 0x08_u8;
+static auto const PRIORITIZED = 0x20_u8;
+
+static auto const ENABLE_PUSH            = 0x2_u16;
+static auto const MAX_CONCURRENT_STREAMS = 0x3_u16;
+static auto const INITIAL_WINDOW_SIZE    = 0x4_u16;
+
+static auto const REFUSED_STREAM = uint32_t{0x7};
+static auto const CANCEL         = uint32_t{0x8};
+
+static auto const FRAME_HEADER   = 9_sz;
+static auto const MAX_STREAMS    = uint32_t{128};
+static auto const DEFAULT_WINDOW = int64_t{65535};
+static auto const MAX_WINDOW     = int64_t{0x7fffffff};
+
+// The header block is accumulated until END_HEADERS, whose encoded size is limited as well
+static auto const HEADER_LIMIT = 64_sz * 1024;
+
+struct Code {
+  uint32_t code_;
+  uint8_t  bits_;
+};
+
+struct Node {
+  std::array<int16_t, 2> next_   = {-1, -1};
+  int16_t                symbol_ = -1;
+};
+
+// The Huffman codes of the octets and EOS @RFC7541 Appendix B
+static auto const HUFFMAN_CODES = std::array<Code, 257>{{
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28},
+    {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28}, {0xfffffe8, 28}, {0xffffea, 24},
+    {0x3ffffffc, 30}, {0xfffffe9, 28}, {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28},
+    {0xfffffec, 28}, {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+    {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28}, {0xffffff4, 28},
+    {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28},
+    {0xffffffa, 28}, {0xffffffb, 28}, {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+    {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8},
+    {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6}, {0x0, 5}, {0x1, 5}, {0x2, 5},
+    {0x19, 6}, {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6}, {0x5c, 7},
+    {0xfb, 8}, {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6},
+    {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7}, {0x63, 7}, {0x64, 7},
+    {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7},
+    {0x6d, 7}, {0x6e, 7}, {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7},
+    {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6}, {0x7ffd, 15},
+    {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5},
+    {0x74, 7}, {0x75, 7}, {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7},
+    {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7}, {0x79, 7}, {0x7a, 7}, {0x7b, 7},
+    {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20},
+    {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20}, {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22},
+    {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23},
+    {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23}, {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22},
+    {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23},
+    {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23}, {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23},
+    {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22},
+    {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21}, {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22},
+    {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21},
+    {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21}, {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23},
+    {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23},
+    {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23}, {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20},
+    {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26},
+    {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27}, {0x7ffffdf, 27}, {0x3ffffe5, 26},
+    {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26},
+    {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+    {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28},
+    {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20},
+    {0x1fffe6, 21}, {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22},
+    {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24},
+    {0x3ffffea, 26}, {0x7ffff4, 23}, {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26},
+    {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+    {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27}, {0x7ffffee, 27},
+    {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+    {0x3fffffff, 30},
+}};
+
+static auto const EOS = 256;
+
+// The static table @RFC7541 Appendix A, whose index starts from 1
+static auto const STATIC_TABLE = std::array<std::pair<std::string_view, std::string_view>, 61>{{
+    {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"},
+    {":path", "/index.html"}, {":scheme", "http"}, {":scheme", "https"}, {":status", "200"},
+    {":status", "204"}, {":status", "206"}, {":status", "304"}, {":status", "400"},
+    {":status", "404"}, {":status", "500"}, {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"}, {"accept-language", ""}, {"accept-ranges", ""},
+    {"accept", ""}, {"access-control-allow-origin", ""}, {"age", ""}, {"allow", ""},
+    {"authorization", ""}, {"cache-control", ""}, {"content-disposition", ""},
+    {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+    {"content-location", ""}, {"content-range", ""}, {"content-type", ""}, {"cookie", ""},
+    {"date", ""}, {"etag", ""}, {"expect", ""}, {"expires", ""}, {"from", ""}, {"host", ""},
+    {"if-match", ""}, {"if-modified-since", ""}, {"if-none-match", ""}, {"if-range", ""},
+    {"if-unmodified-since", ""}, {"last-modified", ""}, {"link", ""}, {"location", ""},
+    {"max-forwards", ""}, {"proxy-authenticate", ""}, {"proxy-authorization", ""}, {"range", ""},
+    {"referer", ""}, {"refresh", ""}, {"retry-after", ""}, {"server", ""}, {"set-cookie", ""},
+    {"strict-transport-security", ""}, {"transfer-encoding", ""}, {"user-agent", ""}, {"vary", ""},
+    {"via", ""}, {"www-authenticate", ""},
+}};
+
+static auto const STATUS             = 8_sz;
+static auto const PROXY_AUTHENTICATE = 48_sz;
+
+// The size of an entry in the dynamic table is counted with an overhead @RFC7541 4.1
+static auto const ENTRY_OVERHEAD = 32_sz;
+
+static std::vector<Node> build_tree()
+{
+  auto tree = std::vector<Node>(1);
+  for (auto symbol = 0; symbol < rngs::ssize(HUFFMAN_CODES); ++symbol) {
+    auto node = 0;
+    for (auto i = HUFFMAN_CODES[symbol].bits_; i-- > 0;) {
+      auto bit = (HUFFMAN_CODES[symbol].code_ >> i) & 1;
+      if (tree[node].next_[bit] < 0) {
+        tree[node].next_[bit] = static_cast<int16_t>(tree.size());
+        tree.emplace_back();
+      }
+      node = tree[node].next_[bit];
+    }
+    tree[node].symbol_ = static_cast<int16_t>(symbol);
+  }
+  return tree;
+}
+
+static std::string decode_huffman(ConstBuffer src)
+{
+  static auto const TREE = build_tree();
+
+  auto ret   = std::string{};
+  auto node  = 0;
+  auto depth = 0;  // The bits consumed since the last symbol
+  auto ones  = true;
+  for (auto byte : src) {
+    for (auto i = 8; i-- > 0;) {
+      auto bit = (byte >> i) & 1;
+      node     = TREE[node].next_[bit];
+      assertTrue(node >= 0, PichiError::BAD_PROTO);
+      ++depth;
+      ones = ones && bit == 1;
+      if (TREE[node].symbol_ < 0) continue;
+
+      assertTrue(TREE[node].symbol_ != EOS, PichiError::BAD_PROTO);
+      ret.push_back(static_cast<char>(TREE[node].symbol_));
+      node  = 0;
+      depth = 0;
+      ones  = true;
+    }
+  }
+
+  // The padding is the most significant bits of EOS, which is shorter than 8 bits
+  assertTrue(depth < 8 && ones, PichiError::BAD_PROTO);
+  return ret;
+}
+
+// The integer with a prefix of bits @RFC7541 5.1
+static size_t decode_integer(ConstBuffer& src, uint8_t bits)
+{
+  assertFalse(src.empty(), PichiError::BAD_PROTO);
+  auto max   = (1_sz << bits) - 1;
+  auto value = src[0] & max;
+  src += 1;
+  if (value < max) return value;
+
+  for (auto shift = 0; true; shift += 7) {
+    assertTrue(!src.empty() && shift <= 28, PichiError::BAD_PROTO);
+    auto byte = src[0];
+    src += 1;
+    value += static_cast<size_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return value;
+  }
+}
+
+// The string literal @RFC7541 5.2
+static std::string decode_string(ConstBuffer& src)
+{
+  assertFalse(src.empty(), PichiError::BAD_PROTO);
+  auto huffman = (src[0] & 0x80) != 0;
+  auto len     = decode_integer(src, 7);
+  assertTrue(len <= src.size(), PichiError::BAD_PROTO);
+
+  auto raw = ConstBuffer{src.data(), len};
+  src += len;
+  return huffman ? decode_huffman(raw) : std::string{rngs::begin(raw), rngs::end(raw)};
+}
+
+static size_t encode_integer(size_t value, uint8_t bits, uint8_t flags, MutableBuffer dst)
+{
+  auto max = (1_sz << bits) - 1;
+  if (value < max) {
+    dst[0] = static_cast<uint8_t>(flags | value);
+    return 1;
+  }
+
+  dst[0]   = static_cast<uint8_t>(flags | max);
+  auto len = 1_sz;
+  for (value -= max; value >= 0x80; value >>= 7) dst[len++] = static_cast<uint8_t>(value | 0x80);
+  dst[len++] = static_cast<uint8_t>(value);
+  return len;
+}
+
+// The literal field without indexing, whose name is indexed @RFC7541 6.2.2
+static size_t encode_field(size_t name, std::string_view value, MutableBuffer dst)
+{
+  auto len = encode_integer(name, 4, 0x00, dst);
+  len += encode_integer(value.size(), 7, 0x00, dst + len);
+  rngs::copy(value, rngs::begin(dst) + len);
+  return len + value.size();
+}
+
+// Only the status, and the authentication scheme if required, are replied
+static size_t encode_status(http::status status, MutableBuffer dst)
+{
+  auto value = std::to_string(static_cast<unsigned>(status));
+  auto it    = rngs::find(STATIC_TABLE, std::pair{":status"sv, std::string_view{value}});
+  if (it != rngs::end(STATIC_TABLE))
+    return encode_integer(rngs::distance(rngs::begin(STATIC_TABLE), it) + 1, 7, 0x80, dst);
+
+  auto len = encode_field(STATUS, value, dst);
+  if (status == http::status::proxy_authentication_required)
+    len += encode_field(PROXY_AUTHENTICATE, "Basic"sv, dst + len);
+  return len;
+}
+
+Decoder::Fields Decoder::decode(ConstBuffer block, size_t limit)
+{
+  auto fields = Fields{};
+  auto total  = 0_sz;
+  auto emit   = [&](Field field) {
+    total += field.first.size() + field.second.size();
+    assertTrue(total <= limit, PichiError::BAD_PROTO);
+    fields.push_back(std::move(field));
+  };
+
+  while (!block.empty()) {
+    auto prefix = block[0];
+    if ((prefix & 0x80) != 0)
+      emit(get(decode_integer(block, 7)));
+    else if ((prefix & 0x40) != 0) {
+      auto field = literal(block, 6);
+      insert(field);
+      emit(std::move(field));
+    }
+    else if ((prefix & 0x20) != 0) {
+      // The size update is only allowed at the beginning of the block @RFC7541 4.2
+      assertTrue(fields.empty(), PichiError::BAD_PROTO);
+      capacity_ = decode_integer(block, 5);
+      assertTrue(capacity_ <= TABLE_SIZE, PichiError::BAD_PROTO);
+      evict(capacity_);
+    }
+    else
+      emit(literal(block, 4));
+  }
+  return fields;
+}
+
+Decoder::Field Decoder::get(size_t index) const
+{
+  assertTrue(index > 0 && index <= STATIC_TABLE.size() + table_.size(), PichiError::BAD_PROTO);
+  if (index > STATIC_TABLE.size()) return table_[index - STATIC_TABLE.size() - 1];
+
+  auto&& [name, value] = STATIC_TABLE[index - 1];
+  return {std::string{name}, std::string{value}};
+}
+
+Decoder::Field Decoder::literal(ConstBuffer& block, uint8_t bits) const
+{
+  auto index = decode_integer(block, bits);
+  auto name  = index == 0 ? decode_string(block) : get(index).first;
+  return {std::move(name), decode_string(block)};
+}
+
+void Decoder::insert(Field field)
+{
+  // The table is emptied by the entry larger than its capacity @RFC7541 4.4
+  auto size = field.first.size() + field.second.size() + ENTRY_OVERHEAD;
+  evict(capacity_ - std::min(size, capacity_));
+  if (size > capacity_) return;
+
+  size_ += size;
+  table_.push_front(std::move(field));
+}
+
+void Decoder::evict(size_t capacity)
+{
+  while (size_ > capacity) {
+    auto&& [name, value] = table_.back();
+    size_ -= name.size() + value.size() + ENTRY_OVERHEAD;
+    table_.pop_back();
+  }
+}
+
+static size_t
+    serialize(MutableBuffer dst, Type type, uint8_t flags, uint32_t id, ConstBuffer payload)
+{
+  auto len = payload.size();
+  dst[0]   = static_cast<uint8_t>(len >> 16);
+  dst[1]   = static_cast<uint8_t>(len >> 8);
+  dst[2]   = static_cast<uint8_t>(len);
+  dst[3]   = static_cast<uint8_t>(type);
+  dst[4]   = flags;
+  hton(id, {dst.data() + 5, sizeof(uint32_t)});
+  rngs::copy(payload, rngs::begin(dst) + FRAME_HEADER);
+  return FRAME_HEADER + len;
+}
+
+static void serialize(MutableBuffer dst, uint16_t id, uint32_t value)
+{
+  hton(id, {dst.data(), sizeof(uint16_t)});
+  hton(value, {dst.data() + sizeof(uint16_t), sizeof(uint32_t)});
+}
+
+template <typename Transport> class Connection : public mux::Link {
+private:
+  using Timer = asio::steady_timer;
+  using Frame = std::array<uint8_t, FRAME_HEADER + mux::MAX_FRAME>;
+
+  // A stream is PENDING until it's responded, and ENDED if responded with an error
+  enum class State { PENDING, OPEN, ENDED };
+
+  /*
+   * The bytes buffered by the stream are pending until they're returned by UPD, and the pending
+   * ones are returned to the connection window once the stream is erased.
+   */
+  struct Entry {
+    std::weak_ptr<mux::Stream> stream_;
+    State                      state_    = State::PENDING;
+    bool                       released_ = false;
+    size_t                     pending_  = 0;
+  };
+
+  using Streams = std::unordered_map<uint32_t, Entry>;
+
+  std::shared_ptr<mux::Stream> find(uint32_t) const;
+  void                         finish(sys::error_code const&);
+  size_t                       erase(typename Streams::iterator);
+
+  Awaitable<void> lock();
+  Awaitable<void> flush(size_t);
+  Awaitable<void> send(Type, uint8_t, uint32_t, ConstBuffer);
+  Awaitable<void> update(uint32_t, size_t);
+  Awaitable<void> reply(uint32_t, http::status, bool);
+
+  Awaitable<void> read(MutableBuffer);
+  Awaitable<void> skip(size_t);
+  Awaitable<void> greet();
+  Awaitable<void> dispatch(Type, uint8_t, uint32_t, size_t);
+  Awaitable<void> receive(uint8_t, uint32_t, size_t);
+  Awaitable<void> collect(Type, uint8_t, uint32_t, size_t);
+  Awaitable<void> configure(uint8_t, uint32_t, size_t);
+  Awaitable<void> request(uint32_t, Decoder::Fields, bool);
+
+public:
+  Connection(IOExecutor const&, Transport, mux::Accept);
+
+  Awaitable<std::shared_ptr<mux::Stream>> open(Endpoint const&) override;
+  Awaitable<void> write(mux::Command, uint32_t, ConstBuffer) override;
+  Awaitable<void> respond(uint32_t, sys::error_code) override;
+  void            release(uint32_t) override;
+
+  size_t streams() const override;
+  bool   is_open() const override;
+
+  Awaitable<void> run();
+
+private:
+  IOExecutor  ex_;
+  Transport   transport_;
+  mux::Accept accept_;
+  Streams     streams_ = {};
+  uint32_t    last_    = 0;
+  bool        open_    = true;
+  bool        writing_ = false;
+  Timer       gate_;
+
+  // The connection window of the outgoing data, and the initial one of each stream
+  int64_t window_  = DEFAULT_WINDOW;
+  int64_t initial_ = DEFAULT_WINDOW;
+  Timer   windowed_;
+
+  // The header block being continued, which belongs to block_id_ unless it's 0
+  Decoder              decoder_   = {};
+  std::vector<uint8_t> block_     = {};
+  uint32_t             block_id_  = 0;
+  bool                 block_end_ = false;
+
+  // The outgoing frames, and the incoming payload which is not buffered by any stream
+  Frame frame_   = {};
+  Frame inbound_ = {};
+};
+
+template <typename Transport>
+Connection<Transport>::Connection(IOExecutor const& ex, Transport transport, mux::Accept accept)
+  : ex_{ex},
+    transport_{std::move(transport)},
+    accept_{std::move(accept)},
+    gate_{ex, Timer::time_point::max()},
+    windowed_{ex, Timer::time_point::max()}
+{
+}
+
+// The released streams are being closed, whose frames are discarded
+template <typename Transport>
+std::shared_ptr<mux::Stream> Connection<Transport>::find(uint32_t id) const
+{
+  auto it = streams_.find(id);
+  return it == std::cend(streams_) || it->second.released_ ? nullptr : it->second.stream_.lock();
+}
+
+template <typename Transport> void Connection<Transport>::finish(sys::error_code const& ec)
+{
+  open_ = false;
+  for (auto&& [id, entry] : streams_)
+    if (auto stream = entry.stream_.lock(); stream) stream->finish(ec ? ec : asio::error::eof);
+  streams_.clear();
+  gate_.cancel();
+  windowed_.cancel();
+}
+
+// Erase the stream, and return its pending bytes
+template <typename Transport>
+size_t Connection<Transport>::erase(typename Streams::iterator it)
+{
+  auto pending = it->second.pending_;
+  streams_.erase(it);
+  return pending;
+}
+
+template <typename Transport> Awaitable<void> Connection<Transport>::lock()
+{
+  while (writing_ && open_) co_await mux::wait(gate_);
+  if (!open_) asio::detail::throw_error(asio::error::not_connected);
+  writing_ = true;
+}
+
+// Send the first len bytes of frame_, which is locked before
+template <typename Transport> Awaitable<void> Connection<Transport>::flush(size_t len)
+{
+  auto ec  = co_await redirect(transport_.send({frame_, len}));
+  writing_ = false;
+  gate_.cancel_one();
+  asio::detail::throw_error(ec);
+}
+
+template <typename Transport>
+Awaitable<void>
+    Connection<Transport>::send(Type type, uint8_t flags, uint32_t id, ConstBuffer payload)
+{
+  co_await lock();
+  co_await flush(serialize(frame_, type, flags, id, payload));
+}
+
+// Return n bytes to the connection window, and to the stream one unless id is 0
+template <typename Transport> Awaitable<void> Connection<Transport>::update(uint32_t id, size_t n)
+{
+  if (n == 0) co_return;
+
+  auto bytes = std::array<uint8_t, sizeof(uint32_t)>{};
+  hton(static_cast<uint32_t>(n), bytes);
+
+  co_await lock();
+  auto len = serialize(frame_, Type::WINDOW_UPDATE, 0, 0, bytes);
+  if (id != 0) len += serialize(MutableBuffer{frame_} + len, Type::WINDOW_UPDATE, 0, id, bytes);
+  co_await flush(len);
+}
+
+template <typename Transport>
+Awaitable<void> Connection<Transport>::reply(uint32_t id, http::status status, bool end)
+{
+  auto block = std::array<uint8_t, 32>{};
+  auto len   = encode_status(status, block);
+  auto flags = static_cast<uint8_t>(end ? END_HEADERS | END_STREAM : END_HEADERS);
+  co_await send(Type::HEADERS, flags, id, {block, len});
+}
+
+template <typename Transport> Awaitable<void> Connection<Transport>::read(MutableBuffer buf)
+{
+  while (buf.size() > 0) buf += co_await transport_.recv(buf);
+}
+
+template <typename Transport> Awaitable<void> Connection<Transport>::skip(size_t n)
+{
+  while (n > 0) {
+    auto len = std::min(n, inbound_.size());
+    co_await read({inbound_, len});
+    n -= len;
+  }
+}
+
+// The server preface, after which the connection window is enlarged to the maximum
+template <typename Transport> Awaitable<void> Connection<Transport>::greet()
+{
+  auto settings = std::array<uint8_t, 18>{};
+  serialize(settings, ENABLE_PUSH, 0);
+  serialize(MutableBuffer{settings} + 6, MAX_CONCURRENT_STREAMS, MAX_STREAMS);
+  serialize(MutableBuffer{settings} + 12, INITIAL_WINDOW_SIZE, mux::WINDOW);
+
+  auto bytes = std::array<uint8_t, sizeof(uint32_t)>{};
+  hton(static_cast<uint32_t>(MAX_WINDOW - DEFAULT_WINDOW), bytes);
+
+  co_await lock();
+  auto len = serialize(frame_, Type::SETTINGS, 0, 0, settings);
+  len += serialize(MutableBuffer{frame_} + len, Type::WINDOW_UPDATE, 0, 0, bytes);
+  co_await flush(len);
+}
+
+template <typename Transport>
+Awaitable<void> Connection<Transport>::dispatch(Type type, uint8_t flags, uint32_t id, size_t len)
+{
+  assertTrue(len <= mux::MAX_FRAME, PichiError::BAD_PROTO);
+  // No frame is allowed to interleave the header block @RFC9113 6.10
+  assertTrue(
+      type == Type::CONTINUATION ? id != 0 && id == block_id_ : block_id_ == 0,
+      PichiError::BAD_PROTO
+  );
+
+  switch (type) {
+  case Type::DATA:
+    co_await receive(flags, id, len);
+    break;
+  case Type::HEADERS:
+  case Type::CONTINUATION:
+    co_await collect(type, flags, id, len);
+    break;
+  case Type::RST_STREAM:
+    assertTrue(id != 0 && len == sizeof(uint32_t), PichiError::BAD_PROTO);
+    co_await read({inbound_, len});
+    if (auto stream = find(id); stream) stream->finish(asio::error::connection_reset);
+    if (auto it = streams_.find(id); it != std::end(streams_)) co_await update(0, erase(it));
+    break;
+  case Type::SETTINGS:
+    co_await configure(flags, id, len);
+    break;
+  case Type::PING:
+    assertTrue(id == 0 && len == 8, PichiError::BAD_PROTO);
+    co_await read({inbound_, len});
+    if ((flags & ACK) == 0) co_await send(Type::PING, ACK, 0, {inbound_, len});
+    break;
+  case Type::WINDOW_UPDATE: {
+    assertTrue(len == sizeof(uint32_t), PichiError::BAD_PROTO);
+    co_await read({inbound_, len});
+    auto n = ntoh<uint32_t>({inbound_.data(), len}) & 0x7fffffff;
+    assertTrue(n > 0, PichiError::BAD_PROTO);
+    if (id == 0) {
+      window_ += n;
+      assertTrue(window_ <= MAX_WINDOW, PichiError::BAD_PROTO);
+      windowed_.cancel();
+    }
+    else if (auto stream = find(id); stream)
+      stream->grant(n);
+    break;
+  }
+  case Type::PUSH_PROMISE:
+    fail(PichiError::BAD_PROTO);
+  default:
+    // PRIORITY, GOAWAY and the unknown frames are ignored
+    co_await skip(len);
+  }
+}
+
+template <typename Transport>
+Awaitable<void> Connection<Transport>::receive(uint8_t flags, uint32_t id, size_t len)
+{
+  assertTrue(id != 0, PichiError::BAD_PROTO);
+
+  auto padding = 0_sz;
+  if ((flags & PADDED) != 0) {
+    assertTrue(len > 0, PichiError::BAD_PROTO);
+    co_await read({inbound_, 1});
+    padding = inbound_[0];
+    assertTrue(padding < len, PichiError::BAD_PROTO);
+  }
+
+  auto size   = len - padding - ((flags & PADDED) != 0 ? 1 : 0);
+  auto stream = find(id);
+  if (stream) {
+    assertTrue(stream->admit(size), PichiError::BAD_PROTO);
+    co_await read(stream->prepare(size));
+    stream->commit(size);
+    // The stream might be erased while reading, whose bytes are returned as the discarded ones
+    if (auto it = streams_.find(id); it != std::end(streams_))
+      it->second.pending_ += size;
+    else
+      co_await update(0, size);
+  }
+  else
+    co_await skip(size);
+  co_await skip(padding);
+
+  // The data is returned to the windows once consumed, while the rest of the frame is returned now
+  if (stream)
+    co_await update(id, len - size);
+  else
+    co_await update(0, len);
+  if (stream && (flags & END_STREAM) != 0) stream->finish(asio::error::eof);
+}
+
+template <typename Transport>
+Awaitable<void> Connection<Transport>::collect(Type type, uint8_t flags, uint32_t id, size_t len)
+{
+  assertTrue(id != 0 && block_.size() + len <= HEADER_LIMIT, PichiError::BAD_PROTO);
+
+  auto fragment = MutableBuffer{inbound_, len};
+  co_await read(fragment);
+  if (type == Type::HEADERS) {
+    if ((flags & PADDED) != 0) {
+      assertTrue(!fragment.empty() && fragment[0] < fragment.size(), PichiError::BAD_PROTO);
+      fragment = {fragment.data() + 1, fragment.size() - 1 - fragment[0]};
+    }
+    if ((flags & PRIORITIZED) != 0) {
+      assertTrue(fragment.size() >= 5, PichiError::BAD_PROTO);
+      fragment += 5;
+    }
+    block_id_  = id;
+    block_end_ = (flags & END_STREAM) != 0;
+  }
+  block_.insert(std::end(block_), std::begin(fragment), std::end(fragment));
+  if ((flags & END_HEADERS) == 0) co_return;
+
+  block_id_   = 0;
+  auto fields = decoder_.decode(block_);
+  block_.clear();
+  co_await request(id, std::move(fields), block_end_);
+}
+
+template <typename Transport>
+Awaitable<void> Connection<Transport>::configure(uint8_t flags, uint32_t id, size_t len)
+{
+  assertTrue(id == 0 && len % 6 == 0, PichiError::BAD_PROTO);
+  if ((flags & ACK) != 0) {
+    assertTrue(len == 0, PichiError::BAD_PROTO);
+    co_return;
+  }
+
+  co_await read({inbound_, len});
+  for (auto it = inbound_.data(); it != inbound_.data() + len; it += 6) {
+    if (ntoh<uint16_t>({it, sizeof(uint16_t)}) != INITIAL_WINDOW_SIZE) continue;
+
+    auto value = static_cast<int64_t>(ntoh<uint32_t>({it + 2, sizeof(uint32_t)}));
+    assertTrue(value <= MAX_WINDOW, PichiError::BAD_PROTO);
+    // The change applies to the opened streams as well @RFC9113 6.9.2
+    auto delta = value - initial_;
+    initial_   = value;
+    for (auto&& item : streams_)
+      if (auto stream = item.second.stream_.lock(); stream) stream->grant(delta);
+  }
+  co_await send(Type::SETTINGS, ACK, 0, {});
+}
+
+template <typename Transport>
+Awaitable<void> Connection<Transport>::request(uint32_t id, Decoder::Fields fields, bool end)
+{
+  // The trailers are decoded only to keep the dynamic table synchronized
+  if (id <= last_) {
+    if (auto stream = find(id); stream && end) stream->finish(asio::error::eof);
+    co_return;
+  }
+  assertTrue(id % 2 == 1, PichiError::BAD_PROTO);
+  last_ = id;
+
+  auto method    = ""sv;
+  auto authority = ""sv;
+  auto tunnel    = !end;
+  auto others    = http::fields{};
+  for (auto&& [name, value] : fields) {
+    if (name == ":method")
+      method = value;
+    else if (name == ":authority")
+      authority = value;
+    else if (name.starts_with(':'))
+      // The CONNECT request carries neither :scheme nor :path @RFC9113 8.5
+      tunnel = false;
+    else
+      others.insert(name, value);
+  }
+
+  if (method != "CONNECT") {
+    co_await reply(id, http::status::method_not_allowed, true);
+    co_return;
+  }
+  if (!tunnel || authority.empty()) {
+    co_await reply(id, http::status::bad_request, true);
+    co_return;
+  }
+  if (streams_.size() >= MAX_STREAMS) {
+    auto bytes = std::array<uint8_t, sizeof(uint32_t)>{};
+    hton(REFUSED_STREAM, bytes);
+    co_await send(Type::RST_STREAM, 0, id, bytes);
+    co_return;
+  }
+
+  auto ec     = sys::error_code{};
+  auto remote = Endpoint{};
+  try {
+    transport_.authenticate(others);
+    auto hp = HostAndPort{authority};
+    remote  = makeEndpoint(hp.host_, hp.port_);
+  }
+  catch (sys::system_error const& e) {
+    ec = e.code();
+  }
+  if (ec) {
+    co_await reply(id, detail::to_status(ec), true);
+    co_return;
+  }
+
+  auto stream = std::make_shared<mux::Stream>(shared_from_this(), id, ex_, initial_, MAX_WINDOW);
+  streams_.emplace(id, Entry{stream});
+  accept_(std::move(stream), std::move(remote));
+}
+
+template <typename Transport>
+Awaitable<std::shared_ptr<mux::Stream>> Connection<Transport>::open(Endpoint const&)
+{
+  fail("Unexpected invocation");
+}
+
+template <typename Transport>
+Awaitable<void> Connection<Transport>::write(mux::Command cmd, uint32_t id, ConstBuffer payload)
+{
+  switch (cmd) {
+  case mux::Command::PSH: {
+    auto size = static_cast<int64_t>(payload.size());
+    while (window_ < size && open_) co_await mux::wait(windowed_);
+    if (!open_) asio::detail::throw_error(asio::error::not_connected);
+    // The stream might be reset by the peer while waiting
+    if (!streams_.contains(id)) asio::detail::throw_error(asio::error::connection_reset);
+    window_ -= size;
+    co_await send(Type::DATA, 0, id, payload);
+    break;
+  }
+  case mux::Command::FIN: {
+    auto it = streams_.find(id);
+    if (it == std::end(streams_)) co_return;
+
+    auto state   = it->second.state_;
+    auto pending = erase(it);
+    if (state == State::OPEN)
+      co_await send(Type::DATA, END_STREAM, id, {});
+    else if (state == State::PENDING) {
+      auto bytes = std::array<uint8_t, sizeof(uint32_t)>{};
+      hton(CANCEL, bytes);
+      co_await send(Type::RST_STREAM, 0, id, bytes);
+    }
+    co_await update(0, pending);
+    break;
+  }
+  case mux::Command::UPD: {
+    // The bytes of the erased stream have been returned to the connection window
+    auto it = streams_.find(id);
+    if (it == std::end(streams_)) co_return;
+
+    auto n = ntoh<uint32_t>(payload);
+    it->second.pending_ -= n;
+    co_await update(it->second.released_ ? 0 : id, n);
+    break;
+  }
+  default:
+    fail(PichiError::BAD_PROTO);
+  }
+}
+
+template <typename Transport>
+Awaitable<void> Connection<Transport>::respond(uint32_t id, sys::error_code ec)
+{
+  auto it = streams_.find(id);
+  if (it == std::end(streams_) || it->second.state_ != State::PENDING) co_return;
+
+  it->second.state_ = ec ? State::ENDED : State::OPEN;
+  co_await reply(id, ec ? detail::to_status(ec) : http::status::ok, static_cast<bool>(ec));
+}
+
+// The stream is erased after its END_STREAM or RST_STREAM is sent by FIN
+template <typename Transport> void Connection<Transport>::release(uint32_t id)
+{
+  if (auto it = streams_.find(id); it != std::end(streams_)) it->second.released_ = true;
+}
+
+template <typename Transport> size_t Connection<Transport>::streams() const
+{
+  return streams_.size();
+}
+
+template <typename Transport> bool Connection<Transport>::is_open() const { return open_; }
+
+template <typename Transport> Awaitable<void> Connection<Transport>::run()
+{
+  // The connection lives until its transport fails
+  auto self   = shared_from_this();
+  auto header = std::array<uint8_t, FRAME_HEADER>{};
+  auto ec     = sys::error_code{};
+  co_await redirect(greet(), ec);
+  while (!ec) {
+    co_await redirect(read(header), ec);
+    if (ec) break;
+    co_await redirect(
+        dispatch(
+            static_cast<Type>(header[3]),
+            header[4],
+            ntoh<uint32_t>({header.data() + 5, sizeof(uint32_t)}) & 0x7fffffff,
+            size_t{header[0]} << 16 | size_t{header[1]} << 8 | header[2]
+        ),
+        ec
+    );
+  }
+  finish(ec);
+  co_await transport_.close();
+}
+
+template <typename Transport>
+Awaitable<void> serve(IOExecutor const& ex, Transport transport, mux::Accept accept)
+{
+  auto conn = std::make_shared<Connection<Transport>>(ex, std::move(transport), std::move(accept));
+  co_await conn->run();
+}
+
+template Awaitable<void> serve(IOExecutor const&, HttpIngress<Socket>, mux::Accept);
+template Awaitable<void> serve(IOExecutor const&, HttpIngress<Tls>, mux::Accept);
+template Awaitable<void> serve(IOExecutor const&, HttpIngress<unit_test::TestSocket>, mux::Accept);
+
+}  // namespace pichi::adapter::tcp::h2
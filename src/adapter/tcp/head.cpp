@@ -0,0 +1,189 @@
+#include "pichi/common/config.hpp"
+#include <algorithm>
+#include <bit>
+#include <pichi/adapter/tcp/head.hpp>
+#include <pichi/common/literals.hpp>
+#include <ranges>
+#include <stdint.h>
+#include <utility>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif  // __AVX2__ || __SSE2__
+
+using namespace std::literals;
+namespace rngs = std::ranges;
+
+namespace pichi::adapter::tcp::head {
+
+static auto const CONNECT             = "CONNECT "sv;
+static auto const CRLF                = "\r\n"sv;
+static auto const PROXY_AUTHORIZATION = "proxy-authorization"sv;
+static auto const BASIC               = "basic "sv;
+static auto const DEFAULT_PORT        = "80"sv;
+
+// Whether the LF at the position ends the blank line
+static bool blank(uint8_t const* p, size_t i)
+{
+  return p[i - 1] == '\r' && p[i - 2] == '\n' && p[i - 3] == '\r';
+}
+
+static bool digit(char c) { return c >= '0' && c <= '9'; }
+
+static bool alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+// The token characters @RFC9110 5.6.2
+static bool tchar(char c)
+{
+  return alpha(c) || digit(c) || "!#$%&'*+-.^_`|~"sv.find(c) != std::string_view::npos;
+}
+
+// The characters rejected by the Beast parser in the target or the field values
+static bool control(char c) { return (c >= 0 && c < 0x20 && c != '\t') || c == 0x7f; }
+
+static char lower(char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; }
+
+static bool iequal(std::string_view lhs, std::string_view rhs)
+{
+  return rngs::equal(lhs, rhs, [](auto l, auto r) { return lower(l) == lower(r); });
+}
+
+static std::string_view trim(std::string_view s)
+{
+  auto first = s.find_first_not_of(" \t"sv);
+  if (first == std::string_view::npos) return {};
+  return s.substr(first, s.find_last_not_of(" \t"sv) - first + 1);
+}
+
+static std::string_view view(ConstBuffer buf)
+{
+  return {reinterpret_cast<char const*>(rngs::data(buf)), rngs::size(buf)};
+}
+
+// Remove the line ended by CRLF from the head, and return it without CRLF
+static std::string_view line(std::string_view& head)
+{
+  auto n   = std::min(head.find(CRLF), head.size());
+  auto ret = head.substr(0, n);
+  head.remove_prefix(std::min(n + CRLF.size(), head.size()));
+  return ret;
+}
+
+// The same forms accepted by HostAndPort, which are host[:port] and [IPv6][:port]
+static std::optional<std::pair<std::string_view, std::string_view>> split(std::string_view target)
+{
+  if (rngs::any_of(target, [](auto c) { return control(c) || c == ' '; })) return std::nullopt;
+
+  auto host = std::string_view{};
+  auto port = std::string_view{};
+  if (target.starts_with('[')) {
+    auto close = target.find(']');
+    if (close == std::string_view::npos) return std::nullopt;
+    host = target.substr(1, close - 1);
+    port = target.substr(close + 1);
+    if (host.empty() || !rngs::all_of(host, [](auto c) {
+          return digit(c) || (c >= 'a' && c <= 'f') || c == ':' || c == '.';
+        }))
+      return std::nullopt;
+  }
+  else {
+    auto colon = std::min(target.find(':'), target.size());
+    host       = target.substr(0, colon);
+    port       = target.substr(colon);
+    if (host.empty() || host.find_first_of("/[]"sv) != std::string_view::npos) return std::nullopt;
+  }
+
+  if (port.empty()) return std::make_pair(host, DEFAULT_PORT);
+  if (!port.starts_with(':')) return std::nullopt;
+  port.remove_prefix(1);
+  if (port.empty() || !rngs::all_of(port, digit)) return std::nullopt;
+  return std::make_pair(host, port);
+}
+
+size_t find_end(ConstBuffer buf, size_t from)
+{
+  auto p = rngs::data(buf);
+  auto n = rngs::size(buf);
+  auto i = std::max(from, 3_sz);
+
+  // The LFs are located by comparing 32 or 16 bytes at once, and then verified one by one
+#ifdef __AVX2__
+  for (auto lf = _mm256_set1_epi8('\n'); i + 32 <= n; i += 32) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i));
+    auto m = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, lf)));
+    for (; m != 0; m &= m - 1)
+      if (auto j = i + std::countr_zero(m); blank(p, j)) return j + 1;
+  }
+#endif  // __AVX2__
+#ifdef __SSE2__
+  for (auto lf = _mm_set1_epi8('\n'); i + 16 <= n; i += 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+    auto m = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, lf)));
+    for (; m != 0; m &= m - 1)
+      if (auto j = i + std::countr_zero(m); blank(p, j)) return j + 1;
+  }
+#endif  // __SSE2__
+  for (; i < n; ++i)
+    if (p[i] == '\n' && blank(p, i)) return i + 1;
+  return 0;
+}
+
+// The host and the port of the request line, or nullopt if it's not a plain CONNECT request
+static std::optional<std::pair<std::string_view, std::string_view>> request(std::string_view line)
+{
+  if (!line.starts_with(CONNECT)) return std::nullopt;
+  line.remove_prefix(CONNECT.size());
+
+  auto sp = line.find(' ');
+  if (sp == std::string_view::npos) return std::nullopt;
+  auto version = line.substr(sp + 1);
+  if (version != "HTTP/1.1"sv && version != "HTTP/1.0"sv) return std::nullopt;
+  return split(line.substr(0, sp));
+}
+
+bool maybe_connect(ConstBuffer buf)
+{
+  auto head = view(buf);
+  if (head.substr(0, CONNECT.size()) != CONNECT.substr(0, head.size())) return false;
+  return head.find(CRLF) == std::string_view::npos || request(line(head)).has_value();
+}
+
+std::optional<Connect> parse_connect(ConstBuffer buf)
+{
+  auto head      = view(buf);
+  auto authority = request(line(head));
+  if (!authority.has_value()) return std::nullopt;
+
+  auto ret = Connect{authority->first, authority->second, std::nullopt};
+  for (auto field = line(head); !field.empty(); field = line(head)) {
+    // The obsolete line folding is rejected here since the name must be a token
+    auto colon = field.find(':');
+    if (colon == 0 || colon == std::string_view::npos) return std::nullopt;
+    auto name  = field.substr(0, colon);
+    auto value = field.substr(colon + 1);
+    if (!rngs::all_of(name, tchar) || rngs::any_of(value, control)) return std::nullopt;
+
+    // The first one is taken as the Beast parser does
+    if (!ret.authorization_.has_value() && iequal(name, PROXY_AUTHORIZATION))
+      ret.authorization_ = trim(value);
+  }
+  return ret;
+}
+
+std::optional<std::string_view> basic_credential(std::string_view value)
+{
+  if (value.size() <= BASIC.size() || !iequal(value.substr(0, BASIC.size()), BASIC))
+    return std::nullopt;
+
+  // The base64 characters followed by 2 paddings at most
+  auto credential = value.substr(BASIC.size());
+  auto padding    = credential.substr(std::min(credential.find('='), credential.size()));
+  auto encoded    = credential.substr(0, credential.size() - padding.size());
+  if (encoded.empty() || padding.size() > 2 ||
+      padding.find_first_not_of('=') != std::string_view::npos ||
+      !rngs::all_of(encoded, [](auto c) { return alpha(c) || digit(c) || c == '+' || c == '/'; }))
+    return std::nullopt;
+  return credential;
+}
+
+}  // namespace pichi::adapter::tcp::head
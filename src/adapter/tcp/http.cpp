@@ -1,6 +1,7 @@
 #include "pichi/common/config.hpp"
 #include <algorithm>
 #include <boost/asio/buffers_iterator.hpp>
+#include <boost/asio/error.hpp>
 #include <boost/beast/http/error.hpp>
 #include <boost/beast/http/field.hpp>
 #include <boost/beast/http/read.hpp>
@@ -9,15 +10,17 @@
 #include <boost/system/system_error.hpp>
 #include <botan/base64.h>
 #include <format>
+#include <limits>
 #include <pichi/adapter/tcp/adapter.hpp>
+#include <pichi/adapter/tcp/head.hpp>
 #include <pichi/adapter/tcp/http.hpp>
 #include <pichi/common/asserts.hpp>
+#include <pichi/common/literals.hpp>
 #include <pichi/common/uri.hpp>
 #include <pichi/stream/helpers.hpp>
 #include <pichi/stream/test.hpp>
 #include <pichi/stream/tls.hpp>
 #include <ranges>
-#include <regex>
 
 namespace asio  = boost::asio;
 namespace http  = boost::beast::http;
@@ -34,9 +37,13 @@ namespace detail {
 // FIXME hardcode HTTP header limit to 1M
 static uint32_t const HEADER_LIMIT = 1024ul * 1024ul;
 
-static auto const BASIC_AUTH_PATTERN = std::regex{"^basic ([a-z0-9+/]+={0,2})", std::regex::icase};
+// The size read at once while looking for the end of the request head
+static auto const HEAD_READ_SIZE = 1024_sz;
 
-static Endpoint get_remote(Request& req)
+// The HTTP/2 connection preface is parsed as a request without any field, which is followed by it
+static auto const PREFACE_TAIL = "SM\r\n\r\n"sv;
+
+static Endpoint get_remote(Header<true>& req)
 {
   /*
    * HTTP Proxy @RFC2068
@@ -72,6 +79,32 @@ static Endpoint get_remote(Request& req)
   }
 }
 
+// Append the serialized header only, even if the message is chunked
+template <bool isRequest> static void serialize(Header<isRequest> const& header, Cache& cache)
+{
+  auto msg = Message<isRequest>{header};
+  auto sr  = http::serializer<isRequest, Body>{msg};
+  sr.split(true);
+  do {
+    auto ec = sys::error_code{};
+    sr.next(ec, [&](auto&&, auto serialized) {
+      auto n = asio::buffer_size(serialized);
+      asio::buffer_copy(cache.prepare(n), serialized);
+      cache.commit(n);
+      sr.consume(n);
+    });
+    asio::detail::throw_error(ec);
+  } while (!sr.is_header_done());
+}
+
+static size_t take(Cache& cache, MutableBuffer buf)
+{
+  auto copied = std::min(cache.size(), buf.size());
+  std::copy_n(asio::buffers_begin(cache.data()), copied, std::begin(buf));
+  cache.consume(copied);
+  return copied;
+}
+
 template <stream::AsyncLayer NextLayer>
 Awaitable<size_t> InvalidManner<NextLayer>::recv(NextLayer&, MutableBuffer)
 {
@@ -121,44 +154,74 @@ Awaitable<void> ConnectManner<NextLayer>::confirm(NextLayer& underlying)
   co_await http::async_write(underlying, rep, asio::use_awaitable);
 }
 
-template <stream::AsyncLayer NextLayer>
-ProxyManner<NextLayer>::ProxyManner(Cache cache, Request req)
-  : in_{std::move(cache)}, out_{}, parser_{}
+template <stream::AsyncLayer NextLayer> bool ConnectManner<NextLayer>::drained() const
 {
-  auto sticked = in_.size();
+  return cache_.size() == 0;
+}
 
-  auto sr = http::serializer<true, Body>{req};
-  do {
-    auto ec = sys::error_code{};
-    sr.next(ec, [&](auto&&, auto serialized) {
-      auto n = asio::buffer_size(serialized);
-      asio::buffer_copy(in_.prepare(n), serialized);
-      in_.commit(n);
-      sr.consume(n);
-    });
-    asio::detail::throw_error(ec);
-  } while (!sr.is_header_done());
+template <stream::AsyncLayer NextLayer>
+ProxyManner<NextLayer>::ProxyManner(Cache cache, std::unique_ptr<RequestTracker> request)
+  : in_{std::move(cache)},
+    request_{std::move(request)},
+    persistent_{!request_->upgrade()},
+    keep_alive_{request_->keep_alive()}
+{
+  auto& req = request_->get();
+  if (persistent_) {
+    // The upstream connection is kept for the following requests, whatever the client wants
+    req.keep_alive(true);
+    req.erase(http::field::proxy_connection);
+  }
+  serialize(req, head_);
+  reset();
+}
 
-  asio::buffer_copy(in_.prepare(sticked), in_.data());
-  in_.commit(sticked);
-  in_.consume(sticked);
+template <stream::AsyncLayer NextLayer> void ProxyManner<NextLayer>::reset()
+{
+  response_ = std::make_unique<ResponseTracker>();
+  response_->header_limit(HEADER_LIMIT);
+  response_->body_limit(std::numeric_limits<uint64_t>::max());
+  response_->skip(request_->get().method() == http::verb::head);
 }
 
 template <stream::AsyncLayer NextLayer>
 Awaitable<size_t> ProxyManner<NextLayer>::recv(NextLayer& underlying, MutableBuffer buf)
 {
-  if (in_.size() == 0) co_return co_await stream::read_some(underlying, buf);
+  auto n = take(head_, buf);
+  if (!persistent_) {
+    n += take(in_, buf + n);
+    if (n == 0) n = co_await stream::read_some(underlying, buf);
+    co_return n;
+  }
 
-  auto copied = std::min(in_.size(), buf.size());
-  std::copy_n(asio::buffers_begin(in_.data()), copied, std::begin(buf));
-  in_.consume(copied);
-  co_return copied;
+  n += track(buf + n);
+  if (n > 0) co_return n;
+  if (request_->is_done()) asio::detail::throw_error(asio::error::eof);
+
+  while (n == 0) {
+    assertTrue(in_.size() < buf.size(), PichiError::BAD_PROTO, "Too long chunk header");
+    in_.commit(co_await stream::read_some(underlying, in_.prepare(buf.size() - in_.size())));
+    n = track(buf);
+  }
+  co_return n;
+}
+
+template <stream::AsyncLayer NextLayer> size_t ProxyManner<NextLayer>::track(MutableBuffer buf)
+{
+  if (in_.size() == 0 || buf.size() == 0 || request_->is_done()) return 0;
+
+  // Only the bytes parsed as the request body are relayed, which might end in the middle of in_
+  auto ec = sys::error_code{};
+  auto n  = request_->put(asio::buffer(in_.cdata(), buf.size()), ec);
+  if (ec && ec != http::error::need_more) throw sys::system_error{ec};
+  in_.consume(asio::buffer_copy(asio::buffer(buf.data(), buf.size()), in_.data(), n));
+  return n;
 }
 
 template <stream::AsyncLayer NextLayer>
 Awaitable<void> ProxyManner<NextLayer>::send(NextLayer& underlying, ConstBuffer buf)
 {
-  if (parser_.is_header_done()) {
+  if (!persistent_ && response_->is_header_done()) {
     co_await stream::write(underlying, buf);
     co_return;
   }
@@ -170,9 +233,16 @@ Awaitable<void> ProxyManner<NextLayer>::send(NextLayer& underlying, ConstBuffer
     buf = out_.cdata();
   }
 
-  auto ec = sys::error_code{};
-  auto n  = parser_.put(asio::buffer(buf), ec);
-  if (ec && ec != http::error::need_more) throw sys::system_error(ec);
+  auto n = 0_sz;
+  while (n < buf.size() && !response_->is_header_done()) {
+    auto ec = sys::error_code{};
+    n += response_->put(asio::buffer(buf + n), ec);
+    if (ec && ec != http::error::need_more) throw sys::system_error{ec};
+    if (response_->is_header_done()) co_await reply(underlying);
+    else
+      break;
+  }
+  if (response_->is_header_done()) n += co_await relay(underlying, buf + n);
 
   if (out_.size() > 0) {
     out_.consume(n);
@@ -181,20 +251,63 @@ Awaitable<void> ProxyManner<NextLayer>::send(NextLayer& underlying, ConstBuffer
     rngs::copy(buf | views::drop(n), asio::buffers_begin(out_.prepare(rngs::size(buf) - n)));
     out_.commit(rngs::size(buf) - n);
   }
+}
 
-  if (!parser_.is_header_done()) co_return;
+template <stream::AsyncLayer NextLayer>
+Awaitable<void> ProxyManner<NextLayer>::reply(NextLayer& underlying)
+{
+  auto& rep     = response_->get();
+  auto  head    = Cache{};
+  auto  interim = rep.result_int() < 200 && rep.result() != http::status::switching_protocols;
+
+  if (!persistent_) {
+    if (!response_->upgrade()) {
+      rep.set(http::field::connection, "close");
+      rep.set(http::field::proxy_connection, "close");
+    }
+    serialize(rep, head);
+  }
+  else if (!interim) {
+    // The client connection is kept only if the end of the response is told by itself
+    keep_alive_ = keep_alive_ && !response_->need_eof();
+    rep.keep_alive(keep_alive_);
+    rep.set(http::field::proxy_connection, keep_alive_ ? "keep-alive" : "close");
+    serialize(rep, head);
+    response_->eager(true);
+  }
+  else {
+    // The interim response is followed by another one for the same request
+    serialize(rep, head);
+    reset();
+  }
 
-  auto rep = parser_.release();
-  if (!parser_.upgrade()) {
-    rep.set(http::field::connection, "close");
-    rep.set(http::field::proxy_connection, "close");
+  co_await stream::write(underlying, head.cdata());
+}
+
+template <stream::AsyncLayer NextLayer>
+Awaitable<size_t> ProxyManner<NextLayer>::relay(NextLayer& underlying, ConstBuffer buf)
+{
+  if (!persistent_) {
+    co_await stream::write(underlying, buf);
+    co_return buf.size();
   }
 
-  co_await http::async_write(underlying, rep, asio::use_awaitable);
-  if (out_.size() > 0) {
-    co_await stream::write(underlying, out_.cdata());
-    out_.consume(out_.size());
+  auto n = 0_sz;
+  while (n < buf.size() && !response_->is_done()) {
+    auto ec     = sys::error_code{};
+    auto parsed = response_->put(asio::buffer(buf + n), ec);
+    if (ec && ec != http::error::need_more) throw sys::system_error{ec};
+    if (parsed == 0) break;
+    n += parsed;
   }
+  if (n > 0) co_await stream::write(underlying, ConstBuffer{buf, n});
+
+  if (response_->is_done() && n < buf.size()) {
+    // The upstream sent more than the response, so that it can't be reused
+    surplus_ = true;
+    n        = buf.size();
+  }
+  co_return n;
 }
 
 template <stream::AsyncLayer NextLayer> Awaitable<void> ProxyManner<NextLayer>::confirm(NextLayer&)
@@ -202,6 +315,36 @@ template <stream::AsyncLayer NextLayer> Awaitable<void> ProxyManner<NextLayer>::
   co_return;
 }
 
+template <stream::AsyncLayer NextLayer> bool ProxyManner<NextLayer>::persistent() const
+{
+  return persistent_;
+}
+
+template <stream::AsyncLayer NextLayer> bool ProxyManner<NextLayer>::requested() const
+{
+  return persistent_ && head_.size() == 0 && request_->is_done();
+}
+
+template <stream::AsyncLayer NextLayer> bool ProxyManner<NextLayer>::responded() const
+{
+  return persistent_ && response_->is_done();
+}
+
+template <stream::AsyncLayer NextLayer> bool ProxyManner<NextLayer>::kept_alive() const
+{
+  return requested() && responded() && keep_alive_;
+}
+
+template <stream::AsyncLayer NextLayer> bool ProxyManner<NextLayer>::reusable() const
+{
+  return requested() && responded() && response_->keep_alive() && !surplus_;
+}
+
+template <stream::AsyncLayer NextLayer> Cache ProxyManner<NextLayer>::release()
+{
+  return std::move(in_);
+}
+
 static auto gen_auth(std::string_view u, std::string_view p)
 {
   return Botan::base64_encode(ConstBuffer{std::format("{}:{}", u, p)});
@@ -218,24 +361,24 @@ static auto gen_credentials(vo::Ingress const& vo)
   return ret;
 }
 
-static bool
-    authenticate(http::fields const& req, std::unordered_set<std::string> const& credentials)
+static std::optional<std::string_view> authorization(http::fields const& fields)
 {
-  auto it = req.find(http::field::proxy_authorization);
-  assertFalse(it == std::cend(req), PichiError::BAD_AUTH_METHOD);
+  auto it = fields.find(http::field::proxy_authorization);
+  if (it == std::cend(fields)) return std::nullopt;
+  return std::string_view{it->value().data(), it->value().size()};
+}
 
-  auto match = std::cmatch{};
-  auto auth  = it->value();
-  assertTrue(
-      std::regex_match(std::cbegin(auth), std::cend(auth), match, BASIC_AUTH_PATTERN),
-      PichiError::BAD_AUTH_METHOD
-  );
-  assertTrue(2 == match.size() && match[1].matched, PichiError::BAD_AUTH_METHOD);
+static bool
+    authenticate(std::string_view auth, std::unordered_set<std::string> const& credentials)
+{
+  auto credential = head::basic_credential(auth);
+  assertTrue(credential.has_value(), PichiError::BAD_AUTH_METHOD);
 
-  return credentials.contains({match[1].first, static_cast<size_t>(match[1].length())});
+  // Looked up linearly against the few credentials, to avoid constructing the key
+  return rngs::find(credentials, *credential) != std::cend(credentials);
 }
 
-static auto gen_credential(vo::Egress const& vo)
+std::string gen_credential(vo::Egress const& vo)
 {
   if (!vo.credential_.has_value()) return ""s;
 
@@ -243,6 +386,29 @@ static auto gen_credential(vo::Egress const& vo)
   return std::format("Basic {}", gen_auth(pair.first, pair.second));
 }
 
+http::status to_status(sys::error_code const& ec)
+{
+  if (ec == PichiError::CONN_FAILURE) return http::status::gateway_timeout;
+  if (ec == PichiError::BAD_AUTH_METHOD) return http::status::proxy_authentication_required;
+  if (ec == PichiError::UNAUTHENTICATED) return http::status::forbidden;
+  if (ec.category() == PICHI_CATEGORY) return http::status::internal_server_error;
+
+  /* TODO It's not clear that http::make_error_code() will return error codes
+   * with different categories when its invoker are located in the different
+   * DLLs. As the result, the pre-defined category will never equal to what
+   * comes from Boost.Test. The downcasting at runtime has to be used to
+   * detect the equation here.
+   *
+   * The original code:
+   * static auto const& HTTP_ERROR_CATEGORY =
+   *   http::make_error_code(http::error::end_of_stream).category();
+   */
+
+  using CategoryPtr = http::detail::http_error_category const*;
+  auto pCat         = dynamic_cast<CategoryPtr>(&ec.category());
+  return pCat ? http::status::bad_request : http::status::gateway_timeout;
+}
+
 }  // namespace detail
 
 template <stream::AsyncLayer NextLayer>
@@ -251,8 +417,6 @@ HttpIngress<NextLayer>::HttpIngress(vo::Ingress const& vo, NextLayer underlying)
     manner_{detail::InvalidManner<NextLayer>{}},
     credentials_{detail::gen_credentials(vo)}
 {
-  parser_.header_limit(detail::HEADER_LIMIT);
-  parser_.body_limit(std::numeric_limits<uint64_t>::max());
 }
 
 template <stream::AsyncLayer NextLayer> Awaitable<void> HttpIngress<NextLayer>::close()
@@ -266,12 +430,55 @@ Awaitable<Endpoint> HttpIngress<NextLayer>::continue_read_remote(ConstBuffer b)
   rngs::copy(b, asio::buffers_begin(cache_.prepare(rngs::size(b))));
   cache_.commit(rngs::size(b));
 
-  co_await http::async_read_header(underlying_, cache_, parser_, asio::use_awaitable);
+  /*
+   * The plain CONNECT request is parsed in place once its head is complete. Anything else,
+   * including the failure to read the whole head, is left to the Beast parser, which rejects the
+   * malformed request line without waiting for the rest of the head.
+   */
+  auto end = head::find_end(cache_.cdata());
+  while (end == 0 && cache_.size() < detail::HEADER_LIMIT && head::maybe_connect(cache_.cdata())) {
+    auto scanned = cache_.size();
+    auto ec      = sys::error_code{};
+    auto n       = co_await redirect(
+        stream::read_some(underlying_, cache_.prepare(detail::HEAD_READ_SIZE)), ec
+    );
+    if (ec) break;
+    cache_.commit(*n);
+    end = head::find_end(cache_.cdata(), scanned);
+  }
+  if (auto connect = head::parse_connect(ConstBuffer{cache_.cdata(), end}); connect.has_value()) {
+    authenticate(connect->authorization_);
+    auto remote = makeEndpoint(connect->host_, connect->port_);
+    cache_.consume(end);
+    manner_.template emplace<detail::ConnectManner<NextLayer>>(std::move(cache_));
+    co_return remote;
+  }
 
-  auto req = parser_.release();
+  auto parser = detail::RequestParser{};
+  parser.header_limit(detail::HEADER_LIMIT);
+  parser.body_limit(std::numeric_limits<uint64_t>::max());
+  co_await http::async_read_header(underlying_, cache_, parser, asio::use_awaitable);
 
-  if (!rngs::empty(credentials_))
-    assertTrue(detail::authenticate(req, credentials_), PichiError::UNAUTHENTICATED);
+  auto& req = parser.get();
+
+  if (req.method_string() == "PRI" && req.target() == "*" && req.version() == 20) {
+    while (cache_.size() < detail::PREFACE_TAIL.size()) {
+      auto n = detail::PREFACE_TAIL.size() - cache_.size();
+      cache_.commit(co_await stream::read_some(underlying_, cache_.prepare(n)));
+    }
+    assertTrue(
+        rngs::equal(ConstBuffer{cache_.data(), detail::PREFACE_TAIL.size()}, detail::PREFACE_TAIL),
+        PichiError::BAD_PROTO
+    );
+    cache_.consume(detail::PREFACE_TAIL.size());
+
+    // The frames following the preface are authenticated and routed stream by stream
+    multiplexed_ = true;
+    manner_.template emplace<detail::ConnectManner<NextLayer>>(std::move(cache_));
+    co_return Endpoint{};
+  }
+
+  authenticate(req);
 
   if (req.method() == http::verb::connect) {
     manner_.template emplace<detail::ConnectManner<NextLayer>>(std::move(cache_));
@@ -288,18 +495,24 @@ Awaitable<Endpoint> HttpIngress<NextLayer>::continue_read_remote(ConstBuffer b)
     co_return makeEndpoint(hp.host_, hp.port_);
   }
   else {
-    auto remote = detail::get_remote(req);
-    if (!parser_.upgrade()) {
-      req.set(http::field::connection, "close");
-      req.set(http::field::proxy_connection, "close");
-    }
-    manner_.template emplace<detail::ProxyManner<NextLayer>>(std::move(cache_), std::move(req));
+    // The body, if any, is relayed as it is while being tracked to its end
+    auto tracker = std::make_unique<detail::RequestTracker>(std::move(parser));
+    tracker->eager(true);
+    auto remote = detail::get_remote(tracker->get());
+    manner_.template emplace<detail::ProxyManner<NextLayer>>(std::move(cache_), std::move(tracker));
     co_return remote;
   }
 }
 
 template <stream::AsyncLayer NextLayer> Awaitable<Endpoint> HttpIngress<NextLayer>::read_remote()
 {
+  if (auto proxy = std::get_if<detail::ProxyManner<NextLayer>>(&manner_); proxy != nullptr) {
+    // The following request on the connection kept alive, which might be pipelined
+    assertTrue(proxy->kept_alive(), PichiError::MISC, "Connection not kept alive");
+    cache_ = proxy->release();
+    co_return co_await continue_read_remote({});
+  }
+
   co_await stream::accept(underlying_);
 
   auto buf = std::array<uint8_t, 1>{};
@@ -338,36 +551,70 @@ Awaitable<void> HttpIngress<NextLayer>::disconnect(sys::error_code const& ec)
   auto rep = detail::Response{};
   rep.version(11);
   rep.set(http::field::connection, "Close");
-  if (ec == PichiError::CONN_FAILURE) {
-    rep.result(http::status::gateway_timeout);
-  }
-  else if (ec == PichiError::BAD_AUTH_METHOD) {
-    rep.result(http::status::proxy_authentication_required);
+  rep.result(detail::to_status(ec));
+  if (rep.result() == http::status::proxy_authentication_required)
     rep.set(http::field::proxy_authenticate, "Basic");
-  }
-  else if (ec == PichiError::UNAUTHENTICATED) {
-    rep.result(http::status::forbidden);
-  }
-  else if (ec.category() == PICHI_CATEGORY) {
-    rep.result(http::status::internal_server_error);
-  }
-  else {
-    /* TODO It's not clear that http::make_error_code() will return error codes
-     * with different categories when its invoker are located in the different
-     * DLLs. As the result, the pre-defined category will never equal to what
-     * comes from Boost.Test. The downcasting at runtime has to be used to
-     * detect the equation here.
-     *
-     * The original code:
-     * static auto const& HTTP_ERROR_CATEGORY =
-     *   http::make_error_code(http::error::end_of_stream).category();
-     */
+  co_await http::async_write(underlying_, rep, asio::use_awaitable);
+}
 
-    using CategoryPtr = http::detail::http_error_category const*;
-    auto pCat         = dynamic_cast<CategoryPtr>(&ec.category());
-    rep.result(pCat ? http::status::bad_request : http::status::gateway_timeout);
+template <stream::AsyncLayer NextLayer>
+asio::ip::tcp::socket* HttpIngress<NextLayer>::raw_socket()
+{
+  if constexpr (std::same_as<NextLayer, Socket>) {
+    auto manner = std::get_if<detail::ConnectManner<NextLayer>>(&manner_);
+    return manner != nullptr && manner->drained() ? &underlying_ : nullptr;
   }
-  co_await http::async_write(underlying_, rep, asio::use_awaitable);
+  else
+    return nullptr;
+}
+
+template <stream::AsyncLayer NextLayer> bool HttpIngress<NextLayer>::multiplexed() const
+{
+  return multiplexed_;
+}
+
+template <stream::AsyncLayer NextLayer>
+void HttpIngress<NextLayer>::authenticate(http::fields const& fields) const
+{
+  authenticate(detail::authorization(fields));
+}
+
+template <stream::AsyncLayer NextLayer>
+void HttpIngress<NextLayer>::authenticate(std::optional<std::string_view> auth) const
+{
+  if (rngs::empty(credentials_)) return;
+  assertTrue(auth.has_value(), PichiError::BAD_AUTH_METHOD);
+  assertTrue(detail::authenticate(*auth, credentials_), PichiError::UNAUTHENTICATED);
+}
+
+template <stream::AsyncLayer NextLayer> bool HttpIngress<NextLayer>::persistent() const
+{
+  auto proxy = std::get_if<detail::ProxyManner<NextLayer>>(&manner_);
+  return proxy != nullptr && proxy->persistent();
+}
+
+template <stream::AsyncLayer NextLayer> bool HttpIngress<NextLayer>::requested() const
+{
+  auto proxy = std::get_if<detail::ProxyManner<NextLayer>>(&manner_);
+  return proxy != nullptr && proxy->requested();
+}
+
+template <stream::AsyncLayer NextLayer> bool HttpIngress<NextLayer>::responded() const
+{
+  auto proxy = std::get_if<detail::ProxyManner<NextLayer>>(&manner_);
+  return proxy != nullptr && proxy->responded();
+}
+
+template <stream::AsyncLayer NextLayer> bool HttpIngress<NextLayer>::kept_alive() const
+{
+  auto proxy = std::get_if<detail::ProxyManner<NextLayer>>(&manner_);
+  return proxy != nullptr && proxy->kept_alive();
+}
+
+template <stream::AsyncLayer NextLayer> bool HttpIngress<NextLayer>::reusable() const
+{
+  auto proxy = std::get_if<detail::ProxyManner<NextLayer>>(&manner_);
+  return proxy != nullptr && proxy->reusable();
 }
 
 template class HttpIngress<Socket>;
@@ -376,7 +623,15 @@ template class HttpIngress<unit_test::TestSocket>;
 
 template <stream::AsyncLayer NextLayer>
 HttpEgress<NextLayer>::HttpEgress(vo::Egress const& vo, NextLayer underlying)
-  : underlying_{std::move(underlying)}, peer_{*vo.server_}, credential_{detail::gen_credential(vo)}
+  : HttpEgress{vo, detail::gen_credential(vo), std::move(underlying)}
+{
+}
+
+template <stream::AsyncLayer NextLayer>
+HttpEgress<NextLayer>::HttpEgress(
+    vo::Egress const& vo, std::string credential, NextLayer underlying
+)
+  : underlying_{std::move(underlying)}, peer_{*vo.server_}, credential_{std::move(credential)}
 {
 }
 
@@ -424,6 +679,15 @@ Awaitable<void> HttpEgress<NextLayer>::connect(Endpoint const& remote)
   assertTrue(code >= 200 && code < 300, PichiError::CONN_FAILURE);
 }
 
+template <stream::AsyncLayer NextLayer>
+asio::ip::tcp::socket* HttpEgress<NextLayer>::raw_socket()
+{
+  if constexpr (std::same_as<NextLayer, Socket>)
+    return cache_.size() == 0 ? &underlying_ : nullptr;
+  else
+    return nullptr;
+}
+
 template class HttpEgress<Socket>;
 template class HttpEgress<Tls>;
 template class HttpEgress<unit_test::TestSocket>;
@@ -0,0 +1,503 @@
+#include "pichi/common/config.hpp"
+#include <algorithm>
+#include <array>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/detail/throw_error.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/execution/context.hpp>
+#include <boost/asio/query.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <chrono>
+#include <pichi/adapter/tcp/adapter.hpp>
+#include <pichi/adapter/tcp/mux.hpp>
+#include <pichi/common/asserts.hpp>
+#include <pichi/common/literals.hpp>
+#include <pichi/stream/test.hpp>
+#include <ranges>
+#include <unordered_map>
+
+namespace asio = boost::asio;
+namespace rngs = std::ranges;
+namespace sys  = boost::system;
+
+namespace pichi::adapter::tcp {
+
+namespace mux {
+
+// The idle client side connections are closed after that
+static auto const IDLE_TIMEOUT = std::chrono::seconds{60};
+
+Awaitable<void> wait(asio::steady_timer& timer)
+{
+  co_await redirect(timer.async_wait(asio::use_awaitable));
+  auto state = co_await asio::this_coro::cancellation_state;
+  if (state.cancelled() != asio::cancellation_type::none)
+    asio::detail::throw_error(asio::error::operation_aborted);
+}
+
+template <typename Transport> class Connection : public Link {
+private:
+  using Timer   = asio::steady_timer;
+  using Streams = std::unordered_map<uint32_t, std::weak_ptr<Stream>>;
+  using Frame   = std::array<uint8_t, HEADER_SIZE + MAX_FRAME>;
+
+  std::shared_ptr<Stream> find(uint32_t) const;
+  void                    finish(sys::error_code const&);
+
+  Awaitable<void> read(MutableBuffer);
+  Awaitable<void> skip(size_t);
+  Awaitable<void> dispatch(Command, uint32_t, size_t);
+
+public:
+  // The connection without accept is the client side
+  Connection(IOExecutor const&, Transport, Accept = {});
+
+  Transport& transport();
+
+  Awaitable<std::shared_ptr<Stream>> open(Endpoint const&) override;
+  Awaitable<void>                    write(Command, uint32_t, ConstBuffer) override;
+  Awaitable<void>                    respond(uint32_t, sys::error_code) override;
+  void                               release(uint32_t) override;
+
+  size_t streams() const override;
+  bool   is_open() const override;
+
+  Awaitable<void> run();
+  Awaitable<void> watch();
+
+private:
+  IOExecutor ex_;
+  Transport  transport_;
+  Accept     accept_;
+  Streams    streams_ = {};
+  uint32_t   next_    = 1;
+  bool       open_    = true;
+  bool       writing_ = false;
+  Timer      gate_;
+  Timer      idle_;
+
+  // The outgoing frame, and the incoming payload which is not buffered by any stream
+  Frame                     frame_   = {};
+  std::array<uint8_t, 512> scratch_ = {};
+};
+
+template <typename Transport>
+Connection<Transport>::Connection(IOExecutor const& ex, Transport transport, Accept accept)
+  : ex_{ex},
+    transport_{std::move(transport)},
+    accept_{std::move(accept)},
+    gate_{ex, Timer::time_point::max()},
+    idle_{ex, accept_ ? Timer::time_point::max() : Timer::clock_type::now() + IDLE_TIMEOUT}
+{
+}
+
+template <typename Transport> Transport& Connection<Transport>::transport() { return transport_; }
+
+template <typename Transport>
+std::shared_ptr<Stream> Connection<Transport>::find(uint32_t id) const
+{
+  auto it = streams_.find(id);
+  return it == std::cend(streams_) ? nullptr : it->second.lock();
+}
+
+template <typename Transport> void Connection<Transport>::finish(sys::error_code const& ec)
+{
+  open_ = false;
+  for (auto&& [id, weak] : streams_)
+    if (auto stream = weak.lock(); stream) stream->finish(ec ? ec : asio::error::eof);
+  streams_.clear();
+  gate_.cancel();
+  idle_.cancel();
+}
+
+template <typename Transport> Awaitable<void> Connection<Transport>::read(MutableBuffer buf)
+{
+  while (buf.size() > 0) buf += co_await transport_.recv(buf);
+}
+
+template <typename Transport> Awaitable<void> Connection<Transport>::skip(size_t n)
+{
+  while (n > 0) {
+    auto len = std::min(n, scratch_.size());
+    co_await read({scratch_, len});
+    n -= len;
+  }
+}
+
+template <typename Transport>
+Awaitable<void> Connection<Transport>::dispatch(Command cmd, uint32_t id, size_t len)
+{
+  switch (cmd) {
+  case Command::SYN: {
+    assertTrue(accept_ && id % 2 == 1 && !streams_.contains(id), PichiError::BAD_PROTO);
+    assertTrue(len <= scratch_.size(), PichiError::BAD_PROTO);
+    auto payload = MutableBuffer{scratch_, len};
+    co_await read(payload);
+    auto remote = parseEndpoint([src = ConstBuffer{payload}](auto dst) mutable {
+      assertTrue(dst.size() <= src.size(), PichiError::BAD_PROTO);
+      rngs::copy_n(rngs::cbegin(src), dst.size(), rngs::begin(dst));
+      src += dst.size();
+    });
+    auto stream = std::make_shared<Stream>(shared_from_this(), id, ex_);
+    streams_.emplace(id, stream);
+    accept_(std::move(stream), std::move(remote));
+    break;
+  }
+  case Command::PSH: {
+    auto stream = find(id);
+    if (!stream) {
+      co_await skip(len);
+      break;
+    }
+    assertTrue(stream->admit(len), PichiError::BAD_PROTO);
+    co_await read(stream->prepare(len));
+    stream->commit(len);
+    break;
+  }
+  case Command::FIN:
+    assertTrue(len == 0, PichiError::BAD_PROTO);
+    if (auto stream = find(id); stream) stream->finish(asio::error::eof);
+    release(id);
+    break;
+  case Command::UPD: {
+    assertTrue(len == sizeof(uint32_t), PichiError::BAD_PROTO);
+    auto bytes = std::array<uint8_t, sizeof(uint32_t)>{};
+    co_await read(bytes);
+    if (auto stream = find(id); stream) stream->grant(ntoh<uint32_t>(bytes));
+    break;
+  }
+  default:
+    fail(PichiError::BAD_PROTO);
+  }
+}
+
+template <typename Transport>
+Awaitable<std::shared_ptr<Stream>> Connection<Transport>::open(Endpoint const& remote)
+{
+  if (!open_) asio::detail::throw_error(asio::error::not_connected);
+
+  auto id = next_;
+  next_ += 2;
+
+  auto stream = std::make_shared<Stream>(shared_from_this(), id, ex_);
+  if (streams_.empty()) idle_.expires_at(Timer::time_point::max());
+  streams_.emplace(id, stream);
+
+  auto buf = std::array<uint8_t, 512>{};
+  co_await write(Command::SYN, id, {buf, serializeEndpoint(remote, buf)});
+  co_return stream;
+}
+
+template <typename Transport>
+Awaitable<void> Connection<Transport>::write(Command cmd, uint32_t id, ConstBuffer payload)
+{
+  assertTrue(payload.size() <= MAX_FRAME);
+  while (writing_ && open_) co_await wait(gate_);
+  if (!open_) asio::detail::throw_error(asio::error::not_connected);
+
+  writing_  = true;
+  frame_[0] = static_cast<uint8_t>(cmd);
+  hton(id, {frame_.data() + 1, sizeof(uint32_t)});
+  hton(static_cast<uint16_t>(payload.size()), {frame_.data() + 5, sizeof(uint16_t)});
+  rngs::copy(payload, rngs::begin(frame_) + HEADER_SIZE);
+
+  auto ec = co_await redirect(transport_.send({frame_, HEADER_SIZE + payload.size()}));
+  writing_ = false;
+  gate_.cancel_one();
+  asio::detail::throw_error(ec);
+}
+
+// The streams are opened without any reply
+template <typename Transport>
+Awaitable<void> Connection<Transport>::respond(uint32_t, sys::error_code)
+{
+  co_return;
+}
+
+template <typename Transport> void Connection<Transport>::release(uint32_t id)
+{
+  streams_.erase(id);
+  if (!accept_ && open_ && streams_.empty()) idle_.expires_after(IDLE_TIMEOUT);
+}
+
+template <typename Transport> size_t Connection<Transport>::streams() const
+{
+  return streams_.size();
+}
+
+template <typename Transport> bool Connection<Transport>::is_open() const { return open_; }
+
+template <typename Transport> Awaitable<void> Connection<Transport>::run()
+{
+  // The connection lives until its transport fails
+  auto self   = shared_from_this();
+  auto header = std::array<uint8_t, HEADER_SIZE>{};
+  auto ec     = sys::error_code{};
+  while (!ec) {
+    co_await redirect(read(header), ec);
+    if (ec) break;
+    co_await redirect(
+        dispatch(
+            static_cast<Command>(header[0]),
+            ntoh<uint32_t>({header.data() + 1, sizeof(uint32_t)}),
+            ntoh<uint16_t>({header.data() + 5, sizeof(uint16_t)})
+        ),
+        ec
+    );
+  }
+  finish(ec);
+  co_await transport_.close();
+}
+
+template <typename Transport> Awaitable<void> Connection<Transport>::watch()
+{
+  auto self = shared_from_this();
+  while (open_) {
+    auto ec = co_await redirect(idle_.async_wait(asio::use_awaitable));
+    // The timer is reset by opening or releasing streams, or cancelled by failure
+    if (ec == asio::error::operation_aborted) continue;
+    if (streams_.empty()) {
+      open_ = false;
+      co_await transport_.close();
+    }
+    else
+      idle_.expires_at(Timer::time_point::max());
+  }
+}
+
+template <typename Transport>
+Awaitable<std::shared_ptr<Link>> connect(IOExecutor const& ex, Transport transport)
+{
+  auto conn = std::make_shared<Connection<Transport>>(ex, std::move(transport));
+  co_await conn->transport().multiplex();
+  asio::co_spawn(ex, conn->run(), asio::detached);
+  asio::co_spawn(ex, conn->watch(), asio::detached);
+  co_return conn;
+}
+
+template <typename Transport>
+Awaitable<void> serve(IOExecutor const& ex, Transport transport, Accept accept)
+{
+  auto conn = std::make_shared<Connection<Transport>>(ex, std::move(transport), std::move(accept));
+  co_await conn->run();
+}
+
+template Awaitable<std::shared_ptr<Link>> connect(IOExecutor const&, TrojanEgress<Tls>);
+template Awaitable<std::shared_ptr<Link>> connect(IOExecutor const&, TrojanEgress<Websocket>);
+template Awaitable<std::shared_ptr<Link>>
+    connect(IOExecutor const&, TrojanEgress<unit_test::TestSocket>);
+
+template Awaitable<void> serve(IOExecutor const&, TrojanIngress<Tls>, Accept);
+template Awaitable<void> serve(IOExecutor const&, TrojanIngress<Websocket>, Accept);
+template Awaitable<void> serve(IOExecutor const&, TrojanIngress<unit_test::TestSocket>, Accept);
+
+Stream::Stream(
+    std::shared_ptr<Link> link, uint32_t id, IOExecutor const& ex, int64_t credit, int64_t limit
+)
+  : link_{std::move(link)},
+    id_{id},
+    readable_{ex, Timer::time_point::max()},
+    writable_{ex, Timer::time_point::max()},
+    credit_{credit},
+    limit_{limit}
+{
+}
+
+Stream::~Stream()
+{
+  if (closed_) return;
+  link_->release(id_);
+  asio::co_spawn(
+      readable_.get_executor(),
+      [link = link_, id = id_]() -> Awaitable<void> {
+        co_await redirect(link->write(Command::FIN, id, {}));
+      },
+      asio::detached
+  );
+}
+
+Awaitable<size_t> Stream::recv(MutableBuffer buf)
+{
+  while (inbound_.size() == 0 && !ec_) co_await wait(readable_);
+  if (inbound_.size() == 0) asio::detail::throw_error(ec_);
+
+  auto n = asio::buffer_copy(asio::buffer(buf.data(), buf.size()), inbound_.data());
+  inbound_.consume(n);
+  unacked_ += n;
+  if (unacked_ >= WINDOW / 2 && !ec_) {
+    auto bytes = std::array<uint8_t, sizeof(uint32_t)>{};
+    hton(static_cast<uint32_t>(unacked_), bytes);
+    unacked_ = 0;
+    co_await link_->write(Command::UPD, id_, bytes);
+  }
+  co_return n;
+}
+
+Awaitable<void> Stream::send(ConstBuffer buf)
+{
+  while (buf.size() > 0) {
+    while (credit_ <= 0 && !ec_) co_await wait(writable_);
+    asio::detail::throw_error(ec_);
+
+    auto n = std::min({buf.size(), static_cast<size_t>(credit_), MAX_FRAME});
+    credit_ -= static_cast<int64_t>(n);
+    co_await link_->write(Command::PSH, id_, {buf.data(), n});
+    buf += n;
+  }
+}
+
+Awaitable<void> Stream::close()
+{
+  if (closed_) co_return;
+  closed_ = true;
+  finish(asio::error::operation_aborted);
+  link_->release(id_);
+  co_await redirect(link_->write(Command::FIN, id_, {}));
+}
+
+Awaitable<void> Stream::respond(sys::error_code const& ec) { co_await link_->respond(id_, ec); }
+
+bool Stream::admit(size_t n) const { return inbound_.size() + unacked_ + n <= WINDOW; }
+
+MutableBuffer Stream::prepare(size_t n) { return inbound_.prepare(n); }
+
+void Stream::commit(size_t n)
+{
+  inbound_.commit(n);
+  readable_.cancel();
+}
+
+void Stream::grant(int64_t n)
+{
+  assertTrue(credit_ + n <= limit_, PichiError::BAD_PROTO);
+  credit_ += n;
+  writable_.cancel();
+}
+
+void Stream::finish(sys::error_code const& ec)
+{
+  if (!ec_) ec_ = ec;
+  readable_.cancel();
+  writable_.cancel();
+}
+
+Pool::Pool(asio::execution_context& ctx) : asio::detail::execution_context_service_base<Pool>{ctx}
+{
+}
+
+void Pool::shutdown() noexcept { entries_.clear(); }
+
+Awaitable<std::shared_ptr<Link>>
+    Pool::acquire(std::shared_ptr<Connector const> const& connector, Dial dial)
+{
+  std::erase_if(entries_, [](auto&& entry) { return entry.first.expired(); });
+
+  auto&& opt   = *connector->vo().mux_;
+  auto&  entry = entries_[connector];
+  auto   load  = [](auto&& weak) { return weak.lock()->streams(); };
+  while (true) {
+    std::erase_if(entry.links_, [](auto&& weak) {
+      auto link = weak.lock();
+      return !link || !link->is_open();
+    });
+
+    auto dialable = rngs::size(entry.links_) + entry.dialing_ < opt.connections_;
+    auto it       = rngs::min_element(entry.links_, {}, load);
+    if (it != rngs::end(entry.links_) && (load(*it) < opt.streams_ || !dialable))
+      co_return it->lock();
+    if (dialable) break;
+
+    // All connections allowed are being dialed
+    if (!entry.dialed_)
+      entry.dialed_ =
+          std::make_unique<Timer>(co_await asio::this_coro::executor, Timer::time_point::max());
+    co_await wait(*entry.dialed_);
+  }
+
+  ++entry.dialing_;
+  auto [ec, link] = co_await redirect(dial());
+  --entry.dialing_;
+  if (!ec) entry.links_.push_back(*link);
+  if (entry.dialed_) entry.dialed_->cancel();
+  asio::detail::throw_error(ec);
+  co_return *link;
+}
+
+Pool& get_pool(IOExecutor const& ex)
+{
+  return asio::use_service<Pool>(asio::query(ex, asio::execution::context));
+}
+
+}  // namespace mux
+
+MuxIngress::MuxIngress(std::shared_ptr<mux::Stream> stream, Endpoint remote)
+  : stream_{std::move(stream)}, remote_{std::move(remote)}
+{
+}
+
+Awaitable<size_t> MuxIngress::recv(MutableBuffer buf) { co_return co_await stream_->recv(buf); }
+
+Awaitable<void> MuxIngress::send(ConstBuffer buf) { co_await stream_->send(buf); }
+
+Awaitable<void> MuxIngress::close() { co_await stream_->close(); }
+
+Awaitable<Endpoint> MuxIngress::read_remote() { co_return remote_; }
+
+Awaitable<void> MuxIngress::confirm() { co_await stream_->respond({}); }
+
+Awaitable<void> MuxIngress::disconnect(sys::error_code const& ec)
+{
+  co_await redirect(stream_->respond(ec));
+  co_await stream_->close();
+}
+
+MuxEgress::MuxEgress(std::shared_ptr<Connector const> connector, IOExecutor const& ex)
+  : connector_{std::move(connector)}, ex_{ex}
+{
+}
+
+Awaitable<size_t> MuxEgress::recv(MutableBuffer buf) { co_return co_await stream_->recv(buf); }
+
+Awaitable<void> MuxEgress::send(ConstBuffer buf) { co_await stream_->send(buf); }
+
+Awaitable<void> MuxEgress::close()
+{
+  if (stream_) co_await stream_->close();
+}
+
+Awaitable<void> MuxEgress::connect(Endpoint const& remote)
+{
+  auto link = co_await mux::get_pool(ex_).acquire(connector_, [this]() { return dial(); });
+  stream_   = co_await link->open(remote);
+}
+
+Awaitable<std::shared_ptr<mux::Link>> MuxEgress::dial()
+{
+  auto&& vo   = connector_->vo();
+  auto&& cred = connector_->credential();
+  if (vo.websocket_.has_value()) {
+    auto transport = TrojanEgress<Websocket>{
+        vo,
+        cred,
+        Websocket{
+                  vo.websocket_->path_,
+                  vo.websocket_->host_.value_or(""),
+                  vo.tls_->sni_,
+                  connector_->tls(),
+                  ex_
+        }
+    };
+    co_return co_await mux::connect(ex_, std::move(transport));
+  }
+  else {
+    auto transport = TrojanEgress<Tls>{
+        vo,
+        cred,
+        Tls{vo.tls_->sni_, connector_->tls(), ex_}
+    };
+    co_return co_await mux::connect(ex_, std::move(transport));
+  }
+}
+
+}  // namespace pichi::adapter::tcp
@@ -98,21 +98,21 @@ template <typename Stream> Awaitable<std::string> read_string(Stream& stream)
   co_return std::string{std::cbegin(buf), std::cbegin(buf) + len};
 }
 
-static auto gen_data(vo::Egress const& vo, MutableBuffer dst)
+std::string gen_credential(vo::Egress const& vo)
 {
-  if (!vo.credential_.has_value()) return 0_sz;
+  if (!vo.credential_.has_value()) return {};
 
-  auto& c = std::get<vo::UpEgressCredential>(*vo.credential_).credential_;
-  auto  p = rngs::begin(dst);
+  auto& c   = std::get<vo::UpEgressCredential>(*vo.credential_).credential_;
+  auto  ret = std::string{};
+  ret.reserve(3_sz + c.first.size() + c.second.size());
 
-  *p++ = 0x01;
-  *p++ = static_cast<uint8_t>(c.first.size());
-  rngs::copy(ConstBuffer{c.first}, p);
-  p += c.first.size();
-  *p++ = static_cast<uint8_t>(c.second.size());
-  rngs::copy(ConstBuffer{c.second}, p);
+  ret.push_back(0x01);
+  ret.push_back(static_cast<char>(c.first.size()));
+  ret.append(c.first);
+  ret.push_back(static_cast<char>(c.second.size()));
+  ret.append(c.second);
 
-  return 3_sz + c.first.size() + c.second.size();
+  return ret;
 }
 
 IngressCredential::IngressCredential(vo::Ingress const& vo)
@@ -131,11 +131,13 @@ bool IngressCredential::authenticate(std::string const& u, std::string const& p)
   return it != std::cend(data_) && it->second == p;
 }
 
-EgressCredential::EgressCredential(vo::Egress const& vo) : len_{gen_data(vo, data_)} {}
+EgressCredential::EgressCredential(vo::Egress const& vo) : data_{gen_credential(vo)} {}
 
-bool EgressCredential::need_auth() const { return len_ > 0; }
+EgressCredential::EgressCredential(std::string data) : data_{std::move(data)} {}
 
-ConstBuffer EgressCredential::data() const { return ConstBuffer{data_, len_}; }
+bool EgressCredential::need_auth() const { return !data_.empty(); }
+
+ConstBuffer EgressCredential::data() const { return ConstBuffer{data_}; }
 
 }  // namespace socks5
 
@@ -258,6 +260,14 @@ Awaitable<void> Socks5Ingress<NextLayer>::disconnect(sys::error_code const& ec)
   co_await redirect(stream::write(underlying_, socks5::err_to_buf(ec)));
 }
 
+template <stream::AsyncLayer NextLayer> ip::tcp::socket* Socks5Ingress<NextLayer>::raw_socket()
+{
+  if constexpr (std::same_as<NextLayer, Socket>)
+    return &underlying_;
+  else
+    return nullptr;
+}
+
 template class Socks5Ingress<Socket>;
 template class Socks5Ingress<Tls>;
 template class Socks5Ingress<unit_test::TestSocket>;
@@ -268,6 +278,14 @@ Socks5Egress<NextLayer>::Socks5Egress(vo::Egress const& vo, NextLayer underlying
 {
 }
 
+template <stream::AsyncLayer NextLayer>
+Socks5Egress<NextLayer>::Socks5Egress(
+    vo::Egress const& vo, std::string credential, NextLayer underlying
+)
+  : underlying_{std::move(underlying)}, peer_{*vo.server_}, credential_{std::move(credential)}
+{
+}
+
 template <stream::AsyncLayer NextLayer>
 Awaitable<size_t> Socks5Egress<NextLayer>::recv(MutableBuffer buf)
 {
@@ -326,6 +344,14 @@ Awaitable<void> Socks5Egress<NextLayer>::connect(Endpoint const& remote)
   co_await parse_endpoint([this](auto dst) { return stream::read(underlying_, dst); });
 }
 
+template <stream::AsyncLayer NextLayer> ip::tcp::socket* Socks5Egress<NextLayer>::raw_socket()
+{
+  if constexpr (std::same_as<NextLayer, Socket>)
+    return &underlying_;
+  else
+    return nullptr;
+}
+
 template class Socks5Egress<Socket>;
 template class Socks5Egress<Tls>;
 template class Socks5Egress<unit_test::TestSocket>;
@@ -187,4 +187,6 @@ Awaitable<void> TransparentIngress::confirm() { co_return; }
 
 Awaitable<void> TransparentIngress::disconnect(sys::error_code const&) { co_return; }
 
+TransparentIngress::Socket* TransparentIngress::raw_socket() { return &socket_; }
+
 }  // namespace pichi::adapter::tcp
@@ -28,6 +28,17 @@ namespace pichi::adapter::tcp {
 
 static auto const PWD_LEN = 56_sz;
 
+/*
+ * MUX is the command of pichi, which is accepted only if the ingress enables the mux option. It
+ * differs from CONNECT(0x01), UDP ASSOCIATE(0x03) and the smux command(0x7f) of trojan-go, whose
+ * frames aren't compatible with pichi's.
+ */
+static auto const CONNECT = 0x01_u8;
+static auto const MUX     = 0xf0_u8;
+
+// The address following the MUX command is meaningless
+static auto const MUX_REMOTE = Endpoint{EndpointType::IPV4, "0.0.0.0", 0_u16};
+
 namespace trojan {
 
 static std::string sha224(std::string_view pwd)
@@ -37,6 +48,11 @@ static std::string sha224(std::string_view pwd)
   return Botan::hex_encode(sha224->final(), false);
 }
 
+std::string gen_credential(vo::Egress const& vo)
+{
+  return sha224(std::get<vo::TrojanEgressCredential>(*vo.credential_).credential_);
+}
+
 template <typename Container> Container create_pwds(vo::TrojanIngressCredential const& vo)
 {
   auto v = vo.credential_ | view::transform([](auto&& cred) { return sha224(cred); });
@@ -112,7 +128,8 @@ template <stream::AsyncLayer NextLayer>
 TrojanIngress<NextLayer>::TrojanIngress(vo::Ingress const& vo, NextLayer underlying)
   : underlying_{std::move(underlying)},
     cred_{vo},
-    remote_{std::get<vo::TrojanOption>(*vo.opt_).remote_}
+    remote_{std::get<vo::TrojanOption>(*vo.opt_).remote_},
+    mux_{std::get<vo::TrojanOption>(*vo.opt_).mux_}
 {
 }
 
@@ -147,7 +164,9 @@ template <stream::AsyncLayer NextLayer> Awaitable<Endpoint> TrojanIngress<NextLa
     assertTrue(cache_.take(2) == "\r\n"sv, PichiError::BAD_PROTO);
 
     co_await cache_.read_from(underlying_);
-    assertTrue(cache_.take(1) == "\x01"sv, PichiError::BAD_PROTO);
+    auto cmd     = static_cast<uint8_t>(cache_.take(1).front());
+    multiplexed_ = mux_ && cmd == MUX;
+    assertTrue(multiplexed_ || cmd == CONNECT, PichiError::BAD_PROTO);
 
     auto remote = co_await parse_endpoint([&](auto demand) -> Awaitable<void> {
       co_await cache_.read_from(underlying_, demand.size());
@@ -163,6 +182,7 @@ template <stream::AsyncLayer NextLayer> Awaitable<Endpoint> TrojanIngress<NextLa
   catch (...) {
     if constexpr (std::same_as<NextLayer, Tls> || std::same_as<NextLayer, unit_test::TestSocket>) {
       cache_.rollback();
+      multiplexed_ = false;
       co_return remote_;
     }
     std::rethrow_exception(std::current_exception());
@@ -180,15 +200,26 @@ Awaitable<void> TrojanIngress<NextLayer>::disconnect(sys::error_code const&)
   co_return;
 }
 
+template <stream::AsyncLayer NextLayer> bool TrojanIngress<NextLayer>::multiplexed() const
+{
+  return multiplexed_;
+}
+
 template class TrojanIngress<Tls>;
 template class TrojanIngress<Websocket>;
 template class TrojanIngress<unit_test::TestSocket>;
 
 template <stream::AsyncLayer NextLayer>
 TrojanEgress<NextLayer>::TrojanEgress(vo::Egress const& vo, NextLayer underlying)
-  : cred_{trojan::sha224(std::get<vo::TrojanEgressCredential>(*vo.credential_).credential_)},
-    peer_{*vo.server_},
-    underlying_{std::move(underlying)}
+  : TrojanEgress{vo, trojan::gen_credential(vo), std::move(underlying)}
+{
+}
+
+template <stream::AsyncLayer NextLayer>
+TrojanEgress<NextLayer>::TrojanEgress(
+    vo::Egress const& vo, std::string credential, NextLayer underlying
+)
+  : cred_{std::move(credential)}, peer_{*vo.server_}, underlying_{std::move(underlying)}
 {
 }
 
@@ -211,6 +242,17 @@ template <stream::AsyncLayer NextLayer> Awaitable<void> TrojanEgress<NextLayer>:
 
 template <stream::AsyncLayer NextLayer>
 Awaitable<void> TrojanEgress<NextLayer>::connect(Endpoint const& remote)
+{
+  co_await request(CONNECT, remote);
+}
+
+template <stream::AsyncLayer NextLayer> Awaitable<void> TrojanEgress<NextLayer>::multiplex()
+{
+  co_await request(MUX, MUX_REMOTE);
+}
+
+template <stream::AsyncLayer NextLayer>
+Awaitable<void> TrojanEgress<NextLayer>::request(uint8_t cmd, Endpoint const& remote)
 {
   co_await stream::connect(underlying_, peer_);
 
@@ -218,8 +260,9 @@ Awaitable<void> TrojanEgress<NextLayer>::connect(Endpoint const& remote)
 
   auto it = rngs::begin(buf);
 
-  it = rngs::copy(cred_, it).out;
-  it = rngs::copy("\r\n\x01"sv, it).out;
+  it    = rngs::copy(cred_, it).out;
+  it    = rngs::copy("\r\n"sv, it).out;
+  *it++ = cmd;
   it += serializeEndpoint(remote, {it, 259_sz});
   it = rngs::copy("\r\n"sv, it).out;
 
@@ -27,8 +27,9 @@ Awaitable<void> Tunnel::close() { co_await stream::close(socket_); }
 
 Awaitable<Endpoint> Tunnel::read_remote()
 {
-  balancer_ = co_await service::get_balancer(socket_.get_executor(), name_);
-  peer_     = co_await balancer_->select();
+  auto ex   = socket_.get_executor();
+  balancer_ = co_await exec_to(ex, service::get_balancer(ex, name_));
+  peer_     = co_await exec_to(ex, balancer_->select());
   co_return peer_;
 }
 
@@ -36,4 +37,6 @@ Awaitable<void> Tunnel::confirm() { co_return; }
 
 Awaitable<void> Tunnel::disconnect(sys::error_code const&) { co_return; }
 
+Tunnel::Socket* Tunnel::raw_socket() { return &socket_; }
+
 }  // namespace pichi::adapter::tcp
@@ -0,0 +1,187 @@
+#include "pichi/common/config.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <pichi/common/buffer_pool.hpp>
+#include <pichi/common/literals.hpp>
+#include <vector>
+
+namespace rngs = std::ranges;
+
+namespace pichi {
+
+using Data = std::unique_ptr<uint8_t[]>;
+
+static auto const CLASSES = std::countr_zero(PooledBuffer::MAX_SIZE / PooledBuffer::MIN_SIZE) + 1;
+
+// The maximum number of the idle buffers cached by each size class of each thread
+static auto const MAX_IDLE = 16_sz;
+
+static size_t size_of(size_t cls) { return PooledBuffer::MIN_SIZE << cls; }
+
+static size_t class_of(size_t size)
+{
+  auto rounded = std::bit_ceil(std::clamp(size, PooledBuffer::MIN_SIZE, PooledBuffer::MAX_SIZE));
+  return std::countr_zero(rounded / PooledBuffer::MIN_SIZE);
+}
+
+static Data allocate(size_t cls) { return Data{new uint8_t[size_of(cls)]}; }
+
+/*
+ * Each counter is written by its own thread only, so a relaxed load and store suffice instead of
+ * any RMW on a shared cache line. A buffer given back by another thread decreases the counters of
+ * that thread, which might wrap around, but their sum is still correct modulo 2^64.
+ */
+class Counter {
+public:
+  operator size_t() const { return value_.load(std::memory_order_relaxed); }
+
+  Counter& operator+=(size_t n)
+  {
+    value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    return *this;
+  }
+
+  Counter& operator-=(size_t n) { return *this += -n; }
+
+private:
+  std::atomic_size_t value_ = 0;
+};
+
+struct Counters {
+  Counter in_use_       = {};
+  Counter in_use_bytes_ = {};
+  Counter idle_         = {};
+  Counter idle_bytes_   = {};
+  Counter hits_         = {};
+  Counter misses_       = {};
+};
+
+static void accumulate(BufferPoolStats& stats, Counters const& counters)
+{
+  stats.in_use_ += counters.in_use_;
+  stats.in_use_bytes_ += counters.in_use_bytes_;
+  stats.idle_ += counters.idle_;
+  stats.idle_bytes_ += counters.idle_bytes_;
+  stats.hits_ += counters.hits_;
+  stats.misses_ += counters.misses_;
+}
+
+class Pool;
+
+// The pools of the running threads, and the counters left by the exited ones
+static auto mutex   = std::mutex{};
+static auto pools   = std::vector<Pool const*>{};
+static auto retired = Counters{};
+
+// Buffers might be given back after the pool of the thread is destroyed, such as the ones held by
+// the coroutines which are destroyed along with a static io_context.
+static thread_local auto destroyed = false;
+
+class Pool {
+public:
+  Pool()
+  {
+    auto lock = std::scoped_lock{mutex};
+    pools.push_back(this);
+  }
+
+  ~Pool()
+  {
+    for (auto cls = 0_sz; cls < rngs::size(free_); ++cls) {
+      counters_.idle_ -= rngs::size(free_[cls]);
+      counters_.idle_bytes_ -= rngs::size(free_[cls]) * size_of(cls);
+    }
+
+    auto lock = std::scoped_lock{mutex};
+    retired.in_use_ += counters_.in_use_;
+    retired.in_use_bytes_ += counters_.in_use_bytes_;
+    retired.hits_ += counters_.hits_;
+    retired.misses_ += counters_.misses_;
+    std::erase(pools, this);
+    destroyed = true;
+  }
+
+  Counters const& counters() const { return counters_; }
+
+  Data borrow(size_t cls)
+  {
+    counters_.in_use_ += 1;
+    counters_.in_use_bytes_ += size_of(cls);
+
+    auto& free = free_[cls];
+    if (rngs::empty(free)) {
+      counters_.misses_ += 1;
+      return allocate(cls);
+    }
+
+    counters_.hits_ += 1;
+    counters_.idle_ -= 1;
+    counters_.idle_bytes_ -= size_of(cls);
+    auto ret = std::move(free.back());
+    free.pop_back();
+    return ret;
+  }
+
+  void giveback(size_t cls, Data data)
+  {
+    counters_.in_use_ -= 1;
+    counters_.in_use_bytes_ -= size_of(cls);
+
+    auto& free = free_[cls];
+    if (rngs::size(free) >= MAX_IDLE) return;
+
+    counters_.idle_ += 1;
+    counters_.idle_bytes_ += size_of(cls);
+    free.push_back(std::move(data));
+  }
+
+private:
+  Counters                               counters_ = {};
+  std::array<std::vector<Data>, CLASSES> free_     = {};
+};
+
+static thread_local auto pool = Pool{};
+
+// The buffers borrowed or given back while the thread is exiting are counted as retired
+static Data borrow(size_t cls)
+{
+  if (!destroyed) return pool.borrow(cls);
+
+  auto lock = std::scoped_lock{mutex};
+  retired.in_use_ += 1;
+  retired.in_use_bytes_ += size_of(cls);
+  retired.misses_ += 1;
+  return allocate(cls);
+}
+
+static void giveback(size_t cls, Data data)
+{
+  if (!destroyed) return pool.giveback(cls, std::move(data));
+
+  auto lock = std::scoped_lock{mutex};
+  retired.in_use_ -= 1;
+  retired.in_use_bytes_ -= size_of(cls);
+}
+
+PooledBuffer::PooledBuffer(size_t size)
+  : data_{borrow(class_of(size))}, size_{size_of(class_of(size))}
+{
+}
+
+PooledBuffer::~PooledBuffer() { giveback(class_of(size_), std::move(data_)); }
+
+MutableBuffer PooledBuffer::buffer() const { return {data_.get(), size_}; }
+
+BufferPoolStats buffer_pool_stats()
+{
+  auto lock = std::scoped_lock{mutex};
+  auto ret  = BufferPoolStats{};
+  accumulate(ret, retired);
+  for (auto&& p : pools) accumulate(ret, p->counters());
+  return ret;
+}
+
+}  // namespace pichi
@@ -0,0 +1,398 @@
+#include "pichi/common/config.hpp"
+#include <algorithm>
+#include <limits>
+#include <pichi/common/asserts.hpp>
+#include <pichi/common/literals.hpp>
+#include <pichi/common/pattern.hpp>
+#include <ranges>
+
+namespace rngs = std::ranges;
+
+namespace pichi {
+
+using CharSet = std::bitset<256>;
+
+static auto const INFINITE = std::numeric_limits<size_t>::max();
+
+[[noreturn]] static void reject(std::string_view reason)
+{
+  fail(PichiError::SEMANTIC_ERROR, reason);
+}
+
+static CharSet make_set(uint8_t lo, uint8_t hi)
+{
+  auto set = CharSet{};
+  for (auto c = static_cast<size_t>(lo); c <= hi; ++c) set.set(c);
+  return set;
+}
+
+static CharSet make_set(std::string_view chars)
+{
+  auto set = CharSet{};
+  for (auto c : chars) set.set(static_cast<uint8_t>(c));
+  return set;
+}
+
+static auto const DIGITS = make_set('0', '9');
+static auto const WORDS  = make_set('a', 'z') | make_set('A', 'Z') | DIGITS | make_set("_");
+static auto const SPACES = make_set(" \t\n\v\f\r");
+static auto const ANY    = ~make_set("\n\r");
+
+static uint8_t front(CharSet const& set)
+{
+  auto c = 0_sz;
+  while (!set.test(c)) ++c;
+  return static_cast<uint8_t>(c);
+}
+
+struct Node {
+  enum class Type : uint8_t { SET, CONCAT, ALTER, REPEAT, BOL, EOL };
+
+  Type              type_;
+  CharSet           set_      = {};
+  std::vector<Node> children_ = {};
+  size_t            min_      = 0;
+  size_t            max_      = 0;
+};
+
+class Parser {
+public:
+  explicit Parser(std::string_view pattern) : rest_{pattern} {}
+
+  Node parse()
+  {
+    auto root = alternation(0_sz);
+    if (!rngs::empty(rest_)) reject("Unbalanced parenthesis");
+    return root;
+  }
+
+private:
+  bool consume(char c)
+  {
+    if (rngs::empty(rest_) || rest_.front() != c) return false;
+    rest_.remove_prefix(1);
+    return true;
+  }
+
+  uint8_t take()
+  {
+    if (rngs::empty(rest_)) reject("Unexpected end of pattern");
+    auto c = static_cast<uint8_t>(rest_.front());
+    rest_.remove_prefix(1);
+    return c;
+  }
+
+  Node alternation(size_t depth)
+  {
+    if (depth > PatternSet::MAX_DEPTH) reject("Pattern nested too deeply");
+    auto node = Node{.type_ = Node::Type::ALTER};
+    do {
+      node.children_.push_back(concatenation(depth));
+    } while (consume('|'));
+    return rngs::size(node.children_) == 1 ? std::move(node.children_.front()) : node;
+  }
+
+  Node concatenation(size_t depth)
+  {
+    auto node = Node{.type_ = Node::Type::CONCAT};
+    while (!rngs::empty(rest_) && rest_.front() != '|' && rest_.front() != ')') {
+      node.children_.push_back(atom(depth));
+      quantify(node.children_.back());
+    }
+    return node;
+  }
+
+  Node atom(size_t depth)
+  {
+    switch (auto c = take()) {
+    case '^':
+      return Node{.type_ = Node::Type::BOL};
+    case '$':
+      return Node{.type_ = Node::Type::EOL};
+    case '.':
+      return Node{.type_ = Node::Type::SET, .set_ = ANY};
+    case '[':
+      return Node{.type_ = Node::Type::SET, .set_ = klass()};
+    case '\\':
+      return Node{.type_ = Node::Type::SET, .set_ = escape(false)};
+    case '(': {
+      if (consume('?') && !consume(':')) reject("Unsupported group");
+      auto node = alternation(depth + 1);
+      if (!consume(')')) reject("Unbalanced parenthesis");
+      return node;
+    }
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+      reject("Nothing to repeat");
+    default:
+      return Node{.type_ = Node::Type::SET, .set_ = CharSet{}.set(c)};
+    }
+  }
+
+  size_t count()
+  {
+    auto n = 0_sz;
+    if (rngs::empty(rest_) || !DIGITS.test(static_cast<uint8_t>(rest_.front())))
+      reject("Invalid repetition");
+    while (!rngs::empty(rest_) && DIGITS.test(static_cast<uint8_t>(rest_.front()))) {
+      n = n * 10 + (take() - '0');
+      if (n > PatternSet::MAX_REPEAT) reject("Repetition too large");
+    }
+    return n;
+  }
+
+  void quantify(Node& node)
+  {
+    auto min = 0_sz;
+    auto max = INFINITE;
+    if (consume('*'))
+      ;
+    else if (consume('+'))
+      min = 1_sz;
+    else if (consume('?'))
+      max = 1_sz;
+    else if (consume('{')) {
+      min = count();
+      max = consume(',') ? (!rngs::empty(rest_) && rest_.front() == '}' ? INFINITE : count()) : min;
+      if (!consume('}') || min > max) reject("Invalid repetition");
+    }
+    else
+      return;
+
+    if (node.type_ == Node::Type::BOL || node.type_ == Node::Type::EOL)
+      reject("Nothing to repeat");
+    // Laziness makes no difference for searching
+    consume('?');
+    auto child = std::move(node);
+    node       = Node{.type_ = Node::Type::REPEAT, .children_ = {child}, .min_ = min, .max_ = max};
+  }
+
+  CharSet klass()
+  {
+    auto negative = consume('^');
+    auto set      = CharSet{};
+    while (!consume(']')) {
+      auto lo = class_atom();
+      if (lo.count() == 1 && !rngs::empty(rest_) && rest_.front() == '-' &&
+          rest_.substr(1, 1) != "]") {
+        rest_.remove_prefix(1);
+        auto hi = class_atom();
+        if (hi.count() != 1) reject("Invalid range in character class");
+        auto first = front(lo);
+        auto last  = front(hi);
+        if (first > last) reject("Invalid range in character class");
+        set |= make_set(first, last);
+      }
+      else
+        set |= lo;
+    }
+    return negative ? ~set : set;
+  }
+
+  CharSet class_atom()
+  {
+    if (rngs::empty(rest_)) reject("Unbalanced bracket");
+    auto c = take();
+    return c == '\\' ? escape(true) : CharSet{}.set(c);
+  }
+
+  uint8_t hex()
+  {
+    auto c = take();
+    if (DIGITS.test(c)) return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    reject("Invalid hexadecimal escape");
+  }
+
+  CharSet escape(bool inClass)
+  {
+    switch (auto c = take()) {
+    case 'd':
+      return DIGITS;
+    case 'D':
+      return ~DIGITS;
+    case 'w':
+      return WORDS;
+    case 'W':
+      return ~WORDS;
+    case 's':
+      return SPACES;
+    case 'S':
+      return ~SPACES;
+    case 't':
+      return CharSet{}.set('\t');
+    case 'n':
+      return CharSet{}.set('\n');
+    case 'r':
+      return CharSet{}.set('\r');
+    case 'f':
+      return CharSet{}.set('\f');
+    case 'v':
+      return CharSet{}.set('\v');
+    case '0':
+      return CharSet{}.set(0);
+    case 'x': {
+      auto high = hex();
+      return CharSet{}.set(high << 4 | hex());
+    }
+    case 'b':
+      if (inClass) return CharSet{}.set('\b');
+      reject("Unsupported word boundary");
+    case 'B':
+      reject("Unsupported word boundary");
+    default:
+      if (DIGITS.test(c)) reject("Unsupported backreference");
+      if (WORDS.test(c)) reject("Unsupported escape");
+      return CharSet{}.set(c);
+    }
+  }
+
+  std::string_view rest_;
+};
+
+class PatternCompiler {
+public:
+  PatternCompiler(PatternSet& set, size_t index)
+    : set_{set}, index_{index}, base_{rngs::size(set.states_)}
+  {
+  }
+
+  uint32_t push(PatternSet::Kind kind, uint32_t out, uint32_t alt = 0)
+  {
+    if (rngs::size(set_.states_) - base_ >= PatternSet::MAX_STATES) reject("Pattern too complex");
+    set_.states_.push_back({kind, out, alt, index_});
+    return static_cast<uint32_t>(rngs::size(set_.states_) - 1);
+  }
+
+  // Emit the states matching the node and then continuing with the state 'out'
+  uint32_t emit(Node const& node, uint32_t out)
+  {
+    switch (node.type_) {
+    case Node::Type::SET:
+      set_.sets_.push_back(node.set_);
+      return push(PatternSet::Kind::CHAR, out, static_cast<uint32_t>(rngs::size(set_.sets_) - 1));
+    case Node::Type::CONCAT:
+      for (auto&& child : node.children_ | std::views::reverse) out = emit(child, out);
+      return out;
+    case Node::Type::ALTER: {
+      auto entry = emit(node.children_.back(), out);
+      for (auto&& child : node.children_ | std::views::reverse | std::views::drop(1))
+        entry = push(PatternSet::Kind::SPLIT, emit(child, out), entry);
+      return entry;
+    }
+    case Node::Type::REPEAT: {
+      auto const& child = node.children_.front();
+      auto        entry = out;
+      if (node.max_ == INFINITE) {
+        entry                    = push(PatternSet::Kind::SPLIT, 0, out);
+        set_.states_[entry].out_ = emit(child, entry);
+      }
+      else
+        for (auto i = node.min_; i < node.max_; ++i)
+          entry = push(PatternSet::Kind::SPLIT, emit(child, entry), out);
+      for (auto i = 0_sz; i < node.min_; ++i) entry = emit(child, entry);
+      return entry;
+    }
+    case Node::Type::BOL:
+      return push(PatternSet::Kind::BOL, out);
+    case Node::Type::EOL:
+      return push(PatternSet::Kind::EOL, out);
+    default:
+      fail();
+    }
+  }
+
+private:
+  PatternSet& set_;
+  size_t      index_;
+  size_t      base_;
+};
+
+void PatternSet::add(std::string_view pattern, size_t index)
+{
+  auto root     = Parser{pattern}.parse();
+  auto compiler = PatternCompiler{*this, index};
+  auto start    = compiler.emit(root, compiler.push(Kind::MATCH, 0));
+  entries_.insert(
+      rngs::upper_bound(entries_, index, rngs::less{}, &Entry::index_),
+      Entry{start, index}
+  );
+}
+
+std::optional<size_t> PatternSet::match(std::string_view input) const
+{
+  // The scratch lists are reused by all sets in the thread, marked by the generations
+  thread_local auto marks      = std::vector<uint32_t>{};
+  thread_local auto generation = uint32_t{0};
+  thread_local auto current    = std::vector<uint32_t>{};
+  thread_local auto next       = std::vector<uint32_t>{};
+  thread_local auto stack      = std::vector<uint32_t>{};
+
+  if (rngs::size(marks) < rngs::size(states_)) marks.resize(rngs::size(states_));
+
+  auto best    = INFINITE;
+  auto advance = [&]() {
+    if (++generation == 0) {
+      rngs::fill(marks, uint32_t{0});
+      generation = 1;
+    }
+  };
+  // Follow the epsilon transitions from the state at the position
+  auto follow = [&](uint32_t s, size_t pos, std::vector<uint32_t>& list) {
+    stack.push_back(s);
+    while (!rngs::empty(stack)) {
+      auto i = stack.back();
+      stack.pop_back();
+      auto const& state = states_[i];
+      if (marks[i] == generation || state.index_ >= best) continue;
+      marks[i] = generation;
+      switch (state.kind_) {
+      case Kind::CHAR:
+        list.push_back(i);
+        break;
+      case Kind::SPLIT:
+        stack.push_back(state.alt_);
+        stack.push_back(state.out_);
+        break;
+      case Kind::BOL:
+        if (pos == 0) stack.push_back(state.out_);
+        break;
+      case Kind::EOL:
+        if (pos == rngs::size(input)) stack.push_back(state.out_);
+        break;
+      case Kind::MATCH:
+        best = state.index_;
+        break;
+      }
+    }
+  };
+  // Each position is a new beginning of searching
+  auto seed = [&](size_t pos, std::vector<uint32_t>& list) {
+    for (auto&& entry : entries_) {
+      if (entry.index_ >= best) break;
+      follow(entry.state_, pos, list);
+    }
+  };
+
+  current.clear();
+  advance();
+  seed(0_sz, current);
+  for (auto pos = 0_sz; pos < rngs::size(input); ++pos) {
+    auto c = static_cast<uint8_t>(input[pos]);
+    next.clear();
+    advance();
+    for (auto i : current) {
+      auto const& state = states_[i];
+      if (state.index_ < best && sets_[state.alt_].test(c)) follow(state.out_, pos + 1, next);
+    }
+    seed(pos + 1, next);
+    std::swap(current, next);
+    if (rngs::empty(current) && (rngs::empty(entries_) || entries_.front().index_ >= best)) break;
+  }
+  return best == INFINITE ? std::nullopt : std::make_optional(best);
+}
+
+}  // namespace pichi
@@ -1,38 +1,63 @@
 #include <pichi/common/config.hpp>
 // Include config.hpp first
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
-#include <cmath>
 #include <pichi/common/asserts.hpp>
 #include <pichi/common/uri.hpp>
-#include <regex>
+#include <ranges>
+#include <tuple>
+#include <utility>
 
 using namespace std;
 using namespace std::string_view_literals;
 
 namespace pichi {
 
-// This URI regex isn't intended to follow RFC3986
-static auto const URI_REGEX =
-    regex{"^(https?)://(([^:/?#\\[\\]]+)|\\[([a-f0-9:.]+)\\])(:(\\d+))?(/[^#?]*([#?].*)?)?$",
-          regex::icase};
-static auto const URI_REGEX_SIZE = 9;
-static auto const HOST_REGEX = regex{"^(([^:/\\[\\]]+)|\\[([a-f0-9:.]+)\\])(:(\\d+))?$"};
-static auto const HOST_REGEX_SIZE = 6;
+/*
+ * The URI and the authority are parsed linearly in place, accepting the same forms as the regexes
+ * below, which aren't intended to follow RFC3986 either:
+ *
+ *   URI:  ^(https?)://(([^:/?#\[\]]+)|\[([a-f0-9:.]+)\])(:(\d+))?(/[^#?]*([#?].*)?)?$ with icase
+ *   Host: ^(([^:/\[\]]+)|\[([a-f0-9:.]+)\])(:(\d+))?$
+ */
+static auto const URI_HOST_DELIMITERS = ":/?#[]"sv;
+static auto const HOST_DELIMITERS = ":/[]"sv;
+static auto const QUERY_DELIMITERS = "#?"sv;
 
-static string_view r2sv(csub_match const& m, csub_match::difference_type size)
+static bool digit(char c) { return c >= '0' && c <= '9'; }
+
+// The characters inside the brackets, with or without the capital hex digits
+static bool ipv6(char c) { return digit(c) || (c >= 'a' && c <= 'f') || c == ':' || c == '.'; }
+
+static bool iipv6(char c) { return ipv6(c) || (c >= 'A' && c <= 'F'); }
+
+static string_view take(string_view& s, size_t n)
 {
-  assert(size <= m.length());
-  return {m.first, static_cast<size_t>(abs(size))};
+  auto ret = s.substr(0, n);
+  s.remove_prefix(ret.size());
+  return ret;
 }
 
-static string_view r2sv(csub_match const& m) { return r2sv(m, m.length()); }
-
-static auto matching(string_view s, regex const& re, size_t size)
+// Remove host[:port] from the beginning of s, and the port is empty if omitted
+static pair<string_view, string_view> authority(string_view& s, string_view delimiters, bool icase)
 {
-  auto r = cmatch{};
-  assertTrue(regex_match(s.data(), s.data() + s.size(), r, re), PichiError::BAD_PROTO);
-  assertTrue(r.size() == size, PichiError::BAD_PROTO);
-  return r;
+  auto host = string_view{};
+  if (s.starts_with('[')) {
+    auto close = s.find(']');
+    assertFalse(close == string_view::npos, PichiError::BAD_PROTO);
+    host = s.substr(1, close - 1);
+    assertTrue(ranges::all_of(host, icase ? iipv6 : ipv6), PichiError::BAD_PROTO);
+    s.remove_prefix(close + 1);
+  }
+  else
+    host = take(s, s.find_first_of(delimiters));
+  assertFalse(host.empty(), PichiError::BAD_PROTO);
+
+  if (!s.starts_with(':')) return {host, {}};
+  s.remove_prefix(1);
+  auto port = take(s, static_cast<size_t>(ranges::find_if_not(s, digit) - s.begin()));
+  assertFalse(port.empty(), PichiError::BAD_PROTO);
+  return {host, port};
 }
 
 static string_view scheme2port(string_view scheme)
@@ -45,25 +70,36 @@ static string_view scheme2port(string_view scheme)
     fail(PichiError::BAD_PROTO);
 }
 
-Uri::Uri(string_view s)
+Uri::Uri(string_view s) : all_{s}
 {
-  auto r = matching(s, URI_REGEX, URI_REGEX_SIZE);
-
-  all_ = r2sv(r[0]);
-  scheme_ = r2sv(r[1]);
-  host_ = r2sv(r[2]);
-  host_ = r[3].matched ? r2sv(r[3]) : r2sv(r[4]);
-  port_ = r[5].matched ? r2sv(r[6]) : scheme2port(scheme_);
-  suffix_ = r[7].matched ? r2sv(r[7]) : "/"sv;
-  path_ = r[7].matched ? r2sv(r[7], distance(r[7].first, r[8].first)) : "/"sv;
-  query_ = r2sv(r[8]);
+  auto sep = s.find("://"sv);
+  assertFalse(sep == string_view::npos, PichiError::BAD_PROTO);
+  scheme_ = take(s, sep);
+  s.remove_prefix(3);
+
+  auto default_port = scheme2port(scheme_);
+  tie(host_, port_) = authority(s, URI_HOST_DELIMITERS, true);
+  if (port_.empty()) port_ = default_port;
+
+  if (s.empty()) {
+    suffix_ = "/"sv;
+    path_ = "/"sv;
+    return;
+  }
+
+  // The query, or the fragment, lasts until the end without any line terminator
+  assertTrue(s.starts_with('/'), PichiError::BAD_PROTO);
+  suffix_ = s;
+  path_ = take(s, s.find_first_of(QUERY_DELIMITERS));
+  query_ = s;
+  assertTrue(query_.find_first_of("\r\n"sv) == string_view::npos, PichiError::BAD_PROTO);
 }
 
 HostAndPort::HostAndPort(string_view s)
 {
-  auto r = matching(s, HOST_REGEX, HOST_REGEX_SIZE);
-  host_ = r[2].matched ? r2sv(r[2]) : r2sv(r[3]);
-  port_ = r[4].matched ? r2sv(r[5]) : "80"sv;
+  tie(host_, port_) = authority(s, HOST_DELIMITERS, false);
+  assertTrue(s.empty(), PichiError::BAD_PROTO);
+  if (port_.empty()) port_ = "80"sv;
 }
 
 }  // namespace pichi
@@ -1,27 +1,78 @@
 #include "pichi/common/config.hpp"
 #include <boost/asio/co_spawn.hpp>
 #include <boost/asio/io_context.hpp>
+#include <chrono>
 #include <iostream>
 #include <pichi.h>
 #include <pichi/actor/detached.hpp>
 #include <pichi/actor/server.hpp>
 #include <pichi/common/asserts.hpp>
 #include <pichi/service/mmdb.hpp>
+#include <pichi/service/resolver.hpp>
+#include <pichi/service/sentry.hpp>
+#include <pichi/service/workers.hpp>
+#include <pichi/stream/tls_server.hpp>
 
-namespace actor = pichi::actor;
-namespace asio  = boost::asio;
+namespace actor   = pichi::actor;
+namespace asio    = boost::asio;
+namespace service = pichi::service;
+
+using pichi::stream::TlsServerContext;
 
 static asio::io_context io{};
 
+void pichi_init_server_options(pichi_server_options* opts)
+{
+  *opts = {
+      .bind             = nullptr,
+      .port             = 0,
+      .mmdb             = nullptr,
+      .threads          = 1,
+      .replay_window    = static_cast<uint32_t>(service::SaltSentry::DEFAULT_WINDOW.count()),
+      .replay_capacity  = service::SaltSentry::DEFAULT_CAPACITY,
+      .replay_fp        = service::SaltSentry::DEFAULT_FP,
+      .dns_ttl          = static_cast<uint32_t>(service::Resolver::DEFAULT_TTL.count()),
+      .dns_negative_ttl = static_cast<uint32_t>(service::Resolver::DEFAULT_NEGATIVE_TTL.count()),
+      .connect_delay    = static_cast<uint32_t>(service::Resolver::DEFAULT_DELAY.count()),
+      .route_cache      = 0,
+      .ticket_rotation  = static_cast<uint32_t>(TlsServerContext::DEFAULT_ROTATION.count()),
+  };
+}
+
 int pichi_run_server(char const* bind, uint16_t port, char const* mmdb)
+{
+  auto opts = pichi_server_options{};
+  pichi_init_server_options(&opts);
+  opts.bind = bind;
+  opts.port = port;
+  opts.mmdb = mmdb;
+  return pichi_run_server_mt(&opts);
+}
+
+int pichi_run_server_mt(pichi_server_options const* opts)
 {
   try {
-    pichi::assertFalse(bind == nullptr);
+    pichi::assertFalse(opts == nullptr);
+    pichi::assertFalse(opts->bind == nullptr);
+
+    auto workers = service::WorkerPool{io, opts->threads};
 
-    if (mmdb != nullptr) asio::use_service<pichi::service::Mmdb>(io).initialize(mmdb);
+    if (opts->mmdb != nullptr) asio::use_service<service::Mmdb>(io).initialize(opts->mmdb);
+    asio::use_service<service::SaltSentry>(io).configure(
+        std::chrono::seconds{opts->replay_window}, opts->replay_capacity, opts->replay_fp
+    );
+    asio::use_service<service::Resolver>(io).configure(
+        std::chrono::seconds{opts->dns_ttl},
+        std::chrono::seconds{opts->dns_negative_ttl},
+        std::chrono::milliseconds{opts->connect_delay}
+    );
 
-    auto server = actor::Server{io.get_executor()};
-    asio::co_spawn(io, server.serve({asio::ip::make_address(bind), port}), actor::detached);
+    auto server = actor::Server{
+        io.get_executor(), opts->route_cache, std::chrono::seconds{opts->ticket_rotation}
+    };
+    asio::co_spawn(
+        io, server.serve({asio::ip::make_address(opts->bind), opts->port}), actor::detached
+    );
 
     io.run();
     return 0;
@@ -3,6 +3,7 @@
 #include <pichi/common/asserts.hpp>
 #include <pichi/common/literals.hpp>
 #include <pichi/service/balancer.hpp>
+#include <pichi/service/workers.hpp>
 #include <ranges>
 
 namespace asio  = boost::asio;
@@ -52,7 +53,7 @@ Awaitable<void> Service::create(vo::Ingress const& vo)
 
 Service& use_service(IOExecutor const& ex)
 {
-  return asio::use_service<Service>(asio::query(ex, asio::execution::context));
+  return asio::use_service<Service>(asio::query(primary_executor(ex), asio::execution::context));
 }
 
 Random::Random(IOExecutor const& ex, vo::TunnelOption const& opt)
@@ -153,7 +154,7 @@ void Balancer::release(Endpoint const& peer)
 Awaitable<void> create_balancer(IOExecutor const& ex, vo::Ingress const& vo)
 {
   auto& svc = balancer::use_service(ex);
-  svc.initialize(ex);
+  svc.initialize(primary_executor(ex));
   co_await svc.create(vo);
 }
 
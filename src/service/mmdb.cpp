@@ -1,7 +1,11 @@
+#include <boost/asio/ip/tcp.hpp>
 #include <pichi/common/asserts.hpp>
 #include <pichi/service/mmdb.hpp>
+#include <ranges>
 
 namespace asio = boost::asio;
+namespace ip   = asio::ip;
+namespace rngs = std::ranges;
 
 namespace pichi::service {
 
@@ -29,22 +33,80 @@ void Mmdb::shutdown() noexcept
   db_.reset();
 }
 
-bool Mmdb::match(sockaddr const* const endpoint, std::string_view country)
+std::optional<std::string_view> Mmdb::query(ip::address const& address) const
 {
-  if (!db_.has_value()) return false;
+  auto endpoint = ip::tcp::endpoint{address, 0};
+  auto status   = MMDB_SUCCESS;
+  auto result   = MMDB_lookup_sockaddr(std::addressof(*db_), endpoint.data(), &status);
 
-  auto status = MMDB_SUCCESS;
-  auto result = MMDB_lookup_sockaddr(std::addressof(*db_), endpoint, &status);
-
-  if (status != MMDB_SUCCESS || !result.found_entry) return false;
+  if (status != MMDB_SUCCESS || !result.found_entry) return {};
 
   auto entry = MMDB_entry_data_s{};
   status     = MMDB_get_value(&result.entry, &entry, "country", "iso_code", nullptr);
 
-  if (status != MMDB_SUCCESS || !entry.has_data) return false;
+  if (status != MMDB_SUCCESS || !entry.has_data) return {};
   assertTrue(entry.type == MMDB_DATA_TYPE_UTF8_STRING);
 
-  return std::string_view{entry.utf8_string, entry.data_size} == country;
+  return std::string_view{entry.utf8_string, entry.data_size};
+}
+
+Mmdb::Country Mmdb::emplace(std::string_view country)
+{
+  auto it = countries_.find(country);
+  if (it == std::end(countries_))
+    it = countries_.emplace(country, static_cast<Country>(rngs::size(countries_))).first;
+  return it->second;
+}
+
+Mmdb::Country Mmdb::intern(std::string_view country)
+{
+  auto lock = std::scoped_lock{mutex_};
+  return emplace(country);
+}
+
+std::optional<Mmdb::Country> Mmdb::lookup(ip::address const& address)
+{
+  if (!db_.has_value()) return {};
+
+  auto key = Key{};
+  if (address.is_v4()) {
+    key[0] = 4;
+    rngs::copy(address.to_v4().to_bytes(), rngs::begin(key) + 1);
+  }
+  else {
+    key[0] = 6;
+    rngs::copy(address.to_v6().to_bytes(), rngs::begin(key) + 1);
+  }
+
+  auto lock = std::unique_lock{mutex_};
+  if (auto it = index_.find(key); it != std::end(index_)) {
+    ++hits_;
+    lru_.splice(rngs::begin(lru_), lru_, it->second);
+    return it->second->second;
+  }
+  lock.unlock();
+
+  // Looking up the database, which is read-only, needs no locking
+  auto found = query(address);
+
+  lock.lock();
+  ++misses_;
+  auto country = found.has_value() ? std::make_optional(emplace(*found)) : std::nullopt;
+  if (index_.contains(key)) return country;
+
+  if (rngs::size(lru_) >= MAX_ENTRIES) {
+    index_.erase(lru_.back().first);
+    lru_.pop_back();
+  }
+  lru_.emplace_front(key, country);
+  index_.emplace(key, rngs::begin(lru_));
+  return country;
+}
+
+MmdbStats Mmdb::stats()
+{
+  auto lock = std::scoped_lock{mutex_};
+  return {.entries_ = rngs::size(lru_), .hits_ = hits_, .misses_ = misses_};
 }
 
 }  // namespace pichi::service
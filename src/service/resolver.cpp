@@ -0,0 +1,186 @@
+#include "pichi/common/config.hpp"
+#include <algorithm>
+#include <boost/asio/execution/context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/query.hpp>
+#include <iterator>
+#include <string>
+#include <pichi/common/asserts.hpp>
+#include <pichi/service/resolver.hpp>
+#include <pichi/service/workers.hpp>
+#include <ranges>
+
+using namespace std::literals;
+namespace asio  = boost::asio;
+namespace ip    = asio::ip;
+namespace rngs  = std::ranges;
+namespace sys   = boost::system;
+namespace views = std::views;
+
+namespace pichi::service {
+
+Resolver::Waiter::Waiter(IOExecutor const& ex) : timer_{ex, Clock::time_point::max()} {}
+
+Resolver::Resolver(asio::execution_context& ctx)
+  : asio::detail::execution_context_service_base<Resolver>{ctx}
+{
+}
+
+void Resolver::configure(Ttl ttl, Ttl negative, Delay delay)
+{
+  assertTrue(ttl.count() >= 0, PichiError::MISC, "Invalid DNS TTL");
+  assertTrue(negative.count() >= 0, PichiError::MISC, "Invalid DNS negative TTL");
+  assertTrue(delay.count() >= 0, PichiError::MISC, "Invalid connection attempt delay");
+  auto lock = std::scoped_lock{mutex_};
+  ttl_      = ttl;
+  negative_ = negative;
+  delay_    = delay;
+}
+
+void Resolver::evict()
+{
+  if (rngs::size(entries_) < MAX_ENTRIES) return;
+  auto now = Clock::now();
+  std::erase_if(entries_, [now](auto&& p) {
+    return !p.second.pending_ && p.second.expiry_ <= now;
+  });
+  if (rngs::size(entries_) < MAX_ENTRIES) return;
+
+  // Dropping the eighth of the answers expiring soonest at once, rather than one per lookup
+  auto oldest = std::vector<Entries::iterator>{};
+  oldest.reserve(rngs::size(entries_));
+  for (auto it = std::begin(entries_); it != std::end(entries_); ++it)
+    if (!it->second.pending_) oldest.push_back(it);
+  auto n = std::min(rngs::size(oldest), MAX_ENTRIES / 8);
+  rngs::nth_element(oldest, rngs::begin(oldest) + n, rngs::less{}, [](auto&& it) {
+    return it->second.expiry_;
+  });
+  for (auto&& it : oldest | views::take(n)) entries_.erase(it);
+}
+
+// Waking up the first waiter alive to issue the query once more, or false if there's none
+bool Resolver::handover(Entry& entry)
+{
+  auto&& waiters = entry.waiters_;
+  while (!rngs::empty(waiters)) {
+    auto waiter = waiters.front().lock();
+    waiters.erase(rngs::begin(waiters));
+    if (!waiter) continue;
+
+    waiter->retry_ = true;
+    asio::post(waiter->timer_.get_executor(), [waiter]() {
+      waiter->timer_.expires_at(Clock::time_point::min());
+    });
+    return true;
+  }
+  return false;
+}
+
+void Resolver::complete(
+    std::string const& key, sys::error_code const& ec, ResolveResults const& results
+)
+{
+  auto lock = std::scoped_lock{mutex_};
+  auto it   = entries_.find(key);
+  if (it == std::end(entries_)) return;
+
+  // The rest waiters keep waiting for the query issued by the new owner
+  if (ec == asio::error::operation_aborted) {
+    if (!handover(it->second)) entries_.erase(it);
+    return;
+  }
+
+  for (auto&& weak : it->second.waiters_) {
+    if (auto waiter = weak.lock()) {
+      waiter->ec_      = ec;
+      waiter->results_ = results;
+      // Expiring rather than cancelling wakes the waiter even if it hasn't started waiting
+      asio::post(waiter->timer_.get_executor(), [waiter]() {
+        waiter->timer_.expires_at(Clock::time_point::min());
+      });
+    }
+  }
+
+  it->second = Entry{
+      .expiry_  = Clock::now() + (ec ? negative_ : ttl_),
+      .ec_      = ec,
+      .results_ = results,
+  };
+}
+
+Awaitable<ResolveResults>
+    Resolver::query(std::string const& key, std::string const& host, uint16_t port)
+{
+  auto resolver      = ip::tcp::resolver{co_await asio::this_coro::executor};
+  auto [ec, results] = co_await redirect(
+      resolver.async_resolve(host, std::to_string(port), asio::use_awaitable)
+  );
+  complete(key, ec, results.value_or(ResolveResults{}));
+  if (ec) throw sys::system_error{ec};
+  co_return *results;
+}
+
+Awaitable<ResolveResults> Resolver::resolve(std::string const& host, uint16_t port)
+{
+  auto ex   = co_await asio::this_coro::executor;
+  auto key  = host + ":"s + std::to_string(port);
+  auto lock = std::unique_lock{mutex_};
+  auto it   = entries_.find(key);
+
+  if (it != std::end(entries_) && it->second.pending_) {
+    ++hits_;
+    auto waiter = std::make_shared<Waiter>(ex);
+    it->second.waiters_.push_back(waiter);
+    lock.unlock();
+
+    // Woken up once the pending query completes
+    auto ignored = sys::error_code{};
+    co_await redirect(waiter->timer_.async_wait(asio::use_awaitable), ignored);
+    if (waiter->retry_) co_return co_await query(key, host, port);
+    if (waiter->ec_) throw sys::system_error{waiter->ec_};
+    co_return waiter->results_;
+  }
+
+  if (it != std::end(entries_) && Clock::now() < it->second.expiry_) {
+    ++hits_;
+    auto ec      = it->second.ec_;
+    auto results = it->second.results_;
+    lock.unlock();
+    if (ec) throw sys::system_error{ec};
+    co_return results;
+  }
+
+  ++misses_;
+  evict();
+  entries_.insert_or_assign(key, Entry{.pending_ = true});
+  lock.unlock();
+
+  co_return co_await query(key, host, port);
+}
+
+void Resolver::clear()
+{
+  auto lock = std::scoped_lock{mutex_};
+  std::erase_if(entries_, [](auto&& p) { return !p.second.pending_; });
+}
+
+ResolverStats Resolver::stats()
+{
+  auto lock = std::scoped_lock{mutex_};
+  return {.entries_ = rngs::size(entries_), .hits_ = hits_, .misses_ = misses_};
+}
+
+Resolver::Delay Resolver::delay()
+{
+  auto lock = std::scoped_lock{mutex_};
+  return delay_;
+}
+
+void Resolver::shutdown() noexcept { entries_.clear(); }
+
+Resolver& get_resolver(IOExecutor const& ex)
+{
+  return asio::use_service<Resolver>(asio::query(primary_executor(ex), asio::execution::context));
+}
+
+}  // namespace pichi::service
@@ -1,77 +1,147 @@
 #include "pichi/common/config.hpp"
-#include <botan/hex.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <botan/sodium.h>
+#include <cmath>
+#include <numbers>
 #include <pichi/actor/detached.hpp>
+#include <pichi/common/asserts.hpp>
+#include <pichi/common/literals.hpp>
 #include <pichi/service/sentry.hpp>
+#include <pichi/service/workers.hpp>
+#include <utility>
 
 using namespace std::literals;
 namespace asio = boost::asio;
+namespace rngs = std::ranges;
 namespace sys  = boost::system;
 
 namespace pichi::service {
 
+static auto const WORD_BITS = 64_sz;
+
 SaltSentry::SaltSentry(asio::execution_context& ctx)
   : asio::detail::execution_context_service_base<SaltSentry>{ctx}
 {
 }
 
+void SaltSentry::configure(Window window, size_t capacity, double fp)
+{
+  assertTrue(window.count() > 0, PichiError::MISC, "Invalid replay window");
+  assertTrue(capacity > 0, PichiError::MISC, "Invalid replay capacity");
+  assertTrue(fp > 0.0 && fp < 1.0, PichiError::MISC, "Invalid false-positive rate");
+  window_   = window;
+  capacity_ = capacity;
+  fp_       = fp;
+}
+
 void SaltSentry::initialize(IOExecutor const& ex)
 {
   std::call_once(
       flag_,
       [this](auto&& ex) {
-        strand_ = asio::make_strand(ex);
-        timer_  = asio::system_timer{ex};
+        // The optimal bloom filter: m = -n * ln(p) / ln(2)^2, k = m / n * ln(2)
+        auto ln2  = std::numbers::ln2;
+        auto bits = std::ceil(-static_cast<double>(capacity_) * std::log(fp_) / (ln2 * ln2));
+        auto size = (static_cast<size_t>(bits) + WORD_BITS - 1) / WORD_BITS;
+        auto k    = std::round(static_cast<double>(size * WORD_BITS) / capacity_ * ln2);
+        hashes_   = std::max(static_cast<size_t>(k), 1_sz);
+        expiring_.assign(size, 0);
+        active_.assign(size, 0);
+
+        auto key = std::array<uint8_t, 16>{};
+        Botan::Sodium::randombytes_buf(rngs::data(key), rngs::size(key));
+        mac_ = Botan::MessageAuthenticationCode::create_or_throw("SipHash(2,4)");
+        mac_->set_key(key);
+
+        timer_ = asio::system_timer{ex};
         asio::co_spawn(ex, run(), actor::detached);
       },
       ex
   );
 }
 
-void SaltSentry::cancel()
-{
-  timer_.reset();
-  strand_.reset();
-}
+void SaltSentry::cancel() { timer_.reset(); }
 
 Awaitable<void> SaltSentry::run()
 {
   auto ec = sys::error_code{};
   while (true) {
-    // TODO Adjust how long it expires
-    timer_->expires_after(600s);
+    timer_->expires_after(window_);
     co_await redirect(timer_->async_wait(asio::use_awaitable), ec);
     if (ec) break;
-    co_await switch_to(*strand_);
-    expiring_ = std::move(active_);
+
+    auto lock = std::scoped_lock{mutex_};
+    std::swap(expiring_, active_);
+    rngs::fill(active_, 0);
+    expiring_size_ = std::exchange(active_size_, 0);
   }
   if (ec != asio::error::operation_aborted) asio::detail::throw_error(ec);
 }
 
-Awaitable<bool> SaltSentry::contains(ConstBuffer salt)
+bool SaltSentry::contains(ConstBuffer salt)
 {
-  co_await switch_to(*strand_);
-  auto [it, inserted] = active_.insert(Botan::hex_encode(salt));
-  co_return !inserted || expiring_.contains(*it);
+  auto digest = std::array<uint8_t, 8>{};
+  auto lock   = std::scoped_lock{mutex_};
+
+  mac_->update(salt);
+  mac_->final(digest);
+
+  // Double hashing: the i-th bit is h1 + i * h2, where h2 is odd to cover all words
+  auto h1 = std::bit_cast<uint64_t>(digest);
+  auto h2 = std::rotl(h1, 32) | 1;
+  auto m  = rngs::size(active_) * WORD_BITS;
+
+  auto in_active   = true;
+  auto in_expiring = true;
+  for (auto i = 0_sz; i < hashes_; ++i) {
+    auto bit  = (h1 + i * h2) % m;
+    auto word = bit / WORD_BITS;
+    auto mask = uint64_t{1} << (bit % WORD_BITS);
+    in_active &= (active_[word] & mask) != 0;
+    in_expiring &= (expiring_[word] & mask) != 0;
+    active_[word] |= mask;
+  }
+  if (!in_active) ++active_size_;
+  return in_active || in_expiring;
 }
 
-Awaitable<void> SaltSentry::reset()
+void SaltSentry::reset()
 {
-  co_await switch_to(*strand_);
-  expiring_.clear();
-  active_.clear();
+  auto lock = std::scoped_lock{mutex_};
+  rngs::fill(expiring_, 0);
+  rngs::fill(active_, 0);
+  expiring_size_ = 0;
+  active_size_   = 0;
 }
 
-void SaltSentry::shutdown() noexcept
+SaltSentryStats SaltSentry::stats()
 {
-  timer_.reset();
-  strand_.reset();
+  auto lock = std::scoped_lock{mutex_};
+  return {
+      .capacity_ = capacity_,
+      .active_   = active_size_,
+      .expiring_ = expiring_size_,
+      .bytes_    = (rngs::size(active_) + rngs::size(expiring_)) * sizeof(uint64_t),
+  };
 }
 
+void SaltSentry::shutdown() noexcept { timer_.reset(); }
+
 SaltSentry& get_sentry(IOExecutor const& ex)
 {
-  auto&& sentry = asio::use_service<SaltSentry>(asio::query(ex, asio::execution::context));
-  sentry.initialize(ex);
+  auto primary  = primary_executor(ex);
+  auto&& sentry = asio::use_service<SaltSentry>(asio::query(primary, asio::execution::context));
+  sentry.initialize(primary);
   return sentry;
 }
 
+SaltSentryStats sentry_stats(IOExecutor const& ex)
+{
+  // No need to initialize the sentry, which is not used if there's no shadowsocks ingress
+  auto primary = primary_executor(ex);
+  return asio::use_service<SaltSentry>(asio::query(primary, asio::execution::context)).stats();
+}
+
 }  // namespace pichi::service
@@ -0,0 +1,79 @@
+#include "pichi/common/config.hpp"
+#include <algorithm>
+#include <boost/asio/execution/context.hpp>
+#include <boost/asio/query.hpp>
+#include <iterator>
+#include <pichi/common/literals.hpp>
+#include <pichi/service/workers.hpp>
+#include <ranges>
+
+namespace asio = boost::asio;
+namespace rngs = std::ranges;
+
+namespace pichi::service {
+
+static Workers& get_workers(IOExecutor const& ex)
+{
+  return asio::use_service<Workers>(asio::query(ex, asio::execution::context));
+}
+
+Workers::Workers(asio::execution_context& ctx)
+  : asio::detail::execution_context_service_base<Workers>{ctx}
+{
+}
+
+void Workers::shutdown() noexcept
+{
+  executors_.clear();
+  primary_.reset();
+}
+
+void Workers::attach(IOExecutor const& worker) { executors_.push_back(worker); }
+
+void Workers::bind(IOExecutor const& primary) { primary_ = primary; }
+
+Workers::Primary const& Workers::primary() const { return primary_; }
+
+Workers::Executors const& Workers::executors() const { return executors_; }
+
+WorkerPool::WorkerPool(Context& primary, size_t threads)
+{
+  if (threads < 2) return;
+
+  attach_worker(primary.get_executor(), primary.get_executor());
+  for (auto i = 1_sz; i < threads; ++i) {
+    auto& ctx = *contexts_.emplace_back(std::make_unique<Context>(1));
+    guards_.emplace_back(ctx.get_executor());
+    attach_worker(primary.get_executor(), ctx.get_executor());
+  }
+  rngs::transform(contexts_, std::back_inserter(threads_), [](auto&& ctx) {
+    return std::thread{[ctx = ctx.get()]() { ctx->run(); }};
+  });
+}
+
+WorkerPool::~WorkerPool()
+{
+  guards_.clear();
+  rngs::for_each(contexts_, [](auto&& ctx) { ctx->stop(); });
+  rngs::for_each(threads_, [](auto&& thread) { thread.join(); });
+}
+
+void attach_worker(IOExecutor const& primary, IOExecutor const& worker)
+{
+  get_workers(primary).attach(worker);
+  get_workers(worker).bind(primary);
+}
+
+IOExecutor primary_executor(IOExecutor const& ex)
+{
+  auto const& primary = get_workers(ex).primary();
+  return primary.has_value() ? *primary : ex;
+}
+
+std::vector<IOExecutor> worker_executors(IOExecutor const& ex)
+{
+  auto const& executors = get_workers(primary_executor(ex)).executors();
+  return rngs::empty(executors) ? std::vector<IOExecutor>{ex} : executors;
+}
+
+}  // namespace pichi::service
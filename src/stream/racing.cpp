@@ -0,0 +1,122 @@
+#include "pichi/common/config.hpp"
+#include <boost/asio/detached.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/system/system_error.hpp>
+#include <memory>
+#include <optional>
+#include <pichi/stream/racing.hpp>
+#include <ranges>
+#include <vector>
+
+namespace asio = boost::asio;
+namespace rngs = std::ranges;
+namespace sys  = boost::system;
+
+using asio::ip::tcp;
+
+namespace pichi::stream {
+
+using Endpoints = std::vector<tcp::endpoint>;
+
+struct Race {
+  Race(IOExecutor const& ex, size_t n) : signal_{ex}
+  {
+    sockets_.reserve(n);
+    for (auto i = size_t{0}; i < n; ++i) sockets_.emplace_back(ex);
+  }
+
+  // Cancelled by the attempts to notify their completions
+  asio::steady_timer       signal_;
+  std::vector<tcp::socket> sockets_  = {};
+  size_t                   pending_  = 0;
+  size_t                   failures_ = 0;
+  std::optional<size_t>    winner_   = {};
+  sys::error_code          ec_       = asio::error::host_not_found;
+};
+
+// Alternate the address families, starting with the preferred family of the first address
+static Endpoints interleave(tcp::resolver::results_type const& results)
+{
+  auto preferred = Endpoints{};
+  auto others    = Endpoints{};
+  for (auto&& entry : results) {
+    auto endpoint = entry.endpoint();
+    auto same = rngs::empty(preferred) || preferred.front().protocol() == endpoint.protocol();
+    (same ? preferred : others).push_back(endpoint);
+  }
+
+  auto ret = Endpoints{};
+  ret.reserve(rngs::size(preferred) + rngs::size(others));
+  for (auto i = size_t{0}; i < rngs::size(preferred) || i < rngs::size(others); ++i) {
+    if (i < rngs::size(preferred)) ret.push_back(preferred[i]);
+    if (i < rngs::size(others)) ret.push_back(others[i]);
+  }
+  return ret;
+}
+
+static Awaitable<void> attempt(std::shared_ptr<Race> race, size_t i, tcp::endpoint endpoint)
+{
+  auto& socket = race->sockets_[i];
+  auto  ec     = sys::error_code{};
+  co_await redirect(socket.async_connect(endpoint, asio::use_awaitable), ec);
+
+  --race->pending_;
+  if (ec) {
+    ++race->failures_;
+    // The attempts cancelled by the winner don't count
+    if (!race->winner_.has_value()) race->ec_ = ec;
+  }
+  else if (race->winner_.has_value()) {
+    socket.close(ec);
+  }
+  else {
+    race->winner_ = i;
+  }
+  race->signal_.cancel();
+}
+
+Awaitable<void> race(
+    tcp::socket& s, tcp::resolver::results_type const& results, std::chrono::milliseconds delay
+)
+{
+  auto endpoints = interleave(results);
+  if (rngs::size(endpoints) <= 1) {
+    if (rngs::empty(endpoints)) throw sys::system_error{asio::error::host_not_found};
+    co_await s.async_connect(endpoints.front(), asio::use_awaitable);
+    co_return;
+  }
+
+  auto ex      = s.get_executor();
+  auto state   = std::make_shared<Race>(ex, rngs::size(endpoints));
+  auto ignored = sys::error_code{};
+  auto wait    = [&]() {
+    return redirect(state->signal_.async_wait(asio::use_awaitable), ignored);
+  };
+
+  for (auto i = size_t{0}; i < rngs::size(endpoints) && !state->winner_.has_value(); ++i) {
+    ++state->pending_;
+    asio::co_spawn(ex, attempt(state, i, endpoints[i]), asio::detached);
+    if (i + 1 == rngs::size(endpoints)) break;
+
+    // Start the next attempt once the delay elapses or any attempt fails
+    auto failures = state->failures_;
+    state->signal_.expires_after(delay);
+    while (!state->winner_.has_value() && failures == state->failures_ &&
+           asio::steady_timer::clock_type::now() < state->signal_.expiry())
+      co_await wait();
+  }
+
+  while (!state->winner_.has_value() && state->pending_ > 0) {
+    state->signal_.expires_at(asio::steady_timer::time_point::max());
+    co_await wait();
+  }
+
+  if (!state->winner_.has_value()) throw sys::system_error{state->ec_};
+
+  for (auto i = size_t{0}; i < rngs::size(state->sockets_); ++i)
+    if (i != *state->winner_) state->sockets_[i].close(ignored);
+  s = std::move(state->sockets_[*state->winner_]);
+}
+
+}  // namespace pichi::stream
@@ -1,13 +1,14 @@
 #include <botan/hash.h>
 #include <botan/kdf.h>
 #include <botan/sodium.h>
+#include <pichi/common/asserts.hpp>
 #include <pichi/common/literals.hpp>
 #include <pichi/stream/shadowsocks.hpp>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
 
 using namespace std::literals;
-namespace asio  = boost::asio;
 namespace rngs  = std::ranges;
 namespace views = rngs::views;
 
@@ -45,59 +46,149 @@ static auto random_salt(CryptoMethod method)
   return salt;
 }
 
-static auto generate_psk(ConstBuffer pw, MutableBuffer data, size_t size)
+static auto generate_psk(Botan::HashFunction& md5, ConstBuffer pw, size_t size)
 {
-  auto psk = MutableBuffer{data, size};
+  auto psk = std::vector<uint8_t>(size + md5.output_length(), 0_u8);
+  auto len = md5.output_length();
 
   auto tmp = ConstBuffer{};
-  for (auto i = 0_sz; i < size; i += rngs::size(tmp)) {
-    auto md5 = Botan::HashFunction::create_or_throw("MD5");
-    auto len = md5->output_length();
-
-    md5->update(tmp);
-    md5->update(pw);
-    md5->final(data);
-
+  for (auto data = MutableBuffer{psk}; rngs::size(data) > len; data += len) {
+    md5.update(tmp);
+    md5.update(pw);
+    md5.final(data);
     tmp = {data, len};
-    data += len;
   }
 
+  psk.resize(size);
   return psk;
 }
 
+// Cryptors might be destroyed after the pool of the thread is destroyed, such as the ones held by
+// the coroutines which are destroyed along with a static io_context.
+static thread_local auto destroyed = false;
+
+/*
+ * CryptoPool holds the crypto objects reused by all connections of the current thread, including
+ * the KDF and the idle ciphers. The master keys are derived by the ingresses and egresses instead.
+ */
+class CryptoPool {
+private:
+  using Cipher  = std::unique_ptr<Botan::Cipher_Mode>;
+  using Ciphers = std::vector<Cipher>;
+  using Key     = std::pair<CryptoMethod, Botan::Cipher_Dir>;
+
+  struct KeyHash {
+    size_t operator()(Key const& key) const
+    {
+      return static_cast<size_t>(key.first) * 2 + static_cast<size_t>(key.second);
+    }
+  };
+
+public:
+  ~CryptoPool() { destroyed = true; }
+
+  Botan::KDF const& kdf() const { return *kdf_; }
+
+  Cipher borrow(CryptoMethod method, Botan::Cipher_Dir direction)
+  {
+    auto& idle = idle_[{method, direction}];
+    if (rngs::empty(idle)) {
+      ++stats_.misses_;
+      return Botan::Cipher_Mode::create_or_throw(ALGO_MAP.at(method), direction);
+    }
+
+    ++stats_.hits_;
+    auto ret = std::move(idle.back());
+    idle.pop_back();
+    return ret;
+  }
+
+  void giveback(CryptoMethod method, Botan::Cipher_Dir direction, Cipher cipher)
+  {
+    auto& idle = idle_[{method, direction}];
+    if (rngs::size(idle) >= MAX_IDLE) return;
+
+    // Dropping the key, so that no one is able to use it without setting a new one
+    cipher->clear();
+    idle.push_back(std::move(cipher));
+  }
+
+  CryptoPoolStats stats() const
+  {
+    auto ret  = stats_;
+    ret.idle_ = 0;
+    for (auto&& [_, idle] : idle_) ret.idle_ += rngs::size(idle);
+    return ret;
+  }
+
+private:
+  std::unique_ptr<Botan::KDF> kdf_ = Botan::KDF::create_or_throw("HKDF(SHA-1)");
+
+  std::unordered_map<Key, Ciphers, KeyHash> idle_  = {};
+  CryptoPoolStats                           stats_ = {};
+};
+
+static thread_local auto pool = CryptoPool{};
+
 Cryptor::Cryptor(CryptoMethod method, Botan::Cipher_Dir direction)
-  : cryptor_{Botan::Cipher_Mode::create_or_throw(ALGO_MAP.at(method), direction)},
+  : method_{method},
+    direction_{direction},
+    cryptor_{
+        destroyed ? Botan::Cipher_Mode::create_or_throw(ALGO_MAP.at(method), direction)
+                  : pool.borrow(method, direction)
+    },
     nonce_(NONCE_SIZE.at(method), 0_u8)
 {
+  // Reserving the capacity makes Cipher_Mode::finish free from the allocation
+  tag_.reserve(cryptor_->tag_size());
+}
+
+Cryptor::~Cryptor() { giveback(); }
+
+Cryptor& Cryptor::operator=(Cryptor&& other)
+{
+  if (this == &other) return *this;
+
+  giveback();
+  method_    = other.method_;
+  direction_ = other.direction_;
+  cryptor_   = std::move(other.cryptor_);
+  nonce_     = std::move(other.nonce_);
+  tag_       = std::move(other.tag_);
+  return *this;
+}
+
+void Cryptor::giveback()
+{
+  if (cryptor_ && !destroyed) pool.giveback(method_, direction_, std::move(cryptor_));
 }
 
-void Cryptor::set_psk(ConstBuffer pw, ConstBuffer salt)
+void Cryptor::set_psk(ConstBuffer key, ConstBuffer salt)
 {
-  auto data = std::array<uint8_t, 1024>{};
-  auto psk  = generate_psk(pw, data, rngs::size(salt));
+  // No handshake is able to happen while the thread is exiting
+  assertFalse(destroyed);
   cryptor_->set_key(
-      Botan::KDF::create_or_throw("HKDF(SHA-1)")
-          ->derive_key(rngs::size(salt), psk, salt, ConstBuffer{"ss-subkey"sv})
+      pool.kdf().derive_key(rngs::size(salt), key, salt, ConstBuffer{"ss-subkey"sv})
   );
 }
 
 size_t Cryptor::process(ConstBuffer orig, MutableBuffer dest)
 {
   auto n = rngs::size(orig) - cryptor_->minimum_final_size();
-  rngs::copy(orig | views::take(n), rngs::begin(dest));
+  if (rngs::data(orig) != rngs::data(dest)) rngs::copy(orig | views::take(n), rngs::begin(dest));
   cryptor_->start(nonce_);
   cryptor_->process(dest | views::take(n));
 
   auto v = orig | views::drop(n);
-  auto t = std::vector<uint8_t>{rngs::begin(v), rngs::end(v)};
-  cryptor_->finish(t);
-  rngs::copy(t, rngs::begin(dest | views::drop(n)));
+  tag_.assign(rngs::begin(v), rngs::end(v));
+  cryptor_->finish(tag_);
+  rngs::copy(tag_, rngs::begin(dest | views::drop(n)));
 
   Botan::Sodium::sodium_increment(rngs::data(nonce_), rngs::size(nonce_));
-  return n + rngs::size(t);
+  return n + rngs::size(tag_);
 }
 
-Encryptor::Encryptor(CryptoMethod method, ConstBuffer pw, ConstBuffer salt)
+Encryptor::Encryptor(CryptoMethod method, ConstBuffer key, ConstBuffer salt)
 : cryptor_{method, Botan::Cipher_Dir::Encryption},
   salt_{
     rngs::empty(salt) ?
@@ -105,7 +196,7 @@ Encryptor::Encryptor(CryptoMethod method, ConstBuffer pw, ConstBuffer salt)
     std::vector<uint8_t>{rngs::begin(salt), rngs::end(salt)}
   }
 {
-  cryptor_.set_psk(pw, salt_);
+  cryptor_.set_psk(key, salt_);
 }
 
 ConstBuffer Encryptor::salt() const { return salt_; }
@@ -123,32 +214,27 @@ Decryptor::Decryptor(CryptoMethod method)
 
 MutableBuffer Decryptor::salt() { return salt_; }
 
-void Decryptor::set_psk(ConstBuffer pw)
-{
-  cryptor_.set_psk(pw, salt_);
-  salt_.clear();
-}
+void Decryptor::drop_salt() { salt_.clear(); }
+
+void Decryptor::set_psk(ConstBuffer key) { cryptor_.set_psk(key, salt_); }
 
 size_t Decryptor::process(ConstBuffer cipher, MutableBuffer plain)
 {
   return cryptor_.process(cipher, plain);
 }
 
-bool Cache::empty() const { return data_.size() == 0; };
+CryptoPoolStats crypto_pool_stats() { return destroyed ? CryptoPoolStats{} : pool.stats(); }
 
-size_t Cache::copy(MutableBuffer dst)
-{
-  auto n = asio::buffer_copy(asio::buffer(rngs::data(dst), rngs::size(dst)), data_.cdata());
-  data_.consume(n);
-  return n;
-}
+}  // namespace pichi::stream::detail
 
-MutableBuffer Cache::prepare(MutableBuffer provided, size_t n)
+namespace pichi::stream {
+
+MasterKey derive_master_key(CryptoMethod method, ConstBuffer pw)
 {
-  if (n <= rngs::size(provided)) return {provided, n};
-  auto buf = data_.prepare(n);
-  data_.commit(n);
-  return buf;
+  auto md5 = Botan::HashFunction::create_or_throw("MD5");
+  return std::make_shared<std::vector<uint8_t> const>(
+      detail::generate_psk(*md5, pw, detail::KEY_SIZE.at(method))
+  );
 }
 
-}  // namespace pichi::stream::detail
+}  // namespace pichi::stream
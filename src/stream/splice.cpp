@@ -0,0 +1,75 @@
+#include "pichi/common/config.hpp"
+#include <pichi/stream/splice.hpp>
+
+#ifdef HAS_SPLICE
+
+#include <boost/asio/error.hpp>
+#include <boost/system/system_error.hpp>
+#include <pichi/common/asserts.hpp>
+
+extern "C" {
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+}
+
+namespace asio = boost::asio;
+namespace sys  = boost::system;
+
+using asio::ip::tcp;
+
+namespace pichi::stream {
+
+static size_t const       CHUNK_SIZE = 0x10000;
+static unsigned int const FLAGS      = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+
+class Pipe {
+public:
+  Pipe() { assertSuccess(::pipe2(fds_, O_NONBLOCK | O_CLOEXEC)); }
+
+  ~Pipe()
+  {
+    ::close(fds_[0]);
+    ::close(fds_[1]);
+  }
+
+  Pipe(Pipe const&)            = delete;
+  Pipe& operator=(Pipe const&) = delete;
+
+  int in() const { return fds_[1]; }
+  int out() const { return fds_[0]; }
+
+private:
+  int fds_[2] = {-1, -1};
+};
+
+Awaitable<void> splice(tcp::socket& from, tcp::socket& to)
+{
+  auto pipe = Pipe{};
+  from.native_non_blocking(true);
+  to.native_non_blocking(true);
+
+  while (true) {
+    co_await from.async_wait(tcp::socket::wait_read, asio::use_awaitable);
+    auto n = ::splice(from.native_handle(), nullptr, pipe.in(), nullptr, CHUNK_SIZE, FLAGS);
+    if (n == 0) throw sys::system_error{asio::error::eof};
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EINTR) continue;
+      failWithErrno();
+    }
+
+    while (n > 0) {
+      auto m = ::splice(pipe.out(), nullptr, to.native_handle(), nullptr, n, FLAGS);
+      if (m >= 0)
+        n -= m;
+      else if (errno == EAGAIN || errno == EINTR)
+        co_await to.async_wait(tcp::socket::wait_write, asio::use_awaitable);
+      else
+        failWithErrno();
+    }
+  }
+}
+
+}  // namespace pichi::stream
+
+#endif  // HAS_SPLICE
@@ -1,5 +1,14 @@
 #include "pichi/common/config.hpp"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <pichi/common/asserts.hpp>
+#include <pichi/common/literals.hpp>
 #include <pichi/stream/tls.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <boost/version.hpp>
 #if BOOST_VERSION >= 107300
@@ -12,7 +21,6 @@
 #include <array>
 #include <brotli/decode.h>
 #include <brotli/encode.h>
-#include <pichi/common/literals.hpp>
 #endif  // TLS_FINGERPRINT
 
 namespace asio = boost::asio;
@@ -20,6 +28,161 @@ namespace ssl  = asio::ssl;
 
 namespace pichi::stream {
 
+/*
+ * The client sessions of one egress context, which are all established with the same server. The
+ * latest few resumable sessions are queued, and each one of TLS 1.3 is taken out by the handshake
+ * offering it, since its ticket is meant to be used once (RFC 8446 C.4). The sessions of TLS 1.2
+ * are left in the queue to be reused.
+ */
+struct SessionCache {
+  using Session = std::unique_ptr<::SSL_SESSION, decltype(&::SSL_SESSION_free)>;
+
+  static constexpr size_t MAX_SESSIONS = 8;
+
+  std::mutex          mutex_      = {};
+  std::deque<Session> sessions_   = {};
+  std::atomic<size_t> handshakes_ = 0;
+  std::atomic<size_t> resumed_    = 0;
+};
+
+static void free_cache(void*, void* ptr, ::CRYPTO_EX_DATA*, int, long, void*)
+{
+  delete static_cast<SessionCache*>(ptr);
+}
+
+static int cache_index()
+{
+  static auto const INDEX = ::SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, &free_cache);
+  return INDEX;
+}
+
+static SessionCache* get_cache(::SSL_CTX* ctx)
+{
+  return static_cast<SessionCache*>(::SSL_CTX_get_ex_data(ctx, cache_index()));
+}
+
+/*
+ * OpenSSL marks the session of a connection unresumable once the connection is freed without
+ * close_notify, which is quite common for a proxy, so that the cached session is never shared with
+ * any connection. The sessions of BoringSSL are immutable, whose references are enough.
+ */
+static SessionCache::Session copy_session(::SSL_SESSION* session)
+{
+#ifdef TLS_FINGERPRINT
+  ::SSL_SESSION_up_ref(session);
+  return {session, &::SSL_SESSION_free};
+#else   // TLS_FINGERPRINT
+  return {::SSL_SESSION_dup(session), &::SSL_SESSION_free};
+#endif  // TLS_FINGERPRINT
+}
+
+static int store_session(::SSL* ssl, ::SSL_SESSION* session)
+{
+  auto cache = get_cache(::SSL_get_SSL_CTX(ssl));
+  if (cache == nullptr || ::SSL_SESSION_is_resumable(session) == 0) return 0;
+
+  auto copy = copy_session(session);
+  if (!copy) return 0;
+
+  auto lock = std::scoped_lock{cache->mutex_};
+  cache->sessions_.push_back(std::move(copy));
+  if (cache->sessions_.size() > SessionCache::MAX_SESSIONS) cache->sessions_.pop_front();
+  return 0;
+}
+
+static void count_handshake(::SSL const* ssl, int where, int)
+{
+  if ((where & SSL_CB_HANDSHAKE_DONE) == 0) return;
+  auto cache = get_cache(::SSL_get_SSL_CTX(ssl));
+  if (cache == nullptr) return;
+  ++cache->handshakes_;
+  if (::SSL_session_reused(const_cast<::SSL*>(ssl)) == 1) ++cache->resumed_;
+}
+
+static void enable_resumption(::SSL_CTX* ctx)
+{
+  assertTrue(::SSL_CTX_set_ex_data(ctx, cache_index(), new SessionCache{}) == 1);
+  ::SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  ::SSL_CTX_sess_set_new_cb(ctx, &store_session);
+  ::SSL_CTX_set_info_callback(ctx, &count_handshake);
+}
+
+void resume_session(::SSL* ssl)
+{
+  auto cache = get_cache(::SSL_get_SSL_CTX(ssl));
+  if (cache == nullptr) return;
+
+  // The latest session is the least likely to have expired
+  auto lock = std::unique_lock{cache->mutex_};
+  if (cache->sessions_.empty()) return;
+  auto&& latest = cache->sessions_.back();
+  auto   copy   = SessionCache::Session{nullptr, &::SSL_SESSION_free};
+  if (::SSL_SESSION_get_protocol_version(latest.get()) >= TLS1_3_VERSION) {
+    copy = std::move(latest);
+    cache->sessions_.pop_back();
+  }
+  else
+    copy = copy_session(latest.get());
+  lock.unlock();
+
+  // The connection takes its own reference
+  if (copy) ::SSL_set_session(ssl, copy.get());
+}
+
+TlsStats tls_stats(ssl::context& ctx)
+{
+  auto cache = get_cache(ctx.native_handle());
+  if (cache == nullptr) return {};
+  return {.handshakes_ = cache->handshakes_, .resumed_ = cache->resumed_};
+}
+
+static void free_protocols(void*, void* ptr, ::CRYPTO_EX_DATA*, int, long, void*)
+{
+  delete static_cast<std::string*>(ptr);
+}
+
+static int protocols_index()
+{
+  static auto const INDEX =
+      ::SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, &free_protocols);
+  return INDEX;
+}
+
+// The length prefixed protocol at the offset of the wire format
+static std::string_view protocol_at(std::string_view protocols, size_t offset)
+{
+  return protocols.substr(offset, static_cast<uint8_t>(protocols[offset]) + 1_sz);
+}
+
+// Pick the first protocol of the server preference offered by the client
+static int select_protocol(
+    ::SSL*, uint8_t const** out, uint8_t* outlen, uint8_t const* in, unsigned inlen, void* arg
+)
+{
+  auto protocols = std::string_view{*static_cast<std::string*>(arg)};
+  auto offered   = std::string_view{reinterpret_cast<char const*>(in), inlen};
+  for (auto i = 0_sz; i < protocols.size(); i += protocol_at(protocols, i).size()) {
+    for (auto j = 0_sz; j < offered.size(); j += protocol_at(offered, j).size()) {
+      if (protocol_at(offered, j) != protocol_at(protocols, i)) continue;
+      *out    = in + j + 1;
+      *outlen = in[j];
+      return SSL_TLSEXT_ERR_OK;
+    }
+  }
+  return SSL_TLSEXT_ERR_NOACK;
+}
+
+static void enable_alpn(::SSL_CTX* ctx, std::vector<std::string> const& alpn)
+{
+  auto protocols = new std::string{};
+  for (auto&& protocol : alpn) {
+    protocols->push_back(static_cast<char>(protocol.size()));
+    protocols->append(protocol);
+  }
+  assertTrue(::SSL_CTX_set_ex_data(ctx, protocols_index(), protocols) == 1);
+  ::SSL_CTX_set_alpn_select_cb(ctx, &select_protocol, protocols);
+}
+
 #ifdef TLS_FINGERPRINT
 
 void setup_fingerprint(::SSL* ssl)
@@ -132,6 +295,7 @@ ssl::context tls_context(vo::TlsIngressOption const& opt)
   auto ctx = ssl::context{ssl::context::tls_server};
   ctx.use_certificate_chain_file(opt.certFile_);
   ctx.use_private_key_file(opt.keyFile_, ssl::context::pem);
+  if (!opt.alpn_.empty()) enable_alpn(ctx.native_handle(), opt.alpn_);
 
 #ifdef TLS_FINGERPRINT
   ::SSL_CTX_add_cert_compression_alg(
@@ -148,6 +312,7 @@ ssl::context tls_context(vo::TlsIngressOption const& opt)
 ssl::context tls_context(vo::TlsEgressOption const& opt, std::string const& sn)
 {
   auto ctx = ssl::context{ssl::context::tls_client};
+  enable_resumption(ctx.native_handle());
 
 #ifdef TLS_FINGERPRINT
   setup_fingerprint(ctx.native_handle());
@@ -0,0 +1,234 @@
+#include "pichi/common/config.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <optional>
+#include <pichi/common/asserts.hpp>
+#include <pichi/stream/tls.hpp>
+#include <pichi/stream/tls_server.hpp>
+#include <span>
+#include <stdint.h>
+#include <system_error>
+#include <utility>
+
+#ifdef TLS_FINGERPRINT
+#include <openssl/hmac.h>
+#else   // TLS_FINGERPRINT
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif  // TLS_FINGERPRINT
+
+namespace fs   = std::filesystem;
+namespace rngs = std::ranges;
+namespace ssl  = boost::asio::ssl;
+
+namespace pichi::stream {
+
+#ifdef TLS_FINGERPRINT
+using MacContext = ::HMAC_CTX;
+#else   // TLS_FINGERPRINT
+using MacContext = ::EVP_MAC_CTX;
+#endif  // TLS_FINGERPRINT
+
+struct TicketKey {
+  std::array<uint8_t, 16> name_ = {};
+  std::array<uint8_t, 32> aes_  = {};
+  std::array<uint8_t, 32> hmac_ = {};
+};
+
+static void random_bytes(uint8_t* buf, size_t size)
+{
+  assertTrue(::RAND_bytes(buf, static_cast<int>(size)) == 1, PichiError::CRYPTO_ERROR);
+}
+
+static TicketKey generate_key()
+{
+  auto key = TicketKey{};
+  random_bytes(key.name_.data(), key.name_.size());
+  random_bytes(key.aes_.data(), key.aes_.size());
+  random_bytes(key.hmac_.data(), key.hmac_.size());
+  return key;
+}
+
+// Shared by all contexts built by the same TlsServerContext
+struct SessionTickets {
+  using Clock   = std::chrono::steady_clock;
+  using Seconds = std::chrono::seconds;
+
+  Seconds           rotation_;
+  Clock::time_point rotated_ = Clock::now();
+
+  std::mutex               mutex_    = {};
+  TicketKey                current_  = generate_key();
+  std::optional<TicketKey> previous_ = {};
+
+  std::atomic<size_t> handshakes_ = 0;
+  std::atomic<size_t> resumed_    = 0;
+};
+
+using TicketsPtr = std::shared_ptr<SessionTickets>;
+
+static void free_tickets(void*, void* ptr, ::CRYPTO_EX_DATA*, int, long, void*)
+{
+  delete static_cast<TicketsPtr*>(ptr);
+}
+
+static int tickets_index()
+{
+  static auto const INDEX =
+      ::SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, &free_tickets);
+  return INDEX;
+}
+
+static SessionTickets& get_tickets(::SSL const* ssl)
+{
+  return **static_cast<TicketsPtr*>(::SSL_CTX_get_ex_data(::SSL_get_SSL_CTX(ssl), tickets_index()));
+}
+
+static bool init_mac(MacContext* mac, TicketKey const& key)
+{
+#ifdef TLS_FINGERPRINT
+  return ::HMAC_Init_ex(mac, key.hmac_.data(), key.hmac_.size(), ::EVP_sha256(), nullptr) == 1;
+#else   // TLS_FINGERPRINT
+  auto digest = std::array<char, 7>{"SHA256"};
+  auto params = std::array<::OSSL_PARAM, 3>{
+      ::OSSL_PARAM_construct_octet_string(
+          OSSL_MAC_PARAM_KEY,
+          const_cast<uint8_t*>(key.hmac_.data()),
+          key.hmac_.size()
+      ),
+      ::OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest.data(), 0),
+      ::OSSL_PARAM_construct_end()
+  };
+  return ::EVP_MAC_CTX_set_params(mac, params.data()) == 1;
+#endif  // TLS_FINGERPRINT
+}
+
+/*
+ * The returned value means:
+ *   - -1: failure,
+ *   - 0: the ticket is encrypted by an unknown key, so that a full handshake is performed,
+ *   - 1: success,
+ *   - 2: the ticket is decrypted by the previous key, so that it's renewed by the current one.
+ */
+static int crypt_ticket(
+    ::SSL* ssl, uint8_t* name, uint8_t* iv, ::EVP_CIPHER_CTX* cipher, MacContext* mac, int enc
+)
+{
+  auto& tickets = get_tickets(ssl);
+  auto  key     = TicketKey{};
+  auto  ret     = 1;
+  {
+    auto lock = std::scoped_lock{tickets.mutex_};
+    if (enc == 1 || rngs::equal(tickets.current_.name_, std::span{name, key.name_.size()}))
+      key = tickets.current_;
+    else if (tickets.previous_.has_value() &&
+             rngs::equal(tickets.previous_->name_, std::span{name, key.name_.size()})) {
+      key = *tickets.previous_;
+      ret = 2;
+    }
+    else
+      return 0;
+  }
+
+  if (enc == 1) {
+    rngs::copy(key.name_, name);
+    if (::RAND_bytes(iv, ::EVP_CIPHER_iv_length(::EVP_aes_256_cbc())) != 1) return -1;
+  }
+  if (::EVP_CipherInit_ex(cipher, ::EVP_aes_256_cbc(), nullptr, key.aes_.data(), iv, enc) != 1)
+    return -1;
+  return init_mac(mac, key) ? ret : -1;
+}
+
+static void count_handshake(::SSL const* ssl, int where, int)
+{
+  if ((where & SSL_CB_HANDSHAKE_DONE) == 0) return;
+  auto& tickets = get_tickets(ssl);
+  ++tickets.handshakes_;
+  if (::SSL_session_reused(const_cast<::SSL*>(ssl)) == 1) ++tickets.resumed_;
+}
+
+static std::shared_ptr<ssl::context>
+    make_context(vo::TlsIngressOption const& opt, TicketsPtr const& tickets)
+{
+  auto ctx    = std::make_shared<ssl::context>(tls_context(opt));
+  auto native = ctx->native_handle();
+  auto secs   = tickets->rotation_.count();
+
+  assertTrue(secs >= 0, PichiError::MISC, "Invalid rotation of ticket keys");
+  assertTrue(::SSL_CTX_set_ex_data(native, tickets_index(), new TicketsPtr{tickets}) == 1);
+  ::SSL_CTX_set_info_callback(native, &count_handshake);
+  if (secs == 0) {
+    ::SSL_CTX_set_options(native, SSL_OP_NO_TICKET);
+    return ctx;
+  }
+
+  // The ticket expires before its key is discarded
+  ::SSL_CTX_set_timeout(native, static_cast<long>(secs));
+#ifdef TLS_FINGERPRINT
+  ::SSL_CTX_set_tlsext_ticket_key_cb(native, &crypt_ticket);
+#else   // TLS_FINGERPRINT
+  ::SSL_CTX_set_tlsext_ticket_key_evp_cb(native, &crypt_ticket);
+#endif  // TLS_FINGERPRINT
+  return ctx;
+}
+
+// A file failed to stat is regarded as unmodified, which is going to fail the building anyway
+static fs::file_time_type modified_time(std::string const& file)
+{
+  auto ec = std::error_code{};
+  return fs::last_write_time(file, ec);
+}
+
+TlsServerContext::TlsServerContext(vo::TlsIngressOption opt, Seconds rotation)
+  : opt_{std::move(opt)},
+    cert_time_{modified_time(opt_.certFile_)},
+    key_time_{modified_time(opt_.keyFile_)},
+    tickets_{std::make_shared<SessionTickets>(rotation)},
+    ctx_{make_context(opt_, tickets_)}
+{
+}
+
+std::shared_ptr<ssl::context> TlsServerContext::get() const
+{
+  auto lock = std::scoped_lock{mutex_};
+  return ctx_;
+}
+
+bool TlsServerContext::reload()
+{
+  auto cert = modified_time(opt_.certFile_);
+  auto key  = modified_time(opt_.keyFile_);
+  if (cert == cert_time_ && key == key_time_) return false;
+
+  // Not retried until the next modification, e.g. the pair is replaced one file at a time
+  cert_time_ = cert;
+  key_time_  = key;
+
+  auto ctx  = make_context(opt_, tickets_);
+  auto lock = std::scoped_lock{mutex_};
+  ctx_      = std::move(ctx);
+  return true;
+}
+
+bool TlsServerContext::rotate()
+{
+  auto now = SessionTickets::Clock::now();
+  if (tickets_->rotation_.count() == 0 || now - tickets_->rotated_ < tickets_->rotation_)
+    return false;
+
+  auto key  = generate_key();
+  auto lock = std::scoped_lock{tickets_->mutex_};
+  tickets_->previous_ = std::exchange(tickets_->current_, key);
+  tickets_->rotated_  = now;
+  return true;
+}
+
+TlsStats TlsServerContext::stats() const
+{
+  return {.handshakes_ = tickets_->handshakes_, .resumed_ = tickets_->resumed_};
+}
+
+}  // namespace pichi::stream
@@ -57,6 +57,7 @@ json::Value toJson(Egress const& egress, json::Document::AllocatorType& alloc)
     ret.AddMember(egress::TLS, toJson(*egress.tls_, alloc), alloc);
     if (egress.websocket_.has_value())
       ret.AddMember(egress::WEBSOCKET, toJson(*egress.websocket_, alloc), alloc);
+    if (egress.mux_.has_value()) ret.AddMember(egress::MUX, toJson(*egress.mux_, alloc), alloc);
     break;
   default:
     fail();
@@ -102,6 +103,7 @@ template <> Egress parse(json::Value const& v)
     egress.tls_        = parse<TlsEgressOption>(v[egress::TLS]);
     if (v.HasMember(egress::WEBSOCKET))
       egress.websocket_ = parse<WebsocketOption>(v[egress::WEBSOCKET]);
+    if (v.HasMember(egress::MUX)) egress.mux_ = parse<MuxOption>(v[egress::MUX]);
     break;
   default:
     fail(PichiError::BAD_JSON, msg::AT_INVALID);
@@ -125,7 +127,7 @@ bool operator==(Egress const& lhs, Egress const& rhs)
     return lhs.server_ == rhs.server_ && lhs.opt_ == rhs.opt_;
   case AdapterType::TROJAN:
     return lhs.server_ == rhs.server_ && lhs.credential_ == rhs.credential_ &&
-           lhs.tls_ == rhs.tls_ && lhs.websocket_ == rhs.websocket_;
+           lhs.tls_ == rhs.tls_ && lhs.websocket_ == rhs.websocket_ && lhs.mux_ == rhs.mux_;
   default:
     fail();
   }
@@ -1,4 +1,5 @@
 #include "pichi/common/config.hpp"
+#include <iterator>
 #include <numeric>
 #include <pichi/common/asserts.hpp>
 #include <pichi/common/literals.hpp>
@@ -14,6 +15,9 @@ using Allocator = json::Document::AllocatorType;
 
 namespace pichi::vo {
 
+static auto const DEFAULT_MUX_CONNECTIONS = 2_u16;
+static auto const DEFAULT_MUX_STREAMS     = 32_u16;
+
 template <> ShadowsocksOption parse(json::Value const& v)
 {
   assertTrue(v.IsObject(), PichiError::BAD_JSON, msg::OBJ_TYPE_ERROR);
@@ -110,19 +114,23 @@ template <> TrojanOption parse(json::Value const& v)
 {
   assertTrue(v.IsObject(), PichiError::BAD_JSON, msg::OBJ_TYPE_ERROR);
   assertTrue(v.HasMember(option::REMOTE), PichiError::BAD_JSON, msg::MISSING_REMOTE_FIELD);
-  return {parse<Endpoint>(v[option::REMOTE])};
+  auto ret    = TrojanOption{};
+  ret.remote_ = parse<Endpoint>(v[option::REMOTE]);
+  ret.mux_    = v.HasMember(option::MUX) ? parse<bool>(v[option::MUX]) : false;
+  return ret;
 }
 
 json::Value toJson(TrojanOption const& opt, Allocator& alloc)
 {
   auto ret = json::Value{json::kObjectType};
   ret.AddMember(option::REMOTE, toJson(opt.remote_, alloc), alloc);
+  if (opt.mux_) ret.AddMember(option::MUX, opt.mux_, alloc);
   return ret;
 }
 
 bool operator==(TrojanOption const& lhs, TrojanOption const& rhs)
 {
-  return lhs.remote_ == rhs.remote_;
+  return lhs.remote_ == rhs.remote_ && lhs.mux_ == rhs.mux_;
 }
 
 template <> TlsIngressOption parse(json::Value const& v)
@@ -130,7 +138,16 @@ template <> TlsIngressOption parse(json::Value const& v)
   assertTrue(v.IsObject(), PichiError::BAD_JSON, msg::OBJ_TYPE_ERROR);
   assertTrue(v.HasMember(tls::CERT_FILE), PichiError::BAD_JSON, msg::MISSING_CERT_FILE_FIELD);
   assertTrue(v.HasMember(tls::KEY_FILE), PichiError::BAD_JSON, msg::MISSING_KEY_FILE_FIELD);
-  return {parse<std::string>(v[tls::CERT_FILE]), parse<std::string>(v[tls::KEY_FILE])};
+  auto ret      = TlsIngressOption{};
+  ret.certFile_ = parse<std::string>(v[tls::CERT_FILE]);
+  ret.keyFile_  = parse<std::string>(v[tls::KEY_FILE]);
+  parseArray(v, tls::ALPN, back_inserter(ret.alpn_), [](auto&& v) {
+    auto protocol = parse<std::string>(v);
+    assertFalse(protocol.empty(), PichiError::BAD_JSON, msg::ALPN_INVALID);
+    assertTrue(protocol.size() <= 255, PichiError::BAD_JSON, msg::ALPN_INVALID);
+    return protocol;
+  });
+  return ret;
 }
 
 json::Value toJson(TlsIngressOption const& opt, Allocator& alloc)
@@ -138,12 +155,14 @@ json::Value toJson(TlsIngressOption const& opt, Allocator& alloc)
   auto ret = json::Value{json::kObjectType};
   ret.AddMember(tls::CERT_FILE, toJson(opt.certFile_, alloc), alloc);
   ret.AddMember(tls::KEY_FILE, toJson(opt.keyFile_, alloc), alloc);
+  if (!opt.alpn_.empty())
+    ret.AddMember(tls::ALPN, toJson(std::cbegin(opt.alpn_), std::cend(opt.alpn_), alloc), alloc);
   return ret;
 }
 
 bool operator==(TlsIngressOption const& lhs, TlsIngressOption const& rhs)
 {
-  return lhs.keyFile_ == rhs.keyFile_ && lhs.certFile_ == rhs.certFile_;
+  return lhs.keyFile_ == rhs.keyFile_ && lhs.certFile_ == rhs.certFile_ && lhs.alpn_ == rhs.alpn_;
 }
 
 template <> TlsEgressOption parse(json::Value const& v)
@@ -202,4 +221,30 @@ bool operator==(WebsocketOption const& lhs, WebsocketOption const& rhs)
   return lhs.path_ == rhs.path_ && lhs.host_ == rhs.host_;
 }
 
+template <> MuxOption parse(json::Value const& v)
+{
+  assertTrue(v.IsObject(), PichiError::BAD_JSON, msg::OBJ_TYPE_ERROR);
+  auto ret         = MuxOption{};
+  ret.connections_ = v.HasMember(mux::CONNECTIONS) ? parse<uint16_t>(v[mux::CONNECTIONS])
+                                                   : DEFAULT_MUX_CONNECTIONS;
+  ret.streams_ =
+      v.HasMember(mux::STREAMS) ? parse<uint16_t>(v[mux::STREAMS]) : DEFAULT_MUX_STREAMS;
+  assertTrue(ret.connections_ > 0_u16, PichiError::BAD_JSON, msg::MUX_INVALID);
+  assertTrue(ret.streams_ > 0_u16, PichiError::BAD_JSON, msg::MUX_INVALID);
+  return ret;
+}
+
+json::Value toJson(MuxOption const& opt, Allocator& alloc)
+{
+  auto ret = json::Value{json::kObjectType};
+  ret.AddMember(mux::CONNECTIONS, opt.connections_, alloc);
+  ret.AddMember(mux::STREAMS, opt.streams_, alloc);
+  return ret;
+}
+
+bool operator==(MuxOption const& lhs, MuxOption const& rhs)
+{
+  return lhs.connections_ == rhs.connections_ && lhs.streams_ == rhs.streams_;
+}
+
 }  // namespace pichi::vo
@@ -1,6 +1,7 @@
 #include "pichi/common/config.hpp"
 #include <algorithm>
 #include <iterator>
+#include <pichi/common/pattern.hpp>
 #include <pichi/vo/keys.hpp>
 #include <pichi/vo/parse.hpp>
 #include <pichi/vo/rule.hpp>
@@ -77,6 +78,8 @@ template <> Rule parse(json::Value const& v)
   parseArray(v, rule::INGRESS, std::back_inserter(rvo.ingress_), parseString);
   parseArray(v, rule::TYPE, std::back_inserter(rvo.type_), parseAdapterType);
   parseArray(v, rule::PATTERN, std::back_inserter(rvo.pattern_), parseString);
+  // Reject the unsupported or pathological patterns before they are routed
+  rngs::for_each(rvo.pattern_, [](auto&& pattern) { PatternSet{}.add(pattern, 0); });
   parseArray(v, rule::DOMAIN_NAME, std::back_inserter(rvo.domain_), parseString);
   parseArray(v, rule::COUNTRY, std::back_inserter(rvo.country_), parseString);
   parseArray(v, rule::COUNTRY_NR, std::back_inserter(rvo.country_nr_), parseString);
@@ -0,0 +1,78 @@
+#include "pichi/common/config.hpp"
+#include <pichi/vo/keys.hpp>
+#include <pichi/vo/stats.hpp>
+#include <pichi/vo/to_json.hpp>
+
+namespace json  = rapidjson;
+using Allocator = json::Document::AllocatorType;
+
+namespace pichi::vo {
+
+static json::Value toJson(size_t n) { return json::Value{static_cast<uint64_t>(n)}; }
+
+static json::Value toJson(BufferPoolStats const& bvo, Allocator& alloc)
+{
+  auto buffers = json::Value{};
+  buffers.SetObject();
+  buffers.AddMember(stats::IN_USE, toJson(bvo.in_use_), alloc);
+  buffers.AddMember(stats::IN_USE_BYTES, toJson(bvo.in_use_bytes_), alloc);
+  buffers.AddMember(stats::IDLE, toJson(bvo.idle_), alloc);
+  buffers.AddMember(stats::IDLE_BYTES, toJson(bvo.idle_bytes_), alloc);
+  buffers.AddMember(stats::HITS, toJson(bvo.hits_), alloc);
+  buffers.AddMember(stats::MISSES, toJson(bvo.misses_), alloc);
+  return buffers;
+}
+
+static json::Value toJson(service::SaltSentryStats const& svo, Allocator& alloc)
+{
+  auto sentry = json::Value{};
+  sentry.SetObject();
+  sentry.AddMember(stats::CAPACITY, toJson(svo.capacity_), alloc);
+  sentry.AddMember(stats::ACTIVE, toJson(svo.active_), alloc);
+  sentry.AddMember(stats::EXPIRING, toJson(svo.expiring_), alloc);
+  sentry.AddMember(stats::BYTES, toJson(svo.bytes_), alloc);
+  return sentry;
+}
+
+static json::Value toJson(actor::RouterStats const& rvo, Allocator& alloc)
+{
+  auto router = json::Value{};
+  router.SetObject();
+  router.AddMember(stats::CAPACITY, toJson(rvo.capacity_), alloc);
+  router.AddMember(stats::ENTRIES, toJson(rvo.entries_), alloc);
+  router.AddMember(stats::HITS, toJson(rvo.hits_), alloc);
+  router.AddMember(stats::MISSES, toJson(rvo.misses_), alloc);
+  return router;
+}
+
+static json::Value toJson(stream::TlsStats const& tvo, Allocator& alloc)
+{
+  auto tls = json::Value{};
+  tls.SetObject();
+  tls.AddMember(stats::HANDSHAKES, toJson(tvo.handshakes_), alloc);
+  tls.AddMember(stats::RESUMED, toJson(tvo.resumed_), alloc);
+  return tls;
+}
+
+static json::Value
+    toJson(std::unordered_map<std::string, stream::TlsStats> const& tvos, Allocator& alloc)
+{
+  auto ret = json::Value{};
+  ret.SetObject();
+  for (auto&& [name, tvo] : tvos) ret.AddMember(toJson(name, alloc), toJson(tvo, alloc), alloc);
+  return ret;
+}
+
+json::Value toJson(Stats const& svo, Allocator& alloc)
+{
+  auto stats = json::Value{};
+  stats.SetObject();
+  stats.AddMember(stats::BUFFERS, toJson(svo.buffers_, alloc), alloc);
+  stats.AddMember(stats::SENTRY, toJson(svo.sentry_, alloc), alloc);
+  stats.AddMember(stats::ROUTER, toJson(svo.router_, alloc), alloc);
+  stats.AddMember(stats::INGRESSES, toJson(svo.ingresses_, alloc), alloc);
+  stats.AddMember(stats::EGRESSES, toJson(svo.egresses_, alloc), alloc);
+  return stats;
+}
+
+}  // namespace pichi::vo
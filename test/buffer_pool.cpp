@@ -0,0 +1,78 @@
+#define BOOST_TEST_MODULE pichi buffer pool test
+
+#include "utils.hpp"
+#include <boost/test/unit_test.hpp>
+#include <pichi/common/buffer_pool.hpp>
+#include <pichi/common/literals.hpp>
+#include <thread>
+
+namespace pichi::unit_test {
+
+BOOST_AUTO_TEST_SUITE(BUFFER_POOL)
+
+BOOST_AUTO_TEST_CASE(PooledBuffer_Size_Class)
+{
+  BOOST_CHECK_EQUAL(PooledBuffer::MIN_SIZE, PooledBuffer{0_sz}.buffer().size());
+  BOOST_CHECK_EQUAL(PooledBuffer::MIN_SIZE, PooledBuffer{1_sz}.buffer().size());
+  BOOST_CHECK_EQUAL(PooledBuffer::MIN_SIZE, PooledBuffer{4096_sz}.buffer().size());
+  BOOST_CHECK_EQUAL(8192_sz, PooledBuffer{4097_sz}.buffer().size());
+  BOOST_CHECK_EQUAL(32768_sz, PooledBuffer{20000_sz}.buffer().size());
+  BOOST_CHECK_EQUAL(PooledBuffer::MAX_SIZE, PooledBuffer{65536_sz}.buffer().size());
+  BOOST_CHECK_EQUAL(PooledBuffer::MAX_SIZE, PooledBuffer{65537_sz}.buffer().size());
+}
+
+BOOST_AUTO_TEST_CASE(PooledBuffer_In_Use)
+{
+  auto origin = buffer_pool_stats();
+  {
+    auto b0    = PooledBuffer{4096_sz};
+    auto b1    = PooledBuffer{65536_sz};
+    auto stats = buffer_pool_stats();
+    BOOST_CHECK_EQUAL(origin.in_use_ + 2, stats.in_use_);
+    BOOST_CHECK_EQUAL(origin.in_use_bytes_ + 4096 + 65536, stats.in_use_bytes_);
+  }
+  auto stats = buffer_pool_stats();
+  BOOST_CHECK_EQUAL(origin.in_use_, stats.in_use_);
+  BOOST_CHECK_EQUAL(origin.in_use_bytes_, stats.in_use_bytes_);
+}
+
+BOOST_AUTO_TEST_CASE(PooledBuffer_Recycled)
+{
+  auto data = std::invoke([]() { return PooledBuffer{8192_sz}.buffer().data(); });
+
+  auto origin = buffer_pool_stats();
+  auto reused = PooledBuffer{8192_sz};
+  auto stats  = buffer_pool_stats();
+
+  BOOST_CHECK(data == reused.buffer().data());
+  BOOST_CHECK_EQUAL(origin.hits_ + 1, stats.hits_);
+  BOOST_CHECK_EQUAL(origin.misses_, stats.misses_);
+  BOOST_CHECK_EQUAL(origin.idle_ - 1, stats.idle_);
+  BOOST_CHECK_EQUAL(origin.idle_bytes_ - 8192, stats.idle_bytes_);
+}
+
+BOOST_AUTO_TEST_CASE(PooledBuffer_Thread_Exit)
+{
+  auto origin = buffer_pool_stats();
+  std::thread{[]() { auto b = PooledBuffer{16384_sz}; }}.join();
+  auto stats = buffer_pool_stats();
+
+  BOOST_CHECK_EQUAL(origin.misses_ + 1, stats.misses_);
+  BOOST_CHECK_EQUAL(origin.idle_, stats.idle_);
+  BOOST_CHECK_EQUAL(origin.idle_bytes_, stats.idle_bytes_);
+}
+
+BOOST_AUTO_TEST_CASE(PooledBuffer_Given_Back_By_Other_Thread)
+{
+  auto origin = buffer_pool_stats();
+  auto b      = std::make_unique<PooledBuffer>(32768_sz);
+  std::thread{[&b]() { b.reset(); }}.join();
+  auto stats = buffer_pool_stats();
+
+  BOOST_CHECK_EQUAL(origin.in_use_, stats.in_use_);
+  BOOST_CHECK_EQUAL(origin.in_use_bytes_, stats.in_use_bytes_);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace pichi::unit_test
@@ -0,0 +1,61 @@
+#define BOOST_TEST_MODULE pichi coro test
+
+#include "utils.hpp"
+#include <array>
+#include <atomic>
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <new>
+#include <pichi/common/buffer.hpp>
+#include <pichi/common/coro.hpp>
+#include <pichi/common/literals.hpp>
+
+// Counting all allocations via the global allocator of this test process
+static auto allocations = std::atomic_size_t{0};
+
+void* operator new(std::size_t size)
+{
+  ++allocations;
+  if (auto p = std::malloc(size == 0 ? 1 : size); p != nullptr) return p;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace pichi::unit_test {
+
+static Awaitable<size_t> read(MutableBuffer buf) { co_return buf.size(); }
+
+static Awaitable<size_t> recv(MutableBuffer buf) { co_return co_await read(buf); }
+
+static Awaitable<size_t> relay(MutableBuffer buf)
+{
+  auto [ec, n] = co_await redirect(recv(buf));
+  co_return ec ? 0 : *n;
+}
+
+BOOST_AUTO_TEST_SUITE(CORO)
+
+BOOST_AUTO_TEST_CASE(Awaitable_Frames_Recycled)
+{
+  run_case([](auto&&) -> Awaitable<void> {
+    auto buf = std::array<uint8_t, 1024>{};
+
+    // Warming up the thread-local cache
+    co_await relay(buf);
+
+    auto origin = allocations.load();
+    auto total  = 0_sz;
+    for (auto i = 0; i < 1024; ++i) total += co_await relay(buf);
+    auto steady = allocations.load();
+
+    BOOST_CHECK_EQUAL(1024 * buf.size(), total);
+    BOOST_CHECK_EQUAL(origin, steady);
+  });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace pichi::unit_test
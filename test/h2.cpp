@@ -0,0 +1,343 @@
+#define BOOST_TEST_MODULE pichi h2 test
+
+#include "utils.hpp"
+#include <array>
+#include <boost/asio/detached.hpp>
+#include <memory>
+#include <pichi/adapter/tcp/adapter.hpp>
+#include <pichi/adapter/tcp/h2.hpp>
+#include <pichi/common/literals.hpp>
+#include <pichi/stream/helpers.hpp>
+#include <pichi/stream/test.hpp>
+#include <ranges>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+namespace asio = boost::asio;
+namespace h2   = pichi::adapter::tcp::h2;
+namespace mux  = pichi::adapter::tcp::mux;
+namespace rngs = std::ranges;
+namespace sys  = boost::system;
+
+namespace pichi::unit_test {
+
+using Ingress = adapter::tcp::HttpIngress<TestSocket>;
+using Bytes   = std::vector<uint8_t>;
+
+static auto const PREFACE   = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"sv;
+static auto const AUTHORITY = "localhost:443"sv;
+static auto const REMOTE    = makeEndpoint("localhost", 443_u16);
+
+static auto const IVO_AUTH = vo::Ingress{
+    .type_       = AdapterType::HTTP,
+    .credential_ = vo::UpIngressCredential{.credential_ = {{"pichi", "pichi"}}}
+};
+
+// The frame types and flags @RFC9113
+static auto const DATA          = 0x0_u8;
+static auto const HEADERS       = 0x1_u8;
+static auto const RST_STREAM    = 0x3_u8;
+static auto const SETTINGS      = 0x4_u8;
+static auto const WINDOW_UPDATE = 0x8_u8;
+static auto const END_STREAM    = 0x1_u8;
+static auto const ACK           = 0x1_u8;
+static auto const END_HEADERS   = 0x4_u8;
+
+// The error code CANCEL @RFC9113 7
+static auto const CANCEL = Bytes{0x00, 0x00, 0x00, 0x08};
+
+struct Frame {
+  uint8_t  type_;
+  uint8_t  flags_;
+  uint32_t id_;
+  Bytes    payload_;
+};
+
+static Bytes to_bytes(std::string_view s) { return {rngs::begin(s), rngs::end(s)}; }
+
+static Bytes serialize(Frame const& frame)
+{
+  auto len = frame.payload_.size();
+  auto ret = Bytes{
+      static_cast<uint8_t>(len >> 16),
+      static_cast<uint8_t>(len >> 8),
+      static_cast<uint8_t>(len),
+      frame.type_,
+      frame.flags_,
+      0_u8,
+      0_u8,
+      0_u8,
+      0_u8
+  };
+  hton(frame.id_, {ret.data() + 5, sizeof(uint32_t)});
+  ret.insert(rngs::end(ret), rngs::begin(frame.payload_), rngs::end(frame.payload_));
+  return ret;
+}
+
+static Awaitable<Frame> read_frame(TestSocket& client)
+{
+  auto header = std::array<uint8_t, 9>{};
+  co_await stream::read(client, header);
+
+  auto frame = Frame{
+      .type_    = header[3],
+      .flags_   = header[4],
+      .id_      = ntoh<uint32_t>({header.data() + 5, sizeof(uint32_t)}),
+      .payload_ = Bytes(size_t{header[0]} << 16 | size_t{header[1]} << 8 | header[2]),
+  };
+  co_await stream::read(client, frame.payload_);
+  co_return frame;
+}
+
+// The request block with the literal fields whose names are indexed
+static Bytes gen_connect(std::string_view authority)
+{
+  auto block = Bytes{0x02_u8, 0x07_u8};
+  rngs::copy("CONNECT"sv, std::back_inserter(block));
+  block.push_back(0x01_u8);
+  block.push_back(static_cast<uint8_t>(authority.size()));
+  rngs::copy(authority, std::back_inserter(block));
+  return block;
+}
+
+// Send the preface and the request, after which the server is serving the connection
+static Awaitable<TestSocket>
+    handshake(IOExecutor ex, vo::Ingress const& vo, Bytes block, mux::Accept accept)
+{
+  auto client  = TestSocket{ex};
+  auto ingress = Ingress{vo, client.peer()};
+
+  co_await stream::write(client, PREFACE);
+  co_await stream::write(client, serialize({SETTINGS, 0, 0, {}}));
+  co_await stream::write(client, serialize({HEADERS, END_HEADERS, 1, std::move(block)}));
+
+  co_await ingress.read_remote();
+  BOOST_CHECK(ingress.multiplexed());
+  asio::co_spawn(ex, h2::serve(ex, std::move(ingress), std::move(accept)), asio::detached);
+
+  // The server preface, and the acknowledgement of the client one
+  auto settings = co_await read_frame(client);
+  BOOST_CHECK_EQUAL(settings.type_, SETTINGS);
+  BOOST_CHECK_EQUAL(settings.flags_, 0_u8);
+  BOOST_CHECK_EQUAL((co_await read_frame(client)).type_, WINDOW_UPDATE);
+  auto ack = co_await read_frame(client);
+  BOOST_CHECK_EQUAL(ack.type_, SETTINGS);
+  BOOST_CHECK_EQUAL(ack.flags_, ACK);
+
+  co_return client;
+}
+
+// The connection-level WINDOW_UPDATE returning n bytes
+static void check_update(Frame const& frame, uint32_t n)
+{
+  auto expect = Bytes(sizeof(uint32_t));
+  hton(n, expect);
+  BOOST_CHECK_EQUAL(frame.type_, WINDOW_UPDATE);
+  BOOST_CHECK_EQUAL(frame.id_, 0u);
+  BOOST_CHECK(frame.payload_ == expect);
+}
+
+static Awaitable<void> echo(std::shared_ptr<mux::Stream> stream)
+{
+  co_await stream->respond({});
+
+  auto buf = std::array<uint8_t, 1024>{};
+  auto ec  = sys::error_code{};
+  while (!ec) {
+    auto n = co_await redirect(stream->recv(buf), ec);
+    if (!ec) co_await stream->send({buf, *n});
+  }
+  co_await stream->close();
+}
+
+BOOST_AUTO_TEST_SUITE(H2)
+
+BOOST_AUTO_TEST_CASE(Decoder_decode_Huffman_With_Dynamic_Table)
+{
+  // The requests with Huffman coding @RFC7541 C.4
+  auto const BLOCKS = std::array<Bytes, 3>{
+      Bytes{0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab,
+            0x90, 0xf4, 0xff},
+      Bytes{0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8, 0xeb, 0x10, 0x64, 0x9c, 0xbf},
+      Bytes{0x82, 0x87, 0x85, 0xbf, 0x40, 0x88, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xa9, 0x7d, 0x7f,
+            0x89, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xb8, 0xe8, 0xb4, 0xbf}
+  };
+  auto const EXPECTS = std::array<h2::Decoder::Fields, 3>{
+      h2::Decoder::Fields{
+                          {":method", "GET"},
+                          {":scheme", "http"},
+                          {":path", "/"},
+                          {":authority", "www.example.com"}},
+      h2::Decoder::Fields{
+                          {":method", "GET"},
+                          {":scheme", "http"},
+                          {":path", "/"},
+                          {":authority", "www.example.com"},
+                          {"cache-control", "no-cache"}},
+      h2::Decoder::Fields{
+                          {":method", "GET"},
+                          {":scheme", "https"},
+                          {":path", "/index.html"},
+                          {":authority", "www.example.com"},
+                          {"custom-key", "custom-value"}}
+  };
+
+  auto decoder = h2::Decoder{};
+  for (auto i = 0_sz; i < BLOCKS.size(); ++i) BOOST_CHECK(decoder.decode(BLOCKS[i]) == EXPECTS[i]);
+}
+
+BOOST_AUTO_TEST_CASE(Decoder_decode_Invalid_Blocks)
+{
+  auto decoder = h2::Decoder{};
+
+  // The index exceeds the static table while the dynamic one is empty
+  BOOST_CHECK_EXCEPTION(
+      decoder.decode(Bytes{0xbe}),
+      SystemError,
+      verify_exception<PichiError::BAD_PROTO>
+  );
+
+  // The Huffman padding is not a prefix of EOS
+  BOOST_CHECK_EXCEPTION(
+      decoder.decode(Bytes{0x41, 0x81, 0x00}),
+      SystemError,
+      verify_exception<PichiError::BAD_PROTO>
+  );
+
+  // The fields exceed the limit
+  BOOST_CHECK_EXCEPTION(
+      decoder.decode(Bytes{0x82, 0x86}, 8),
+      SystemError,
+      verify_exception<PichiError::BAD_PROTO>
+  );
+}
+
+BOOST_AUTO_TEST_CASE(serve_Connect_Echo)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto accept = [ex](auto stream, auto remote) {
+      BOOST_CHECK(remote == REMOTE);
+      asio::co_spawn(ex, echo(std::move(stream)), asio::detached);
+    };
+    auto client = co_await handshake(ex, {}, gen_connect(AUTHORITY), std::move(accept));
+
+    // :status 200 is indexed by the static table
+    auto reply = co_await read_frame(client);
+    BOOST_CHECK_EQUAL(reply.type_, HEADERS);
+    BOOST_CHECK_EQUAL(reply.flags_, END_HEADERS);
+    BOOST_CHECK_EQUAL(reply.id_, 1u);
+    BOOST_CHECK(reply.payload_ == Bytes{0x88});
+
+    co_await stream::write(client, serialize({DATA, 0, 1, to_bytes("pichi")}));
+    auto data = co_await read_frame(client);
+    BOOST_CHECK_EQUAL(data.type_, DATA);
+    BOOST_CHECK_EQUAL(data.id_, 1u);
+    BOOST_CHECK(data.payload_ == to_bytes("pichi"));
+
+    co_await stream::write(client, serialize({DATA, END_STREAM, 1, {}}));
+    auto end = co_await read_frame(client);
+    BOOST_CHECK_EQUAL(end.type_, DATA);
+    BOOST_CHECK_EQUAL(end.flags_, END_STREAM);
+    BOOST_CHECK(end.payload_.empty());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(serve_Connect_Authentication_Required)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto client = co_await handshake(ex, IVO_AUTH, gen_connect(AUTHORITY), [](auto, auto) {
+      BOOST_ERROR("Unauthenticated stream accepted");
+    });
+
+    // :status 407 and proxy-authenticate are literals with the indexed names
+    auto expect = Bytes{0x08, 0x03};
+    rngs::copy("407"sv, std::back_inserter(expect));
+    expect.insert(rngs::end(expect), {0x0f, 0x21, 0x05});
+    rngs::copy("Basic"sv, std::back_inserter(expect));
+
+    auto reply = co_await read_frame(client);
+    BOOST_CHECK_EQUAL(reply.type_, HEADERS);
+    BOOST_CHECK_EQUAL(reply.flags_, END_HEADERS | END_STREAM);
+    BOOST_CHECK(reply.payload_ == expect);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(serve_Not_Connect)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    // GET https://localhost:443/
+    auto block = Bytes{0x82, 0x87, 0x84, 0x01, static_cast<uint8_t>(AUTHORITY.size())};
+    rngs::copy(AUTHORITY, std::back_inserter(block));
+    auto client = co_await handshake(ex, {}, std::move(block), [](auto, auto) {
+      BOOST_ERROR("Non-CONNECT stream accepted");
+    });
+
+    auto expect = Bytes{0x08, 0x03};
+    rngs::copy("405"sv, std::back_inserter(expect));
+
+    auto reply = co_await read_frame(client);
+    BOOST_CHECK_EQUAL(reply.type_, HEADERS);
+    BOOST_CHECK_EQUAL(reply.flags_, END_HEADERS | END_STREAM);
+    BOOST_CHECK(reply.payload_ == expect);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(serve_Reset_Streams_Return_Connection_Window)
+{
+  // The unconsumed bytes of all streams exceed the initial connection window
+  auto const STREAMS = 64u;
+  auto const SIZE    = 4096_sz;
+
+  run_case([&](auto&& ex) -> Awaitable<void> {
+    // The streams are held without being consumed
+    auto streams = std::make_shared<std::vector<std::shared_ptr<mux::Stream>>>();
+    auto accept  = [streams](auto stream, auto) { streams->push_back(std::move(stream)); };
+    auto client  = co_await handshake(ex, {}, gen_connect(AUTHORITY), std::move(accept));
+
+    for (auto id = 1u; id < 2 * STREAMS; id += 2) {
+      auto block = gen_connect(AUTHORITY);
+      if (id != 1) co_await stream::write(client, serialize({HEADERS, END_HEADERS, id, block}));
+      co_await stream::write(client, serialize({DATA, 0, id, Bytes(SIZE, 0_u8)}));
+      co_await stream::write(client, serialize({RST_STREAM, 0, id, CANCEL}));
+      check_update(co_await read_frame(client), SIZE);
+    }
+    BOOST_CHECK_EQUAL(streams->size(), STREAMS);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(serve_Closed_Stream_Returns_Connection_Window)
+{
+  auto const SIZE = 4096_sz;
+
+  run_case([&](auto&& ex) -> Awaitable<void> {
+    // Only 1 byte is consumed before the stream is closed
+    auto accept = [ex](auto stream, auto) {
+      asio::co_spawn(
+          ex,
+          [stream = std::move(stream)]() -> Awaitable<void> {
+            co_await stream->respond({});
+            auto buf = std::array<uint8_t, 1>{};
+            co_await stream->recv(buf);
+            co_await stream->close();
+          },
+          asio::detached
+      );
+    };
+    auto client = co_await handshake(ex, {}, gen_connect(AUTHORITY), std::move(accept));
+
+    auto reply = co_await read_frame(client);
+    BOOST_CHECK_EQUAL(reply.type_, HEADERS);
+    BOOST_CHECK(reply.payload_ == Bytes{0x88});
+
+    co_await stream::write(client, serialize({DATA, 0, 1, Bytes(SIZE, 0_u8)}));
+    auto end = co_await read_frame(client);
+    BOOST_CHECK_EQUAL(end.type_, DATA);
+    BOOST_CHECK_EQUAL(end.flags_, END_STREAM);
+    check_update(co_await read_frame(client), SIZE);
+  });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace pichi::unit_test
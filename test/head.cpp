@@ -0,0 +1,155 @@
+#define BOOST_TEST_MODULE pichi head test
+
+#include "utils.hpp"
+#include <boost/test/unit_test.hpp>
+#include <pichi/adapter/tcp/head.hpp>
+#include <pichi/common/literals.hpp>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+using namespace std::literals;
+namespace head = pichi::adapter::tcp::head;
+
+namespace pichi::unit_test {
+
+static auto const AUTH = "Basic cGljaGk6cGljaGk="sv;
+
+static size_t naive_end(std::string_view s)
+{
+  auto pos = s.find("\r\n\r\n"sv);
+  return pos == std::string_view::npos ? 0 : pos + 4;
+}
+
+BOOST_AUTO_TEST_SUITE(HEAD)
+
+BOOST_AUTO_TEST_CASE(find_end_Across_Vector_Boundaries)
+{
+  // The blank line is placed at every offset around the 16 and 32 bytes boundaries
+  for (auto i = 0_sz; i < 80_sz; ++i) {
+    auto s = std::string(i, 'x') + "\r\n\r\n" + std::string(80 - i, 'y');
+    BOOST_CHECK_EQUAL(head::find_end(ConstBuffer{s}), i + 4);
+    BOOST_CHECK_EQUAL(head::find_end(ConstBuffer{s, i + 3}), 0_sz);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(find_end_Broken_Blank_Lines)
+{
+  for (auto&& s : {
+           ""s,
+           "\r\n\r"s,
+           "\n\n\n\n"s,
+           "\r\n\n\r\n"s,
+           "\r\r\n\n"s,
+           "CONNECT a:1 HTTP/1.1\r\nHost: a\r\n\n\r\n\r\r\n\n"s,
+           std::string(100, '\n'),
+           std::string(100, '\r'),
+       })
+    BOOST_CHECK_EQUAL(head::find_end(ConstBuffer{s}), naive_end(s));
+}
+
+BOOST_AUTO_TEST_CASE(find_end_Resumed)
+{
+  auto s = "CONNECT example.com:443 HTTP/1.1\r\nHost: example.com:443\r\n\r\n"s;
+
+  // The scanning is resumed from the size of the previous incomplete head
+  for (auto from = 0_sz; from < s.size(); ++from)
+    BOOST_CHECK_EQUAL(head::find_end(ConstBuffer{s}, from), s.size());
+  BOOST_CHECK_EQUAL(head::find_end(ConstBuffer{s}, s.size()), 0_sz);
+}
+
+BOOST_AUTO_TEST_CASE(maybe_connect_Incomplete_Heads)
+{
+  BOOST_CHECK(head::maybe_connect(ConstBuffer{""sv}));
+  BOOST_CHECK(head::maybe_connect(ConstBuffer{"CONN"sv}));
+  BOOST_CHECK(head::maybe_connect(ConstBuffer{"CONNECT example.com:4"sv}));
+  BOOST_CHECK(head::maybe_connect(ConstBuffer{"CONNECT example.com:443 HTTP/1.1\r\nHo"sv}));
+
+  BOOST_CHECK(!head::maybe_connect(ConstBuffer{"GET / HTTP/1.1\r\n"sv}));
+  BOOST_CHECK(!head::maybe_connect(ConstBuffer{"PRI * HTTP/2.0\r\n"sv}));
+  BOOST_CHECK(!head::maybe_connect(ConstBuffer{"connect example.com:443"sv}));
+  BOOST_CHECK(!head::maybe_connect(ConstBuffer{"CONNECT example.com:443 HTTP/2.0\r\n"sv}));
+}
+
+BOOST_AUTO_TEST_CASE(parse_connect_Targets)
+{
+  for (auto&& [target, host, port] : {
+           std::make_tuple("example.com:443"sv, "example.com"sv, "443"sv),
+           std::make_tuple("example.com"sv, "example.com"sv, "80"sv),
+           std::make_tuple("127.0.0.1:8080"sv, "127.0.0.1"sv, "8080"sv),
+           std::make_tuple("[::1]:443"sv, "::1"sv, "443"sv),
+           std::make_tuple("[fe80::1]"sv, "fe80::1"sv, "80"sv),
+       }) {
+    auto s       = "CONNECT "s + std::string{target} + " HTTP/1.1\r\nHost: " +
+                   std::string{target} + "\r\n\r\n";
+    auto connect = head::parse_connect(ConstBuffer{s});
+    BOOST_REQUIRE(connect.has_value());
+    BOOST_CHECK_EQUAL(connect->host_, host);
+    BOOST_CHECK_EQUAL(connect->port_, port);
+    BOOST_CHECK(!connect->authorization_.has_value());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parse_connect_Authorization)
+{
+  auto s = "CONNECT example.com:443 HTTP/1.0\r\n"
+           "User-Agent: curl/8.0\r\n"
+           "proxy-AUTHORIZATION: \t"s +
+           std::string{AUTH} +
+           " \r\n"
+           "Proxy-Authorization: Basic Zm9vOmJhcg==\r\n"
+           "\r\n";
+  auto connect = head::parse_connect(ConstBuffer{s});
+  BOOST_REQUIRE(connect.has_value());
+  BOOST_CHECK_EQUAL(connect->host_, "example.com"sv);
+  BOOST_CHECK_EQUAL(connect->port_, "443"sv);
+  BOOST_REQUIRE(connect->authorization_.has_value());
+  BOOST_CHECK_EQUAL(*connect->authorization_, AUTH);
+}
+
+BOOST_AUTO_TEST_CASE(parse_connect_Off_The_Fast_Path)
+{
+  for (auto&& s : {
+           "GET http://example.com/ HTTP/1.1\r\n\r\n"sv,
+           "CONNECT example.com:443 HTTP/2.0\r\n\r\n"sv,
+           "CONNECT example.com:443  HTTP/1.1\r\n\r\n"sv,
+           "CONNECT example.com:https HTTP/1.1\r\n\r\n"sv,
+           "CONNECT example.com: HTTP/1.1\r\n\r\n"sv,
+           "CONNECT [::1 HTTP/1.1\r\n\r\n"sv,
+           "CONNECT [::1]x443 HTTP/1.1\r\n\r\n"sv,
+           "CONNECT http://example.com/ HTTP/1.1\r\n\r\n"sv,
+           "CONNECT example.com:443 HTTP/1.1\r\nHost: example.com\r\n folded\r\n\r\n"sv,
+           "CONNECT example.com:443 HTTP/1.1\r\nBad Name: value\r\n\r\n"sv,
+           "CONNECT example.com:443 HTTP/1.1\r\n: value\r\n\r\n"sv,
+           "CONNECT example.com:443 HTTP/1.1\r\nNo colon\r\n\r\n"sv,
+       })
+    BOOST_CHECK(!head::parse_connect(ConstBuffer{s}).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(basic_credential_Valid)
+{
+  BOOST_CHECK_EQUAL(*head::basic_credential(AUTH), "cGljaGk6cGljaGk="sv);
+  BOOST_CHECK_EQUAL(*head::basic_credential("bAsIc Zm9v"sv), "Zm9v"sv);
+  BOOST_CHECK_EQUAL(*head::basic_credential("Basic Zg=="sv), "Zg=="sv);
+  BOOST_CHECK_EQUAL(*head::basic_credential("Basic a+/b"sv), "a+/b"sv);
+}
+
+BOOST_AUTO_TEST_CASE(basic_credential_Invalid)
+{
+  for (auto&& value : {
+           ""sv,
+           "Basic"sv,
+           "Basic "sv,
+           "Basic  Zm9v"sv,
+           "Basic =="sv,
+           "Basic Zg==="sv,
+           "Basic Zg=a"sv,
+           "Basic invalid BASE64 code"sv,
+           "Token XXXXX"sv,
+       })
+    BOOST_CHECK(!head::basic_credential(value).has_value());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace pichi::unit_test
@@ -3,7 +3,9 @@
 #include "pichi/common/config.hpp"
 #include "utils.hpp"
 #include <boost/asio/use_awaitable.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/read.hpp>
 #include <boost/beast/http/serializer.hpp>
 #include <boost/beast/http/string_body.hpp>
 #include <boost/beast/http/write.hpp>
@@ -152,6 +154,13 @@ static void verify_field(http::fields const& hdr, http::field field, std::string
   }
 }
 
+// The request relayed to the upstream is neither closing nor carrying Proxy-Connection
+template <typename Body> static void verify_kept_alive(http::request<Body> const& req)
+{
+  BOOST_CHECK(req.keep_alive());
+  BOOST_CHECK(req.find(http::field::proxy_connection) == rngs::end(req));
+}
+
 BOOST_AUTO_TEST_SUITE(HTTP)
 
 BOOST_AUTO_TEST_CASE(Ingress_read_remote_Invalid_HTTP_Header)
@@ -417,6 +426,46 @@ BOOST_AUTO_TEST_CASE(Ingress_read_remote_Relay_Without_Both_Fields)
   });
 }
 
+BOOST_AUTO_TEST_CASE(Ingress_read_remote_Relay_Kept_Alive)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto client  = TestSocket{ex};
+    auto ingress = Ingress{{}, client.peer()};
+
+    // The second request is pipelined
+    co_await http::async_write(
+        client,
+        gen_request(http::verb::get, LOCALHOST_URI),
+        asio::use_awaitable
+    );
+    co_await http::async_write(client, gen_request(ROOT_URI), asio::use_awaitable);
+
+    auto remote = co_await ingress.read_remote();
+    BOOST_CHECK(HTTP_ENDPOINT == remote);
+    BOOST_CHECK(ingress.persistent());
+
+    auto buf   = std::array<uint8_t, 1024>{};
+    auto first = parse<true, http::empty_body>(buf | views::take(co_await ingress.recv(buf)));
+    BOOST_CHECK_EQUAL(http::verb::get, first.method());
+    BOOST_CHECK(ingress.requested());
+    BOOST_CHECK(!ingress.responded());
+
+    co_await ingress.send(buf | views::take(serialize(gen_response(), buf)));
+    co_await stream::read_some(client, buf);
+    BOOST_CHECK(ingress.kept_alive());
+
+    remote = co_await ingress.read_remote();
+    BOOST_CHECK(HTTP_ENDPOINT == remote);
+
+    auto second = parse<true, http::string_body>(buf | views::take(co_await ingress.recv(buf)));
+    BOOST_CHECK_EQUAL(http::verb::post, second.method());
+    BOOST_CHECK_EQUAL(CONTENT, second.body());
+    verify_kept_alive(second);
+    BOOST_CHECK(ingress.requested());
+    BOOST_CHECK(!ingress.kept_alive());
+  });
+}
+
 BOOST_AUTO_TEST_CASE(Ingress_recv_Tunnel_With_Sticky_Content)
 {
   run_case([](auto&& ex) -> Awaitable<void> {
@@ -500,8 +549,7 @@ BOOST_AUTO_TEST_CASE(Ingress_recv_Relay_Without_Connection_Field)
     auto req = parse<true, http::empty_body>(buf | views::take(co_await ingress.recv(buf)));
     BOOST_CHECK_EQUAL(ROOT_URI, req.target());
     verify_field(req, http::field::host, LOCALHOST);
-    verify_field(req, http::field::connection, CLOSE_FIELD);
-    verify_field(req, http::field::proxy_connection, CLOSE_FIELD);
+    verify_kept_alive(req);
   });
 }
 
@@ -550,8 +598,7 @@ BOOST_AUTO_TEST_CASE(Ingress_recv_Relay_With_Keep_Alive)
     auto req = parse<true, http::empty_body>(buf | views::take(co_await ingress.recv(buf)));
     BOOST_CHECK_EQUAL(ROOT_URI, req.target());
     verify_field(req, http::field::host, LOCALHOST);
-    verify_field(req, http::field::connection, CLOSE_FIELD);
-    verify_field(req, http::field::proxy_connection, CLOSE_FIELD);
+    verify_kept_alive(req);
   });
 }
 
@@ -574,8 +621,7 @@ BOOST_AUTO_TEST_CASE(Ingress_recv_Relay_With_Body)
     BOOST_CHECK_EQUAL(ROOT_URI, req.target());
     BOOST_CHECK_EQUAL(CONTENT, req.body());
     verify_field(req, http::field::host, LOCALHOST);
-    verify_field(req, http::field::connection, CLOSE_FIELD);
-    verify_field(req, http::field::proxy_connection, CLOSE_FIELD);
+    verify_kept_alive(req);
   });
 }
 
@@ -608,8 +654,7 @@ BOOST_AUTO_TEST_CASE(Ingress_recv_Relay_By_Insufficient_Buffer)
     BOOST_CHECK_EQUAL(ROOT_URI, req.target());
     BOOST_CHECK_EQUAL(CONTENT, req.body());
     verify_field(req, http::field::host, LOCALHOST);
-    verify_field(req, http::field::connection, CLOSE_FIELD);
-    verify_field(req, http::field::proxy_connection, CLOSE_FIELD);
+    verify_kept_alive(req);
   });
 }
 
@@ -845,18 +890,15 @@ BOOST_AUTO_TEST_CASE(Ingress_send_Relay)
     auto rep =
         parse<false, http::empty_body>(buf | views::take(co_await stream::read_some(client, buf)));
     BOOST_CHECK_EQUAL(http::status::no_content, rep.result());
-    verify_field(rep, http::field::connection, CLOSE_FIELD);
-    verify_field(rep, http::field::proxy_connection, CLOSE_FIELD);
+    BOOST_CHECK(rep.keep_alive());
+    verify_field(rep, http::field::proxy_connection, KEEP_ALIVE_FIELD);
+    BOOST_CHECK(ingress.kept_alive());
+    BOOST_CHECK(ingress.reusable());
 
+    // The bytes following the response are dropped along with the upstream connection
     co_await ingress.send(CONTENT);
-
-    auto fact = buf | views::take(co_await stream::read_some(client, buf));
-    BOOST_CHECK_EQUAL_COLLECTIONS(
-        rngs::begin(CONTENT),
-        rngs::end(CONTENT),
-        rngs::begin(fact),
-        rngs::end(fact)
-    );
+    BOOST_CHECK(ingress.kept_alive());
+    BOOST_CHECK(!ingress.reusable());
   });
 }
 
@@ -901,21 +943,92 @@ BOOST_AUTO_TEST_CASE(Ingress_send_Relay_One_By_One)
     co_await ingress.read_remote();
     co_await ingress.confirm();
 
+    auto origin = gen_response(http::status::ok);
+    origin.content_length(rngs::size(CONTENT));
+
     auto buf = std::array<uint8_t, 1024>{};
-    auto len = serialize(gen_response(), buf);
+    auto len = serialize(origin, buf);
     for (auto i = 0_sz; i < len; ++i) co_await ingress.send(buf | views::drop(i) | views::take(1));
 
-    auto rep =
-        parse<false, http::empty_body>(buf | views::take(co_await stream::read_some(client, buf)));
-    BOOST_CHECK_EQUAL(http::status::no_content, rep.result());
-    verify_field(rep, http::field::connection, CLOSE_FIELD);
-    verify_field(rep, http::field::proxy_connection, CLOSE_FIELD);
+    auto cache  = boost::beast::flat_buffer{};
+    auto parser = http::response_parser<http::empty_body>{};
+    co_await http::async_read_header(client, cache, parser, asio::use_awaitable);
+    BOOST_CHECK_EQUAL(http::status::ok, parser.get().result());
+    BOOST_CHECK(parser.get().keep_alive());
+    verify_field(parser.get(), http::field::proxy_connection, KEEP_ALIVE_FIELD);
 
     for (auto i = 0_sz; i < rngs::size(CONTENT); ++i) {
+      BOOST_CHECK(!ingress.responded());
       co_await ingress.send(CONTENT | views::drop(i) | views::take(1));
       BOOST_CHECK_EQUAL(1, co_await stream::read_some(client, buf));
       BOOST_CHECK_EQUAL(CONTENT[i], buf[0]);
     }
+    BOOST_CHECK(ingress.responded());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Ingress_send_Relay_Chunked)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto client  = TestSocket{ex};
+    auto ingress = Ingress{{}, client.peer()};
+
+    co_await http::async_write(
+        client,
+        gen_request(http::verb::get, LOCALHOST_URI),
+        asio::use_awaitable
+    );
+
+    co_await ingress.read_remote();
+    co_await ingress.confirm();
+
+    auto origin = http::response<http::string_body>{http::status::ok, 11, CONTENT};
+    origin.chunked(true);
+
+    auto buf = std::array<uint8_t, 1024>{};
+    co_await ingress.send(buf | views::take(serialize(origin, buf)));
+    BOOST_CHECK(ingress.kept_alive());
+    BOOST_CHECK(ingress.reusable());
+
+    auto cache = boost::beast::flat_buffer{};
+    auto rep   = http::response<http::string_body>{};
+    co_await http::async_read(client, cache, rep, asio::use_awaitable);
+    BOOST_CHECK(rep.chunked());
+    BOOST_CHECK(rep.keep_alive());
+    BOOST_CHECK_EQUAL(CONTENT, rep.body());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Ingress_send_Relay_Until_EOF)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto client  = TestSocket{ex};
+    auto ingress = Ingress{{}, client.peer()};
+
+    co_await http::async_write(
+        client,
+        gen_request(http::verb::get, LOCALHOST_URI),
+        asio::use_awaitable
+    );
+
+    co_await ingress.read_remote();
+    co_await ingress.confirm();
+
+    // The response without the length is ended by closing the connection
+    auto buf = std::array<uint8_t, 1024>{};
+    co_await ingress.send(buf | views::take(serialize(gen_response(http::status::ok), buf)));
+
+    auto cache  = boost::beast::flat_buffer{};
+    auto parser = http::response_parser<http::empty_body>{};
+    co_await http::async_read_header(client, cache, parser, asio::use_awaitable);
+    verify_field(parser.get(), http::field::connection, CLOSE_FIELD);
+    verify_field(parser.get(), http::field::proxy_connection, CLOSE_FIELD);
+
+    co_await ingress.send(CONTENT);
+    auto fact = buf | views::take(co_await stream::read_some(client, buf));
+    BOOST_CHECK(rngs::equal(CONTENT, fact));
+    BOOST_CHECK(!ingress.responded());
+    BOOST_CHECK(!ingress.kept_alive());
   });
 }
 
@@ -0,0 +1,133 @@
+#define BOOST_TEST_MODULE pichi idle test
+
+#include "pichi/common/config.hpp"
+#include "utils.hpp"
+#include <array>
+#include <boost/asio/execution/context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/query.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <memory>
+#include <pichi/adapter/tcp/adapter.hpp>
+#include <pichi/common/literals.hpp>
+#include <pichi/service/clients.hpp>
+#include <pichi/stream/helpers.hpp>
+#include <tuple>
+#include <utility>
+
+using namespace std::literals;
+namespace asio = boost::asio;
+namespace sys  = boost::system;
+
+using asio::ip::tcp;
+
+namespace pichi::unit_test {
+
+using adapter::tcp::Direct;
+using adapter::tcp::Egress;
+using adapter::tcp::IdlePool;
+
+using Clock = std::chrono::steady_clock;
+
+static auto const CONNECTOR =
+    std::make_shared<adapter::tcp::Connector const>(vo::Egress{.type_ = AdapterType::DIRECT});
+
+// The direct egress, and the upstream connection accepted for it
+static Awaitable<std::tuple<Egress, tcp::socket, Endpoint>> connect(IOExecutor const& ex)
+{
+  asio::use_service<service::TcpClients>(asio::query(ex, asio::execution::context)).initialize(ex);
+
+  auto ac = tcp::acceptor{
+      ex, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}
+  };
+  auto remote = makeEndpoint("127.0.0.1", ac.local_endpoint().port());
+  auto egress = Egress{std::in_place_type<Direct>, ex};
+  co_await std::get<Direct>(egress).connect(remote);
+  auto upstream = co_await ac.async_accept(asio::use_awaitable);
+  co_return std::make_tuple(std::move(egress), std::move(upstream), std::move(remote));
+}
+
+// Whether the egress connection is closed by the pool
+static Awaitable<bool> closed(tcp::socket& upstream)
+{
+  auto buf = std::array<uint8_t, 1>{};
+  auto ec  = sys::error_code{};
+  co_await redirect(stream::read_some(upstream, buf), ec);
+  co_return ec == asio::error::eof;
+}
+
+static Awaitable<void> wait(IOExecutor const& ex, Clock::duration duration)
+{
+  auto timer = asio::steady_timer{ex, duration};
+  co_await timer.async_wait(asio::use_awaitable);
+}
+
+BOOST_AUTO_TEST_SUITE(IDLE)
+
+BOOST_AUTO_TEST_CASE(acquire_Alive)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto&& pool                     = adapter::tcp::get_idle_pool(ex);
+    auto [egress, upstream, remote] = co_await connect(ex);
+
+    pool.release(CONNECTOR, remote, std::move(egress));
+    BOOST_CHECK(!pool.acquire(CONNECTOR, makeEndpoint("127.0.0.1", 1_u16)).has_value());
+
+    auto idle = pool.acquire(CONNECTOR, remote);
+    BOOST_REQUIRE(idle.has_value());
+    BOOST_CHECK(std::holds_alternative<Direct>(*idle));
+    BOOST_CHECK(!pool.acquire(CONNECTOR, remote).has_value());
+
+    co_await std::get<Direct>(*idle).close();
+  });
+}
+
+BOOST_AUTO_TEST_CASE(acquire_Closed_By_Upstream)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto&& pool                     = adapter::tcp::get_idle_pool(ex);
+    auto [egress, upstream, remote] = co_await connect(ex);
+
+    pool.release(CONNECTOR, remote, std::move(egress));
+    upstream.close();
+
+    // The FIN arrives after a while
+    co_await wait(ex, 100ms);
+    BOOST_CHECK(!pool.acquire(CONNECTOR, remote).has_value());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(acquire_Unsolicited_Response)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto&& pool                     = adapter::tcp::get_idle_pool(ex);
+    auto [egress, upstream, remote] = co_await connect(ex);
+
+    pool.release(CONNECTOR, remote, std::move(egress));
+    co_await stream::write(upstream, "HTTP/1.1 408 Request Timeout\r\n\r\n"sv);
+
+    co_await wait(ex, 100ms);
+    BOOST_CHECK(!pool.acquire(CONNECTOR, remote).has_value());
+    BOOST_CHECK(co_await closed(upstream));
+  });
+}
+
+BOOST_AUTO_TEST_CASE(release_Expired_By_Timer)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto&& pool                     = adapter::tcp::get_idle_pool(ex);
+    auto [egress, upstream, remote] = co_await connect(ex);
+
+    // The egress is closed without any following acquisition
+    auto since = Clock::now();
+    pool.release(CONNECTOR, remote, std::move(egress));
+    BOOST_CHECK(co_await closed(upstream));
+    BOOST_CHECK(Clock::now() - since >= IdlePool::TIMEOUT);
+    BOOST_CHECK(!pool.acquire(CONNECTOR, remote).has_value());
+  });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace pichi::unit_test
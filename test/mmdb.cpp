@@ -0,0 +1,63 @@
+#define BOOST_TEST_MODULE pichi mmdb test
+
+#include "utils.hpp"
+#include <boost/asio/io_context.hpp>
+#include <pichi/service/mmdb.hpp>
+#include <string>
+
+using namespace std::literals;
+namespace asio = boost::asio;
+namespace ip   = asio::ip;
+
+namespace pichi::unit_test {
+
+BOOST_AUTO_TEST_SUITE(MMDB)
+
+BOOST_AUTO_TEST_CASE(intern_Same_Country)
+{
+  auto io    = asio::io_context{};
+  auto& mmdb = asio::use_service<service::Mmdb>(io);
+  BOOST_CHECK_EQUAL(mmdb.intern("AU"), mmdb.intern("AU"s));
+  BOOST_CHECK_NE(mmdb.intern("AU"), mmdb.intern("US"));
+  BOOST_CHECK_NE(mmdb.intern("AU"), mmdb.intern("au"));
+}
+
+BOOST_AUTO_TEST_CASE(lookup_Uninitialized)
+{
+  auto io = asio::io_context{};
+  BOOST_CHECK(!asio::use_service<service::Mmdb>(io).lookup(ip::make_address("1.1.1.1")));
+}
+
+BOOST_AUTO_TEST_CASE(lookup_Countries)
+{
+  auto io    = asio::io_context{};
+  auto& mmdb = asio::use_service<service::Mmdb>(io);
+  mmdb.initialize("geo.mmdb"s);
+
+  auto au = mmdb.intern("AU");
+  BOOST_CHECK(mmdb.lookup(ip::make_address("1.1.1.1")) == au);
+  BOOST_CHECK(mmdb.lookup(ip::make_address("::ffff:1.1.1.1")) == au);
+  BOOST_CHECK(mmdb.lookup(ip::make_address("8.8.8.8")) != au);
+}
+
+BOOST_AUTO_TEST_CASE(lookup_Cached)
+{
+  auto io    = asio::io_context{};
+  auto& mmdb = asio::use_service<service::Mmdb>(io);
+  mmdb.initialize("geo.mmdb"s);
+
+  for (auto&& address : {"1.1.1.1", "8.8.8.8", "127.0.0.1"}) {
+    auto first = mmdb.lookup(ip::make_address(address));
+    BOOST_CHECK(first == mmdb.lookup(ip::make_address(address)));
+  }
+
+  // The absent country of 127.0.0.1 is cached as well
+  auto stats = mmdb.stats();
+  BOOST_CHECK_EQUAL(3, stats.entries_);
+  BOOST_CHECK_EQUAL(3, stats.hits_);
+  BOOST_CHECK_EQUAL(3, stats.misses_);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace pichi::unit_test
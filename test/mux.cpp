@@ -0,0 +1,190 @@
+#define BOOST_TEST_MODULE pichi mux test
+
+#include "utils.hpp"
+#include <algorithm>
+#include <array>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <memory>
+#include <pichi/adapter/tcp/adapter.hpp>
+#include <pichi/adapter/tcp/mux.hpp>
+#include <pichi/common/literals.hpp>
+#include <pichi/stream/test.hpp>
+#include <ranges>
+#include <vector>
+
+using namespace std::literals;
+namespace asio = boost::asio;
+namespace mux  = pichi::adapter::tcp::mux;
+namespace rngs = std::ranges;
+namespace sys  = boost::system;
+
+namespace pichi::unit_test {
+
+using Ingress = adapter::tcp::TrojanIngress<TestSocket>;
+using Egress  = adapter::tcp::TrojanEgress<TestSocket>;
+using Streams = std::vector<std::shared_ptr<mux::Stream>>;
+
+static auto const PASSWORD = "pichi"s;
+static auto const REMOTE   = makeEndpoint("127.0.0.1", "443");
+
+static auto const IVO = vo::Ingress{
+    .type_       = AdapterType::TROJAN,
+    .credential_ = vo::TrojanIngressCredential{.credential_ = {PASSWORD}},
+    .opt_        = vo::TrojanOption{.remote_ = makeEndpoint("localhost", "80"), .mux_ = true}
+};
+
+static auto const EVO = vo::Egress{
+    .type_       = AdapterType::TROJAN,
+    .server_     = REMOTE,
+    .credential_ = vo::TrojanEgressCredential{.credential_ = PASSWORD},
+    .mux_        = vo::MuxOption{.connections_ = 2, .streams_ = 1},
+};
+
+static Awaitable<void> echo(std::shared_ptr<mux::Stream> stream)
+{
+  auto buf = std::array<uint8_t, 1024>{};
+  auto ec  = sys::error_code{};
+  while (!ec) {
+    auto n = co_await redirect(stream->recv(buf), ec);
+    if (!ec) co_await stream->send({buf, *n});
+  }
+  co_await stream->close();
+}
+
+// Connect both sides of a multiplexed connection, whose streams are handed to accept
+template <typename Executor>
+static Awaitable<std::shared_ptr<mux::Link>> multiplex(Executor ex, mux::Accept accept)
+{
+  auto socket  = TestSocket{ex};
+  auto ingress = Ingress{IVO, socket.peer()};
+  auto link    = co_await mux::connect(ex, Egress{EVO, std::move(socket)});
+
+  co_await ingress.read_remote();
+  BOOST_CHECK(ingress.multiplexed());
+
+  asio::co_spawn(ex, mux::serve(ex, std::move(ingress), std::move(accept)), asio::detached);
+  co_return link;
+}
+
+BOOST_AUTO_TEST_SUITE(MUX)
+
+BOOST_AUTO_TEST_CASE(Ingress_read_remote_Connect_Not_Multiplexed)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto socket  = TestSocket{ex};
+    auto ingress = Ingress{IVO, socket.peer()};
+    auto egress  = Egress{EVO, std::move(socket)};
+
+    co_await egress.connect(REMOTE);
+
+    BOOST_CHECK(co_await ingress.read_remote() == REMOTE);
+    BOOST_CHECK(!ingress.multiplexed());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Ingress_read_remote_Mux_Disabled)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto ivo     = IVO;
+    ivo.opt_     = vo::TrojanOption{.remote_ = makeEndpoint("localhost", "80")};
+    auto socket  = TestSocket{ex};
+    auto ingress = Ingress{ivo, socket.peer()};
+    auto egress  = Egress{EVO, std::move(socket)};
+
+    // The MUX command is taken as a non-Trojan request, which falls back to the remote
+    co_await egress.multiplex();
+    BOOST_CHECK(co_await ingress.read_remote() == makeEndpoint("localhost", "80"));
+    BOOST_CHECK(!ingress.multiplexed());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Stream_Echo_Beyond_Window)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto link = co_await multiplex(ex, [ex](auto stream, auto remote) {
+      BOOST_CHECK(remote == REMOTE);
+      asio::co_spawn(ex, echo(std::move(stream)), asio::detached);
+    });
+
+    auto data = std::vector<uint8_t>(mux::WINDOW * 2 + 1);
+    rngs::generate(data, [i = 0_u8]() mutable { return i++; });
+
+    // Both streams are sending before either one is received
+    auto streams = Streams{co_await link->open(REMOTE), co_await link->open(REMOTE)};
+    for (auto&& stream : streams)
+      asio::co_spawn(ex, stream->send(data), asio::detached);
+    BOOST_CHECK_EQUAL(link->streams(), 2_sz);
+
+    for (auto&& stream : streams) {
+      auto fact = std::vector<uint8_t>(data.size());
+      for (auto buf = MutableBuffer{fact}; buf.size() > 0;) buf += co_await stream->recv(buf);
+      BOOST_CHECK(fact == data);
+      co_await stream->close();
+    }
+    BOOST_CHECK_EQUAL(link->streams(), 0_sz);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Stream_close_Peer_Receives_EOF)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto done = asio::steady_timer{ex, asio::steady_timer::time_point::max()};
+    auto link = co_await multiplex(ex, [ex, &done](auto stream, auto) {
+      auto verify = [&done, stream]() -> Awaitable<void> {
+        auto buf = std::array<uint8_t, 16>{};
+        auto len = co_await stream->recv(buf);
+        BOOST_CHECK_EQUAL(len, buf.size());
+        BOOST_CHECK_EXCEPTION(co_await stream->recv(buf), SystemError, verify_eof);
+        done.cancel();
+      };
+      asio::co_spawn(ex, std::move(verify), asio::detached);
+    });
+
+    auto buf    = std::array<uint8_t, 16>{};
+    auto stream = co_await link->open(REMOTE);
+    co_await stream->send(buf);
+    co_await stream->close();
+    BOOST_CHECK_EXCEPTION(
+        co_await stream->recv(buf),
+        SystemError,
+        verify_exception<asio::error::operation_aborted>
+    );
+
+    auto ec = co_await redirect(done.async_wait(asio::use_awaitable));
+    BOOST_CHECK(ec == asio::error::operation_aborted);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Pool_acquire_Least_Loaded)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto connector = std::make_shared<adapter::tcp::Connector const>(EVO);
+    auto peers     = std::vector<TestSocket>{};
+    auto dial      = [&peers, ex]() {
+      auto socket = TestSocket{ex};
+      peers.push_back(socket.peer());
+      return mux::connect(ex, Egress{EVO, std::move(socket)});
+    };
+
+    auto& pool    = mux::get_pool(ex);
+    auto  streams = Streams{};
+
+    auto first = co_await pool.acquire(connector, dial);
+    streams.push_back(co_await first->open(REMOTE));
+
+    // The first connection is full, and the second one is allowed
+    auto second = co_await pool.acquire(connector, dial);
+    BOOST_CHECK(first != second);
+    streams.push_back(co_await second->open(REMOTE));
+
+    // No more connection is allowed, so that the full ones are shared
+    auto third = co_await pool.acquire(connector, dial);
+    BOOST_CHECK(third == first || third == second);
+    BOOST_CHECK_EQUAL(peers.size(), 2_sz);
+  });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace pichi::unit_test
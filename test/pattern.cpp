@@ -0,0 +1,154 @@
+#define BOOST_TEST_MODULE pichi pattern test
+
+#include "utils.hpp"
+#include <boost/test/unit_test.hpp>
+#include <optional>
+#include <pichi/common/pattern.hpp>
+#include <regex>
+#include <string>
+#include <string_view>
+
+using namespace std::literals;
+
+namespace pichi::unit_test {
+
+static std::optional<size_t> match(std::string_view pattern, std::string_view input)
+{
+  auto set = PatternSet{};
+  set.add(pattern, 0);
+  return set.match(input);
+}
+
+static void verify(std::string const& pattern, std::initializer_list<std::string> inputs)
+{
+  auto re = std::regex{pattern};
+  for (auto&& input : inputs)
+    BOOST_CHECK_MESSAGE(
+        std::regex_search(input, re) == match(pattern, input).has_value(),
+        "/" << pattern << "/ on \"" << input << "\""
+    );
+}
+
+BOOST_AUTO_TEST_SUITE(PATTERN)
+
+BOOST_AUTO_TEST_CASE(match_Empty_Set)
+{
+  BOOST_CHECK(!PatternSet{}.match(""sv).has_value());
+  BOOST_CHECK(!PatternSet{}.match("example.com"sv).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(match_Literals)
+{
+  verify("example", {"", "example", "www.example.com", "exampl", "EXAMPLE"});
+  verify("a\\.b", {"a.b", "axb", "xa.bx"});
+  verify("\\x41\\t", {"A\t", "a\t", "A"});
+}
+
+BOOST_AUTO_TEST_CASE(match_Anchors)
+{
+  verify("^localhost$", {"localhost", "localhost.", "my-localhost", ""});
+  verify("^.*\\.example\\.com$", {"foo.example.com", "fooexample.com", ".example.com"});
+  verify("^$", {"", "a"});
+  verify("a^", {"a", ""});
+}
+
+BOOST_AUTO_TEST_CASE(match_Classes)
+{
+  verify("[a-c]x", {"ax", "bx", "dx", "x"});
+  verify("[^a-c]x", {"ax", "dx", "x", "-x"});
+  verify("[a-]x", {"-x", "ax", "bx"});
+  verify("\\d+\\.\\d+", {"1.2", "a.b", "10.0.0.1"});
+  verify("[\\w.]+$", {"foo.bar", "foo-bar", "-"});
+  verify("\\S\\s\\W", {"a .", "a a", "  ."});
+}
+
+BOOST_AUTO_TEST_CASE(match_Groups_And_Alternations)
+{
+  verify("^(foo|bar)\\.com$", {"foo.com", "bar.com", "baz.com", "foobar.com"});
+  verify("(?:ab|cd)+e", {"abcde", "abe", "ace", "e"});
+  verify("a|", {"", "b"});
+  verify("(a|b(c|d))e", {"ae", "bce", "bde", "be"});
+}
+
+BOOST_AUTO_TEST_CASE(match_Quantifiers)
+{
+  verify("^a*$", {"", "aaa", "aab"});
+  verify("^a+?$", {"", "a", "aa"});
+  verify("^ab?c$", {"ac", "abc", "abbc"});
+  verify("^a{2}$", {"a", "aa", "aaa"});
+  verify("^a{2,}$", {"a", "aa", "aaaaa"});
+  verify("^a{1,3}$", {"", "a", "aaa", "aaaa"});
+  verify("^(a*)*b$", {"b", "aaaaab", "aaaaa"});
+}
+
+BOOST_AUTO_TEST_CASE(match_Least_Index)
+{
+  auto set = PatternSet{};
+  set.add("^.*\\.example\\.com$", 3);
+  set.add("foo", 5);
+  set.add("^bar", 1);
+  set.add("com$", 3);
+
+  BOOST_CHECK_EQUAL(3, set.match("www.example.com").value_or(0));
+  BOOST_CHECK_EQUAL(3, set.match("foo.example.com").value_or(0));
+  BOOST_CHECK_EQUAL(1, set.match("barfoo").value_or(0));
+  BOOST_CHECK_EQUAL(5, set.match("xbarfoo").value_or(0));
+  BOOST_CHECK_EQUAL(3, set.match("foo.com").value_or(0));
+  BOOST_CHECK(!set.match("example.org").has_value());
+}
+
+BOOST_AUTO_TEST_CASE(match_Linear_Time)
+{
+  // Catastrophic for backtracking engines
+  auto set = PatternSet{};
+  set.add("^(a|a)*(a*)*$b", 0);
+  BOOST_CHECK(!set.match(std::string(4096, 'a')).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(add_Unsupported)
+{
+  for (auto&& pattern : {"(a)\\1", "(?=a)", "(?!a)", "a\\b", "\\Ba", "\\q", "\\u0041"}) {
+    BOOST_CHECK_EXCEPTION(
+        PatternSet{}.add(pattern, 0),
+        SystemError,
+        verify_exception<PichiError::SEMANTIC_ERROR>
+    );
+  }
+}
+
+BOOST_AUTO_TEST_CASE(add_Malformed)
+{
+  for (auto&& pattern : {"(a", "a)", "[ab", "[z-a]", "*a", "a**", "^*", "a{2,1}", "a{", "\\x4"}) {
+    BOOST_CHECK_EXCEPTION(
+        PatternSet{}.add(pattern, 0),
+        SystemError,
+        verify_exception<PichiError::SEMANTIC_ERROR>
+    );
+  }
+}
+
+BOOST_AUTO_TEST_CASE(add_Too_Complex)
+{
+  BOOST_CHECK_EXCEPTION(
+      PatternSet{}.add("a{1001}", 0),
+      SystemError,
+      verify_exception<PichiError::SEMANTIC_ERROR>
+  );
+  BOOST_CHECK_EXCEPTION(
+      PatternSet{}.add("(a{1000}){1000}", 0),
+      SystemError,
+      verify_exception<PichiError::SEMANTIC_ERROR>
+  );
+  auto nested = std::string(PatternSet::MAX_DEPTH + 2, '(') + "a" +
+                std::string(PatternSet::MAX_DEPTH + 2, ')');
+  BOOST_CHECK_EXCEPTION(
+      PatternSet{}.add(nested, 0),
+      SystemError,
+      verify_exception<PichiError::SEMANTIC_ERROR>
+  );
+  PatternSet{}.add("a{1000}", 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace pichi::unit_test
@@ -0,0 +1,109 @@
+#define BOOST_TEST_MODULE pichi racing test
+
+#include "utils.hpp"
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <pichi/stream/racing.hpp>
+#include <vector>
+
+using namespace std::literals;
+namespace asio = boost::asio;
+namespace ip   = asio::ip;
+namespace sys  = boost::system;
+
+using ip::tcp;
+using Endpoints = std::vector<tcp::endpoint>;
+
+namespace pichi::unit_test {
+
+static auto const LOOPBACK = ip::make_address("127.0.0.1");
+
+template <typename... Args> tcp::resolver::results_type make_results(Args const&... args)
+{
+  auto endpoints = Endpoints{args...};
+  return tcp::resolver::results_type::create(
+      std::begin(endpoints), std::end(endpoints), "localhost", "0"
+  );
+}
+
+static tcp::acceptor make_acceptor(IOExecutor const& ex) { return {ex, {LOOPBACK, 0}}; }
+
+// An endpoint refusing any connection
+static tcp::endpoint make_closed(IOExecutor const& ex)
+{
+  return make_acceptor(ex).local_endpoint();
+}
+
+BOOST_AUTO_TEST_SUITE(RACING)
+
+BOOST_AUTO_TEST_CASE(race_Empty)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto s  = tcp::socket{ex};
+    auto ec = sys::error_code{};
+    co_await redirect(stream::race(s, make_results(), 0ms), ec);
+    BOOST_CHECK(ec == asio::error::host_not_found);
+    BOOST_CHECK(!s.is_open());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(race_Single)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto ac = make_acceptor(ex);
+    auto s  = tcp::socket{ex};
+    co_await stream::race(s, make_results(ac.local_endpoint()), 10s);
+    BOOST_CHECK(ac.local_endpoint() == s.remote_endpoint());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(race_Fallback_On_Failure)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto ac    = make_acceptor(ex);
+    auto s     = tcp::socket{ex};
+    auto start = std::chrono::steady_clock::now();
+    co_await stream::race(s, make_results(make_closed(ex), ac.local_endpoint()), 10s);
+    // The failure of the first attempt starts the next one without waiting for the delay
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < 5s);
+    BOOST_CHECK(ac.local_endpoint() == s.remote_endpoint());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(race_All_Failed)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto s  = tcp::socket{ex};
+    auto ec = sys::error_code{};
+    co_await redirect(stream::race(s, make_results(make_closed(ex), make_closed(ex)), 0ms), ec);
+    BOOST_CHECK(ec == asio::error::connection_refused);
+    BOOST_CHECK(!s.is_open());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(race_First_Established_Wins)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto first  = make_acceptor(ex);
+    auto second = make_acceptor(ex);
+    auto s      = tcp::socket{ex};
+    co_await stream::race(s, make_results(first.local_endpoint(), second.local_endpoint()), 10s);
+    BOOST_CHECK(first.local_endpoint() == s.remote_endpoint());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(race_Without_Delay)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto first  = make_acceptor(ex);
+    auto second = make_acceptor(ex);
+    auto s      = tcp::socket{ex};
+    co_await stream::race(s, make_results(first.local_endpoint(), second.local_endpoint()), 0ms);
+    auto remote = s.remote_endpoint();
+    BOOST_CHECK(remote == first.local_endpoint() || remote == second.local_endpoint());
+  });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace pichi::unit_test
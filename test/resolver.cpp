@@ -0,0 +1,167 @@
+#define BOOST_TEST_MODULE pichi resolver test
+
+#include "utils.hpp"
+#include <boost/asio/io_context.hpp>
+#include <pichi/common/literals.hpp>
+#include <pichi/service/resolver.hpp>
+#include <string>
+
+using namespace std::literals;
+namespace asio = boost::asio;
+
+namespace pichi::unit_test {
+
+static void run_resolving(asio::io_context& io, std::string const& host, size_t n)
+{
+  for (auto i = 0_sz; i < n; ++i)
+    asio::co_spawn(
+        io,
+        [&]() -> Awaitable<void> {
+          auto ec = boost::system::error_code{};
+          co_await redirect(service::get_resolver(io.get_executor()).resolve(host, 80), ec);
+        },
+        [](auto&& eptr) { BOOST_CHECK(!eptr); }
+    );
+  io.run();
+  io.restart();
+}
+
+BOOST_AUTO_TEST_SUITE(RESOLVER)
+
+BOOST_AUTO_TEST_CASE(resolve_Cached)
+{
+  auto io        = asio::io_context{};
+  auto& resolver = service::get_resolver(io.get_executor());
+
+  asio::co_spawn(
+      io,
+      [&]() -> Awaitable<void> {
+        auto first  = co_await resolver.resolve("localhost"s, 80);
+        auto second = co_await resolver.resolve("localhost"s, 80);
+        BOOST_CHECK(!first.empty());
+        BOOST_CHECK(first == second);
+        BOOST_CHECK_EQUAL(80, first.begin()->endpoint().port());
+      },
+      [](auto&& eptr) { BOOST_CHECK(!eptr); }
+  );
+  io.run();
+
+  auto stats = resolver.stats();
+  BOOST_CHECK_EQUAL(1, stats.entries_);
+  BOOST_CHECK_EQUAL(1, stats.hits_);
+  BOOST_CHECK_EQUAL(1, stats.misses_);
+}
+
+BOOST_AUTO_TEST_CASE(resolve_Different_Ports)
+{
+  auto io = asio::io_context{};
+  run_resolving(io, "localhost"s, 1);
+
+  asio::co_spawn(
+      io,
+      [&]() -> Awaitable<void> {
+        auto rs = co_await service::get_resolver(io.get_executor()).resolve("localhost"s, 443);
+        BOOST_CHECK_EQUAL(443, rs.begin()->endpoint().port());
+      },
+      [](auto&& eptr) { BOOST_CHECK(!eptr); }
+  );
+  io.run();
+
+  auto stats = service::get_resolver(io.get_executor()).stats();
+  BOOST_CHECK_EQUAL(2, stats.entries_);
+  BOOST_CHECK_EQUAL(2, stats.misses_);
+}
+
+BOOST_AUTO_TEST_CASE(resolve_Coalesced)
+{
+  auto io = asio::io_context{};
+  run_resolving(io, "localhost"s, 8);
+
+  auto stats = service::get_resolver(io.get_executor()).stats();
+  BOOST_CHECK_EQUAL(1, stats.misses_);
+  BOOST_CHECK_EQUAL(7, stats.hits_);
+}
+
+BOOST_AUTO_TEST_CASE(resolve_Negative_Cached)
+{
+  auto io        = asio::io_context{};
+  auto& resolver = service::get_resolver(io.get_executor());
+
+  asio::co_spawn(
+      io,
+      [&]() -> Awaitable<void> {
+        auto first  = boost::system::error_code{};
+        auto second = boost::system::error_code{};
+        co_await redirect(resolver.resolve("pichi.invalid"s, 80), first);
+        co_await redirect(resolver.resolve("pichi.invalid"s, 80), second);
+        BOOST_CHECK(first);
+        BOOST_CHECK(first == second);
+      },
+      [](auto&& eptr) { BOOST_CHECK(!eptr); }
+  );
+  io.run();
+
+  auto stats = resolver.stats();
+  BOOST_CHECK_EQUAL(1, stats.hits_);
+  BOOST_CHECK_EQUAL(1, stats.misses_);
+}
+
+BOOST_AUTO_TEST_CASE(resolve_Without_Caching)
+{
+  auto io        = asio::io_context{};
+  auto& resolver = service::get_resolver(io.get_executor());
+  resolver.configure(0s, 0s, service::Resolver::DEFAULT_DELAY);
+
+  run_resolving(io, "localhost"s, 1);
+  run_resolving(io, "localhost"s, 1);
+
+  auto stats = resolver.stats();
+  BOOST_CHECK_EQUAL(0, stats.hits_);
+  BOOST_CHECK_EQUAL(2, stats.misses_);
+}
+
+BOOST_AUTO_TEST_CASE(resolve_Oldest_Evicted)
+{
+  auto const MAX = service::Resolver::MAX_ENTRIES;
+
+  auto io        = asio::io_context{};
+  auto& resolver = service::get_resolver(io.get_executor());
+
+  asio::co_spawn(
+      io,
+      [&]() -> Awaitable<void> {
+        for (auto port = 1_sz; port <= MAX; ++port)
+          co_await resolver.resolve("localhost"s, static_cast<uint16_t>(port));
+        BOOST_CHECK_EQUAL(MAX, resolver.stats().entries_);
+
+        // Only the oldest answers are evicted by the lookup overflowing the cache
+        co_await resolver.resolve("localhost"s, 0);
+        auto stats = resolver.stats();
+        BOOST_CHECK_EQUAL(MAX - MAX / 8 + 1, stats.entries_);
+
+        co_await resolver.resolve("localhost"s, static_cast<uint16_t>(MAX));
+        BOOST_CHECK_EQUAL(stats.hits_ + 1, resolver.stats().hits_);
+      },
+      [](auto&& eptr) { BOOST_CHECK(!eptr); }
+  );
+  io.run();
+}
+
+BOOST_AUTO_TEST_CASE(clear)
+{
+  auto io        = asio::io_context{};
+  auto& resolver = service::get_resolver(io.get_executor());
+
+  run_resolving(io, "localhost"s, 1);
+  BOOST_CHECK_EQUAL(1, resolver.stats().entries_);
+
+  resolver.clear();
+  BOOST_CHECK_EQUAL(0, resolver.stats().entries_);
+
+  run_resolving(io, "localhost"s, 1);
+  BOOST_CHECK_EQUAL(2, resolver.stats().misses_);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace pichi::unit_test
@@ -54,7 +54,7 @@ template <typename Arg>
 requires(
     std::same_as<Arg, Endpoint> || std::same_as<Arg, std::string> || std::same_as<Arg, AdapterType>
 )
-Awaitable<std::tuple<std::string, std::string, vo::Egress>>
+Awaitable<actor::Router::Result>
     route(IOExecutor const& ex, vo::Rule const& rule, Arg const& arg, std::string_view rr)
 {
   auto& mmdb = asio::use_service<service::Mmdb>(asio::query(ex, asio::execution::context));
@@ -78,7 +78,7 @@ void run_generic_test(
 )
 {
   run_case([=](auto&& ex) -> Awaitable<void> {
-    auto [r, e, _] = co_await route(ex, rule, arg, rr);
+    auto [r, e, _, __] = co_await route(ex, rule, arg, rr);
     if (matched) {
       BOOST_CHECK_EQUAL(SPEC_RULE, r);
       BOOST_CHECK_EQUAL(SPEC_EGRESS, e);
@@ -212,6 +212,227 @@ BOOST_AUTO_TEST_CASE(Matcher_match_Domains_Case_Insensitive)
   run_domain_test(true, "Example.com", "example.Com");
 }
 
+BOOST_AUTO_TEST_CASE(Router_route_Domains_First_Rule)
+{
+  auto const rules = std::unordered_map<std::string, vo::Rule>{
+      {"generic"s,  {.domain_ = {"example.com"s, "example.org"s}}},
+      {"specific"s, {.domain_ = {".FOO.example.com"s}}          },
+  };
+  auto const generic_first = vo::Route{
+      .default_ = DEFT_EGRESS,
+      .rules_   = {std::make_pair(std::vector<std::string>{"generic"s, "specific"s}, SPEC_EGRESS)},
+  };
+  auto const specific_first = vo::Route{
+      .default_ = DEFT_EGRESS,
+      .rules_   = {std::make_pair(std::vector<std::string>{"specific"s}, SPEC_EGRESS),
+                   std::make_pair(std::vector<std::string>{"generic"s}, DEFT_EGRESS)},
+  };
+
+  run_case([&](auto&& ex) -> Awaitable<void> {
+    // The arguments must outlive the routing, which is awaited lazily
+    auto route = [&](auto&& router, std::string host) -> Awaitable<actor::Router::Result> {
+      co_return co_await router.route(
+          makeEndpoint(host, 0), ""s, AdapterType::DIRECT, resolve(""sv)
+      );
+    };
+
+    auto generic = actor::Router{ex, EGRESSES, rules, generic_first};
+    BOOST_CHECK_EQUAL("generic"s, std::get<0>(co_await route(generic, "bar.foo.example.com"s)));
+    BOOST_CHECK_EQUAL("generic"s, std::get<0>(co_await route(generic, "foo.example.org"s)));
+    BOOST_CHECK_EQUAL(DEFT_RULE, std::get<0>(co_await route(generic, "example.net"s)));
+
+    auto specific = actor::Router{ex, EGRESSES, rules, specific_first};
+    BOOST_CHECK_EQUAL("specific"s, std::get<0>(co_await route(specific, "bar.foo.example.com"s)));
+    BOOST_CHECK_EQUAL("specific"s, std::get<0>(co_await route(specific, "Foo.Example.Com"s)));
+    BOOST_CHECK_EQUAL("generic"s, std::get<0>(co_await route(specific, "barfoo.example.com"s)));
+    BOOST_CHECK_EQUAL(DEFT_RULE, std::get<0>(co_await route(specific, "example.net"s)));
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Router_route_Ranges_First_Rule)
+{
+  auto const rules = std::unordered_map<std::string, vo::Rule>{
+      {"wide"s,   {.range_ = {"10.0.0.0/8"s, "fd00::/8"s}}     },
+      {"narrow"s, {.range_nr_ = {"10.1.0.0/16"s, "fd00::/16"s}}},
+  };
+  auto const route = vo::Route{
+      .default_ = DEFT_EGRESS,
+      .rules_   = {std::make_pair(std::vector<std::string>{"narrow"s}, SPEC_EGRESS),
+                   std::make_pair(std::vector<std::string>{"wide"s}, DEFT_EGRESS)},
+  };
+
+  run_case([&](auto&& ex) -> Awaitable<void> {
+    auto router = actor::Router{ex, EGRESSES, rules, route};
+    auto match  = [&](auto&& host, auto&& rr) -> Awaitable<std::string> {
+      auto [r, _, __, ___] =
+          co_await router.route(makeEndpoint(host, 0), ""s, AdapterType::DIRECT, resolve(rr));
+      co_return r;
+    };
+
+    BOOST_CHECK_EQUAL("narrow"s, co_await match("10.1.255.255"s, ""sv));
+    BOOST_CHECK_EQUAL("wide"s, co_await match("10.2.0.0"s, ""sv));
+    BOOST_CHECK_EQUAL("narrow"s, co_await match("fd00::1"s, ""sv));
+    BOOST_CHECK_EQUAL("wide"s, co_await match("fd01::"s, ""sv));
+    BOOST_CHECK_EQUAL(DEFT_RULE, co_await match("127.0.0.1"s, ""sv));
+    // No resolving for the preceding rules without needing it
+    BOOST_CHECK_EQUAL("wide"s, co_await match("example.com"s, "10.1.0.0"sv));
+    BOOST_CHECK_EQUAL(DEFT_RULE, co_await match("example.com"s, "127.0.0.1"sv));
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Router_route_Resolved_Results)
+{
+  auto const rules = std::unordered_map<std::string, vo::Rule>{
+      {"domain"s, {.domain_ = {"example.org"s}}},
+      {"range"s,  {.range_ = {"10.0.0.0/8"s}}  },
+  };
+  auto const route = vo::Route{
+      .default_ = DEFT_EGRESS,
+      .rules_   = {std::make_pair(std::vector<std::string>{"domain"s}, SPEC_EGRESS),
+                   std::make_pair(std::vector<std::string>{"range"s}, DEFT_EGRESS)},
+  };
+
+  run_case([&](auto&& ex) -> Awaitable<void> {
+    auto router   = actor::Router{ex, EGRESSES, rules, route};
+    auto resolved = [&](auto&& host, auto&& rr) -> Awaitable<std::optional<ResolveResults>> {
+      auto [_, __, ___, rs] =
+          co_await router.route(makeEndpoint(host, 0), ""s, AdapterType::DIRECT, resolve(rr));
+      co_return rs;
+    };
+
+    // Routed before resolving
+    auto routed = co_await resolved("example.org"s, ""sv);
+    BOOST_CHECK(!routed.has_value());
+
+    // No need to resolve an IP address
+    auto ip = co_await resolved("10.0.0.1"s, ""sv);
+    BOOST_CHECK(!ip.has_value());
+
+    auto matched = co_await resolved("example.com"s, "10.0.0.1"sv);
+    BOOST_REQUIRE(matched.has_value());
+    BOOST_CHECK_EQUAL("10.0.0.1"s, matched->begin()->endpoint().address().to_string());
+
+    auto unmatched = co_await resolved("example.com"s, "127.0.0.1"sv);
+    BOOST_REQUIRE(unmatched.has_value());
+    BOOST_CHECK_EQUAL("127.0.0.1"s, unmatched->begin()->endpoint().address().to_string());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Router_route_Cached)
+{
+  auto const rules = std::unordered_map<std::string, vo::Rule>{
+      {SPEC_RULE, {.range_ = {"10.0.0.0/8"s}}}
+  };
+
+  run_case([&](auto&& ex) -> Awaitable<void> {
+    auto router = actor::Router{ex, EGRESSES, rules, ROUTE, 2};
+    auto route  = [&](auto&& host, auto&& iname, auto&& rr) -> Awaitable<std::string> {
+      auto [r, _, __, ___] =
+          co_await router.route(makeEndpoint(host, 0), iname, AdapterType::DIRECT, resolve(rr));
+      co_return r;
+    };
+
+    BOOST_CHECK_EQUAL(SPEC_RULE, co_await route("example.com"s, "foo"s, "10.0.0.1"sv));
+    // Resolving is prohibited by the empty record, so the decision must be cached
+    BOOST_CHECK_EQUAL(SPEC_RULE, co_await route("example.com"s, "foo"s, ""sv));
+    BOOST_CHECK_EQUAL(DEFT_RULE, co_await route("example.com"s, "bar"s, "127.0.0.1"sv));
+    BOOST_CHECK_EQUAL(DEFT_RULE, co_await route("example.com"s, "bar"s, ""sv));
+
+    auto stats = router.stats();
+    BOOST_CHECK_EQUAL(2, stats.capacity_);
+    BOOST_CHECK_EQUAL(2, stats.entries_);
+    BOOST_CHECK_EQUAL(2, stats.hits_);
+    BOOST_CHECK_EQUAL(2, stats.misses_);
+
+    // The least recently used decision is evicted
+    BOOST_CHECK_EQUAL(SPEC_RULE, co_await route("example.org"s, "foo"s, "10.0.0.1"sv));
+    BOOST_CHECK_EQUAL(DEFT_RULE, co_await route("example.com"s, "bar"s, ""sv));
+    auto [ec, _] = co_await redirect(route("example.com"s, "foo"s, ""sv));
+    BOOST_CHECK(ec == RESOLV_ERROR);
+    BOOST_CHECK_EQUAL(2, router.stats().entries_);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Router_route_Shared_Connector)
+{
+  auto const egresses = std::unordered_map<std::string, vo::Egress>{
+      {SPEC_EGRESS,
+       {.type_       = AdapterType::SOCKS5,
+        .server_     = makeEndpoint("localhost"s, 1080),
+        .credential_ = vo::UpEgressCredential{.credential_ = {"foo"s, "bar"s}}}},
+  };
+  auto const rules = std::unordered_map<std::string, vo::Rule>{
+      {SPEC_RULE, {.range_ = {"10.0.0.0/8"s}}}
+  };
+  auto const route = vo::Route{
+      .default_ = SPEC_EGRESS,
+      .rules_   = {std::make_pair(std::vector<std::string>{SPEC_RULE}, SPEC_EGRESS)},
+  };
+
+  run_case([&](auto&& ex) -> Awaitable<void> {
+    auto router = actor::Router{ex, egresses, rules, route};
+    auto [r0, _0, matched, __0] = co_await router.route(
+        makeEndpoint("example.com"s, 0), ""s, AdapterType::DIRECT, resolve("10.0.0.1"sv)
+    );
+    auto [r1, _1, unmatched, __1] = co_await router.route(
+        makeEndpoint("example.com"s, 0), ""s, AdapterType::DIRECT, resolve("127.0.0.1"sv)
+    );
+    BOOST_CHECK_EQUAL(SPEC_RULE, r0);
+    BOOST_CHECK_EQUAL(DEFT_RULE, r1);
+
+    // The egress is compiled only once, whichever rule it's routed by
+    BOOST_REQUIRE(matched);
+    BOOST_CHECK(matched == unmatched);
+    BOOST_CHECK(AdapterType::SOCKS5 == matched->vo().type_);
+    BOOST_CHECK_EQUAL("\x01\x03" "foo" "\x03" "bar"s, matched->credential());
+    BOOST_CHECK(!matched->tls());
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Router_tls_stats)
+{
+  auto const egresses = std::unordered_map<std::string, vo::Egress>{
+      {SPEC_EGRESS,
+       {.type_   = AdapterType::SOCKS5,
+        .server_ = makeEndpoint("localhost"s, 1080),
+        .tls_    = vo::TlsEgressOption{.insecure_ = true}}},
+      {DEFT_EGRESS, {.type_ = AdapterType::DIRECT}},
+  };
+  auto const rules = std::unordered_map<std::string, vo::Rule>{
+      {SPEC_RULE, {.range_ = {"10.0.0.0/8"s}}}
+  };
+  auto const route = vo::Route{
+      .default_ = SPEC_EGRESS,
+      .rules_   = {std::make_pair(std::vector<std::string>{SPEC_RULE}, DEFT_EGRESS)},
+  };
+
+  run_case([&](auto&& ex) -> Awaitable<void> {
+    auto router = actor::Router{ex, egresses, rules, route};
+
+    // Only the egresses over TLS are counted
+    auto stats = router.tls_stats();
+    BOOST_REQUIRE_EQUAL(1, stats.size());
+    BOOST_CHECK_EQUAL(0, stats.at(SPEC_EGRESS).handshakes_);
+    BOOST_CHECK_EQUAL(0, stats.at(SPEC_EGRESS).resumed_);
+    co_return;
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Router_route_Uncached)
+{
+  run_case([&](auto&& ex) -> Awaitable<void> {
+    auto router = actor::Router{ex, EGRESSES, RULES, ROUTE};
+    co_await router.route(makeEndpoint("example.com"s, 0), ""s, AdapterType::DIRECT, resolve(""sv));
+    co_await router.route(makeEndpoint("example.com"s, 0), ""s, AdapterType::DIRECT, resolve(""sv));
+
+    auto stats = router.stats();
+    BOOST_CHECK_EQUAL(0, stats.capacity_);
+    BOOST_CHECK_EQUAL(0, stats.entries_);
+    BOOST_CHECK_EQUAL(0, stats.hits_);
+    BOOST_CHECK_EQUAL(0, stats.misses_);
+  });
+}
+
 BOOST_AUTO_TEST_CASE(Router_Router_Bad_Input)
 {
   auto io = asio::io_context{};
@@ -240,6 +461,18 @@ BOOST_AUTO_TEST_CASE(Matcher_match_Ranges)
   run_range_test(false, "fe00::1", "fd00::/8");
 }
 
+BOOST_AUTO_TEST_CASE(Matcher_match_Ranges_Network_And_Broadcast)
+{
+  run_range_test(true, "10.0.0.0", "10.0.0.0/8");
+  run_range_test(true, "10.255.255.255", "10.0.0.0/8");
+  run_range_test(true, "255.255.255.255", "0.0.0.0/0");
+  run_range_test(true, "10.1.1.1", "10.1.1.1/32");
+  run_range_test(true, "fd00::", "fd00::/8");
+  run_range_test(true, "fdff:ffff:ffff:ffff:ffff:ffff:ffff:ffff", "fd00::/8");
+  run_range_test(false, "11.0.0.0", "10.0.0.0/8");
+  run_range_test(false, "fe00::", "fd00::/8");
+}
+
 BOOST_AUTO_TEST_CASE(Matcher_match_Ranges_With_Resolving)
 {
   run_range_test(RESOLV_ERROR, "example.com", "10.0.0.0/8");
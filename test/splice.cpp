@@ -0,0 +1,87 @@
+#define BOOST_TEST_MODULE pichi splice test
+
+#include "utils.hpp"
+#include <algorithm>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/experimental/parallel_group.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <pichi/common/config.hpp>
+#include <pichi/common/literals.hpp>
+#include <pichi/stream/helpers.hpp>
+#include <pichi/stream/splice.hpp>
+#include <ranges>
+#include <tuple>
+#include <vector>
+
+namespace asio = boost::asio;
+namespace rngs = std::ranges;
+namespace sys  = boost::system;
+
+using asio::ip::tcp;
+
+namespace pichi::unit_test {
+
+#ifdef HAS_SPLICE
+
+static Awaitable<std::tuple<tcp::socket, tcp::socket>> make_pair(IOExecutor const& ex)
+{
+  auto ac = tcp::acceptor{
+      ex, tcp::endpoint{asio::ip::make_address("127.0.0.1"), 0}
+  };
+  auto client = tcp::socket{ex};
+  co_await client.async_connect(ac.local_endpoint(), asio::use_awaitable);
+  auto server = co_await ac.async_accept(asio::use_awaitable);
+  co_return std::make_tuple(std::move(client), std::move(server));
+}
+
+BOOST_AUTO_TEST_SUITE(SPLICE)
+
+BOOST_AUTO_TEST_CASE(splice_Relay_Until_EOF)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto ingress = co_await make_pair(ex);
+    auto egress  = co_await make_pair(ex);
+    auto& src    = std::get<0>(ingress);
+    auto& from   = std::get<1>(ingress);
+    auto& to     = std::get<0>(egress);
+    auto& dst    = std::get<1>(egress);
+
+    auto sent = std::vector<uint8_t>(1024_sz * 1024_sz);
+    rngs::generate(sent, [i = 0_u8]() mutable { return i++; });
+
+    auto received = std::vector<uint8_t>(rngs::size(sent));
+
+    auto [order, e0, ec, e1, e2] =
+        co_await asio::experimental::make_parallel_group(
+            asio::co_spawn(
+                ex,
+                [&]() -> Awaitable<sys::error_code> {
+                  co_return co_await redirect(stream::splice(from, to));
+                },
+                asio::deferred
+            ),
+            asio::co_spawn(
+                ex,
+                [&]() -> Awaitable<void> {
+                  co_await stream::write(src, sent);
+                  src.shutdown(tcp::socket::shutdown_send);
+                },
+                asio::deferred
+            ),
+            asio::co_spawn(ex, stream::read(dst, received), asio::deferred)
+        )
+            .async_wait(asio::experimental::wait_for_all(), asio::use_awaitable);
+
+    BOOST_CHECK(!e0);
+    BOOST_CHECK(!e1);
+    BOOST_CHECK(!e2);
+    BOOST_CHECK(ec == asio::error::eof);
+    BOOST_CHECK(sent == received);
+  });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif  // HAS_SPLICE
+
+}  // namespace pichi::unit_test
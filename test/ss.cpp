@@ -3,13 +3,19 @@
 #include "pichi/common/config.hpp"
 #include "utils.hpp"
 #include <algorithm>
+#include <array>
+#include <boost/asio/io_context.hpp>
 #include <botan/exceptn.h>
 #include <botan/hex.h>
+#include <chrono>
+#include <functional>
+#include <iterator>
 #include <pichi/adapter/tcp/shadowsocks.hpp>
 #include <pichi/common/literals.hpp>
 #include <pichi/service/sentry.hpp>
 #include <pichi/stream/shadowsocks.hpp>
 #include <pichi/stream/test.hpp>
+#include <string>
 #include <utility>
 
 using namespace std::literals;
@@ -26,25 +32,40 @@ using Ingress = adapter::tcp::Shadowsocks<TestSocket>;
 using stream::detail::Decryptor;
 using stream::detail::Encryptor;
 
-using Buffer = std::array<uint8_t, 1024>;
-
 struct TestData {
   std::string              salt_;
   std::vector<std::string> ciphers_;
 };
 
 static auto const PASSWORD = "a flexible rule-based proxy"s;
+
+static stream::MasterKey key_of(CryptoMethod m) { return stream::derive_master_key(m, PASSWORD); }
 static auto const ENDPOINT = makeEndpoint("localhost", 443);
 
+using Buffer = std::array<uint8_t, 1024>;
+
+// The salt followed by an authenticated chunk, after which the salt is recorded
 static Awaitable<void> send_salt(IOExecutor const& ex, CryptoMethod m, size_t s, uint8_t c)
 {
-  auto salt   = std::vector<uint8_t>(s, c);
-  auto client = TestSocket{ex};
-  auto stream = Stream{m, PASSWORD, client.peer()};
+  auto salt      = std::vector<uint8_t>(s, c);
+  auto client    = TestSocket{ex};
+  auto stream    = Stream{m, key_of(m), client.peer()};
+  auto encryptor = Encryptor{m, *key_of(m), salt};
+
+  auto lb     = std::array<uint8_t, 2>{};
+  auto cipher = Buffer{};
+  hton(1_u16, lb);
+  auto n = encryptor.process(lb, cipher);
+  n += encryptor.process(std::array{c}, MutableBuffer{cipher} + n);
 
   co_await stream::write(client, salt);
+  co_await stream::write(client, ConstBuffer{cipher, n});
 
   co_await stream.async_accept(asio::use_awaitable);
+
+  auto buf = Buffer{};
+  BOOST_CHECK_EQUAL(1_sz, co_await stream::read_some(stream, buf));
+  BOOST_CHECK_EQUAL(c, buf.front());
 }
 
 static auto const KEY_SIZE = std::unordered_map<CryptoMethod, size_t>{
@@ -237,7 +258,7 @@ template <typename TestCase> void run_test_case(TestCase&& test)
     for (auto&& item : KEY_SIZE) {
       auto [m, s] = item;
       auto ec     = co_await redirect(test(ex, m, s));
-      co_await service::get_sentry(ex).reset();
+      service::get_sentry(ex).reset();
       BOOST_CHECK(!ec);
     }
   });
@@ -254,7 +275,7 @@ BOOST_AUTO_TEST_CASE(SaltSentry_Conflict)
     ec = co_await redirect(send_salt(ex, m, s, 0_u8));
     BOOST_CHECK_EQUAL(make_error_code(PichiError::BAD_PROTO), ec);
 
-    co_await service::get_sentry(ex).reset();
+    service::get_sentry(ex).reset();
   });
 }
 
@@ -266,19 +287,85 @@ BOOST_AUTO_TEST_CASE(SaltSentry_Normal)
       BOOST_CHECK(!ec);
     }
 
-    co_await service::get_sentry(ex).reset();
+    service::get_sentry(ex).reset();
+  });
+}
+
+BOOST_AUTO_TEST_CASE(SaltSentry_Occupancy)
+{
+  run_case([](auto&& ex) -> Awaitable<void> {
+    auto& sentry = service::get_sentry(ex);
+    sentry.reset();
+
+    for (auto c : views::iota(0_u8, 0x10_u8)) {
+      auto salt = std::vector<uint8_t>(32_sz, c);
+      BOOST_CHECK(!sentry.contains(salt));
+      BOOST_CHECK(sentry.contains(salt));
+    }
+
+    auto stats = sentry.stats();
+    BOOST_CHECK_EQUAL(service::SaltSentry::DEFAULT_CAPACITY, stats.capacity_);
+    BOOST_CHECK_EQUAL(0x10_sz, stats.active_);
+    BOOST_CHECK_EQUAL(0_sz, stats.expiring_);
+    BOOST_CHECK_LT(0_sz, stats.bytes_);
+
+    sentry.reset();
+    BOOST_CHECK_EQUAL(0_sz, sentry.stats().active_);
+    co_return;
+  });
+}
+
+BOOST_AUTO_TEST_CASE(SaltSentry_Unauthenticated)
+{
+  run_test_case([](auto&& ex, auto m, auto s) -> Awaitable<void> {
+    auto salt   = std::vector<uint8_t>(s, 0_u8);
+    auto client = TestSocket{ex};
+    auto stream = Stream{m, key_of(m), client.peer()};
+    auto buf    = Buffer{};
+
+    // The garbage following the salt fails the authentication, and the salt isn't recorded
+    co_await stream::write(client, salt);
+    co_await stream::write(client, buf);
+    BOOST_CHECK_THROW(co_await stream::read_some(stream, buf), Botan::Invalid_Authentication_Tag);
+    BOOST_CHECK_EQUAL(0_sz, service::get_sentry(ex).stats().active_);
+
+    co_await send_salt(ex, m, s, 0_u8);
+    BOOST_CHECK_EQUAL(1_sz, service::get_sentry(ex).stats().active_);
   });
 }
 
+BOOST_AUTO_TEST_CASE(SaltSentry_Over_Capacity)
+{
+  auto const CAPACITY = 1_sz << 14;
+
+  // A standalone sentry whose window doesn't expire during the test
+  auto  ctx    = asio::io_context{};
+  auto& sentry = asio::use_service<service::SaltSentry>(ctx);
+  sentry.configure(std::chrono::hours{1}, CAPACITY, 0.01);
+  sentry.initialize(ctx.get_executor());
+
+  auto salt_of = [](size_t i) {
+    auto salt = std::array<uint8_t, sizeof(uint64_t)>{};
+    hton(static_cast<uint64_t>(i), salt);
+    return salt;
+  };
+
+  // Exceeding the capacity degrades the false-positive rate, but forgets no salt within the window
+  for (auto i = 0_sz; i < 2 * CAPACITY; ++i) sentry.contains(salt_of(i));
+  for (auto i = 0_sz; i < 2 * CAPACITY; ++i) BOOST_REQUIRE(sentry.contains(salt_of(i)));
+  BOOST_CHECK_GT(sentry.stats().active_, CAPACITY);
+  BOOST_CHECK_EQUAL(0_sz, sentry.stats().expiring_);
+}
+
 BOOST_AUTO_TEST_CASE(Encryption)
 {
   rngs::for_each(TEST_DATA | views::keys, [](auto&& method) {
-    auto encryptor = Encryptor{method, PASSWORD};
+    auto encryptor = Encryptor{method, *key_of(method)};
     auto decryptor = Decryptor{method};
     auto salt      = decryptor.salt();
 
     rngs::copy(encryptor.salt(), rngs::begin(salt));
-    decryptor.set_psk(PASSWORD);
+    decryptor.set_psk(*key_of(method));
 
     auto fact = PLAINS | views::transform([&](auto&& plain) {
                   auto c = Buffer{};
@@ -295,12 +382,12 @@ BOOST_AUTO_TEST_CASE(Encryption)
 BOOST_AUTO_TEST_CASE(Encryption_With_Empty_Password)
 {
   rngs::for_each(TEST_DATA | views::keys, [](auto&& method) {
-    auto password  = ""s;
-    auto encryptor = Encryptor{method, password};
+    auto key       = stream::derive_master_key(method, ""s);
+    auto encryptor = Encryptor{method, *key};
     auto decryptor = Decryptor{method};
     auto salt      = decryptor.salt();
     rngs::copy(encryptor.salt(), rngs::begin(salt));
-    decryptor.set_psk(password);
+    decryptor.set_psk(*key);
     BOOST_CHECK(rngs::equal(PLAINS, PLAINS | views::transform([&](auto&& plain) {
                                       auto c = Buffer{};
                                       auto n = encryptor.process(plain, c);
@@ -312,6 +399,27 @@ BOOST_AUTO_TEST_CASE(Encryption_With_Empty_Password)
   });
 }
 
+BOOST_AUTO_TEST_CASE(Encryption_In_Place)
+{
+  rngs::for_each(TEST_DATA | views::keys, [](auto&& method) {
+    auto encryptor = Encryptor{method, *key_of(method)};
+    auto decryptor = Decryptor{method};
+    auto salt      = decryptor.salt();
+
+    rngs::copy(encryptor.salt(), rngs::begin(salt));
+    decryptor.set_psk(*key_of(method));
+
+    auto fact = PLAINS | views::transform([&](auto&& plain) {
+                  auto b = Buffer{};
+                  rngs::copy(plain, rngs::begin(b));
+                  auto n = encryptor.process({b, rngs::size(plain)}, b);
+                  auto p = ConstBuffer{b, decryptor.process({b, n}, b)};
+                  return std::string{rngs::begin(p), rngs::end(p)};
+                });
+    BOOST_CHECK(rngs::equal(PLAINS, fact));
+  });
+}
+
 BOOST_AUTO_TEST_CASE(Decryption)
 {
   rngs::for_each(TEST_DATA, [](auto&& item) {
@@ -319,7 +427,7 @@ BOOST_AUTO_TEST_CASE(Decryption)
     auto decryptor = Decryptor{m};
 
     Botan::hex_decode(decryptor.salt(), td.salt_);
-    decryptor.set_psk(PASSWORD);
+    decryptor.set_psk(*key_of(m));
 
     auto fact = td.ciphers_ | views::transform([&](auto&& cipher) {
                   auto c = Buffer{};
@@ -339,7 +447,7 @@ BOOST_AUTO_TEST_CASE(Decryption_Invalid_Tag)
     auto decryptor = Decryptor{m};
 
     Botan::hex_decode(decryptor.salt(), td.salt_);
-    decryptor.set_psk(PASSWORD);
+    decryptor.set_psk(*key_of(m));
 
     auto c = Buffer{};
     auto d = Buffer{};
@@ -359,7 +467,7 @@ BOOST_AUTO_TEST_CASE(Decryption_Invalid_Cipher)
     auto decryptor = Decryptor{m};
 
     Botan::hex_decode(decryptor.salt(), td.salt_);
-    decryptor.set_psk(PASSWORD);
+    decryptor.set_psk(*key_of(m));
 
     auto c = Buffer{};
     auto d = Buffer{};
@@ -379,7 +487,7 @@ BOOST_AUTO_TEST_CASE(Decryption_Invalid_Salt)
     auto decryptor = Decryptor{m};
 
     // Salt is not set
-    decryptor.set_psk(PASSWORD);
+    decryptor.set_psk(*key_of(m));
 
     auto c = Buffer{};
     auto d = Buffer{};
@@ -409,11 +517,58 @@ BOOST_AUTO_TEST_CASE(Decryption_Without_PSK)
   });
 }
 
+BOOST_AUTO_TEST_CASE(CryptoPool_Reused_Cipher)
+{
+  auto const METHOD = CryptoMethod::AES_128_GCM;
+
+  // At least 1 idle cipher is left for the method
+  Decryptor{METHOD};
+
+  auto origin = stream::detail::crypto_pool_stats();
+  {
+    auto decryptor = Decryptor{METHOD};
+    auto stats     = stream::detail::crypto_pool_stats();
+    BOOST_CHECK_EQUAL(origin.hits_ + 1, stats.hits_);
+    BOOST_CHECK_EQUAL(origin.misses_, stats.misses_);
+    BOOST_CHECK_EQUAL(origin.idle_ - 1, stats.idle_);
+  }
+  BOOST_CHECK_EQUAL(origin.idle_, stream::detail::crypto_pool_stats().idle_);
+}
+
+BOOST_AUTO_TEST_CASE(MasterKey_Size)
+{
+  auto k128 = key_of(CryptoMethod::AES_128_GCM);
+  auto k256 = key_of(CryptoMethod::AES_256_GCM);
+
+  BOOST_CHECK_EQUAL(16_sz, rngs::size(*k128));
+  BOOST_CHECK_EQUAL(32_sz, rngs::size(*k256));
+
+  // EVP_BytesToKey derives the shorter key as the prefix of the longer one
+  BOOST_CHECK(rngs::equal(*k128, *k256 | views::take(16)));
+}
+
+BOOST_AUTO_TEST_CASE(CryptoPool_Move_Assignment)
+{
+  auto const METHOD = CryptoMethod::AES_128_GCM;
+
+  auto decryptor = Decryptor{METHOD};
+  auto other     = Decryptor{METHOD};
+  auto origin    = stream::detail::crypto_pool_stats();
+
+  // The cipher replaced by the assignment is given back rather than destroyed
+  decryptor = std::move(other);
+  BOOST_CHECK_EQUAL(origin.idle_ + 1, stream::detail::crypto_pool_stats().idle_);
+
+  // The cipher moved from is given back once only
+  std::invoke([moved = std::move(other)]() {});
+  BOOST_CHECK_EQUAL(origin.idle_ + 1, stream::detail::crypto_pool_stats().idle_);
+}
+
 BOOST_AUTO_TEST_CASE(Stream_accept)
 {
   run_test_case([](auto&& ex, auto m, auto s) -> Awaitable<void> {
     auto client = TestSocket{ex};
-    auto stream = Stream{m, PASSWORD, client.peer()};
+    auto stream = Stream{m, key_of(m), client.peer()};
 
     co_await stream::write(client, SALT | views::take(s));
 
@@ -433,7 +588,7 @@ BOOST_AUTO_TEST_CASE(Stream_connect)
     auto salt = SALT | views::take(s);
 
     auto server = TestSocket{ex};
-    auto stream = Stream{m, PASSWORD, salt, server.peer()};
+    auto stream = Stream{m, key_of(m), salt, server.peer()};
 
     co_await stream::connect(stream, ENDPOINT);
 
@@ -452,7 +607,7 @@ BOOST_AUTO_TEST_CASE(Stream_read)
     auto salt = SALT | views::take(s);
 
     auto client = TestSocket{ex};
-    auto stream = Stream{m, PASSWORD, client.peer()};
+    auto stream = Stream{m, key_of(m), client.peer()};
 
     auto buf = Buffer{};
 
@@ -465,13 +620,83 @@ BOOST_AUTO_TEST_CASE(Stream_read)
   });
 }
 
+BOOST_AUTO_TEST_CASE(Stream_read_Batched_Frames)
+{
+  run_test_case([](auto&& ex, auto m, auto s) -> Awaitable<void> {
+    auto salt = SALT | views::take(s);
+
+    auto client    = TestSocket{ex};
+    auto stream    = Stream{m, key_of(m), client.peer()};
+    auto encryptor = Encryptor{m, *key_of(m), salt};
+
+    // All frames are sent in one piece
+    auto cipher = std::vector<uint8_t>{rngs::begin(salt), rngs::end(salt)};
+    auto expect = std::string{};
+    for (auto&& plain : PLAINS) {
+      auto lb = std::array<uint8_t, 2>{};
+      auto c  = Buffer{};
+      hton(static_cast<uint16_t>(rngs::size(plain)), lb);
+      auto n = encryptor.process(lb, c);
+      n += encryptor.process(plain, MutableBuffer{c} + n);
+      rngs::copy(c | views::take(n), std::back_inserter(cipher));
+      expect += plain;
+    }
+    co_await stream::write(client, cipher);
+
+    auto fact = std::string{};
+    while (rngs::size(fact) < rngs::size(expect)) {
+      auto buf = Buffer{};
+      auto n   = co_await stream::read_some(stream, buf);
+      fact.append(rngs::begin(buf), rngs::begin(buf) + n);
+    }
+    BOOST_CHECK_EQUAL(expect, fact);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Stream_read_Partial_Frames)
+{
+  run_test_case([](auto&& ex, auto m, auto s) -> Awaitable<void> {
+    auto salt = SALT | views::take(s);
+
+    auto client    = TestSocket{ex};
+    auto stream    = Stream{m, key_of(m), client.peer()};
+    auto encryptor = Encryptor{m, *key_of(m), salt};
+
+    // An empty frame is skipped, and each of the others is served by several reads
+    auto cipher = std::vector<uint8_t>{rngs::begin(salt), rngs::end(salt)};
+    auto plains = std::vector{PLAINS[0], ""s, PLAINS[1]};
+    for (auto&& plain : plains) {
+      auto lb = std::array<uint8_t, 2>{};
+      auto c  = Buffer{};
+      hton(static_cast<uint16_t>(rngs::size(plain)), lb);
+      auto n = encryptor.process(lb, c);
+      n += encryptor.process(plain, MutableBuffer{c} + n);
+      rngs::copy(c | views::take(n), std::back_inserter(cipher));
+    }
+    BOOST_CHECK(!stream.buffered());
+    co_await stream::write(client, cipher);
+
+    // The socket isn't waited for until all frames read ahead are served
+    auto expect = PLAINS[0] + PLAINS[1];
+    auto fact   = std::string{};
+    while (rngs::size(fact) < rngs::size(expect)) {
+      auto buf = std::array<uint8_t, 5>{};
+      auto n   = co_await stream::read_some(stream, buf);
+      BOOST_CHECK_LE(n, rngs::size(buf));
+      fact.append(rngs::begin(buf), rngs::begin(buf) + n);
+      BOOST_CHECK_EQUAL(rngs::size(fact) < rngs::size(expect), stream.buffered());
+    }
+    BOOST_CHECK_EQUAL(expect, fact);
+  });
+}
+
 BOOST_AUTO_TEST_CASE(Stream_write)
 {
   run_test_case([](auto&& ex, auto m, auto s) -> Awaitable<void> {
     auto salt = SALT | views::take(s);
 
     auto server = TestSocket{ex};
-    auto stream = Stream{m, PASSWORD, salt, server.peer()};
+    auto stream = Stream{m, key_of(m), salt, server.peer()};
 
     auto buf = Buffer{};
 
@@ -489,7 +714,7 @@ BOOST_AUTO_TEST_CASE(Ingress_read_remote)
   run_test_case([](auto&& ex, auto m, auto s) -> Awaitable<void> {
     auto client  = TestSocket{ex};
     auto ingress = Ingress{
-        {m, PASSWORD, client.peer()}
+        {m, key_of(m), client.peer()}
     };
 
     auto buf = Buffer{};
@@ -514,7 +739,7 @@ BOOST_AUTO_TEST_CASE(Ingress_confirm)
     co_await stream::write(peer, dummy);
 
     auto ingress = Ingress{
-        {m, PASSWORD, std::move(peer)}
+        {m, key_of(m), std::move(peer)}
     };
 
     co_await ingress.confirm();
@@ -535,7 +760,7 @@ BOOST_AUTO_TEST_CASE(Ingress_disconnect)
     co_await stream::write(peer, dummy);
 
     auto ingress = Ingress{
-        {m, PASSWORD, std::move(peer)}
+        {m, key_of(m), std::move(peer)}
     };
 
     co_await ingress.disconnect(makeErrorCode(PichiError::MISC));
@@ -550,7 +775,7 @@ BOOST_AUTO_TEST_CASE(Ingress_recv)
   run_test_case([](auto&& ex, auto m, auto s) -> Awaitable<void> {
     auto client  = TestSocket{ex};
     auto ingress = Ingress{
-        {m, PASSWORD, client.peer()}
+        {m, key_of(m), client.peer()}
     };
 
     auto salt = SALT | views::take(s);
@@ -570,7 +795,7 @@ BOOST_AUTO_TEST_CASE(Ingress_recv_With_Insufficient_Buffer)
   run_test_case([](auto&& ex, auto m, auto s) -> Awaitable<void> {
     auto client  = TestSocket{ex};
     auto ingress = Ingress{
-        {m, PASSWORD, client.peer()}
+        {m, key_of(m), client.peer()}
     };
 
     auto salt = SALT | views::take(s);
@@ -596,7 +821,7 @@ BOOST_AUTO_TEST_CASE(Ingress_send)
 
     auto client  = TestSocket{ex};
     auto ingress = Ingress{
-        {m, PASSWORD, salt, client.peer()}
+        {m, key_of(m), salt, client.peer()}
     };
 
     auto buf = Buffer{};
@@ -616,7 +841,7 @@ BOOST_AUTO_TEST_CASE(Egress_connect)
 
     auto server = TestSocket{ex};
     auto egress = Egress{
-        {m, PASSWORD, salt, server.peer()}
+        {m, key_of(m), salt, server.peer()}
     };
 
     co_await egress.connect(ENDPOINT);
@@ -635,7 +860,7 @@ BOOST_AUTO_TEST_CASE(Egress_recv)
 
     auto server = TestSocket{ex};
     auto egress = Egress{
-        {m, PASSWORD, salt, server.peer()}
+        {m, key_of(m), salt, server.peer()}
     };
 
     auto buf = Buffer{};
@@ -656,7 +881,7 @@ BOOST_AUTO_TEST_CASE(Egress_recv_With_Insufficient_Buffer)
 
     auto server = TestSocket{ex};
     auto egress = Egress{
-        {m, PASSWORD, salt, server.peer()}
+        {m, key_of(m), salt, server.peer()}
     };
 
     auto buf = Buffer{};
@@ -681,7 +906,7 @@ BOOST_AUTO_TEST_CASE(Egress_send)
 
     auto server = TestSocket{ex};
     auto egress = Egress{
-        {m, PASSWORD, salt, server.peer()}
+        {m, key_of(m), salt, server.peer()}
     };
 
     auto buf = Buffer{};
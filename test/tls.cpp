@@ -0,0 +1,284 @@
+#define BOOST_TEST_MODULE pichi tls test
+
+#include "utils.hpp"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/write.hpp>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <openssl/evp.h>
+#include <openssl/obj_mac.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <pichi/common/literals.hpp>
+#include <pichi/stream/tls.hpp>
+#include <pichi/stream/tls_server.hpp>
+#include <stdio.h>
+#include <string>
+#include <thread>
+
+using namespace std::literals;
+namespace asio = boost::asio;
+namespace fs   = std::filesystem;
+namespace ip   = asio::ip;
+namespace ssl  = asio::ssl;
+
+using ip::tcp;
+
+namespace pichi::unit_test {
+
+static auto const CERT_FILE = (fs::temp_directory_path() / "pichi_tls_server_cert.pem").string();
+static auto const KEY_FILE  = (fs::temp_directory_path() / "pichi_tls_server_key.pem").string();
+
+// Write a self-signed certificate along with its private key
+static void generate(std::string const& cert, std::string const& key)
+{
+  using PKeyCtx = std::unique_ptr<::EVP_PKEY_CTX, decltype(&::EVP_PKEY_CTX_free)>;
+  using PKey    = std::unique_ptr<::EVP_PKEY, decltype(&::EVP_PKEY_free)>;
+
+  auto kctx = PKeyCtx{::EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr), &::EVP_PKEY_CTX_free};
+  BOOST_REQUIRE(::EVP_PKEY_keygen_init(kctx.get()) == 1);
+  BOOST_REQUIRE(::EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx.get(), NID_X9_62_prime256v1) == 1);
+  auto raw = static_cast<::EVP_PKEY*>(nullptr);
+  BOOST_REQUIRE(::EVP_PKEY_keygen(kctx.get(), &raw) == 1);
+  auto pkey = PKey{raw, &::EVP_PKEY_free};
+
+  auto x509 = std::unique_ptr<::X509, decltype(&::X509_free)>{::X509_new(), &::X509_free};
+  ::ASN1_INTEGER_set(::X509_get_serialNumber(x509.get()), 1);
+  ::X509_gmtime_adj(::X509_getm_notBefore(x509.get()), 0);
+  ::X509_gmtime_adj(::X509_getm_notAfter(x509.get()), 3600);
+  ::X509_set_pubkey(x509.get(), pkey.get());
+  ::X509_set_issuer_name(x509.get(), ::X509_get_subject_name(x509.get()));
+  BOOST_REQUIRE(::X509_sign(x509.get(), pkey.get(), ::EVP_sha256()) > 0);
+
+  auto fp = ::fopen(cert.c_str(), "w");
+  BOOST_REQUIRE(fp != nullptr);
+  ::PEM_write_X509(fp, x509.get());
+  ::fclose(fp);
+
+  fp = ::fopen(key.c_str(), "w");
+  BOOST_REQUIRE(fp != nullptr);
+  ::PEM_write_PrivateKey(fp, pkey.get(), nullptr, nullptr, 0, nullptr, nullptr);
+  ::fclose(fp);
+}
+
+// The modification is noticed even if the file system records time coarsely
+static void touch(std::string const& file, std::chrono::seconds offset)
+{
+  fs::last_write_time(file, fs::last_write_time(file) + offset);
+}
+
+static stream::TlsServerContext
+    make_context(std::chrono::seconds rotation = stream::TlsServerContext::DEFAULT_ROTATION)
+{
+  generate(CERT_FILE, KEY_FILE);
+  return stream::TlsServerContext{{.certFile_ = CERT_FILE, .keyFile_ = KEY_FILE}, rotation};
+}
+
+static auto make_client()
+{
+  return std::make_shared<ssl::context>(
+      stream::tls_context(vo::TlsEgressOption{.insecure_ = true}, "localhost"s)
+  );
+}
+
+static tcp::acceptor make_acceptor(asio::io_context& io)
+{
+  return {io, {ip::make_address("127.0.0.1"), 0}};
+}
+
+// Each connection handshakes and then exchanges one byte, which carries the tickets of TLS 1.3
+static void connect(std::shared_ptr<ssl::context> const& client, ssl::context& server, size_t n)
+{
+  auto io = asio::io_context{};
+  auto ac = make_acceptor(io);
+  asio::co_spawn(
+      io,
+      [&]() -> Awaitable<void> {
+        for (auto i = 0_sz; i < n; ++i) {
+          auto s = ssl::stream<tcp::socket>{co_await ac.async_accept(asio::use_awaitable), server};
+          co_await s.async_handshake(ssl::stream_base::server, asio::use_awaitable);
+          auto c = 'x';
+          co_await asio::async_write(s, asio::buffer(&c, 1), asio::use_awaitable);
+        }
+      },
+      [](auto&& eptr) { BOOST_CHECK(!eptr); }
+  );
+  asio::co_spawn(
+      io,
+      [&]() -> Awaitable<void> {
+        for (auto i = 0_sz; i < n; ++i) {
+          auto s = stream::Tls<tcp::socket>{client, tcp::socket{io}};
+          co_await s.next_layer().async_connect(ac.local_endpoint(), asio::use_awaitable);
+          co_await s.async_handshake(asio::use_awaitable);
+          auto c = '\0';
+          co_await asio::async_read(s, asio::buffer(&c, 1), asio::use_awaitable);
+        }
+      },
+      [](auto&& eptr) { BOOST_CHECK(!eptr); }
+  );
+  io.run();
+}
+
+BOOST_AUTO_TEST_SUITE(TLS)
+
+BOOST_AUTO_TEST_CASE(tls_stats_Resumed)
+{
+  auto server = make_context();
+  auto client = make_client();
+
+  connect(client, *server.get(), 3);
+
+  auto stats = stream::tls_stats(*client);
+  BOOST_CHECK_EQUAL(3, stats.handshakes_);
+  BOOST_CHECK_EQUAL(2, stats.resumed_);
+}
+
+BOOST_AUTO_TEST_CASE(tls_stats_Not_Resumed)
+{
+  auto client = make_client();
+
+  // The tickets issued by one server are useless for another one
+  for (auto i = 0; i < 2; ++i) {
+    auto server = make_context();
+    connect(client, *server.get(), 1);
+  }
+
+  auto stats = stream::tls_stats(*client);
+  BOOST_CHECK_EQUAL(2, stats.handshakes_);
+  BOOST_CHECK_EQUAL(0, stats.resumed_);
+}
+
+BOOST_AUTO_TEST_CASE(tls_stats_Server)
+{
+  auto server = make_context();
+  BOOST_CHECK_EQUAL(0, stream::tls_stats(*server.get()).handshakes_);
+}
+
+BOOST_AUTO_TEST_CASE(stats_Resumed)
+{
+  auto server = make_context();
+
+  connect(make_client(), *server.get(), 3);
+
+  auto stats = server.stats();
+  BOOST_CHECK_EQUAL(3, stats.handshakes_);
+  BOOST_CHECK_EQUAL(2, stats.resumed_);
+}
+
+BOOST_AUTO_TEST_CASE(stats_Without_Tickets)
+{
+  auto server = make_context(0s);
+  auto client = make_client();
+
+  connect(client, *server.get(), 2);
+  BOOST_CHECK(!server.rotate());
+
+  BOOST_CHECK_EQUAL(2, server.stats().handshakes_);
+  BOOST_CHECK_EQUAL(0, server.stats().resumed_);
+  BOOST_CHECK_EQUAL(0, stream::tls_stats(*client).resumed_);
+}
+
+BOOST_AUTO_TEST_CASE(reload_Tickets_Kept)
+{
+  auto server = make_context();
+  auto client = make_client();
+
+  connect(client, *server.get(), 1);
+  touch(CERT_FILE, 2s);
+  BOOST_REQUIRE(server.reload());
+  connect(client, *server.get(), 1);
+
+  BOOST_CHECK_EQUAL(2, server.stats().handshakes_);
+  BOOST_CHECK_EQUAL(1, server.stats().resumed_);
+}
+
+BOOST_AUTO_TEST_CASE(rotate_Previous_Key)
+{
+  auto server = make_context(1s);
+  auto client = make_client();
+
+  BOOST_CHECK(!server.rotate());
+  connect(client, *server.get(), 1);
+  std::this_thread::sleep_for(1s);
+  BOOST_REQUIRE(server.rotate());
+  connect(client, *server.get(), 1);
+
+  BOOST_CHECK_EQUAL(1, server.stats().resumed_);
+}
+
+BOOST_AUTO_TEST_CASE(rotate_Expired_Key)
+{
+  auto server = make_context(1s);
+  auto client = make_client();
+
+  connect(client, *server.get(), 1);
+  for (auto i = 0; i < 2; ++i) {
+    std::this_thread::sleep_for(1s);
+    BOOST_REQUIRE(server.rotate());
+  }
+  connect(client, *server.get(), 1);
+
+  BOOST_CHECK_EQUAL(2, server.stats().handshakes_);
+  BOOST_CHECK_EQUAL(0, server.stats().resumed_);
+}
+
+BOOST_AUTO_TEST_CASE(TlsServerContext_Invalid_Files)
+{
+  BOOST_CHECK_THROW(
+      stream::TlsServerContext({.certFile_ = "non-existent"s, .keyFile_ = "non-existent"s}),
+      boost::system::system_error
+  );
+}
+
+BOOST_AUTO_TEST_CASE(reload_Unmodified)
+{
+  auto tls = make_context();
+  auto ctx = tls.get();
+
+  BOOST_CHECK(!tls.reload());
+  BOOST_CHECK(ctx == tls.get());
+}
+
+BOOST_AUTO_TEST_CASE(reload_Modified)
+{
+  auto tls = make_context();
+  auto ctx = tls.get();
+
+  generate(CERT_FILE, KEY_FILE);
+  touch(CERT_FILE, 2s);
+  touch(KEY_FILE, 2s);
+  BOOST_CHECK(tls.reload());
+  BOOST_CHECK(ctx != tls.get());
+
+  // The old context is still held by its users
+  BOOST_CHECK(ctx->native_handle() != nullptr);
+  BOOST_CHECK(!tls.reload());
+}
+
+BOOST_AUTO_TEST_CASE(reload_Mismatched)
+{
+  auto tls = make_context();
+  auto ctx = tls.get();
+
+  // Only the certificate is replaced, whose private key is another one
+  generate(CERT_FILE, KEY_FILE + ".tmp"s);
+  fs::remove(KEY_FILE + ".tmp"s);
+  touch(CERT_FILE, 2s);
+  BOOST_CHECK_THROW(tls.reload(), boost::system::system_error);
+  BOOST_CHECK(ctx == tls.get());
+
+  // Retried once the private key is replaced too
+  generate(CERT_FILE, KEY_FILE);
+  touch(CERT_FILE, 4s);
+  touch(KEY_FILE, 4s);
+  BOOST_CHECK(tls.reload());
+  BOOST_CHECK(ctx != tls.get());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace pichi::unit_test
@@ -1,13 +1,103 @@
 #define BOOST_TEST_MODULE pichi uri test
 
 #include "utils.hpp"
+#include <array>
 #include <boost/test/unit_test.hpp>
+#include <optional>
 #include <pichi/common/uri.hpp>
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
 
 using namespace std;
 
 namespace pichi::unit_test {
 
+/*
+ * The regex based implementation replaced by the linear parser, which is kept as the reference of
+ * the differential tests.
+ */
+namespace legacy {
+
+static auto const URI_REGEX =
+    regex{"^(https?)://(([^:/?#\\[\\]]+)|\\[([a-f0-9:.]+)\\])(:(\\d+))?(/[^#?]*([#?].*)?)?$",
+          regex::icase};
+static auto const HOST_REGEX = regex{"^(([^:/\\[\\]]+)|\\[([a-f0-9:.]+)\\])(:(\\d+))?$"};
+
+static string_view r2sv(csub_match const& m) { return {m.first, static_cast<size_t>(m.length())}; }
+
+static optional<array<string, 7>> parse_uri(string_view s)
+{
+  auto r = cmatch{};
+  if (!regex_match(s.data(), s.data() + s.size(), r, URI_REGEX)) return nullopt;
+
+  auto scheme = r2sv(r[1]);
+  auto https  = scheme.size() == 5;
+  return array<string, 7>{
+      string{r2sv(r[0])},
+      string{scheme},
+      string{r[3].matched ? r2sv(r[3]) : r2sv(r[4])},
+      string{r[5].matched ? r2sv(r[6]) : (https ? "443"sv : "80"sv)},
+      string{r[7].matched ? r2sv(r[7]) : "/"sv},
+      r[7].matched ? string{r[7].first, r[8].matched ? r[8].first : r[7].second} : "/"s,
+      string{r[8].matched ? r2sv(r[8]) : ""sv},
+  };
+}
+
+static optional<array<string, 2>> parse_host(string_view s)
+{
+  auto r = cmatch{};
+  if (!regex_match(s.data(), s.data() + s.size(), r, HOST_REGEX)) return nullopt;
+  return array<string, 2>{
+      string{r[2].matched ? r2sv(r[2]) : r2sv(r[3])},
+      string{r[4].matched ? r2sv(r[5]) : "80"sv},
+  };
+}
+
+}  // namespace legacy
+
+static optional<array<string, 7>> parse_uri(string_view s)
+{
+  try {
+    auto uri = Uri{s};
+    return array<string, 7>{
+        string{uri.all_},
+        string{uri.scheme_},
+        string{uri.host_},
+        string{uri.port_},
+        string{uri.suffix_},
+        string{uri.path_},
+        string{uri.query_},
+    };
+  }
+  catch (SystemError const& e) {
+    BOOST_CHECK(verify_exception<PichiError::BAD_PROTO>(e));
+    return nullopt;
+  }
+}
+
+static optional<array<string, 2>> parse_host(string_view s)
+{
+  try {
+    auto hp = HostAndPort{s};
+    return array<string, 2>{string{hp.host_}, string{hp.port_}};
+  }
+  catch (SystemError const& e) {
+    BOOST_CHECK(verify_exception<PichiError::BAD_PROTO>(e));
+    return nullopt;
+  }
+}
+
+// The random strings made up of the characters significant to the grammars
+static string gen_random(mt19937& gen, string_view prefix)
+{
+  static auto const ALPHABET = "hHtTpPsS:/[]?#.0189aAfFgZ %\r\n"sv;
+  auto              ret      = string{prefix};
+  for (auto n = gen() % 16; n > 0; --n) ret.push_back(ALPHABET[gen() % ALPHABET.size()]);
+  return ret;
+}
+
 BOOST_AUTO_TEST_SUITE(URI)
 
 BOOST_AUTO_TEST_CASE(Uri_Bad_Scheme)
@@ -246,6 +336,27 @@ BOOST_AUTO_TEST_CASE(HostAndPort_IPv6)
   BOOST_CHECK_EQUAL("::1", HostAndPort{"[::1]:80"}.host_);
 }
 
+BOOST_AUTO_TEST_CASE(Uri_Differential)
+{
+  auto gen = mt19937{};
+  for (auto prefix : {""sv, "http://"sv, "HTTPS://"sv, "http://["sv, "https://example.com"sv,
+                      "http://example.com:80/"sv, "http://[::1]"sv, "ws://"sv})
+    for (auto i = 0; i < 20000; ++i) {
+      auto s = gen_random(gen, prefix);
+      BOOST_CHECK_MESSAGE(parse_uri(s) == legacy::parse_uri(s), s);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(HostAndPort_Differential)
+{
+  auto gen = mt19937{};
+  for (auto prefix : {""sv, "["sv, "example.com"sv, "example.com:"sv, "[fe80::1]"sv})
+    for (auto i = 0; i < 20000; ++i) {
+      auto s = gen_random(gen, prefix);
+      BOOST_CHECK_MESSAGE(parse_host(s) == legacy::parse_host(s), s);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }  // namespace pichi::unit_test
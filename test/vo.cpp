@@ -104,6 +104,10 @@ template <typename Option> Value defaultOptionJson()
     ret.AddMember(websocket::PATH, ph, alloc);
     ret.AddMember(websocket::HOST, ph, alloc);
   }
+  else if constexpr (is_same_v<Option, MuxOption>) {
+    ret.AddMember(mux::CONNECTIONS, Value{1_u16}, alloc);
+    ret.AddMember(mux::STREAMS, Value{1_u16}, alloc);
+  }
   return ret;
 }
 
@@ -114,6 +118,7 @@ template Value defaultOptionJson<TrojanOption>();
 template Value defaultOptionJson<TlsIngressOption>();
 template Value defaultOptionJson<TlsEgressOption>();
 template Value defaultOptionJson<WebsocketOption>();
+template Value defaultOptionJson<MuxOption>();
 
 template <typename Option> Option defaultOption()
 {
@@ -139,6 +144,9 @@ template <typename Option> Option defaultOption()
   else if constexpr (is_same_v<Option, WebsocketOption>) {
     return {ph, ph};
   }
+  else if constexpr (is_same_v<Option, MuxOption>) {
+    return {1_u16, 1_u16};
+  }
   else
     return {};
 }
@@ -150,5 +158,6 @@ template TrojanOption      defaultOption<>();
 template TlsIngressOption  defaultOption<>();
 template TlsEgressOption   defaultOption<>();
 template WebsocketOption   defaultOption<>();
+template MuxOption         defaultOption<>();
 
 }  // namespace pichi::unit_test
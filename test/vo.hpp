@@ -25,7 +25,7 @@ template <typename Credential> rapidjson::Value defaultCredentialJson();
 
 using AllOptions = boost::mpl::set<
     vo::ShadowsocksOption, vo::TunnelOption, vo::RejectOption, vo::TrojanOption,
-    vo::TlsIngressOption, vo::TlsEgressOption, vo::WebsocketOption>;
+    vo::TlsIngressOption, vo::TlsEgressOption, vo::WebsocketOption, vo::MuxOption>;
 
 template <typename Key, typename Set> using HasKeyT = typename boost::mpl::has_key<Set, Key>::type;
 template <typename Key, typename Set> inline constexpr bool HasKey = HasKeyT<Key, Set>::value;
@@ -37,6 +37,7 @@ template <> struct AdapterTrait<AdapterType::DIRECT> {
   static const auto option_     = Present::UNUSED;
   static const auto tls_        = Present::UNUSED;
   static const auto websocket_  = Present::UNUSED;
+  static const auto mux_        = Present::UNUSED;
 };
 
 template <> struct AdapterTrait<AdapterType::HTTP> {
@@ -46,6 +47,7 @@ template <> struct AdapterTrait<AdapterType::HTTP> {
   static const auto option_     = Present::UNUSED;
   static const auto tls_        = Present::OPTIONAL;
   static const auto websocket_  = Present::UNUSED;
+  static const auto mux_        = Present::UNUSED;
   using Credential              = UpEgressCredential;
 };
 
@@ -56,6 +58,7 @@ template <> struct AdapterTrait<AdapterType::SOCKS5> {
   static const auto option_     = Present::UNUSED;
   static const auto tls_        = Present::OPTIONAL;
   static const auto websocket_  = Present::UNUSED;
+  static const auto mux_        = Present::UNUSED;
   using Credential              = UpEgressCredential;
 };
 
@@ -66,6 +69,7 @@ template <> struct AdapterTrait<AdapterType::REJECT> {
   static const auto option_     = Present::MANDATORY;
   static const auto tls_        = Present::UNUSED;
   static const auto websocket_  = Present::UNUSED;
+  static const auto mux_        = Present::UNUSED;
   using Option                  = RejectOption;
 };
 
@@ -76,6 +80,7 @@ template <> struct AdapterTrait<AdapterType::SS> {
   static const auto option_     = Present::MANDATORY;
   static const auto tls_        = Present::UNUSED;
   static const auto websocket_  = Present::UNUSED;
+  static const auto mux_        = Present::UNUSED;
   using Option                  = ShadowsocksOption;
 };
 
@@ -86,6 +91,7 @@ template <> struct AdapterTrait<AdapterType::TROJAN> {
   static const auto option_     = Present::UNUSED;
   static const auto tls_        = Present::MANDATORY;
   static const auto websocket_  = Present::OPTIONAL;
+  static const auto mux_        = Present::OPTIONAL;
   using Credential              = TrojanEgressCredential;
 };
 
@@ -111,6 +117,8 @@ template <AdapterType type> Value defaultEgressJson()
     egress.AddMember(egress::TLS, defaultOptionJson<TlsEgressOption>(), alloc);
   if constexpr (Trait::websocket_ == Present::MANDATORY)
     egress.AddMember(egress::WEBSOCKET, defaultOptionJson<WebsocketOption>(), alloc);
+  if constexpr (Trait::mux_ == Present::MANDATORY)
+    egress.AddMember(egress::MUX, defaultOptionJson<MuxOption>(), alloc);
   return egress;
 }
 
@@ -127,6 +135,7 @@ template <AdapterType type> Egress defaultEgress()
   if constexpr (Trait::tls_ == Present::MANDATORY) egress.tls_ = defaultOption<TlsEgressOption>();
   if constexpr (Trait::websocket_ == Present::MANDATORY)
     egress.websocket_ = defaultOption<WebsocketOption>();
+  if constexpr (Trait::mux_ == Present::MANDATORY) egress.mux_ = defaultOption<MuxOption>();
   return egress;
 }
 
@@ -227,6 +236,14 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(parse_Optional_Fields, Trait, AllAdapterTraits)
         )) == egress
     );
   }
+  if constexpr (Trait::mux_ == Present::OPTIONAL) {
+    auto egress = defaultEgress<Trait::type_>();
+    egress.mux_ = defaultOption<MuxOption>();
+    BOOST_CHECK(
+        parse<Egress>(defaultEgressJson<Trait::type_>()
+                          .AddMember(egress::MUX, defaultOptionJson<MuxOption>(), alloc)) == egress
+    );
+  }
 }
 
 BOOST_AUTO_TEST_CASE_TEMPLATE(parse_Unused_Fields, Trait, AllAdapterTraits)
@@ -242,6 +259,8 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(parse_Unused_Fields, Trait, AllAdapterTraits)
     json.AddMember(egress::TLS, defaultOptionJson<TlsEgressOption>(), alloc);
   if constexpr (Trait::websocket_ == Present::UNUSED)
     json.AddMember(egress::WEBSOCKET, defaultOptionJson<WebsocketOption>(), alloc);
+  if constexpr (Trait::mux_ == Present::UNUSED)
+    json.AddMember(egress::MUX, defaultOptionJson<MuxOption>(), alloc);
   BOOST_CHECK(parse<Egress>(json) == defaultEgress<Trait::type_>());
 }
 
@@ -307,6 +326,10 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(toJson_Optional_Fields, Trait, AllAdapterTraits)
     egress.websocket_ = defaultOption<WebsocketOption>();
     json.AddMember(egress::WEBSOCKET, defaultOptionJson<WebsocketOption>(), alloc);
   }
+  if constexpr (Trait::mux_ == Present::OPTIONAL) {
+    egress.mux_ = defaultOption<MuxOption>();
+    json.AddMember(egress::MUX, defaultOptionJson<MuxOption>(), alloc);
+  }
 
   BOOST_CHECK(toJson(egress, alloc) == json);
 }
@@ -321,6 +344,7 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(toJson_Unused_Fields, Trait, AllAdapterTraits)
   if constexpr (Trait::tls_ == Present::UNUSED) egress.tls_ = defaultOption<TlsEgressOption>();
   if constexpr (Trait::websocket_ == Present::UNUSED)
     egress.websocket_ = defaultOption<WebsocketOption>();
+  if constexpr (Trait::mux_ == Present::UNUSED) egress.mux_ = defaultOption<MuxOption>();
   BOOST_CHECK(toJson(egress, alloc) == defaultEgressJson<Trait::type_>());
 }
 
@@ -127,6 +127,19 @@ BOOST_AUTO_TEST_CASE(parse_TrojanOption_Mandatory_Fields)
   BOOST_CHECK_EXCEPTION(parse<TrojanOption>(generateJsonWithout<TrojanOption>(option::REMOTE)), SystemError, verify_exception<PichiError::BAD_JSON>);
 }
 
+BOOST_AUTO_TEST_CASE(parse_TrojanOption_Optional_Fields)
+{
+  auto noMux = parse<TrojanOption>(defaultOptionJson<TrojanOption>());
+  BOOST_CHECK(!noMux.mux_);
+  BOOST_CHECK(!toJson(noMux, alloc).HasMember(option::MUX));
+
+  auto json = defaultOptionJson<TrojanOption>();
+  json.AddMember(option::MUX, true, alloc);
+  auto mux = parse<TrojanOption>(json);
+  BOOST_CHECK(mux.mux_);
+  BOOST_CHECK(toJson(mux, alloc) == json);
+}
+
 BOOST_AUTO_TEST_CASE(parse_TlsIngressOption_Mandatory_Fields)
 {
   BOOST_CHECK_EXCEPTION(parse<TlsIngressOption>(generateJsonWithout<TlsIngressOption>(tls::CERT_FILE)), SystemError, verify_exception<PichiError::BAD_JSON>);
@@ -134,6 +147,34 @@ BOOST_AUTO_TEST_CASE(parse_TlsIngressOption_Mandatory_Fields)
   BOOST_CHECK_EXCEPTION(parse<TlsIngressOption>(generateJsonWithout<TlsIngressOption>(tls::KEY_FILE)), SystemError, verify_exception<PichiError::BAD_JSON>);
 }
 
+BOOST_AUTO_TEST_CASE(parse_TlsIngressOption_ALPN)
+{
+  auto json = defaultOptionJson<TlsIngressOption>();
+  auto alpn = Value{kArrayType};
+  alpn.PushBack("h2", alloc).PushBack("http/1.1", alloc);
+  json.AddMember(tls::ALPN, alpn, alloc);
+
+  auto opt = parse<TlsIngressOption>(json);
+  BOOST_CHECK(opt.alpn_ == (vector<string>{"h2", "http/1.1"}));
+  BOOST_CHECK(toJson(opt, alloc) == json);
+
+  json[tls::ALPN].PushBack(toJson(string(256, 'a'), alloc), alloc);
+  BOOST_CHECK_EXCEPTION(
+      parse<TlsIngressOption>(json), SystemError, verify_exception<PichiError::BAD_JSON>
+  );
+}
+
+BOOST_AUTO_TEST_CASE(parse_TlsIngressOption_Empty_ALPN)
+{
+  auto json = defaultOptionJson<TlsIngressOption>();
+  auto alpn = Value{kArrayType};
+  alpn.PushBack("h2", alloc).PushBack("", alloc);
+  json.AddMember(tls::ALPN, alpn, alloc);
+  BOOST_CHECK_EXCEPTION(
+      parse<TlsIngressOption>(json), SystemError, verify_exception<PichiError::BAD_JSON>
+  );
+}
+
 BOOST_AUTO_TEST_CASE(parse_TlsEgressOption_Default_Values)
 {
   auto def = parse<TlsEgressOption>(Value{kObjectType});
@@ -201,6 +242,28 @@ BOOST_AUTO_TEST_CASE(toJson_WebsocketOption_Optional_Fields)
   BOOST_CHECK(!json.HasMember(websocket::HOST));
 }
 
+BOOST_AUTO_TEST_CASE(parse_MuxOption_Default_Values)
+{
+  auto def = parse<MuxOption>(Value{kObjectType});
+  BOOST_CHECK_EQUAL(def.connections_, 2_u16);
+  BOOST_CHECK_EQUAL(def.streams_, 32_u16);
+}
+
+BOOST_AUTO_TEST_CASE(parse_MuxOption_Zero_Values)
+{
+  auto noConnections              = defaultOptionJson<MuxOption>();
+  noConnections[mux::CONNECTIONS] = 0_u16;
+  BOOST_CHECK_EXCEPTION(
+      parse<MuxOption>(noConnections), SystemError, verify_exception<PichiError::BAD_JSON>
+  );
+
+  auto noStreams          = defaultOptionJson<MuxOption>();
+  noStreams[mux::STREAMS] = 0_u16;
+  BOOST_CHECK_EXCEPTION(
+      parse<MuxOption>(noStreams), SystemError, verify_exception<PichiError::BAD_JSON>
+  );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }  // namespace pichi::unit_test
@@ -187,6 +187,19 @@ BOOST_AUTO_TEST_CASE(parse_Rule_With_Empty_Fields_Content)
   );
 }
 
+BOOST_AUTO_TEST_CASE(parse_Rule_With_Unsupported_Pattern)
+{
+  for (auto&& p : {"(a)\\1", "(?=a)", "a\\b", "(a{1000}){1000}", "(a"}) {
+    auto pattern = vo::Rule{};
+    pattern.pattern_.emplace_back(p);
+    BOOST_CHECK_EXCEPTION(
+        parse<vo::Rule>(to_string(pattern)),
+        SystemError,
+        verify_exception<PichiError::SEMANTIC_ERROR>
+    );
+  }
+}
+
 BOOST_AUTO_TEST_CASE(parse_Rule_With_Superfluous_Field)
 {
   BOOST_CHECK(vo::Rule{} == parse<vo::Rule>("{\"superfluous_field\":\"none\"}"));
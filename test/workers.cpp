@@ -0,0 +1,86 @@
+#define BOOST_TEST_MODULE pichi workers test
+
+#include "utils.hpp"
+#include <boost/asio/io_context.hpp>
+#include <pichi/service/balancer.hpp>
+#include <pichi/service/workers.hpp>
+#include <pichi/vo/ingress.hpp>
+
+using namespace std::literals;
+namespace asio = boost::asio;
+
+namespace pichi::unit_test {
+
+BOOST_AUTO_TEST_SUITE(WORKERS)
+
+BOOST_AUTO_TEST_CASE(Detached_Context)
+{
+  auto io = asio::io_context{};
+  auto ex = IOExecutor{io.get_executor()};
+
+  BOOST_CHECK(service::primary_executor(ex) == ex);
+
+  auto workers = service::worker_executors(ex);
+  BOOST_REQUIRE_EQUAL(1, workers.size());
+  BOOST_CHECK(workers.front() == ex);
+}
+
+BOOST_AUTO_TEST_CASE(Single_Thread)
+{
+  auto io   = asio::io_context{};
+  auto ex   = IOExecutor{io.get_executor()};
+  auto pool = service::WorkerPool{io, 1};
+
+  BOOST_CHECK(service::primary_executor(ex) == ex);
+  BOOST_CHECK_EQUAL(1, service::worker_executors(ex).size());
+}
+
+BOOST_AUTO_TEST_CASE(Multiple_Threads)
+{
+  auto io   = asio::io_context{};
+  auto ex   = IOExecutor{io.get_executor()};
+  auto pool = service::WorkerPool{io, 4};
+
+  auto workers = service::worker_executors(ex);
+  BOOST_REQUIRE_EQUAL(4, workers.size());
+  BOOST_CHECK(workers.front() == ex);
+  for (auto&& worker : workers) {
+    BOOST_CHECK(service::primary_executor(worker) == ex);
+    BOOST_CHECK_EQUAL(4, service::worker_executors(worker).size());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Shared_Balancer)
+{
+  auto io   = asio::io_context{};
+  auto pool = service::WorkerPool{io, 2};
+
+  auto workers = service::worker_executors(io.get_executor());
+  auto vo      = vo::Ingress{
+      .type_ = AdapterType::TUNNEL,
+      .opt_  = vo::TunnelOption{.destinations_ = {makeEndpoint("localhost", 443)},
+                                .balance_      = BalanceType::ROUND_ROBIN},
+      .name_ = "pichi"s,
+  };
+
+  asio::co_spawn(
+      io,
+      [&]() -> Awaitable<void> {
+        co_await service::create_balancer(workers.front(), vo);
+        // The balancer created by the primary context is visible to the other workers
+        auto balancer =
+            co_await exec_to(workers.back(), service::get_balancer(workers.back(), vo.name_));
+        BOOST_CHECK(co_await balancer->select() == makeEndpoint("localhost", 443));
+        service::remove_balancer(workers.back(), vo.name_);
+      },
+      [&](auto&& eptr) {
+        BOOST_CHECK(!eptr);
+        io.stop();
+      }
+  );
+  io.run();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}  // namespace pichi::unit_test